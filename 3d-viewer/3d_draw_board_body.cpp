@@ -44,6 +44,7 @@
 #include <class_pcb_text.h>
 #include <colors_selection.h>
 #include <convert_basic_shapes_to_polygon.h>
+#include <clearance_poly_cache.h>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/matrix_transform.hpp>
 #include <gal/opengl/opengl_compositor.h>
@@ -203,6 +204,11 @@ void EDA_3D_CANVAS::buildBoard3DView( GLuint aBoardList, GLuint aBodyOnlyList,
 
     LSET            cu_set = LSET::AllCuMask( GetPrm3DVisu().m_CopperLayersCount );
 
+    // Tracks and pads shapes are shared with the zone filling and the plotter
+    CLEARANCE_POLY_CACHE* polyCache = pcb->GetClearancePolyCache();
+
+    polyCache->Prune( pcb );
+
     glNewList( aBoardList, GL_COMPILE );
 
     for( LSEQ cu = cu_set.CuStack();  cu;  ++cu )
@@ -227,9 +233,9 @@ void EDA_3D_CANVAS::buildBoard3DView( GLuint aBoardList, GLuint aBodyOnlyList,
             if( !track->IsOnLayer( layer ) )
                 continue;
 
-            track->TransformShapeWithClearanceToPolygon( bufferPolys,
-                                                         0, segcountforcircle,
-                                                         correctionFactor );
+            polyCache->TransformShapeWithClearanceToPolygon( track, bufferPolys,
+                                                             0, segcountforcircle,
+                                                             correctionFactor );
 
             // Add blind/buried via holes
             if( track->Type() == PCB_VIA_T )
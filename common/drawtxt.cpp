@@ -42,6 +42,7 @@
 
 #include <newstroke_font.h>
 #include <plot_common.h>
+#include <stroke_glyph_cache.h>
 
 /* factor used to calculate actual size of shapes from hershey fonts
  * (could be adjusted depending on the font name)
@@ -138,16 +139,16 @@ int NegableTextLength( const wxString& aText )
 }
 
 
-/* Function GetHersheyShapeDescription
- * return a pointer to the shape corresponding to unicode value AsciiCode
+/* Function GetHersheyGlyph
+ * return the glyph corresponding to unicode value AsciiCode
  * Note we use the same font for Bold and Normal texts
  * because KiCad handles a variable pen size to do that
  * that gives better results in XOR draw mode.
  */
-static const char* GetHersheyShapeDescription( int AsciiCode )
+static const STROKE_GLYPHS::GLYPH& GetHersheyGlyph( const STROKE_GLYPHS& aGlyphs, int AsciiCode )
 {
     // calculate font length
-    int font_length_max = newstroke_font_bufsize;
+    int font_length_max = aGlyphs.GlyphCount();
 
     if( AsciiCode >= (32 + font_length_max) )
         AsciiCode = '?';
@@ -157,12 +158,14 @@ static const char* GetHersheyShapeDescription( int AsciiCode )
 
     AsciiCode -= 32;
 
-    return newstroke_font[AsciiCode];
+    return aGlyphs.Glyph( AsciiCode );
 }
 
 
 int GraphicTextWidth( const wxString& aText, int aXSize, bool aItalic, bool aWidth )
 {
+    boost::shared_ptr<const STROKE_GLYPHS> glyphs =
+            STROKE_GLYPHS::Get( newstroke_font, newstroke_font_bufsize );
     int tally = 0;
     int char_count = aText.length();
 
@@ -180,11 +183,8 @@ int GraphicTextWidth( const wxString& aText, int aXSize, bool aItalic, bool aWid
                 continue;
         }
 
-        const char* shape_ptr = GetHersheyShapeDescription( asciiCode );
-        // Get metrics
-        int         xsta    = *shape_ptr++ - 'R';
-        int         xsto    = *shape_ptr++ - 'R';
-        tally += KiROUND( aXSize * (xsto - xsta) * s_HersheyScaleFactor );
+        const STROKE_GLYPHS::GLYPH& glyph = GetHersheyGlyph( *glyphs, asciiCode );
+        tally += KiROUND( aXSize * glyph.m_advance * s_HersheyScaleFactor );
     }
 
     // For italic correction, add 1/8 size
@@ -242,6 +242,164 @@ static void DrawGraphicTextPline( EDA_RECT* aClipBox,
 }
 
 
+/* A text laid out for a given size and slant: the polylines of the glyphs and of the
+ * overbars, relative to the position of the first letter and not rotated.
+ * The coordinates are rounded the same way for each letter, so a layout is only valid for
+ * the size it was made for.
+ */
+struct TEXT_LAYOUT
+{
+    struct KEY
+    {
+        wxString    m_text;
+        int         m_sizeX, m_sizeY;
+        bool        m_italic;
+
+        bool operator<( const KEY& aOther ) const
+        {
+            if( m_sizeX != aOther.m_sizeX )
+                return m_sizeX < aOther.m_sizeX;
+
+            if( m_sizeY != aOther.m_sizeY )
+                return m_sizeY < aOther.m_sizeY;
+
+            if( m_italic != aOther.m_italic )
+                return aOther.m_italic;
+
+            return m_text.Cmp( aOther.m_text ) < 0;
+        }
+    };
+
+    struct POLYLINE
+    {
+        int     m_first;
+        int     m_count;
+        bool    m_overbar;
+    };
+
+    void AddOverbar( const wxPoint& aStart, const wxPoint& aEnd )
+    {
+        POLYLINE pline = { (int) m_points.size(), 2, true };
+
+        m_points.push_back( aStart );
+        m_points.push_back( aEnd );
+        m_polylines.push_back( pline );
+    }
+
+    std::vector<wxPoint>    m_points;
+    std::vector<POLYLINE>   m_polylines;
+};
+
+
+// The layouts of the last texts drawn or plotted
+static STROKE_LAYOUT_CACHE<TEXT_LAYOUT::KEY, TEXT_LAYOUT> s_textLayoutCache( 8192 );
+
+
+static void LayoutGraphicText( TEXT_LAYOUT& aLayout, const wxString& aText,
+                               int size_h, int size_v, bool aItalic )
+{
+    boost::shared_ptr<const STROKE_GLYPHS> glyphs =
+            STROKE_GLYPHS::Get( newstroke_font, newstroke_font_bufsize );
+    wxPoint     current_char_pos( 0, 0 );   // Draw coordinates for the current char
+    wxPoint     overbar_pos;                // Start point for the current overbar
+    int         overbar_italic_comp;        // Italic compensation for overbar
+    bool        italic_reverse = size_h < 0;    // true for mirrored texts with m_Size.x < 0
+    unsigned    char_count = NegableTextLength( aText );
+
+    if( aItalic )
+    {
+        overbar_italic_comp = OverbarPositionY( size_v ) / 8;
+
+        if( italic_reverse )
+        {
+            overbar_italic_comp = -overbar_italic_comp;
+        }
+    }
+    else
+    {
+        overbar_italic_comp = 0;
+    }
+
+    int overbars = 0;   // Number of '~' seen (except '~~')
+    unsigned ptr = 0;   // ptr = text index
+
+    while( ptr < char_count )
+    {
+        if( aText[ptr + overbars] == '~' )
+        {
+            if( ptr + overbars + 1 < aText.length()
+                && aText[ptr + overbars + 1] == '~' )   /* '~~' draw as '~' */
+                ptr++;                                  // skip first '~' char and draw second
+
+            else
+            {
+                // Found an overbar, adjust the pointers
+                overbars++;
+
+                if( overbars & 1 )      // odd overbars count
+                {
+                    // Starting the overbar
+                    overbar_pos     = current_char_pos;
+                    overbar_pos.x   += overbar_italic_comp;
+                    overbar_pos.y   -= OverbarPositionY( size_v );
+                }
+                else
+                {
+                    // Ending the overbar
+                    wxPoint end = current_char_pos;
+                    end.x += overbar_italic_comp;
+                    end.y -= OverbarPositionY( size_v );
+                    aLayout.AddOverbar( overbar_pos, end );
+                }
+
+                continue;    // Skip ~ processing
+            }
+        }
+
+        const STROKE_GLYPHS::GLYPH& glyph = GetHersheyGlyph( *glyphs,
+                                                             aText.GetChar( ptr + overbars ) );
+
+        for( int stroke = glyph.m_firstStroke;
+             stroke < glyph.m_firstStroke + glyph.m_strokeCount; stroke++ )
+        {
+            const STROKE_GLYPHS::POINT* points = glyphs->StrokePoints( stroke );
+            TEXT_LAYOUT::POLYLINE pline = { (int) aLayout.m_points.size(),
+                                            glyphs->StrokeSize( stroke ), false };
+
+            for( int i = 0; i < pline.m_count; i++ )
+            {
+                // The glyph points are already aligned on the midpoint
+                int hc1 = KiROUND( points[i].x * size_h * s_HersheyScaleFactor );
+                int hc2 = KiROUND( points[i].y * size_v * s_HersheyScaleFactor );
+
+                // To simulate an italic font,
+                // add a x offset depending on the y offset
+                if( aItalic )
+                    hc1 -= KiROUND( italic_reverse ? -hc2 / 8.0 : hc2 / 8.0 );
+
+                aLayout.m_points.push_back( wxPoint( hc1 + current_char_pos.x,
+                                                     hc2 + current_char_pos.y ) );
+            }
+
+            aLayout.m_polylines.push_back( pline );
+        }
+
+        ptr++;
+
+        // Apply the advance width
+        current_char_pos.x += KiROUND( size_h * glyph.m_advance * s_HersheyScaleFactor );
+    }
+
+    if( overbars % 2 )
+    {
+        // Close the last overbar
+        wxPoint end = current_char_pos;
+        end.y -= OverbarPositionY( size_v );
+        aLayout.AddOverbar( overbar_pos, end );
+    }
+}
+
+
 /**
  * Function DrawGraphicText
  * Draw a graphic text (like module texts)
@@ -279,18 +437,13 @@ void DrawGraphicText( EDA_RECT* aClipBox,
                       void (* aCallback)( int x0, int y0, int xf, int yf ),
                       PLOTTER* aPlotter )
 {
-    int         AsciiCode;
     int         x0, y0;
     int         size_h, size_v;
-    unsigned    ptr;
     int         dx, dy;                     // Draw coordinate for segments to draw. also used in some other calculation
     wxPoint     current_char_pos;           // Draw coordinates for the current char
-    wxPoint     overbar_pos;                // Start point for the current overbar
-    int         overbar_italic_comp;        // Italic compensation for overbar
     #define        BUF_SIZE 100
     wxPoint coord[BUF_SIZE + 1];                // Buffer coordinate used to draw polylines (one char shape)
     bool    sketch_mode     = false;
-    bool    italic_reverse  = false;            // true for mirrored texts with m_Size.x < 0
 
     size_h  = aSize.x;                          /* PLEASE NOTE: H is for HORIZONTAL not for HEIGHT */
     size_v  = aSize.y;
@@ -308,9 +461,6 @@ void DrawGraphicText( EDA_RECT* aClipBox,
     aWidth = Clamp_Text_PenSize( aWidth, aSize, aBold );
 #endif
 
-    if( size_h < 0 ) // text is mirrored using size.x < 0 (mirror / Y axis)
-        italic_reverse = true;
-
     unsigned char_count = NegableTextLength( aText );
 
     if( char_count == 0 )
@@ -413,149 +563,42 @@ void DrawGraphicText( EDA_RECT* aClipBox,
         return;
     }
 
-    if( aItalic )
-    {
-        overbar_italic_comp = OverbarPositionY( size_v ) / 8;
+    // The glyphs are laid out once for a given text, size and slant, the layout is
+    // only moved and rotated here
+    TEXT_LAYOUT::KEY key;
 
-        if( italic_reverse )
-        {
-            overbar_italic_comp = -overbar_italic_comp;
-        }
-    }
-    else
-    {
-        overbar_italic_comp = 0;
-    }
+    key.m_text   = aText;
+    key.m_sizeX  = size_h;
+    key.m_sizeY  = size_v;
+    key.m_italic = aItalic;
 
-    int overbars = 0;   // Number of '~' seen (except '~~')
-    ptr = 0;            // ptr = text index
+    boost::shared_ptr<const TEXT_LAYOUT> layout = s_textLayoutCache.Find( key );
 
-    while( ptr < char_count )
+    if( !layout )
     {
-        if( aText[ptr + overbars] == '~' )
-        {
-            if( ptr + overbars + 1 < aText.length()
-                && aText[ptr + overbars + 1] == '~' )   /* '~~' draw as '~' */
-                ptr++;                                  // skip first '~' char and draw second
-
-            else
-            {
-                // Found an overbar, adjust the pointers
-                overbars++;
-
-                if( overbars & 1 )      // odd overbars count
-                {
-                    // Starting the overbar
-                    overbar_pos     = current_char_pos;
-                    overbar_pos.x   += overbar_italic_comp;
-                    overbar_pos.y   -= OverbarPositionY( size_v );
-                    RotatePoint( &overbar_pos, aPos, aOrient );
-                }
-                else
-                {
-                    // Ending the overbar
-                    coord[0]        = overbar_pos;
-                    overbar_pos     = current_char_pos;
-                    overbar_pos.x   += overbar_italic_comp;
-                    overbar_pos.y   -= OverbarPositionY( size_v );
-                    RotatePoint( &overbar_pos, aPos, aOrient );
-                    coord[1] = overbar_pos;
-                    // Plot the overbar segment
-                    DrawGraphicTextPline( aClipBox, aDC, aColor, aWidth,
-                                          sketch_mode, 2, coord, aCallback, aPlotter );
-                }
+        TEXT_LAYOUT* newLayout = new TEXT_LAYOUT;
 
-                continue;    // Skip ~ processing
-            }
-        }
-
-        AsciiCode = aText.GetChar( ptr + overbars );
+        layout.reset( newLayout );
+        LayoutGraphicText( *newLayout, aText, size_h, size_v, aItalic );
+        s_textLayoutCache.Add( key, layout );
+    }
 
-        const char* ptcar = GetHersheyShapeDescription( AsciiCode );
-        // Get metrics
-        int         xsta    = *ptcar++ - 'R';
-        int         xsto    = *ptcar++ - 'R';
-        int         point_count = 0;
-        bool        endcar = false;
+    for( unsigned ii = 0; ii < layout->m_polylines.size(); ii++ )
+    {
+        const TEXT_LAYOUT::POLYLINE& pline = layout->m_polylines[ii];
+        int point_count = std::min( pline.m_count, BUF_SIZE );
 
-        while( !endcar )
+        for( int ik = 0; ik < point_count; ik++ )
         {
-            int hc1, hc2;
-            hc1 = *ptcar++;
-
-            if( hc1 )
-            {
-                hc2 = *ptcar++;
-            }
-            else
-            {
-                // End of character, insert a synthetic pen up:
-                hc1    = ' ';
-                hc2    = 'R';
-                endcar = true;
-            }
-
-            // Do the Hershey decode thing:
-            // coordinates values are coded as <value> + 'R'
-            hc1 -= 'R';
-            hc2 -= 'R';
-
-            // Pen up request
-            if( hc1 == -50 && hc2 == 0 )
-            {
-                if( point_count )
-                {
-                    if( aWidth <= 1 )
-                        aWidth = 0;
-
-                    DrawGraphicTextPline( aClipBox, aDC, aColor, aWidth,
-                                          sketch_mode, point_count, coord,
-                                          aCallback, aPlotter );
-                }
-
-                point_count = 0;
-            }
-            else
-            {
-                wxPoint currpoint;
-                hc1 -= xsta; hc2 -= 10;    // Align the midpoint
-                hc1  = KiROUND( hc1 * size_h * s_HersheyScaleFactor );
-                hc2  = KiROUND( hc2 * size_v * s_HersheyScaleFactor );
-
-                // To simulate an italic font,
-                // add a x offset depending on the y offset
-                if( aItalic )
-                    hc1 -= KiROUND( italic_reverse ? -hc2 / 8.0 : hc2 / 8.0 );
-
-                currpoint.x = hc1 + current_char_pos.x;
-                currpoint.y = hc2 + current_char_pos.y;
-
-                RotatePoint( &currpoint, aPos, aOrient );
-                coord[point_count] = currpoint;
-
-                if( point_count < BUF_SIZE - 1 )
-                    point_count++;
-            }
-        }    // end draw 1 char
+            coord[ik] = layout->m_points[pline.m_first + ik] + current_char_pos;
+            RotatePoint( &coord[ik], aPos, aOrient );
+        }
 
-        ptr++;
+        if( !pline.m_overbar && aWidth <= 1 )
+            aWidth = 0;
 
-        // Apply the advance width
-        current_char_pos.x += KiROUND( size_h * (xsto - xsta) * s_HersheyScaleFactor );
-    }
-
-    if( overbars % 2 )
-    {
-        // Close the last overbar
-        coord[0]       = overbar_pos;
-        overbar_pos    = current_char_pos;
-        overbar_pos.y -= OverbarPositionY( size_v );
-        RotatePoint( &overbar_pos, aPos, aOrient );
-        coord[1] = overbar_pos;
-
-        // Plot the overbar segment
-        DrawGraphicTextPline( aClipBox, aDC, aColor, aWidth,
-                              sketch_mode, 2, coord, aCallback, aPlotter );
+        DrawGraphicTextPline( aClipBox, aDC, aColor, aWidth, sketch_mode,
+                              point_count, coord, aCallback, aPlotter );
     }
 }
 
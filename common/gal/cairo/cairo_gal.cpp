@@ -30,13 +30,87 @@
 #include <gal/cairo/cairo_gal.h>
 #include <gal/cairo/cairo_compositor.h>
 #include <gal/definitions.h>
+#include <thread_pool.h>
+
+#include <boost/bind.hpp>
 
 #include <limits>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
 
 using namespace KIGFX;
 
 
 const float CAIRO_GAL::LAYER_ALPHA = 0.8;
+const int CAIRO_GAL::TILE_SIZE;
+const int CAIRO_GAL::LAYER_BREAK;
+
+/// Margin (in pixels) around the groups drawn in a tile, for the antialiasing and the thin lines
+static const double TILE_MARGIN = 2.0;
+
+
+// Returns the range of tiles of aTileSize pixels covering an area (in world coordinates),
+// for a world to tile pixels scale aScale
+static void tileRange( const BOX2D& aArea, const VECTOR2D& aScale, int aTileSize,
+                       std::pair<int, int>& aMin, std::pair<int, int>& aMax )
+{
+    const double limit = std::numeric_limits<int>::max() / 2;
+
+    double x0 = aArea.GetX() * aScale.x;
+    double x1 = aArea.GetRight() * aScale.x;
+    double y0 = aArea.GetY() * aScale.y;
+    double y1 = aArea.GetBottom() * aScale.y;
+
+    if( x0 > x1 )
+        std::swap( x0, x1 );
+
+    if( y0 > y1 )
+        std::swap( y0, y1 );
+
+    aMin.first  = floor( std::max( -limit, x0 - TILE_MARGIN ) / aTileSize );
+    aMin.second = floor( std::max( -limit, y0 - TILE_MARGIN ) / aTileSize );
+    aMax.first  = floor( std::min( limit, x1 + TILE_MARGIN ) / aTileSize );
+    aMax.second = floor( std::min( limit, y1 + TILE_MARGIN ) / aTileSize );
+}
+
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+
+// Adds a number to a FNV-1a hash
+static inline void hashAdd( uint64_t& aHash, uint64_t aValue )
+{
+    aHash ^= aValue;
+    aHash *= 1099511628211ULL;
+}
+
+
+static inline void hashAdd( uint64_t& aHash, double aValue )
+{
+    uint64_t bits;
+    memcpy( &bits, &aValue, sizeof( bits ) );
+    hashAdd( aHash, bits );
+}
+
+
+// FNV-1a hash of a draw list, the temporary groups (numbered below aLayerBreak) are identified
+// by the hashes of their contents, as their numbers change on each redraw
+static uint64_t hashDrawList( const std::vector<int>& aDrawList, int aLayerBreak,
+                              const std::vector<uint64_t>& aImmediateHashes )
+{
+    uint64_t hash = FNV_OFFSET;
+
+    for( unsigned int i = 0; i < aDrawList.size(); ++i )
+    {
+        if( aDrawList[i] < aLayerBreak )
+            hashAdd( hash, aImmediateHashes[aLayerBreak - 1 - aDrawList[i]] );
+        else
+            hashAdd( hash, (uint64_t)(uint32_t) aDrawList[i] );
+    }
+
+    return hash;
+}
 
 
 CAIRO_GAL::CAIRO_GAL( wxWindow* aParent, wxEvtHandler* aMouseListener,
@@ -53,6 +127,15 @@ CAIRO_GAL::CAIRO_GAL( wxWindow* aParent, wxEvtHandler* aMouseListener,
     isDeleteSavedPixels = false;
     validCompositor     = false;
     groupCounter        = 0;
+    currentTarget       = TARGET_NONCACHED;
+
+    // The cached target is drawn in tiles
+    isTileCacheEnabled  = true;
+    isTileListDirty     = true;
+    tileUpdateCounter   = 0;
+    tilePool            = NULL;
+    isDrawingGrid       = false;
+    extentsSurface      = cairo_image_surface_create( CAIRO_FORMAT_A8, 1, 1 );
 
     // Connecting the event handlers
     Connect( wxEVT_PAINT,       wxPaintEventHandler( CAIRO_GAL::onPaint ) );
@@ -99,6 +182,9 @@ CAIRO_GAL::~CAIRO_GAL()
     delete cursorPixelsSaved;
 
     ClearCache();
+
+    delete tilePool;
+    cairo_surface_destroy( extentsSurface );
 }
 
 
@@ -128,6 +214,14 @@ void CAIRO_GAL::EndDrawing()
 
     // Merge buffers on the screen
     compositor->DrawBuffer( mainBuffer );
+
+    // With the tile cache, the main buffer keeps only the grid, all the layers are in the tiles
+    if( isTileCacheEnabled )
+    {
+        updateTiles();
+        drawTiles();
+    }
+
     compositor->DrawBuffer( overlayBuffer );
 
     // This code was taken from the wxCairo example - it's not the most efficient one
@@ -312,6 +406,21 @@ void CAIRO_GAL::ClearScreen( const COLOR4D& aColor )
 }
 
 
+void CAIRO_GAL::ComputeWorldScreenMatrix()
+{
+    GAL::ComputeWorldScreenMatrix();
+
+    // The tiles are drawn at whole pixel offsets: the grid, the overlay, the cursor and
+    // the screen <-> world conversions must use the same offset to stay aligned with them
+    if( isTileCacheEnabled )
+    {
+        worldScreenMatrix.m_data[0][2] = floor( worldScreenMatrix.m_data[0][2] + 0.5 );
+        worldScreenMatrix.m_data[1][2] = floor( worldScreenMatrix.m_data[1][2] + 0.5 );
+        screenWorldMatrix = worldScreenMatrix.Inverse();
+    }
+}
+
+
 void CAIRO_GAL::SetIsFill( bool aIsFillEnabled )
 {
     storePath();
@@ -415,6 +524,11 @@ void CAIRO_GAL::SetLayerDepth( double aLayerDepth )
 
         cairo_push_group( currentContext );
     }
+
+    // Layers are composited in the tiles the same way as on the screen (after the paths
+    // of the previous layer are stored)
+    if( isTileCacheEnabled && !tileDrawList.empty() && tileDrawList.back() != LAYER_BREAK )
+        tileDrawList.push_back( LAYER_BREAK );
 }
 
 
@@ -552,87 +666,112 @@ void CAIRO_GAL::EndGroup()
 
 
 void CAIRO_GAL::DrawGroup( int aGroupNumber )
+{
+    storePath();
+
+    // Groups drawn on the cached target are rasterized later, in the tiles they cover
+    if( isTileCacheEnabled && currentTarget == TARGET_CACHED && !isGrouping )
+    {
+        tileDrawList.push_back( aGroupNumber );
+        return;
+    }
+
+    REPLAY_STATE state = { isFillEnabled, isStrokeEnabled, fillColor, strokeColor };
+
+    replayGroup( currentContext, aGroupNumber, state );
+
+    isFillEnabled   = state.isFillEnabled;
+    isStrokeEnabled = state.isStrokeEnabled;
+    fillColor       = state.fillColor;
+    strokeColor     = state.strokeColor;
+}
+
+
+void CAIRO_GAL::replayGroup( cairo_t* aContext, int aGroupNumber, REPLAY_STATE& aState ) const
 {
     // This method implements a small Virtual Machine - all stored commands
     // are executed; nested calling is also possible
+    std::map<int, GROUP>::const_iterator group = groups.find( aGroupNumber );
 
-    storePath();
+    if( group == groups.end() )
+        return;
 
-    for( GROUP::iterator it = groups[aGroupNumber].begin();
-         it != groups[aGroupNumber].end(); ++it )
+    for( GROUP::const_iterator it = group->second.begin(); it != group->second.end(); ++it )
     {
         switch( it->command )
         {
         case CMD_SET_FILL:
-            isFillEnabled = it->boolArgument;
+            aState.isFillEnabled = it->boolArgument;
             break;
 
         case CMD_SET_STROKE:
-            isStrokeEnabled = it->boolArgument;
+            aState.isStrokeEnabled = it->boolArgument;
             break;
 
         case CMD_SET_FILLCOLOR:
-            fillColor = COLOR4D( it->arguments[0], it->arguments[1], it->arguments[2],
-                                 it->arguments[3] );
+            aState.fillColor = COLOR4D( it->arguments[0], it->arguments[1], it->arguments[2],
+                                        it->arguments[3] );
             break;
 
         case CMD_SET_STROKECOLOR:
-            strokeColor = COLOR4D( it->arguments[0], it->arguments[1], it->arguments[2],
-                                   it->arguments[3] );
+            aState.strokeColor = COLOR4D( it->arguments[0], it->arguments[1], it->arguments[2],
+                                          it->arguments[3] );
             break;
 
         case CMD_SET_LINE_WIDTH:
             {
                 // Make lines appear at least 1 pixel wide, no matter of zoom
                 double x = 1.0, y = 1.0;
-                cairo_device_to_user_distance( currentContext, &x, &y );
+                cairo_device_to_user_distance( aContext, &x, &y );
                 double minWidth = std::min( fabs( x ), fabs( y ) );
-                cairo_set_line_width( currentContext, std::max( it->arguments[0], minWidth ) );
+                cairo_set_line_width( aContext, std::max( it->arguments[0], minWidth ) );
             }
             break;
 
 
         case CMD_STROKE_PATH:
-            cairo_set_source_rgb( currentContext, strokeColor.r, strokeColor.g, strokeColor.b );
-            cairo_append_path( currentContext, it->cairoPath );
-            cairo_stroke( currentContext );
+            cairo_set_source_rgb( aContext, aState.strokeColor.r, aState.strokeColor.g,
+                                  aState.strokeColor.b );
+            cairo_append_path( aContext, it->cairoPath );
+            cairo_stroke( aContext );
             break;
 
         case CMD_FILL_PATH:
-            cairo_set_source_rgb( currentContext, fillColor.r, fillColor.g, fillColor.b );
-            cairo_append_path( currentContext, it->cairoPath );
-            cairo_fill( currentContext );
+            cairo_set_source_rgb( aContext, aState.fillColor.r, aState.fillColor.g,
+                                  aState.fillColor.b );
+            cairo_append_path( aContext, it->cairoPath );
+            cairo_fill( aContext );
             break;
 
         case CMD_TRANSFORM:
             cairo_matrix_t matrix;
             cairo_matrix_init( &matrix, it->arguments[0], it->arguments[1], it->arguments[2],
                                it->arguments[3], it->arguments[4], it->arguments[5] );
-            cairo_transform( currentContext, &matrix );
+            cairo_transform( aContext, &matrix );
             break;
 
         case CMD_ROTATE:
-            cairo_rotate( currentContext, it->arguments[0] );
+            cairo_rotate( aContext, it->arguments[0] );
             break;
 
         case CMD_TRANSLATE:
-            cairo_translate( currentContext, it->arguments[0], it->arguments[1] );
+            cairo_translate( aContext, it->arguments[0], it->arguments[1] );
             break;
 
         case CMD_SCALE:
-            cairo_scale( currentContext, it->arguments[0], it->arguments[1] );
+            cairo_scale( aContext, it->arguments[0], it->arguments[1] );
             break;
 
         case CMD_SAVE:
-            cairo_save( currentContext );
+            cairo_save( aContext );
             break;
 
         case CMD_RESTORE:
-            cairo_restore( currentContext );
+            cairo_restore( aContext );
             break;
 
         case CMD_CALL_GROUP:
-            DrawGroup( it->intArgument );
+            replayGroup( aContext, it->intArgument, aState );
             break;
         }
     }
@@ -654,6 +793,12 @@ void CAIRO_GAL::ChangeGroupColor( int aGroupNumber, const COLOR4D& aNewColor )
             it->arguments[3] = aNewColor.a;
         }
     }
+
+    // The tiles showing the group have to be rasterized again
+    std::map<int, BOX2D>::const_iterator extents = groupExtents.find( aGroupNumber );
+
+    if( extents != groupExtents.end() )
+        invalidateTiles( extents->second );
 }
 
 
@@ -681,15 +826,20 @@ void CAIRO_GAL::DeleteGroup( int aGroupNumber )
 
     // Delete the group
     groups.erase( aGroupNumber );
+    groupExtents.erase( aGroupNumber );
 }
 
 
 void CAIRO_GAL::ClearCache()
 {
+    clearImmediateGroups();
+
     for( int i = groups.size() - 1; i >= 0; --i )
     {
         DeleteGroup( i );
     }
+
+    clearTiles();
 }
 
 
@@ -768,6 +918,15 @@ RENDER_TARGET CAIRO_GAL::GetTarget() const
 
 void CAIRO_GAL::ClearTarget( RENDER_TARGET aTarget )
 {
+    if( isTileCacheEnabled && aTarget == TARGET_CACHED )
+    {
+        // The groups are going to be drawn again, the tiles are kept if they do not change
+        clearImmediateGroups();
+        tileDrawList.clear();
+        isTileListDirty = true;
+        return;
+    }
+
     // Save the current state
     unsigned int currentBuffer = compositor->GetBuffer();
 
@@ -808,6 +967,17 @@ void CAIRO_GAL::DrawCursor( const VECTOR2D& aCursorPosition )
 }
 
 
+void CAIRO_GAL::DrawGrid()
+{
+    // The grid is drawn on the main buffer, under the tiles
+    storePath();
+    isDrawingGrid = true;
+    super::DrawGrid();
+    storePath();
+    isDrawingGrid = false;
+}
+
+
 void CAIRO_GAL::drawGridLine( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint )
 {
     cairo_move_to( currentContext, aStartPoint.x, aStartPoint.y );
@@ -823,7 +993,13 @@ void CAIRO_GAL::storePath()
     {
         isElementAdded = false;
 
-        if( !isGrouping )
+        if( !isGrouping && isTileCacheEnabled && !isDrawingGrid &&
+            currentTarget != TARGET_OVERLAY )
+        {
+            // Keep the layer order in the tiles
+            storeImmediatePath();
+        }
+        else if( !isGrouping )
         {
             if( isFillEnabled )
             {
@@ -865,6 +1041,127 @@ void CAIRO_GAL::storePath()
 }
 
 
+void CAIRO_GAL::storeImmediatePath()
+{
+    if( !isFillEnabled && !isStrokeEnabled )
+        return;
+
+    // The tiles have their own world to pixels transformation, so the paths are stored
+    // in world coordinates
+    cairo_matrix_t matrix;
+    cairo_get_matrix( currentContext, &matrix );
+    cairo_set_matrix( currentContext, &cairoWorldScreenMatrix );
+    cairo_path_t* path = cairo_copy_path( currentContext );
+    cairo_path_t* strokePath = ( isFillEnabled && isStrokeEnabled ) ?
+                               cairo_copy_path( currentContext ) : path;
+    cairo_set_matrix( currentContext, &matrix );
+
+    if( path->num_data == 0 )
+    {
+        if( strokePath != path )
+            cairo_path_destroy( strokePath );
+
+        cairo_path_destroy( path );
+        return;
+    }
+
+    int groupNumber = LAYER_BREAK - 1 - (int) immediateHashes.size();
+    GROUP& group = groups[groupNumber];
+    GROUP_ELEMENT groupElement;
+
+    // Filled first, as without the tiles
+    if( isFillEnabled )
+    {
+        groupElement.command = CMD_SET_FILLCOLOR;
+        groupElement.arguments[0] = fillColor.r;
+        groupElement.arguments[1] = fillColor.g;
+        groupElement.arguments[2] = fillColor.b;
+        groupElement.arguments[3] = fillColor.a;
+        group.push_back( groupElement );
+
+        groupElement.command   = CMD_FILL_PATH;
+        groupElement.cairoPath = path;
+        group.push_back( groupElement );
+    }
+
+    if( isStrokeEnabled )
+    {
+        groupElement.command = CMD_SET_LINE_WIDTH;
+        groupElement.arguments[0] = lineWidth;
+        group.push_back( groupElement );
+
+        groupElement.command = CMD_SET_STROKECOLOR;
+        groupElement.arguments[0] = strokeColor.r;
+        groupElement.arguments[1] = strokeColor.g;
+        groupElement.arguments[2] = strokeColor.b;
+        groupElement.arguments[3] = strokeColor.a;
+        group.push_back( groupElement );
+
+        groupElement.command   = CMD_STROKE_PATH;
+        groupElement.cairoPath = strokePath;
+        group.push_back( groupElement );
+    }
+
+    // The group is identified in the tile signatures by its contents
+    uint64_t hash = FNV_OFFSET;
+
+    for( GROUP::const_iterator it = group.begin(); it != group.end(); ++it )
+    {
+        hashAdd( hash, (uint64_t) it->command );
+
+        if( it->command == CMD_SET_FILLCOLOR || it->command == CMD_SET_STROKECOLOR )
+        {
+            for( int i = 0; i < 4; ++i )
+                hashAdd( hash, it->arguments[i] );
+        }
+        else if( it->command == CMD_SET_LINE_WIDTH )
+        {
+            hashAdd( hash, it->arguments[0] );
+        }
+    }
+
+    for( int i = 0; i < path->num_data; i += path->data[i].header.length )
+    {
+        const cairo_path_data_t* data = &path->data[i];
+
+        hashAdd( hash, (uint64_t) data->header.type );
+
+        for( int j = 1; j < data->header.length; ++j )
+        {
+            hashAdd( hash, data[j].point.x );
+            hashAdd( hash, data[j].point.y );
+        }
+    }
+
+    immediateHashes.push_back( hash );
+    tileDrawList.push_back( groupNumber );
+    isTileListDirty = true;
+}
+
+
+void CAIRO_GAL::clearImmediateGroups()
+{
+    storePath();
+
+    for( unsigned int i = 0; i < immediateHashes.size(); ++i )
+    {
+        int groupNumber = LAYER_BREAK - 1 - (int) i;
+
+        for( GROUP::iterator it = groups[groupNumber].begin();
+             it != groups[groupNumber].end(); ++it )
+        {
+            if( it->command == CMD_FILL_PATH || it->command == CMD_STROKE_PATH )
+                cairo_path_destroy( it->cairoPath );
+        }
+
+        groups.erase( groupNumber );
+        groupExtents.erase( groupNumber );
+    }
+
+    immediateHashes.clear();
+}
+
+
 void CAIRO_GAL::onPaint( wxPaintEvent& WXUNUSED( aEvent ) )
 {
     PostPaint();
@@ -1072,3 +1369,423 @@ unsigned int CAIRO_GAL::getNewGroupNumber()
 
     return groupCounter++;
 }
+
+
+BOX2D CAIRO_GAL::GetCachedArea( const BOX2D& aVisibleArea ) const
+{
+    if( !isTileCacheEnabled )
+        return aVisibleArea;
+
+    // Whole tiles are drawn, with the groups around them that could show in the margin
+    VECTOR2D scale( flipX * worldScale, flipY * worldScale );
+    TILE_KEY first, last;
+
+    tileRange( aVisibleArea, scale, TILE_SIZE, first, last );
+
+    VECTOR2D a( ( first.first * TILE_SIZE - TILE_MARGIN ) / scale.x,
+                ( first.second * TILE_SIZE - TILE_MARGIN ) / scale.y );
+    VECTOR2D b( ( ( last.first + 1 ) * TILE_SIZE + TILE_MARGIN ) / scale.x,
+                ( ( last.second + 1 ) * TILE_SIZE + TILE_MARGIN ) / scale.y );
+
+    return BOX2D( a, b - a );
+}
+
+
+void CAIRO_GAL::EnableTileCache( bool aEnable )
+{
+    if( aEnable == isTileCacheEnabled )
+        return;
+
+    isTileCacheEnabled = aEnable;
+    isTileListDirty = true;
+    clearImmediateGroups();
+    tileDrawList.clear();
+    groupExtents.clear();
+    clearTiles();
+    ComputeWorldScreenMatrix();
+
+    // Restore the buffer of the current target
+    if( validCompositor )
+        SetTarget( currentTarget );
+}
+
+
+const BOX2D& CAIRO_GAL::getGroupExtents( int aGroupNumber )
+{
+    std::map<int, BOX2D>::iterator cached = groupExtents.find( aGroupNumber );
+
+    if( cached != groupExtents.end() )
+        return cached->second;
+
+    BOX2D& extents = groupExtents[aGroupNumber];
+    std::map<int, GROUP>::const_iterator group = groups.find( aGroupNumber );
+
+    extents = BOX2D( VECTOR2D( 0, 0 ), VECTOR2D( 0, 0 ) );
+
+    if( group == groups.end() )
+        return extents;
+
+    // The paths are stored in world coordinates, relative to the transformations of the group,
+    // so the group is replayed on a context whose device coordinates are world coordinates
+    cairo_t* ctx = cairo_create( extentsSurface );
+    double lineWidth = 0.0;
+    bool empty = true;
+    VECTOR2D lo, hi;
+
+    for( GROUP::const_iterator it = group->second.begin(); it != group->second.end(); ++it )
+    {
+        switch( it->command )
+        {
+        case CMD_SET_LINE_WIDTH:
+            lineWidth = it->arguments[0];
+            break;
+
+        case CMD_STROKE_PATH:
+        case CMD_FILL_PATH:
+            {
+                if( it->cairoPath->num_data == 0 )
+                    break;
+
+                double x1, y1, x2, y2;
+
+                cairo_new_path( ctx );
+                cairo_append_path( ctx, it->cairoPath );
+                cairo_path_extents( ctx, &x1, &y1, &x2, &y2 );
+                cairo_new_path( ctx );
+
+                double margin = ( it->command == CMD_STROKE_PATH ) ? lineWidth / 2.0 : 0.0;
+                double corners[4][2] =
+                {
+                    { x1 - margin, y1 - margin }, { x2 + margin, y1 - margin },
+                    { x2 + margin, y2 + margin }, { x1 - margin, y2 + margin }
+                };
+
+                for( int i = 0; i < 4; ++i )
+                {
+                    cairo_user_to_device( ctx, &corners[i][0], &corners[i][1] );
+
+                    if( empty )
+                    {
+                        lo = hi = VECTOR2D( corners[i][0], corners[i][1] );
+                        empty = false;
+                    }
+                    else
+                    {
+                        lo.x = std::min( lo.x, corners[i][0] );
+                        lo.y = std::min( lo.y, corners[i][1] );
+                        hi.x = std::max( hi.x, corners[i][0] );
+                        hi.y = std::max( hi.y, corners[i][1] );
+                    }
+                }
+            }
+            break;
+
+        case CMD_TRANSFORM:
+            cairo_matrix_t matrix;
+            cairo_matrix_init( &matrix, it->arguments[0], it->arguments[1], it->arguments[2],
+                               it->arguments[3], it->arguments[4], it->arguments[5] );
+            cairo_transform( ctx, &matrix );
+            break;
+
+        case CMD_ROTATE:
+            cairo_rotate( ctx, it->arguments[0] );
+            break;
+
+        case CMD_TRANSLATE:
+            cairo_translate( ctx, it->arguments[0], it->arguments[1] );
+            break;
+
+        case CMD_SCALE:
+            cairo_scale( ctx, it->arguments[0], it->arguments[1] );
+            break;
+
+        case CMD_SAVE:
+            cairo_save( ctx );
+            break;
+
+        case CMD_RESTORE:
+            cairo_restore( ctx );
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    cairo_destroy( ctx );
+
+    if( !empty )
+        extents = BOX2D( lo, hi - lo );
+
+    return extents;
+}
+
+
+void CAIRO_GAL::updateTiles()
+{
+    // Nothing was drawn on the cached target since the last update
+    if( !isTileListDirty )
+        return;
+
+    isTileListDirty = false;
+
+    // Tiles are aligned on the pixels for a given zoom, they can't be reused after a change
+    VECTOR2D scale( flipX * worldScale, flipY * worldScale );
+
+    if( scale != tileScale )
+    {
+        clearTiles();
+        tileScale = scale;
+    }
+
+    // The translation is already rounded to whole pixels by ComputeWorldScreenMatrix()
+    tileOffset = VECTOR2I( floor( worldScreenMatrix.m_data[0][2] + 0.5 ),
+                           floor( worldScreenMatrix.m_data[1][2] + 0.5 ) );
+
+    // Tiles covering the screen
+    int firstCol = floor( (double) -tileOffset.x / TILE_SIZE );
+    int firstRow = floor( (double) -tileOffset.y / TILE_SIZE );
+    int lastCol  = floor( (double) ( screenSize.x - 1 - tileOffset.x ) / TILE_SIZE );
+    int lastRow  = floor( (double) ( screenSize.y - 1 - tileOffset.y ) / TILE_SIZE );
+    int cols = lastCol - firstCol + 1;
+    int rows = lastRow - firstRow + 1;
+
+    visibleTiles.clear();
+
+    if( cols <= 0 || rows <= 0 )
+        return;
+
+    // Sort the groups into the draw lists of the tiles they cover, keeping the layers apart
+    std::vector< std::vector<int> > drawLists( cols * rows );
+    std::vector<int> lastLayer( cols * rows, 0 );
+    int layer = 0;
+
+    for( unsigned int i = 0; i < tileDrawList.size(); ++i )
+    {
+        int groupNumber = tileDrawList[i];
+
+        if( groupNumber == LAYER_BREAK )
+        {
+            layer++;
+            continue;
+        }
+
+        const BOX2D& extents = getGroupExtents( groupNumber );
+
+        if( extents.GetWidth() == 0.0 && extents.GetHeight() == 0.0 )
+            continue;
+
+        TILE_KEY first, last;
+        tileRange( extents, scale, TILE_SIZE, first, last );
+
+        for( int row = std::max( first.second, firstRow );
+             row <= std::min( last.second, lastRow ); ++row )
+        {
+            for( int col = std::max( first.first, firstCol );
+                 col <= std::min( last.first, lastCol ); ++col )
+            {
+                int index = ( row - firstRow ) * cols + ( col - firstCol );
+                std::vector<int>& drawList = drawLists[index];
+
+                if( !drawList.empty() && lastLayer[index] != layer )
+                    drawList.push_back( LAYER_BREAK );
+
+                lastLayer[index] = layer;
+                drawList.push_back( groupNumber );
+            }
+        }
+    }
+
+    // Rasterize the tiles whose draw lists changed
+    if( !tilePool )
+        tilePool = new THREAD_POOL;
+
+    tileUpdateCounter++;
+
+    for( int row = firstRow; row <= lastRow; ++row )
+    {
+        for( int col = firstCol; col <= lastCol; ++col )
+        {
+            int index = ( row - firstRow ) * cols + ( col - firstCol );
+            const std::vector<int>& drawList = drawLists[index];
+            TILE_KEY key( col, row );
+            TILE& tile = tiles[key];
+            uint64_t signature = hashDrawList( drawList, LAYER_BREAK, immediateHashes );
+
+            visibleTiles.push_back( key );
+            tile.lastUse = tileUpdateCounter;
+
+            if( tile.surface && tile.signature == signature )
+                continue;
+
+            tile.signature = signature;
+            tile.isEmpty = drawList.empty();
+
+            if( tile.isEmpty )
+                continue;
+
+            if( !tile.surface )
+                tile.surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, TILE_SIZE,
+                                                           TILE_SIZE );
+
+            tilePool->Submit( boost::bind( &CAIRO_GAL::rasterizeTile, this, &tile, key,
+                                           &drawList ) );
+        }
+    }
+
+    tilePool->Wait();
+
+    // Keep the tiles around the screen for panning, discard the least recently shown ones
+    unsigned int maxTiles = std::max<unsigned int>( 4 * visibleTiles.size(), 64 );
+
+    if( tiles.size() > maxTiles )
+    {
+        std::vector< std::pair<unsigned int, TILE_KEY> > unused;
+
+        for( TILES::iterator it = tiles.begin(); it != tiles.end(); ++it )
+        {
+            if( it->second.lastUse != tileUpdateCounter )
+                unused.push_back( std::make_pair( it->second.lastUse, it->first ) );
+        }
+
+        std::sort( unused.begin(), unused.end() );
+
+        for( unsigned int i = 0; i < unused.size() && tiles.size() > maxTiles; ++i )
+        {
+            TILES::iterator it = tiles.find( unused[i].second );
+
+            if( it->second.surface )
+                cairo_surface_destroy( it->second.surface );
+
+            tiles.erase( it );
+        }
+    }
+}
+
+
+void CAIRO_GAL::rasterizeTile( TILE* aTile, TILE_KEY aKey,
+                               const std::vector<int>* aDrawList ) const
+{
+    cairo_t* ctx = cairo_create( aTile->surface );
+
+    cairo_set_operator( ctx, CAIRO_OPERATOR_CLEAR );
+    cairo_paint( ctx );
+    cairo_set_operator( ctx, CAIRO_OPERATOR_OVER );
+
+    cairo_set_antialias( ctx, CAIRO_ANTIALIAS_SUBPIXEL );
+    cairo_set_line_join( ctx, CAIRO_LINE_JOIN_ROUND );
+    cairo_set_line_cap( ctx, CAIRO_LINE_CAP_ROUND );
+
+    // World to tile pixels
+    cairo_matrix_t matrix;
+    cairo_matrix_init( &matrix, tileScale.x, 0.0, 0.0, tileScale.y,
+                       -aKey.first * TILE_SIZE, -aKey.second * TILE_SIZE );
+    cairo_set_matrix( ctx, &matrix );
+
+    // Layers are composited as they are on the screen
+    REPLAY_STATE state = { true, false, COLOR4D( 0, 0, 0, 1 ), COLOR4D( 0, 0, 0, 1 ) };
+    bool isLayerOpen = false;
+
+    for( unsigned int i = 0; i < aDrawList->size(); ++i )
+    {
+        int groupNumber = ( *aDrawList )[i];
+
+        if( groupNumber == LAYER_BREAK )
+        {
+            if( isLayerOpen )
+            {
+                cairo_pop_group_to_source( ctx );
+                cairo_paint_with_alpha( ctx, LAYER_ALPHA );
+                isLayerOpen = false;
+            }
+
+            continue;
+        }
+
+        if( !isLayerOpen )
+        {
+            cairo_push_group( ctx );
+            isLayerOpen = true;
+        }
+
+        replayGroup( ctx, groupNumber, state );
+    }
+
+    if( isLayerOpen )
+    {
+        cairo_pop_group_to_source( ctx );
+        cairo_paint_with_alpha( ctx, LAYER_ALPHA );
+    }
+
+    cairo_destroy( ctx );
+    cairo_surface_flush( aTile->surface );
+}
+
+
+void CAIRO_GAL::drawTiles()
+{
+    // Tiles are blitted in screen coordinates
+    cairo_matrix_t matrix;
+    cairo_get_matrix( context, &matrix );
+    cairo_identity_matrix( context );
+
+    for( unsigned int i = 0; i < visibleTiles.size(); ++i )
+    {
+        const TILE_KEY& key = visibleTiles[i];
+        TILES::const_iterator tile = tiles.find( key );
+
+        if( tile == tiles.end() || tile->second.isEmpty )
+            continue;
+
+        double x = key.first * TILE_SIZE + tileOffset.x;
+        double y = key.second * TILE_SIZE + tileOffset.y;
+
+        cairo_set_source_surface( context, tile->second.surface, x, y );
+        cairo_rectangle( context, x, y, TILE_SIZE, TILE_SIZE );
+        cairo_fill( context );
+    }
+
+    cairo_set_matrix( context, &matrix );
+}
+
+
+void CAIRO_GAL::invalidateTiles( const BOX2D& aArea )
+{
+    TILE_KEY first, last;
+
+    tileRange( aArea, tileScale, TILE_SIZE, first, last );
+
+    for( TILES::iterator it = tiles.begin(); it != tiles.end(); )
+    {
+        const TILE_KEY& key = it->first;
+
+        if( key.first >= first.first && key.first <= last.first &&
+            key.second >= first.second && key.second <= last.second )
+        {
+            if( it->second.surface )
+                cairo_surface_destroy( it->second.surface );
+
+            tiles.erase( it++ );
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    isTileListDirty = true;
+}
+
+
+void CAIRO_GAL::clearTiles()
+{
+    for( TILES::iterator it = tiles.begin(); it != tiles.end(); ++it )
+    {
+        if( it->second.surface )
+            cairo_surface_destroy( it->second.surface );
+    }
+
+    tiles.clear();
+    visibleTiles.clear();
+    isTileListDirty = true;
+}
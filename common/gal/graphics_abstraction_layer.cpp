@@ -85,6 +85,39 @@ void GAL::SetTextAttributes( const EDA_TEXT* aText )
 }
 
 
+GAL::ATTRIBUTES GAL::GetAttributes() const
+{
+    ATTRIBUTES attributes;
+
+    attributes.isFillEnabled   = isFillEnabled;
+    attributes.isStrokeEnabled = isStrokeEnabled;
+    attributes.fillColor       = fillColor;
+    attributes.strokeColor     = strokeColor;
+    attributes.lineWidth       = lineWidth;
+
+    return attributes;
+}
+
+
+void GAL::SetAttributes( const ATTRIBUTES& aAttributes )
+{
+    if( isFillEnabled != aAttributes.isFillEnabled )
+        SetIsFill( aAttributes.isFillEnabled );
+
+    if( isStrokeEnabled != aAttributes.isStrokeEnabled )
+        SetIsStroke( aAttributes.isStrokeEnabled );
+
+    if( fillColor != aAttributes.fillColor )
+        SetFillColor( aAttributes.fillColor );
+
+    if( strokeColor != aAttributes.strokeColor )
+        SetStrokeColor( aAttributes.strokeColor );
+
+    if( lineWidth != aAttributes.lineWidth )
+        SetLineWidth( aAttributes.lineWidth );
+}
+
+
 void GAL::ComputeWorldScreenMatrix()
 {
     ComputeWorldScale();
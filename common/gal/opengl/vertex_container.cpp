@@ -36,12 +36,15 @@
 
 using namespace KIGFX;
 
-VERTEX_CONTAINER* VERTEX_CONTAINER::MakeContainer( bool aCached )
+VERTEX_CONTAINER* VERTEX_CONTAINER::MakeContainer( bool aCached, unsigned int aSize )
 {
+    if( aSize == 0 )
+        aSize = defaultInitSize;
+
     if( aCached )
-        return new CACHED_CONTAINER;
+        return new CACHED_CONTAINER( aSize );
     else
-        return new NONCACHED_CONTAINER;
+        return new NONCACHED_CONTAINER( aSize );
 }
 
 
@@ -34,13 +34,14 @@
 #include <gal/opengl/gpu_manager.h>
 #include <gal/opengl/vertex_item.h>
 #include <confirm.h>
+#include <cstring>
 
 using namespace KIGFX;
 
-VERTEX_MANAGER::VERTEX_MANAGER( bool aCached ) :
+VERTEX_MANAGER::VERTEX_MANAGER( bool aCached, unsigned int aInitialSize ) :
     m_noTransform( true ), m_transform( 1.0f )
 {
-    m_container.reset( VERTEX_CONTAINER::MakeContainer( aCached ) );
+    m_container.reset( VERTEX_CONTAINER::MakeContainer( aCached, aInitialSize ) );
     m_gpu.reset( GPU_MANAGER::MakeManager( m_container.get() ) );
 
     // There is no shader used by default
@@ -99,6 +100,37 @@ void VERTEX_MANAGER::Vertices( const VERTEX aVertices[], unsigned int aSize ) co
 }
 
 
+void VERTEX_MANAGER::CopyVertices( const VERTEX aVertices[], unsigned int aSize ) const
+{
+    // flag to avoid hanging by calling DisplayError too many times:
+    static bool show_err = true;
+
+    if( aSize == 0 )
+        return;
+
+    VERTEX* newVertex = m_container->Allocate( aSize );
+
+    if( newVertex == NULL )
+    {
+        if( show_err )
+        {
+            DisplayError( NULL, wxT( "VERTEX_MANAGER::CopyVertices: Vertex allocation error" ) );
+            show_err = false;
+        }
+
+        return;
+    }
+
+    memcpy( newVertex, aVertices, aSize * sizeof( VERTEX ) );
+}
+
+
+unsigned int VERTEX_MANAGER::GetSize() const
+{
+    return m_container->GetSize();
+}
+
+
 void VERTEX_MANAGER::SetItem( VERTEX_ITEM& aItem ) const
 {
     m_container->SetItem( &aItem );
@@ -163,6 +195,12 @@ VERTEX* VERTEX_MANAGER::GetVertices( const VERTEX_ITEM& aItem ) const
 }
 
 
+VERTEX* VERTEX_MANAGER::GetVertices( unsigned int aOffset ) const
+{
+    return m_container->GetVertices( aOffset );
+}
+
+
 void VERTEX_MANAGER::SetShader( SHADER& aShader ) const
 {
     m_gpu->SetShader( aShader );
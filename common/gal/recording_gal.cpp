@@ -0,0 +1,359 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <algorithm>
+
+#include <gal/recording_gal.h>
+
+using namespace KIGFX;
+
+
+RECORDING_GAL::RECORDING_GAL()
+{
+}
+
+
+void RECORDING_GAL::SyncState( const GAL& aGal )
+{
+    zoomFactor = aGal.GetZoomFactor();
+    worldScale = aGal.GetWorldScale();
+    depthRange = VECTOR2D( aGal.GetMinDepth(), aGal.GetMaxDepth() );
+    m_attributes = aGal.GetAttributes();
+    RestoreAttributes();
+}
+
+
+void RECORDING_GAL::RestoreAttributes()
+{
+    isFillEnabled   = m_attributes.isFillEnabled;
+    isStrokeEnabled = m_attributes.isStrokeEnabled;
+    fillColor       = m_attributes.fillColor;
+    strokeColor     = m_attributes.strokeColor;
+    lineWidth       = m_attributes.lineWidth;
+}
+
+
+void RECORDING_GAL::Clear()
+{
+    std::vector<COMMAND>().swap( m_commands );
+    std::vector<VECTOR2D>().swap( m_points );
+    std::vector<MATRIX3x3D>().swap( m_matrices );
+}
+
+
+RECORDING_GAL::COMMAND& RECORDING_GAL::addCommand( COMMAND_TYPE aType, int aPointCount )
+{
+    m_commands.push_back( COMMAND() );
+
+    COMMAND& cmd = m_commands.back();
+
+    cmd.m_type = aType;
+    cmd.m_first = m_points.size();
+    cmd.m_pointCount = aPointCount;
+    m_points.resize( m_points.size() + aPointCount );
+
+    return cmd;
+}
+
+
+void RECORDING_GAL::Replay( GAL& aTarget, int aBegin, int aEnd ) const
+{
+    for( int i = aBegin; i < aEnd; ++i )
+    {
+        const COMMAND& cmd = m_commands[i];
+        const VECTOR2D* p = cmd.m_pointCount ? &m_points[cmd.m_first] : NULL;
+        const double* param = cmd.m_params;
+
+        switch( cmd.m_type )
+        {
+        case CMD_LINE:
+            aTarget.DrawLine( p[0], p[1] );
+            break;
+
+        case CMD_SEGMENT:
+            aTarget.DrawSegment( p[0], p[1], param[0] );
+            break;
+
+        case CMD_CIRCLE:
+            aTarget.DrawCircle( p[0], param[0] );
+            break;
+
+        case CMD_ARC:
+            aTarget.DrawArc( p[0], param[0], param[1], param[2] );
+            break;
+
+        case CMD_RECTANGLE:
+            aTarget.DrawRectangle( p[0], p[1] );
+            break;
+
+        case CMD_POLYLINE:
+            aTarget.DrawPolyline( p, cmd.m_pointCount );
+            break;
+
+        case CMD_POLYGON:
+            aTarget.DrawPolygon( p, cmd.m_pointCount );
+            break;
+
+        case CMD_CURVE:
+            aTarget.DrawCurve( p[0], p[1], p[2], p[3] );
+            break;
+
+        case CMD_SET_FILL:
+            aTarget.SetIsFill( param[0] != 0.0 );
+            break;
+
+        case CMD_SET_STROKE:
+            aTarget.SetIsStroke( param[0] != 0.0 );
+            break;
+
+        case CMD_SET_FILL_COLOR:
+            aTarget.SetFillColor( COLOR4D( param[0], param[1], param[2], param[3] ) );
+            break;
+
+        case CMD_SET_STROKE_COLOR:
+            aTarget.SetStrokeColor( COLOR4D( param[0], param[1], param[2], param[3] ) );
+            break;
+
+        case CMD_SET_LINE_WIDTH:
+            aTarget.SetLineWidth( param[0] );
+            break;
+
+        case CMD_SET_LAYER_DEPTH:
+            aTarget.SetLayerDepth( param[0] );
+            break;
+
+        case CMD_TRANSFORM:
+            aTarget.Transform( m_matrices[cmd.m_first] );
+            break;
+
+        case CMD_ROTATE:
+            aTarget.Rotate( param[0] );
+            break;
+
+        case CMD_TRANSLATE:
+            aTarget.Translate( p[0] );
+            break;
+
+        case CMD_SCALE:
+            aTarget.Scale( p[0] );
+            break;
+
+        case CMD_SAVE:
+            aTarget.Save();
+            break;
+
+        case CMD_RESTORE:
+            aTarget.Restore();
+            break;
+        }
+    }
+}
+
+
+void RECORDING_GAL::DrawLine( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint )
+{
+    COMMAND& cmd = addCommand( CMD_LINE, 2 );
+
+    m_points[cmd.m_first] = aStartPoint;
+    m_points[cmd.m_first + 1] = aEndPoint;
+}
+
+
+void RECORDING_GAL::DrawSegment( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint,
+                                 double aWidth )
+{
+    COMMAND& cmd = addCommand( CMD_SEGMENT, 2 );
+
+    m_points[cmd.m_first] = aStartPoint;
+    m_points[cmd.m_first + 1] = aEndPoint;
+    cmd.m_params[0] = aWidth;
+}
+
+
+void RECORDING_GAL::DrawCircle( const VECTOR2D& aCenterPoint, double aRadius )
+{
+    COMMAND& cmd = addCommand( CMD_CIRCLE, 1 );
+
+    m_points[cmd.m_first] = aCenterPoint;
+    cmd.m_params[0] = aRadius;
+}
+
+
+void RECORDING_GAL::DrawArc( const VECTOR2D& aCenterPoint, double aRadius,
+                             double aStartAngle, double aEndAngle )
+{
+    COMMAND& cmd = addCommand( CMD_ARC, 1 );
+
+    m_points[cmd.m_first] = aCenterPoint;
+    cmd.m_params[0] = aRadius;
+    cmd.m_params[1] = aStartAngle;
+    cmd.m_params[2] = aEndAngle;
+}
+
+
+void RECORDING_GAL::DrawRectangle( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint )
+{
+    COMMAND& cmd = addCommand( CMD_RECTANGLE, 2 );
+
+    m_points[cmd.m_first] = aStartPoint;
+    m_points[cmd.m_first + 1] = aEndPoint;
+}
+
+
+void RECORDING_GAL::DrawPolyline( const std::deque<VECTOR2D>& aPointList )
+{
+    COMMAND& cmd = addCommand( CMD_POLYLINE, aPointList.size() );
+
+    std::copy( aPointList.begin(), aPointList.end(), m_points.begin() + cmd.m_first );
+}
+
+
+void RECORDING_GAL::DrawPolyline( const VECTOR2D aPointList[], int aListSize )
+{
+    COMMAND& cmd = addCommand( CMD_POLYLINE, aListSize );
+
+    std::copy( aPointList, aPointList + aListSize, m_points.begin() + cmd.m_first );
+}
+
+
+void RECORDING_GAL::DrawPolygon( const std::deque<VECTOR2D>& aPointList )
+{
+    COMMAND& cmd = addCommand( CMD_POLYGON, aPointList.size() );
+
+    std::copy( aPointList.begin(), aPointList.end(), m_points.begin() + cmd.m_first );
+}
+
+
+void RECORDING_GAL::DrawPolygon( const VECTOR2D aPointList[], int aListSize )
+{
+    COMMAND& cmd = addCommand( CMD_POLYGON, aListSize );
+
+    std::copy( aPointList, aPointList + aListSize, m_points.begin() + cmd.m_first );
+}
+
+
+void RECORDING_GAL::DrawCurve( const VECTOR2D& aStartPoint, const VECTOR2D& aControlPointA,
+                               const VECTOR2D& aControlPointB, const VECTOR2D& aEndPoint )
+{
+    COMMAND& cmd = addCommand( CMD_CURVE, 4 );
+
+    m_points[cmd.m_first] = aStartPoint;
+    m_points[cmd.m_first + 1] = aControlPointA;
+    m_points[cmd.m_first + 2] = aControlPointB;
+    m_points[cmd.m_first + 3] = aEndPoint;
+}
+
+
+void RECORDING_GAL::SetIsFill( bool aIsFillEnabled )
+{
+    GAL::SetIsFill( aIsFillEnabled );
+    addCommand( CMD_SET_FILL ).m_params[0] = aIsFillEnabled;
+}
+
+
+void RECORDING_GAL::SetIsStroke( bool aIsStrokeEnabled )
+{
+    GAL::SetIsStroke( aIsStrokeEnabled );
+    addCommand( CMD_SET_STROKE ).m_params[0] = aIsStrokeEnabled;
+}
+
+
+void RECORDING_GAL::SetFillColor( const COLOR4D& aColor )
+{
+    GAL::SetFillColor( aColor );
+
+    COMMAND& cmd = addCommand( CMD_SET_FILL_COLOR );
+
+    cmd.m_params[0] = aColor.r;
+    cmd.m_params[1] = aColor.g;
+    cmd.m_params[2] = aColor.b;
+    cmd.m_params[3] = aColor.a;
+}
+
+
+void RECORDING_GAL::SetStrokeColor( const COLOR4D& aColor )
+{
+    GAL::SetStrokeColor( aColor );
+
+    COMMAND& cmd = addCommand( CMD_SET_STROKE_COLOR );
+
+    cmd.m_params[0] = aColor.r;
+    cmd.m_params[1] = aColor.g;
+    cmd.m_params[2] = aColor.b;
+    cmd.m_params[3] = aColor.a;
+}
+
+
+void RECORDING_GAL::SetLineWidth( double aLineWidth )
+{
+    GAL::SetLineWidth( aLineWidth );
+    addCommand( CMD_SET_LINE_WIDTH ).m_params[0] = aLineWidth;
+}
+
+
+void RECORDING_GAL::SetLayerDepth( double aLayerDepth )
+{
+    GAL::SetLayerDepth( aLayerDepth );
+    addCommand( CMD_SET_LAYER_DEPTH ).m_params[0] = aLayerDepth;
+}
+
+
+void RECORDING_GAL::Transform( const MATRIX3x3D& aTransformation )
+{
+    addCommand( CMD_TRANSFORM ).m_first = m_matrices.size();
+    m_matrices.push_back( aTransformation );
+}
+
+
+void RECORDING_GAL::Rotate( double aAngle )
+{
+    addCommand( CMD_ROTATE ).m_params[0] = aAngle;
+}
+
+
+void RECORDING_GAL::Translate( const VECTOR2D& aTranslation )
+{
+    COMMAND& cmd = addCommand( CMD_TRANSLATE, 1 );
+
+    m_points[cmd.m_first] = aTranslation;
+}
+
+
+void RECORDING_GAL::Scale( const VECTOR2D& aScale )
+{
+    COMMAND& cmd = addCommand( CMD_SCALE, 1 );
+
+    m_points[cmd.m_first] = aScale;
+}
+
+
+void RECORDING_GAL::Save()
+{
+    addCommand( CMD_SAVE );
+}
+
+
+void RECORDING_GAL::Restore()
+{
+    addCommand( CMD_RESTORE );
+}
@@ -28,10 +28,34 @@
 
 #include <gal/stroke_font.h>
 #include <gal/graphics_abstraction_layer.h>
+#include <stroke_glyph_cache.h>
 #include <wx/string.h>
 
 using namespace KIGFX;
 
+/**
+ * A single line of text laid out at unit glyph size, neither mirrored nor slanted.
+ * The points of all the strokes are stored in a single buffer.
+ */
+struct KIGFX::STROKE_LINE_LAYOUT
+{
+    struct OVERBAR
+    {
+        double  m_start, m_end;
+        bool    m_first;    ///< true for the first character of an overbarred section
+    };
+
+    std::vector<VECTOR2D>   m_points;
+    std::vector<int>        m_strokeStart;  ///< first point of each stroke, and end of the last one
+    std::vector<OVERBAR>    m_overbars;
+    double                  m_width;
+};
+
+///> The layouts are shared by all the fonts (and GALs) using the same glyphs
+typedef std::pair<const STROKE_GLYPHS*, std::string> LAYOUT_KEY;
+
+static STROKE_LAYOUT_CACHE<LAYOUT_KEY, STROKE_LINE_LAYOUT> s_layoutCache( 8192 );
+
 const double STROKE_FONT::OVERBAR_HEIGHT = 1.22;
 const double STROKE_FONT::BOLD_FACTOR = 1.3;
 const double STROKE_FONT::HERSHEY_SCALE = 1.0 / 21.0;
@@ -40,8 +64,7 @@ STROKE_FONT::STROKE_FONT( GAL* aGal ) :
     m_gal( aGal ),
     m_bold( false ),
     m_italic( false ),
-    m_mirrored( false ),
-    m_overbar( false )
+    m_mirrored( false )
 {
     // Default values
     m_glyphSize = VECTOR2D( 10.0, 10.0 );
@@ -52,106 +75,103 @@ STROKE_FONT::STROKE_FONT( GAL* aGal ) :
 
 bool STROKE_FONT::LoadNewStrokeFont( const char* const aNewStrokeFont[], int aNewStrokeFontSize )
 {
-    m_glyphs.clear();
-    m_glyphBoundingBoxes.clear();
-    m_glyphs.resize( aNewStrokeFontSize );
-    m_glyphBoundingBoxes.resize( aNewStrokeFontSize );
+    m_glyphs = STROKE_GLYPHS::Get( aNewStrokeFont, aNewStrokeFontSize );
 
-    for( int j = 0; j < aNewStrokeFontSize; j++ )
-    {
-        GLYPH    glyph;
-        double   glyphStartX = 0.0;
-        double   glyphEndX = 0.0;
-        VECTOR2D glyphBoundingX;
+    return true;
+}
 
-        std::deque<VECTOR2D> pointList;
 
-        int i = 0;
+int STROKE_FONT::getInterline() const
+{
+    return ( m_glyphSize.y * 14 ) / 10 + m_gal->GetLineWidth();
+}
 
-        while( aNewStrokeFont[j][i] )
-        {
-            VECTOR2D    point( 0.0, 0.0 );
-            char        coordinate[2] = { 0, };
 
-            for( int k = 0; k < 2; k++ )
-            {
-                coordinate[k] = aNewStrokeFont[j][i + k];
-            }
+int STROKE_FONT::glyphIndex( int aChar ) const
+{
+    int dd = aChar - ' ';
 
-            if( i < 2 )
-            {
-                // The first two values contain the width of the char
-                glyphStartX     = ( coordinate[0] - 'R' ) * HERSHEY_SCALE;
-                glyphEndX       = ( coordinate[1] - 'R' ) * HERSHEY_SCALE;
-                glyphBoundingX  = VECTOR2D( 0, glyphEndX - glyphStartX );
-            }
-            else if( ( coordinate[0] == ' ' ) && ( coordinate[1] == 'R' ) )
-            {
-                // Raise pen
-                if( pointList.size() > 0 )
-                    glyph.push_back( pointList );
+    if( dd >= m_glyphs->GlyphCount() || dd < 0 )
+        dd = '?' - ' ';
 
-                pointList.clear();
-            }
-            else
-            {
-                // Every coordinate description of the Hershey format has an offset,
-                // it has to be subtracted
-                point.x = (double) ( coordinate[0] - 'R' ) * HERSHEY_SCALE - glyphStartX;
-				// -10 is here to keep GAL rendering consistent with the legacy gfx stuff
-                point.y = (double) ( coordinate[1] - 'R' - 10) * HERSHEY_SCALE;
-                pointList.push_back( point );
-            }
+    return dd;
+}
 
-            i += 2;
-        }
 
-        if( pointList.size() > 0 )
-            glyph.push_back( pointList );
+boost::shared_ptr<const STROKE_LINE_LAYOUT> STROKE_FONT::getLayout( const UTF8& aText ) const
+{
+    LAYOUT_KEY key( m_glyphs.get(), aText );
+    boost::shared_ptr<const STROKE_LINE_LAYOUT> cached = s_layoutCache.Find( key );
 
-        m_glyphs[j] = glyph;
+    if( cached )
+        return cached;
 
-        // Compute the bounding box of the glyph
-        m_glyphBoundingBoxes[j] = computeBoundingBox( glyph, glyphBoundingX );
-    }
+    STROKE_LINE_LAYOUT* layout = new STROKE_LINE_LAYOUT;
+    boost::shared_ptr<const STROKE_LINE_LAYOUT> result( layout );
 
-    return true;
-}
+    // By default the overbar is turned off
+    bool    overbar = false;
+    bool    last_had_overbar = false;
+    double  xOffset = 0.0;
 
+    layout->m_strokeStart.push_back( 0 );
 
-int STROKE_FONT::getInterline() const
-{
-    return ( m_glyphSize.y * 14 ) / 10 + m_gal->GetLineWidth();
-}
+    for( UTF8::uni_iter chIt = aText.ubegin(), end = aText.uend(); chIt < end; ++chIt )
+    {
+        // Toggle overbar
+        if( *chIt == '~' )
+        {
+            if( ++chIt >= end )
+                break;
 
+            if( *chIt != '~' )      // It was a single tilda, it toggles overbar
+                overbar = !overbar;
 
-BOX2D STROKE_FONT::computeBoundingBox( const GLYPH& aGLYPH, const VECTOR2D& aGLYPHBoundingX ) const
-{
-    BOX2D boundingBox;
+            // If it is a double tilda, just process the second one
+        }
 
-    std::deque<VECTOR2D> boundingPoints;
+        const STROKE_GLYPHS::GLYPH& glyph = m_glyphs->Glyph( glyphIndex( *chIt ) );
+        double advance = glyph.m_advance * HERSHEY_SCALE;
 
-    boundingPoints.push_back( VECTOR2D( aGLYPHBoundingX.x, 0 ) );
-    boundingPoints.push_back( VECTOR2D( aGLYPHBoundingX.y, 0 ) );
+        if( overbar )
+        {
+            STROKE_LINE_LAYOUT::OVERBAR bar;
 
-    for( GLYPH::const_iterator pointListIt = aGLYPH.begin(); pointListIt != aGLYPH.end(); ++pointListIt )
-    {
-        for( std::deque<VECTOR2D>::const_iterator pointIt = pointListIt->begin();
-                pointIt != pointListIt->end(); ++pointIt )
+            bar.m_start = xOffset;
+            bar.m_end   = xOffset + advance;
+            bar.m_first = !last_had_overbar;
+            layout->m_overbars.push_back( bar );
+        }
+
+        last_had_overbar = overbar;
+
+        for( int i = 0; i < glyph.m_strokeCount; i++ )
         {
-            boundingPoints.push_back( VECTOR2D( aGLYPHBoundingX.x, pointIt->y ) );
+            int stroke = glyph.m_firstStroke + i;
+            const STROKE_GLYPHS::POINT* points = m_glyphs->StrokePoints( stroke );
+
+            for( int j = 0; j < m_glyphs->StrokeSize( stroke ); j++ )
+            {
+                layout->m_points.push_back( VECTOR2D( points[j].x * HERSHEY_SCALE + xOffset,
+                                                      points[j].y * HERSHEY_SCALE ) );
+            }
+
+            layout->m_strokeStart.push_back( layout->m_points.size() );
         }
+
+        xOffset += advance;
     }
 
-    boundingBox.Compute( boundingPoints );
+    layout->m_width = xOffset;
+    s_layoutCache.Add( key, result );
 
-    return boundingBox;
+    return result;
 }
 
 
 void STROKE_FONT::Draw( const UTF8& aText, const VECTOR2D& aPosition, double aRotationAngle )
 {
-    if( aText.empty() )
+    if( aText.empty() || !m_glyphs )
         return;
 
     // Context needs to be saved before any transformations
@@ -230,15 +250,12 @@ void STROKE_FONT::Draw( const UTF8& aText, const VECTOR2D& aPosition, double aRo
 
 void STROKE_FONT::drawSingleLineText( const UTF8& aText )
 {
-    // By default the overbar is turned off
-    m_overbar = false;
+    boost::shared_ptr<const STROKE_LINE_LAYOUT> layout = getLayout( aText );
 
     double      xOffset;
-    VECTOR2D    glyphSize( m_glyphSize );
+    double      xScale;
     double      overbar_italic_comp = 0.0;
-
-    // Compute the text size
-    VECTOR2D textSize = computeTextSize( aText );
+    VECTOR2D    textSize( m_glyphSize.x * layout->m_width, m_glyphSize.y );
 
     m_gal->Save();
 
@@ -269,133 +286,60 @@ void STROKE_FONT::drawSingleLineText( const UTF8& aText )
         // (m_glyphSize.x) and start drawing from the position where text normally should end
         // (textSize.x)
         xOffset = textSize.x;
-        glyphSize.x = -m_glyphSize.x;
+        xScale = -m_glyphSize.x;
     }
     else
     {
         xOffset = 0.0;
+        xScale = m_glyphSize.x;
     }
 
     // The overbar is indented inward at the beginning of an italicized section, but
     // must not be indented on subsequent letters to ensure that the bar segments
     // overlap.
-    bool last_had_overbar = false;
-
-    for( UTF8::uni_iter chIt = aText.ubegin(), end = aText.uend(); chIt < end; ++chIt )
+    if( m_italic )
     {
-        // Toggle overbar
-        if( *chIt == '~' )
-        {
-            if( ++chIt >= end )
-                break;
-
-            if( *chIt != '~' )      // It was a single tilda, it toggles overbar
-                m_overbar = !m_overbar;
-
-            // If it is a double tilda, just process the second one
-        }
-
-        int dd = *chIt - ' ';
-
-        if( dd >= (int) m_glyphBoundingBoxes.size() || dd < 0 )
-            dd = '?' - ' ';
-
-        GLYPH& glyph = m_glyphs[dd];
-        BOX2D& bbox  = m_glyphBoundingBoxes[dd];
-
-        if( m_overbar && m_italic )
-        {
-            if( m_mirrored )
-            {
-                overbar_italic_comp = (-m_glyphSize.y * OVERBAR_HEIGHT) / 8;
-            }
-            else
-            {
-                overbar_italic_comp = (m_glyphSize.y * OVERBAR_HEIGHT) / 8;
-            }
-        }
-
-        if( m_overbar )
-        {
-            double overbar_start_x = xOffset;
-            double overbar_start_y = -m_glyphSize.y * OVERBAR_HEIGHT;
-            double overbar_end_x = xOffset + glyphSize.x * bbox.GetEnd().x;
-            double overbar_end_y = -m_glyphSize.y * OVERBAR_HEIGHT;
-
-            if( !last_had_overbar )
-            {
-                overbar_start_x += overbar_italic_comp;
-                last_had_overbar = true;
-            }
-
-            VECTOR2D startOverbar( overbar_start_x, overbar_start_y );
-            VECTOR2D endOverbar( overbar_end_x, overbar_end_y );
-
-            m_gal->DrawLine( startOverbar, endOverbar );
-        }
+        if( m_mirrored )
+            overbar_italic_comp = (-m_glyphSize.y * OVERBAR_HEIGHT) / 8;
         else
-        {
-            last_had_overbar = false;
-        }
+            overbar_italic_comp = (m_glyphSize.y * OVERBAR_HEIGHT) / 8;
+    }
 
-        for( GLYPH::iterator pointListIt = glyph.begin(); pointListIt != glyph.end();
-             ++pointListIt )
-        {
-            std::deque<VECTOR2D> pointListScaled;
+    double overbar_y = -m_glyphSize.y * OVERBAR_HEIGHT;
 
-            for( std::deque<VECTOR2D>::iterator pointIt = pointListIt->begin();
-                 pointIt != pointListIt->end(); ++pointIt )
-            {
-                VECTOR2D pointPos( pointIt->x * glyphSize.x + xOffset, pointIt->y * glyphSize.y );
-
-                if( m_italic )
-                {
-                    // FIXME should be done other way - referring to the lowest Y value of point
-                    // because now italic fonts are translated a bit
-                    if( m_mirrored )
-                        pointPos.x += pointPos.y * 0.1;
-                    else
-                        pointPos.x -= pointPos.y * 0.1;
-                }
-
-                pointListScaled.push_back( pointPos );
-            }
+    for( std::vector<STROKE_LINE_LAYOUT::OVERBAR>::const_iterator it = layout->m_overbars.begin();
+         it != layout->m_overbars.end(); ++it )
+    {
+        VECTOR2D startOverbar( xOffset + xScale * it->m_start, overbar_y );
+        VECTOR2D endOverbar( xOffset + xScale * it->m_end, overbar_y );
 
-            m_gal->DrawPolyline( pointListScaled );
-        }
+        if( it->m_first )
+            startOverbar.x += overbar_italic_comp;
 
-        xOffset += glyphSize.x * bbox.GetEnd().x;
+        m_gal->DrawLine( startOverbar, endOverbar );
     }
 
-    m_gal->Restore();
-}
+    // FIXME the italic slant should refer to the lowest Y value of the points,
+    // now italic fonts are translated a bit
+    double slant = 0.0;
 
+    if( m_italic )
+        slant = m_mirrored ? 0.1 : -0.1;
 
-VECTOR2D STROKE_FONT::computeTextSize( const UTF8& aText ) const
-{
-    VECTOR2D result = VECTOR2D( 0.0, m_glyphSize.y );
+    const std::vector<VECTOR2D>& points = layout->m_points;
+    std::vector<VECTOR2D> pointsScaled( points.size() );
 
-    for( UTF8::uni_iter it = aText.ubegin(), end = aText.uend(); it < end; ++it )
+    for( unsigned i = 0; i < points.size(); i++ )
     {
-        wxASSERT_MSG( *it != '\n',
-                      wxT( "This function is intended to work with single line strings" ) );
+        double y = points[i].y * m_glyphSize.y;
 
-        // If it is double tilda, then it is displayed as a single tilda
-        // If it is single tilda, then it is toggling overbar, so we need to skip it
-        if( *it == '~' )
-        {
-            if( ++it >= end )
-                break;
-        }
-
-        // Index in the bounding boxes table
-        int dd = *it - ' ';
+        pointsScaled[i] = VECTOR2D( points[i].x * xScale + xOffset + y * slant, y );
+    }
 
-        if( dd >= (int) m_glyphBoundingBoxes.size() || dd < 0 )
-            dd = '?' - ' ';
+    const std::vector<int>& strokeStart = layout->m_strokeStart;
 
-        result.x += m_glyphSize.x * m_glyphBoundingBoxes[dd].GetEnd().x;
-    }
+    for( unsigned i = 0; i + 1 < strokeStart.size(); i++ )
+        m_gal->DrawPolyline( &pointsScaled[strokeStart[i]], strokeStart[i + 1] - strokeStart[i] );
 
-    return result;
+    m_gal->Restore();
 }
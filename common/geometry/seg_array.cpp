@@ -0,0 +1,334 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <math/box2.h>
+#include <geometry/seg_array.h>
+#include <geometry/shape_line_chain.h>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+#if defined( HAVE_AVX2_KERNELS )
+#include <cpuid.h>
+
+// defined in seg_array_avx2.cpp, which is compiled with AVX2 enabled
+int SegArrayScanAvx2( const int* aMinX, const int* aMinY, const int* aMaxX, const int* aMaxY,
+                      int aStart, int aCount, const int aBox[4] );
+#endif
+
+
+static int scanScalar( const int* aMinX, const int* aMinY, const int* aMaxX, const int* aMaxY,
+                       int aStart, int aCount, const int aBox[4] )
+{
+    for( int i = aStart; i < aCount; i++ )
+    {
+        if( aMinX[i] <= aBox[2] && aMaxX[i] >= aBox[0] &&
+            aMinY[i] <= aBox[3] && aMaxY[i] >= aBox[1] )
+            return i;
+    }
+
+    return aCount;
+}
+
+
+#if defined( __SSE2__ )
+static int scanSse2( const int* aMinX, const int* aMinY, const int* aMaxX, const int* aMaxY,
+                     int aStart, int aCount, const int aBox[4] )
+{
+    const __m128i loX = _mm_set1_epi32( aBox[0] );
+    const __m128i loY = _mm_set1_epi32( aBox[1] );
+    const __m128i hiX = _mm_set1_epi32( aBox[2] );
+    const __m128i hiY = _mm_set1_epi32( aBox[3] );
+
+    int i = aStart;
+
+    for( ; i + 4 <= aCount; i += 4 )
+    {
+        __m128i minX = _mm_loadu_si128( (const __m128i*) ( aMinX + i ) );
+        __m128i minY = _mm_loadu_si128( (const __m128i*) ( aMinY + i ) );
+        __m128i maxX = _mm_loadu_si128( (const __m128i*) ( aMaxX + i ) );
+        __m128i maxY = _mm_loadu_si128( (const __m128i*) ( aMaxY + i ) );
+
+        __m128i reject = _mm_or_si128(
+                _mm_or_si128( _mm_cmpgt_epi32( minX, hiX ), _mm_cmpgt_epi32( loX, maxX ) ),
+                _mm_or_si128( _mm_cmpgt_epi32( minY, hiY ), _mm_cmpgt_epi32( loY, maxY ) ) );
+
+        int mask = _mm_movemask_ps( _mm_castsi128_ps( reject ) );
+
+        if( mask != 0xf )
+        {
+            while( mask & 1 )
+            {
+                mask >>= 1;
+                i++;
+            }
+
+            return i;
+        }
+    }
+
+    return scanScalar( aMinX, aMinY, aMaxX, aMaxY, i, aCount, aBox );
+}
+#endif
+
+
+#if defined( HAVE_AVX2_KERNELS )
+static bool cpuHasAvx2()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+        return false;
+
+    // AVX (bit 28) and OSXSAVE (bit 27): the OS must also save the AVX registers
+    if( !( ecx & ( 1 << 28 ) ) || !( ecx & ( 1 << 27 ) ) )
+        return false;
+
+    unsigned int xcr0, xcr0High;
+
+    __asm__( "xgetbv" : "=a" ( xcr0 ), "=d" ( xcr0High ) : "c" ( 0 ) );
+
+    if( ( xcr0 & 6 ) != 6 )
+        return false;
+
+    if( __get_cpuid_max( 0, NULL ) < 7 )
+        return false;
+
+    __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+
+    return ebx & ( 1 << 5 );    // AVX2
+}
+#endif
+
+
+static bool kernelAvailable( SEG_ARRAY::KERNEL aKernel )
+{
+    switch( aKernel )
+    {
+    case SEG_ARRAY::SCALAR:
+        return true;
+
+#if defined( __SSE2__ )
+    case SEG_ARRAY::SSE2:
+        return true;
+#endif
+
+#if defined( HAVE_AVX2_KERNELS )
+    case SEG_ARRAY::AVX2:
+        return cpuHasAvx2();
+#endif
+
+    default:
+        return false;
+    }
+}
+
+
+static SEG_ARRAY::KERNEL bestKernel()
+{
+    if( kernelAvailable( SEG_ARRAY::AVX2 ) )
+        return SEG_ARRAY::AVX2;
+
+    if( kernelAvailable( SEG_ARRAY::SSE2 ) )
+        return SEG_ARRAY::SSE2;
+
+    return SEG_ARRAY::SCALAR;
+}
+
+
+static SEG_ARRAY::KERNEL s_kernel = bestKernel();
+
+
+SEG_ARRAY::KERNEL SEG_ARRAY::Kernel()
+{
+    return s_kernel;
+}
+
+
+const char* SEG_ARRAY::KernelName( KERNEL aKernel )
+{
+    switch( aKernel )
+    {
+    case SSE2:
+        return "sse2";
+
+    case AVX2:
+        return "avx2";
+
+    default:
+        return "scalar";
+    }
+}
+
+
+bool SEG_ARRAY::SetKernel( KERNEL aKernel )
+{
+    if( !kernelAvailable( aKernel ) )
+        return false;
+
+    s_kernel = aKernel;
+    return true;
+}
+
+
+void SEG_ARRAY::Clear()
+{
+    m_segs.clear();
+    m_minX.clear();
+    m_minY.clear();
+    m_maxX.clear();
+    m_maxY.clear();
+}
+
+
+void SEG_ARRAY::Reserve( int aCount )
+{
+    m_segs.reserve( aCount );
+    m_minX.reserve( aCount );
+    m_minY.reserve( aCount );
+    m_maxX.reserve( aCount );
+    m_maxY.reserve( aCount );
+}
+
+
+void SEG_ARRAY::Add( const SEG& aSeg )
+{
+    m_segs.push_back( aSeg );
+    m_minX.push_back( std::min( aSeg.A.x, aSeg.B.x ) );
+    m_minY.push_back( std::min( aSeg.A.y, aSeg.B.y ) );
+    m_maxX.push_back( std::max( aSeg.A.x, aSeg.B.x ) );
+    m_maxY.push_back( std::max( aSeg.A.y, aSeg.B.y ) );
+}
+
+
+void SEG_ARRAY::Add( const SHAPE_LINE_CHAIN& aChain )
+{
+    Reserve( Size() + aChain.SegmentCount() );
+
+    for( int i = 0; i < aChain.SegmentCount(); i++ )
+        Add( aChain.CSegment( i ) );
+}
+
+
+int SEG_ARRAY::scan( int aStart, const int aBox[4] ) const
+{
+    if( m_segs.empty() )
+        return 0;
+
+    switch( s_kernel )
+    {
+#if defined( HAVE_AVX2_KERNELS )
+    case AVX2:
+        return SegArrayScanAvx2( &m_minX[0], &m_minY[0], &m_maxX[0], &m_maxY[0],
+                                 aStart, Size(), aBox );
+#endif
+
+#if defined( __SSE2__ )
+    case SSE2:
+        return scanSse2( &m_minX[0], &m_minY[0], &m_maxX[0], &m_maxY[0], aStart, Size(), aBox );
+#endif
+
+    default:
+        return scanScalar( &m_minX[0], &m_minY[0], &m_maxX[0], &m_maxY[0], aStart, Size(), aBox );
+    }
+}
+
+
+typedef SEG_ARRAY::ecoord ecoord;
+
+
+// Stores in aBox the bounding box of aSeg, inflated by aMargin and clamped to the int range
+static void inflatedBox( const SEG& aSeg, ecoord aMargin, int aBox[4] )
+{
+    const ecoord lo = INT_MIN;
+    const ecoord hi = INT_MAX;
+
+    aBox[0] = std::max( lo, (ecoord) std::min( aSeg.A.x, aSeg.B.x ) - aMargin );
+    aBox[1] = std::max( lo, (ecoord) std::min( aSeg.A.y, aSeg.B.y ) - aMargin );
+    aBox[2] = std::min( hi, (ecoord) std::max( aSeg.A.x, aSeg.B.x ) + aMargin );
+    aBox[3] = std::min( hi, (ecoord) std::max( aSeg.A.y, aSeg.B.y ) + aMargin );
+}
+
+
+int SEG_ARRAY::Find( const SEG& aSeg, int aClearance, int aStart ) const
+{
+    BOX2I box_a( aSeg.A, aSeg.B - aSeg.A );
+    BOX2I::ecoord_type dist_sq = (BOX2I::ecoord_type) aClearance * aClearance;
+
+    // The boxes of the candidates must be closer than the clearance along both axes,
+    // otherwise their squared distance can't be smaller than dist_sq
+    ecoord margin = ( aClearance < 0 ? -(ecoord) aClearance : (ecoord) aClearance ) - 1;
+
+    if( margin < 0 )
+        return -1;
+
+    int box[4];
+
+    inflatedBox( aSeg, margin, box );
+
+    for( int i = scan( aStart, box ); i < Size(); i = scan( i + 1, box ) )
+    {
+        const SEG& s = m_segs[i];
+        BOX2I box_b( s.A, s.B - s.A );
+
+        if( box_a.SquaredDistance( box_b ) < dist_sq && s.Collide( aSeg, aClearance ) )
+            return i;
+    }
+
+    return -1;
+}
+
+
+SEG_ARRAY::ecoord SEG_ARRAY::SquaredDistance( const SEG& aSeg ) const
+{
+    ecoord best = VECTOR2I::ECOORD_MAX;
+    int box[4];
+
+    inflatedBox( aSeg, INT_MAX, box );
+
+    for( int i = scan( 0, box ); i < Size(); i = scan( i + 1, box ) )
+    {
+        ecoord d = m_segs[i].SquaredDistance( aSeg );
+
+        if( d < best )
+        {
+            best = d;
+
+            // a segment whose box is farther than sqrt( best ) along an axis
+            // can't be any closer
+            inflatedBox( aSeg, (ecoord) ceil( sqrt( (double) best ) ) + 1, box );
+        }
+    }
+
+    return best;
+}
+
+
+int SEG_ARRAY::Distance( const SEG& aSeg ) const
+{
+    return sqrt( (double) SquaredDistance( aSeg ) );
+}
@@ -0,0 +1,76 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file seg_array_avx2.cpp
+ * @brief AVX2 kernel of SEG_ARRAY. This file is compiled with AVX2 enabled, and its
+ * functions are only called once SEG_ARRAY has checked that the CPU supports AVX2.
+ */
+
+#include <immintrin.h>
+
+
+int SegArrayScanAvx2( const int* aMinX, const int* aMinY, const int* aMaxX, const int* aMaxY,
+                      int aStart, int aCount, const int aBox[4] )
+{
+    const __m256i loX = _mm256_set1_epi32( aBox[0] );
+    const __m256i loY = _mm256_set1_epi32( aBox[1] );
+    const __m256i hiX = _mm256_set1_epi32( aBox[2] );
+    const __m256i hiY = _mm256_set1_epi32( aBox[3] );
+
+    int i = aStart;
+
+    for( ; i + 8 <= aCount; i += 8 )
+    {
+        __m256i minX = _mm256_loadu_si256( (const __m256i*) ( aMinX + i ) );
+        __m256i minY = _mm256_loadu_si256( (const __m256i*) ( aMinY + i ) );
+        __m256i maxX = _mm256_loadu_si256( (const __m256i*) ( aMaxX + i ) );
+        __m256i maxY = _mm256_loadu_si256( (const __m256i*) ( aMaxY + i ) );
+
+        __m256i reject = _mm256_or_si256(
+                _mm256_or_si256( _mm256_cmpgt_epi32( minX, hiX ), _mm256_cmpgt_epi32( loX, maxX ) ),
+                _mm256_or_si256( _mm256_cmpgt_epi32( minY, hiY ), _mm256_cmpgt_epi32( loY, maxY ) ) );
+
+        int mask = _mm256_movemask_ps( _mm256_castsi256_ps( reject ) );
+
+        if( mask != 0xff )
+        {
+            while( mask & 1 )
+            {
+                mask >>= 1;
+                i++;
+            }
+
+            return i;
+        }
+    }
+
+    for( ; i < aCount; i++ )
+    {
+        if( aMinX[i] <= aBox[2] && aMaxX[i] >= aBox[0] &&
+            aMinY[i] <= aBox[3] && aMaxY[i] >= aBox[1] )
+            return i;
+    }
+
+    return aCount;
+}
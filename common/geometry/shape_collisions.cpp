@@ -27,6 +27,7 @@
 
 #include <geometry/shape.h>
 #include <geometry/shape_line_chain.h>
+#include <geometry/seg_array.h>
 #include <geometry/shape_circle.h>
 #include <geometry/shape_rect.h>
 #include <geometry/shape_segment.h>
@@ -220,6 +221,19 @@ static inline bool Collide( const SHAPE_CIRCLE& aA, const SHAPE_SEGMENT& aSeg, i
 static inline bool Collide( const SHAPE_LINE_CHAIN& aA, const SHAPE_LINE_CHAIN& aB, int aClearance,
                             bool aNeedMTV, VECTOR2I& aMTV )
 {
+    // Testing each segment of aB against a SEG_ARRAY of aA is faster than the scalar
+    // loops, once the cost of building the array is shared by enough segments
+    if( aA.SegmentCount() >= SEG_ARRAY::MinBatchSize && aB.SegmentCount() >= 4 )
+    {
+        SEG_ARRAY segs( aA );
+
+        for( int i = 0; i < aB.SegmentCount(); i++ )
+            if( segs.Collide( aB.CSegment( i ), aClearance ) )
+                return true;
+
+        return false;
+    }
+
     for( int i = 0; i < aB.SegmentCount(); i++ )
         if( aA.Collide( aB.CSegment( i ), aClearance ) )
             return true;
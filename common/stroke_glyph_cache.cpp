@@ -0,0 +1,101 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stroke_glyph_cache.h>
+
+
+typedef std::map<const char* const*, boost::shared_ptr<const STROKE_GLYPHS> > FONT_MAP;
+
+static FONT_MAP     s_fonts;
+static boost::mutex s_fontsMutex;
+
+
+boost::shared_ptr<const STROKE_GLYPHS> STROKE_GLYPHS::Get( const char* const aFont[],
+                                                           int aGlyphCount )
+{
+    boost::mutex::scoped_lock lock( s_fontsMutex );
+
+    FONT_MAP::iterator it = s_fonts.find( aFont );
+
+    if( it == s_fonts.end() )
+    {
+        boost::shared_ptr<const STROKE_GLYPHS> glyphs( new STROKE_GLYPHS( aFont, aGlyphCount ) );
+
+        it = s_fonts.insert( FONT_MAP::value_type( aFont, glyphs ) ).first;
+    }
+
+    return it->second;
+}
+
+
+STROKE_GLYPHS::STROKE_GLYPHS( const char* const aFont[], int aGlyphCount )
+{
+    m_glyphs.resize( aGlyphCount );
+    m_strokeStart.push_back( 0 );
+
+    for( int j = 0; j < aGlyphCount; j++ )
+    {
+        const char* shape = aFont[j];
+        GLYPH& glyph = m_glyphs[j];
+
+        glyph.m_firstStroke = m_strokeStart.size() - 1;
+        glyph.m_strokeCount = 0;
+        glyph.m_advance = 0;
+
+        if( !shape[0] || !shape[1] )
+            continue;
+
+        // The first two values contain the horizontal extent of the glyph
+        int xsta = shape[0] - 'R';
+        int xsto = shape[1] - 'R';
+
+        glyph.m_advance = xsto - xsta;
+
+        // Every coordinate of the Hershey format is coded as <value> + 'R', and " R"
+        // raises the pen. Add a pen up at the end of the glyph.
+        for( int i = 2; ; i += 2 )
+        {
+            bool penUp = !shape[i] || ( shape[i] == ' ' && shape[i + 1] == 'R' );
+
+            if( penUp )
+            {
+                if( (int) m_points.size() > m_strokeStart.back() )
+                {
+                    m_strokeStart.push_back( m_points.size() );
+                    glyph.m_strokeCount++;
+                }
+
+                if( !shape[i] )
+                    break;
+            }
+            else
+            {
+                POINT point;
+
+                point.x = shape[i] - 'R' - xsta;
+                point.y = shape[i + 1] - 'R' - 10;
+                m_points.push_back( point );
+            }
+        }
+    }
+}
@@ -0,0 +1,196 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file thread_pool.cpp
+ */
+
+#include <thread_pool.h>
+
+#include <boost/bind.hpp>
+
+
+THREAD_POOL::THREAD_POOL( int aThreadCount ) :
+    m_pending( 0 ),
+    m_running( 0 ),
+    m_finished( 0 ),
+    m_quit( false )
+{
+    m_threadCount = aThreadCount > 0 ? aThreadCount : DefaultThreadCount();
+    m_queues.resize( m_threadCount + 1 );
+
+    for( int i = 0; i < m_threadCount; ++i )
+        m_threads.create_thread( boost::bind( &THREAD_POOL::worker, this, i ) );
+}
+
+
+THREAD_POOL::~THREAD_POOL()
+{
+    CancelPending();
+
+    {
+        boost::mutex::scoped_lock lock( m_lock );
+        m_quit = true;
+    }
+
+    m_jobAvailable.notify_all();
+    m_threads.join_all();
+}
+
+
+int THREAD_POOL::DefaultThreadCount()
+{
+    int count = boost::thread::hardware_concurrency();
+
+    return count > 0 ? count : 1;
+}
+
+
+void THREAD_POOL::Submit( const JOB& aJob )
+{
+    // Jobs submitted by a worker are kept on its own queue
+    int* worker = m_workerIndex.get();
+
+    {
+        boost::mutex::scoped_lock lock( m_lock );
+
+        m_queues[worker ? *worker : m_threadCount].push_back( aJob );
+        ++m_pending;
+    }
+
+    m_jobAvailable.notify_one();
+}
+
+
+bool THREAD_POOL::Wait( int aTimeout )
+{
+    boost::mutex::scoped_lock lock( m_lock );
+
+    if( aTimeout < 0 )
+    {
+        while( m_pending > 0 || m_running > 0 )
+            m_jobFinished.wait( lock );
+
+        return true;
+    }
+
+    boost::system_time deadline = boost::get_system_time() +
+                                  boost::posix_time::milliseconds( aTimeout );
+
+    while( m_pending > 0 || m_running > 0 )
+    {
+        if( !m_jobFinished.timed_wait( lock, deadline ) )
+            return m_pending == 0 && m_running == 0;
+    }
+
+    return true;
+}
+
+
+void THREAD_POOL::CancelPending()
+{
+    {
+        boost::mutex::scoped_lock lock( m_lock );
+
+        for( unsigned int i = 0; i < m_queues.size(); ++i )
+            m_queues[i].clear();
+
+        m_pending = 0;
+    }
+
+    m_jobFinished.notify_all();
+}
+
+
+int THREAD_POOL::GetFinishedCount() const
+{
+    boost::mutex::scoped_lock lock( m_lock );
+
+    return m_finished;
+}
+
+
+bool THREAD_POOL::takeJob( int aIndex, JOB& aJob )
+{
+    // Most recent job of the own queue: it is likely to use data still in the cache
+    std::deque<JOB>& own = m_queues[aIndex];
+
+    if( !own.empty() )
+    {
+        aJob = own.back();
+        own.pop_back();
+        return true;
+    }
+
+    // Then the oldest job of the shared queue, and the oldest jobs of the other workers
+    for( int i = 0; i < m_threadCount; ++i )
+    {
+        std::deque<JOB>& queue = m_queues[i == 0 ? m_threadCount : ( aIndex + i ) % m_threadCount];
+
+        if( !queue.empty() )
+        {
+            aJob = queue.front();
+            queue.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void THREAD_POOL::worker( int aIndex )
+{
+    m_workerIndex.reset( new int( aIndex ) );
+
+    for( ;; )
+    {
+        JOB job;
+
+        {
+            boost::mutex::scoped_lock lock( m_lock );
+
+            // The pending jobs are all in the queues, so a worker finding none sleeps
+            // until the next Submit()
+            while( !m_quit && !takeJob( aIndex, job ) )
+                m_jobAvailable.wait( lock );
+
+            if( m_quit )
+                return;
+
+            --m_pending;
+            ++m_running;
+        }
+
+        job();
+
+        {
+            boost::mutex::scoped_lock lock( m_lock );
+
+            --m_running;
+            ++m_finished;
+        }
+
+        m_jobFinished.notify_all();
+    }
+}
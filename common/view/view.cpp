@@ -22,7 +22,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
+#include <map>
+#include <algorithm>
+#include <cmath>
+
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 #include <base_struct.h>
 #include <layers_id_colors_and_visibility.h>
@@ -32,11 +37,13 @@
 #include <view/view_rtree.h>
 #include <gal/definitions.h>
 #include <gal/graphics_abstraction_layer.h>
+#include <gal/recording_gal.h>
 #include <painter.h>
+#include <thread_pool.h>
 
 #ifdef PROFILE
 #include <profile.h>
-#endif /* PROFILE  */
+#endif /* PROFILE */
 
 using namespace KIGFX;
 
@@ -44,9 +51,12 @@ VIEW::VIEW( bool aIsDynamic ) :
     m_enableOrderModifier( true ),
     m_scale( 4.0 ),
     m_minScale( 4.0 ), m_maxScale( 15000 ),
+    m_minItemSize( 1.0 ),
     m_painter( NULL ),
     m_gal( NULL ),
-    m_dynamic( aIsDynamic )
+    m_dynamic( aIsDynamic ),
+    m_recachePool( NULL ),
+    m_recacheThreadCount( 0 )
 {
     m_boundary.SetMaximum();
     m_needsUpdate.reserve( 32768 );
@@ -67,6 +77,11 @@ VIEW::~VIEW()
 {
     BOOST_FOREACH( LAYER_MAP::value_type& l, m_layers )
         delete l.second.items;
+
+    delete m_recachePool;
+
+    BOOST_FOREACH( RECORDING_GAL* recorder, m_recorders )
+        delete recorder;
 }
 
 
@@ -108,6 +123,47 @@ void VIEW::Add( VIEW_ITEM* aItem )
 }
 
 
+void VIEW::AddItems( const std::vector<VIEW_ITEM*>& aItems )
+{
+    int layers[VIEW_MAX_LAYERS], layers_count;
+    std::map<int, std::vector<VIEW_ITEM*> > layerItems;
+
+    BOOST_FOREACH( VIEW_ITEM* item, aItems )
+    {
+        item->ViewGetLayers( layers, layers_count );
+        item->saveLayers( layers, layers_count );
+
+        if( m_dynamic )
+            item->viewAssign( this );
+
+        for( int i = 0; i < layers_count; ++i )
+            layerItems[layers[i]].push_back( item );
+    }
+
+    for( std::map<int, std::vector<VIEW_ITEM*> >::iterator it = layerItems.begin();
+         it != layerItems.end(); ++it )
+    {
+        VIEW_LAYER& l = m_layers[it->first];
+
+        if( l.items->Empty() )
+        {
+            l.items->BulkLoad( it->second );
+        }
+        else
+        {
+            BOOST_FOREACH( VIEW_ITEM* item, it->second )
+                l.items->Insert( item );
+        }
+
+        MarkTargetDirty( l.target );
+    }
+
+    // As in Add(), once the items are in the trees
+    BOOST_FOREACH( VIEW_ITEM* item, aItems )
+        item->ViewUpdate( VIEW_ITEM::ALL );
+}
+
+
 void VIEW::Remove( VIEW_ITEM* aItem )
 {
     if( m_dynamic )
@@ -579,8 +635,10 @@ void VIEW::UpdateAllLayersOrder()
 
 struct VIEW::drawItem
 {
-    drawItem( VIEW* aView, int aLayer ) :
-        view( aView ), layer( aLayer )
+    drawItem( VIEW* aView, int aLayer, std::vector<VIEW_ITEM*>* aSimplified,
+              bool aSimplifyAll = false ) :
+        view( aView ), layer( aLayer ), drawn( 0 ), simplifiedCount( 0 ),
+        simplified( aSimplified ), simplifyAll( aSimplifyAll )
     {
     }
 
@@ -592,32 +650,108 @@ struct VIEW::drawItem
         if( !drawCondition )
             return true;
 
+        // Too small to show its details, it is drawn after the layer as a rectangle
+        if( simplifyAll || aItem->ViewGetDetailLOD( layer ) >= view->m_scale )
+        {
+            simplified->push_back( aItem );
+            simplifiedCount++;
+            return true;
+        }
+
         view->draw( aItem, layer );
+        drawn++;
 
         return true;
     }
 
     VIEW* view;
     int layer, layers[VIEW_MAX_LAYERS];
+    int drawn, simplifiedCount;
+    std::vector<VIEW_ITEM*>* simplified;
+    bool simplifyAll;
 };
 
 
 void VIEW::redrawRect( const BOX2I& aRect )
 {
+    // Items of cached layers smaller than that (in world units) are always simplified
+    int minSize = ceil( m_minItemSize / m_gal->GetWorldScale() );
+    std::vector<VIEW_ITEM*> simplified;
+#ifdef PROFILE
+    prof_counter layerTime;
+#endif /* PROFILE */
+
+    // The cached target may keep more than the visible area (eg. whole tiles)
+    BOX2D cachedArea = m_gal->GetCachedArea( BOX2D( aRect.GetOrigin(), aRect.GetSize() ) );
+    BOX2I cachedRect( VECTOR2I( cachedArea.GetOrigin() ), VECTOR2I( cachedArea.GetSize() ) );
+    cachedRect.Inflate( 1, 1 );
+
     BOOST_FOREACH( VIEW_LAYER* l, m_orderedLayers )
     {
+        l->stats = LAYER_DRAW_STATS();
+
         if( l->visible && IsTargetDirty( l->target ) && areRequiredLayersEnabled( l->id ) )
         {
-            drawItem drawFunc( this, l->id );
+            drawItem drawFunc( this, l->id, &simplified );
+            drawItem tinyFunc( this, l->id, &simplified, true );
+
+#ifdef PROFILE
+            prof_start( &layerTime );
+#endif /* PROFILE */
 
             m_gal->SetTarget( l->target );
             m_gal->SetLayerDepth( l->renderingOrder );
-            l->items->Query( aRect, drawFunc );
+
+            // Layers that are not cached usually hold the items whose size on the screen
+            // is fixed (eg. cursors, markers), or that are already limited by their LOD
+            if( l->target == TARGET_CACHED && minSize > 0 )
+                l->items->Query( cachedRect, minSize, drawFunc, tinyFunc );
+            else if( l->target == TARGET_CACHED )
+                l->items->Query( cachedRect, drawFunc );
+            else
+                l->items->Query( aRect, drawFunc );
+
+            if( !simplified.empty() )
+                drawSimplified( simplified, l->id );
+
+#ifdef PROFILE
+            prof_end( &layerTime );
+            l->stats.msecs = layerTime.msecs();
+#endif /* PROFILE */
+
+            l->stats.drawn = drawFunc.drawn;
+            l->stats.simplified = simplified.size();
+            l->stats.tiny = tinyFunc.simplifiedCount;
+
+            simplified.clear();
         }
     }
 }
 
 
+void VIEW::drawSimplified( const std::vector<VIEW_ITEM*>& aItems, int aLayer )
+{
+    RENDER_TARGET target = m_gal->GetTarget();
+
+    // Cached targets accept only groups, whereas the simplified items are drawn on each redraw
+    if( target == TARGET_CACHED )
+        m_gal->SetTarget( TARGET_NONCACHED );
+
+    m_gal->SetIsStroke( false );
+    m_gal->SetIsFill( true );
+
+    BOOST_FOREACH( VIEW_ITEM* item, aItems )
+    {
+        const BOX2I bbox = item->ViewBBox();
+
+        m_gal->SetFillColor( m_painter->GetSettings()->GetColor( item, aLayer ) );
+        m_gal->DrawRectangle( bbox.GetOrigin(), bbox.GetEnd() );
+    }
+
+    m_gal->SetTarget( target );
+}
+
+
 void VIEW::draw( VIEW_ITEM* aItem, int aLayer, bool aImmediate )
 {
     if( IsCached( aLayer ) && !aImmediate )
@@ -688,8 +822,10 @@ struct VIEW::unlinkItem
 
 struct VIEW::recacheItem
 {
-    recacheItem( VIEW* aView, GAL* aGal, int aLayer, bool aImmediately ) :
-        view( aView ), gal( aGal ), layer( aLayer ), immediately( aImmediately )
+    recacheItem( VIEW* aView, GAL* aGal, int aLayer, bool aImmediately,
+                 const GAL::ATTRIBUTES& aAttributes ) :
+        view( aView ), gal( aGal ), layer( aLayer ), immediately( aImmediately ),
+        attributes( aAttributes )
     {
     }
 
@@ -706,6 +842,9 @@ struct VIEW::recacheItem
             group = gal->BeginGroup();
             aItem->setGroup( layer, group );
 
+            // Every item starts from the same attributes, as with the recache threads
+            gal->SetAttributes( attributes );
+
             if( !view->m_painter->Draw( aItem, layer ) )
                 aItem->ViewDraw( layer, gal ); // Alternative drawing method
 
@@ -724,6 +863,7 @@ struct VIEW::recacheItem
     GAL* gal;
     int layer;
     bool immediately;
+    const GAL::ATTRIBUTES& attributes;
 };
 
 
@@ -795,6 +935,16 @@ void VIEW::Redraw()
     prof_end( &totalRealTime );
 
     wxLogDebug( wxT( "Redraw: %.1f ms" ), totalRealTime.msecs() );
+
+    BOOST_FOREACH( VIEW_LAYER* l, m_orderedLayers )
+    {
+        if( l->stats.drawn + l->stats.simplified > 0 )
+        {
+            wxLogDebug( wxT( "Redraw: layer %d: %.2f ms, %d drawn, %d simplified (%d tiny)" ),
+                        l->id, l->stats.msecs, l->stats.drawn, l->stats.simplified,
+                        l->stats.tiny );
+        }
+    }
 #endif /* PROFILE */
 }
 
@@ -1010,17 +1160,29 @@ void VIEW::RecacheAllItems( bool aImmediately )
     prof_start( &totalRealTime );
 #endif /* PROFILE */
 
-    for( LAYER_MAP_ITER i = m_layers.begin(); i != m_layers.end(); ++i )
+    int threadCount = m_recacheThreadCount > 0 ? m_recacheThreadCount
+                                               : THREAD_POOL::DefaultThreadCount();
+
+    if( aImmediately && threadCount > 1 )
     {
-        VIEW_LAYER* l = &( ( *i ).second );
+        recacheParallel();
+    }
+    else
+    {
+        const GAL::ATTRIBUTES attributes = m_gal->GetAttributes();
 
-        if( IsCached( l->id ) )
+        for( LAYER_MAP_ITER i = m_layers.begin(); i != m_layers.end(); ++i )
         {
-            m_gal->SetTarget( l->target );
-            m_gal->SetLayerDepth( l->renderingOrder );
-            recacheItem visitor( this, m_gal, l->id, aImmediately );
-            l->items->Query( r, visitor );
-            MarkTargetDirty( l->target );
+            VIEW_LAYER* l = &( ( *i ).second );
+
+            if( IsCached( l->id ) )
+            {
+                m_gal->SetTarget( l->target );
+                m_gal->SetLayerDepth( l->renderingOrder );
+                recacheItem visitor( this, m_gal, l->id, aImmediately, attributes );
+                l->items->Query( r, visitor );
+                MarkTargetDirty( l->target );
+            }
         }
     }
 
@@ -1033,6 +1195,201 @@ void VIEW::RecacheAllItems( bool aImmediately )
 }
 
 
+void VIEW::SetRecacheThreadCount( int aCount )
+{
+    if( aCount == m_recacheThreadCount )
+        return;
+
+    m_recacheThreadCount = aCount;
+
+    // the pool is created again with the new count when needed
+    delete m_recachePool;
+    m_recachePool = NULL;
+}
+
+
+/// Number of items taken at once by the recache threads: the items recorded together
+/// are replayed together, which keeps the replay cache friendly
+static const int recacheBatchSize = 64;
+
+
+struct VIEW::recordedItem
+{
+    VIEW_ITEM*  item;
+    VIEW_LAYER* layer;
+    int         worker;     ///< recorder of the item, -1 if it has to be drawn on the main thread
+    int         begin;      ///< first recorded command
+    int         end;        ///< command following the last recorded one
+    int         built;      ///< data built by the worker GROUP_BUILDER, -1 if none
+};
+
+
+struct VIEW::gatherItems
+{
+    gatherItems( std::vector<recordedItem>& aItems, VIEW_LAYER* aLayer ) :
+        items( aItems ), layer( aLayer )
+    {
+    }
+
+    bool operator()( VIEW_ITEM* aItem )
+    {
+        recordedItem r;
+
+        r.item = aItem;
+        r.layer = layer;
+        r.worker = -1;
+        r.begin = r.end = 0;
+        r.built = -1;
+        items.push_back( r );
+
+        return true;
+    }
+
+    std::vector<recordedItem>& items;
+    VIEW_LAYER* layer;
+};
+
+
+void VIEW::recacheParallel()
+{
+    if( !m_recachePool )
+        m_recachePool = new THREAD_POOL( m_recacheThreadCount );
+
+    int workerCount = m_recachePool->GetThreadCount();
+
+    while( (int) m_recorders.size() < workerCount )
+        m_recorders.push_back( new RECORDING_GAL );
+
+    std::vector<recordedItem> items;
+    std::vector<PAINTER*> painters;
+    std::vector<GROUP_BUILDER*> builders( workerCount, (GROUP_BUILDER*) NULL );
+    const GAL::ATTRIBUTES attributes = m_gal->GetAttributes();
+    BOX2I r;
+
+    r.SetMaximum();
+
+    for( LAYER_MAP_ITER i = m_layers.begin(); i != m_layers.end(); ++i )
+    {
+        VIEW_LAYER* l = &( ( *i ).second );
+
+        if( IsCached( l->id ) )
+        {
+            gatherItems visitor( items, l );
+            l->items->Query( r, visitor );
+            MarkTargetDirty( l->target );
+        }
+    }
+
+    // Parallel phase: the items are drawn by the worker painters, each one recording the
+    // commands in its own GAL. If the GAL supports it, the workers also build the groups data
+    // from the recorded commands. Painters not supporting it draw everything below.
+    boost::atomic<int> next( 0 );
+
+    for( int i = 0; i < workerCount; ++i )
+    {
+        PAINTER* painter = m_painter->Clone( m_recorders[i] );
+
+        if( !painter )
+            break;
+
+        m_recorders[i]->SyncState( *m_gal );
+        painters.push_back( painter );
+
+        builders[i] = m_gal->CreateGroupBuilder();
+
+        if( builders[i] )
+            builders[i]->SyncState( *m_gal );
+
+        m_recachePool->Submit( boost::bind( &VIEW::recordItems, this, &items, &next,
+                                            i, painter, builders[i] ) );
+    }
+
+    m_recachePool->Wait();
+
+    BOOST_FOREACH( PAINTER* painter, painters )
+        delete painter;
+
+    // Serial phase: the built data (or the recorded commands) are added to new groups, layer
+    // by layer, in the order of the serial recache
+    VIEW_LAYER* layer = NULL;
+
+    BOOST_FOREACH( recordedItem& rec, items )
+    {
+        if( rec.layer != layer )
+        {
+            layer = rec.layer;
+            m_gal->SetTarget( layer->target );
+            m_gal->SetLayerDepth( layer->renderingOrder );
+        }
+
+        int group = rec.item->getGroup( layer->id );
+
+        if( group >= 0 )
+            m_gal->DeleteGroup( group );
+
+        group = m_gal->BeginGroup();
+        rec.item->setGroup( layer->id, group );
+
+        // The items start from the attributes the workers recorded or built them with
+        if( rec.built >= 0 )
+        {
+            builders[rec.worker]->AddToGroup( rec.built );
+        }
+        else
+        {
+            m_gal->SetAttributes( attributes );
+
+            if( rec.worker >= 0 )
+                m_recorders[rec.worker]->Replay( *m_gal, rec.begin, rec.end );
+            else if( !m_painter->Draw( rec.item, layer->id ) )
+                rec.item->ViewDraw( layer->id, m_gal ); // Alternative drawing method
+        }
+
+        m_gal->EndGroup();
+    }
+
+    BOOST_FOREACH( GROUP_BUILDER* builder, builders )
+        delete builder;
+
+    BOOST_FOREACH( RECORDING_GAL* recorder, m_recorders )
+        recorder->Clear();
+}
+
+
+void VIEW::recordItems( std::vector<recordedItem>* aItems, boost::atomic<int>* aNext,
+                        int aWorker, PAINTER* aPainter, GROUP_BUILDER* aBuilder )
+{
+    const int count = aItems->size();
+    RECORDING_GAL* recorder = m_recorders[aWorker];
+    int first;
+
+    while( ( first = aNext->fetch_add( recacheBatchSize ) ) < count )
+    {
+        for( int i = first; i < std::min( first + recacheBatchSize, count ); ++i )
+        {
+            recordedItem& rec = ( *aItems )[i];
+            int begin = recorder->GetPosition();
+
+            recorder->RestoreAttributes();
+
+            // Items drawn by themselves (VIEW_ITEM::ViewDraw()) are left to the main thread
+            if( aPainter->Draw( rec.item, rec.layer->id ) )
+            {
+                rec.worker = aWorker;
+                rec.begin = begin;
+                rec.end = recorder->GetPosition();
+
+                if( aBuilder )
+                {
+                    rec.built = aBuilder->Build( *recorder, rec.begin, rec.end,
+                                                 rec.layer->renderingOrder );
+                }
+            }
+        }
+    }
+}
+
+
 void VIEW::UpdateItems()
 {
     // Update items that need this
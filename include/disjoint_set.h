@@ -0,0 +1,121 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file disjoint_set.h
+ * @brief Disjoint-set forest (union-find) of integer elements.
+ */
+
+#ifndef DISJOINT_SET_H
+#define DISJOINT_SET_H
+
+#include <vector>
+#include <algorithm>
+
+
+/**
+ * Class DISJOINT_SET
+ * partitions the elements 0..n-1 in disjoint sets, merged with Union() and
+ * identified by their root element, returned by Find().
+ * <p>
+ * Union by size and path halving make any sequence of m operations run in
+ * O( m * alpha( n ) ), i.e. in practically linear time.
+ * </p>
+ */
+class DISJOINT_SET
+{
+public:
+    DISJOINT_SET( int aSize = 0 )
+    {
+        Reset( aSize );
+    }
+
+    /**
+     * Function Reset
+     * makes aSize singleton sets, one for each element 0..aSize-1.
+     */
+    void Reset( int aSize )
+    {
+        m_parent.resize( aSize );
+        m_size.assign( aSize, 1 );
+
+        for( int ii = 0; ii < aSize; ii++ )
+            m_parent[ii] = ii;
+    }
+
+    /**
+     * Function Find
+     * @return the root element of the set containing aElement.
+     */
+    int Find( int aElement )
+    {
+        while( m_parent[aElement] != aElement )
+        {
+            // Path halving: link each visited element to its grandparent
+            m_parent[aElement] = m_parent[m_parent[aElement]];
+            aElement = m_parent[aElement];
+        }
+
+        return aElement;
+    }
+
+    /**
+     * Function Union
+     * merges the sets containing aFirst and aSecond.
+     * @return the root of the merged set.
+     */
+    int Union( int aFirst, int aSecond )
+    {
+        int root1 = Find( aFirst );
+        int root2 = Find( aSecond );
+
+        if( root1 == root2 )
+            return root1;
+
+        // The smaller tree is attached to the root of the bigger one
+        if( m_size[root1] < m_size[root2] )
+            std::swap( root1, root2 );
+
+        m_parent[root2] = root1;
+        m_size[root1] += m_size[root2];
+
+        return root1;
+    }
+
+    /**
+     * Function GetSetSize
+     * @return the number of elements of the set containing aElement.
+     */
+    int GetSetSize( int aElement )
+    {
+        return m_size[Find( aElement )];
+    }
+
+    int GetSize() const { return m_parent.size(); }
+
+private:
+    std::vector<int> m_parent;
+    std::vector<int> m_size;        ///< element count of the sets, valid for roots only
+};
+
+#endif  // DISJOINT_SET_H
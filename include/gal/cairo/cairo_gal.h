@@ -28,7 +28,9 @@
 #define CAIROGAL_H_
 
 #include <map>
+#include <vector>
 #include <iterator>
+#include <stdint.h>
 
 #include <cairo.h>
 
@@ -46,6 +48,8 @@
 #endif
 #endif
 
+class THREAD_POOL;
+
 /**
  * @brief Class CAIRO_GAL is the cairo implementation of the graphics abstraction layer.
  *
@@ -57,6 +61,8 @@
  * Cairo offers also backends for Postscript and PDF surfaces. So it can be used for printing
  * of KiCad graphics surfaces as well.
  *
+ * The cached and noncached targets are rasterized in tiles, which are reused as long as the
+ * items drawn in them do not change (see EnableTileCache()).
  */
 namespace KIGFX
 {
@@ -139,6 +145,9 @@ public:
     /// @copydoc GAL::ClearScreen()
     virtual void ClearScreen( const COLOR4D& aColor );
 
+    /// @copydoc GAL::ComputeWorldScreenMatrix()
+    virtual void ComputeWorldScreenMatrix();
+
     // -----------------
     // Attribute setting
     // -----------------
@@ -227,6 +236,25 @@ public:
     /// @copydoc GAL::ClearTarget()
     virtual void ClearTarget( RENDER_TARGET aTarget );
 
+    /// @copydoc GAL::GetCachedArea()
+    virtual BOX2D GetCachedArea( const BOX2D& aVisibleArea ) const;
+
+    /**
+     * @brief Enables or disables the tile cache of the cached target (enabled by default).
+     *
+     * With the tile cache, the groups drawn on the cached target are not rasterized on the
+     * screen, but in square tiles aligned on the screen pixels for the current zoom. The tiles
+     * are rasterized on worker threads and kept as long as the groups drawn in them do not
+     * change, so panning only rasterizes the tiles uncovered on the screen, the other ones are
+     * just blitted. The items drawn without a group (eg. on the noncached target) are stored
+     * as temporary groups in the layer being drawn, so the layers keep their order. Only the
+     * grid is drawn directly on the screen, under the tiles. Both targets have to be redrawn
+     * after a change.
+     *
+     * @param aEnable tells if the tile cache should be used.
+     */
+    void EnableTileCache( bool aEnable );
+
     // -------
     // Cursor
     // -------
@@ -237,6 +265,9 @@ public:
     /// @copydoc GAL::DrawCursor()
     virtual void DrawCursor( const VECTOR2D& aCursorPosition );
 
+    /// @copydoc GAL::DrawGrid()
+    virtual void DrawGrid();
+
     /**
      * Function PostPaint
      * posts an event to m_paint_listener.  A post is used so that the actual drawing
@@ -329,6 +360,47 @@ private:
     unsigned int                groupCounter;       ///< Counter used for generating keys for groups
     GROUP*                      currentGroup;       ///< Currently used group
 
+    /// State changed by the commands of the groups
+    struct REPLAY_STATE
+    {
+        bool    isFillEnabled;
+        bool    isStrokeEnabled;
+        COLOR4D fillColor;
+        COLOR4D strokeColor;
+    };
+
+    // Variables for the tile cache
+    static const int TILE_SIZE = 256;               ///< Width and height of the tiles, in pixels
+    static const int LAYER_BREAK = -1;              ///< Separates the layers in the draw lists
+
+    /// A tile of the cached target
+    struct TILE
+    {
+        TILE() : surface( NULL ), signature( 0 ), lastUse( 0 ), isEmpty( true ) {}
+
+        cairo_surface_t*    surface;                ///< Pixels of the tile
+        uint64_t            signature;              ///< Hash of the draw list of the tile
+        unsigned int        lastUse;                ///< Number of the last update showing it
+        bool                isEmpty;                ///< Nothing is drawn in the tile
+    };
+
+    typedef std::pair<int, int> TILE_KEY;           ///< Column and row of a tile
+    typedef std::map<TILE_KEY, TILE> TILES;
+
+    bool                    isTileCacheEnabled;     ///< Is the cached target drawn in tiles ?
+    bool                    isTileListDirty;        ///< Did the draw list change since the update ?
+    std::vector<int>        tileDrawList;           ///< Groups drawn in the tiles, by layer
+    std::map<int, BOX2D>    groupExtents;           ///< Bounding boxes of the groups (world)
+    std::vector<uint64_t>   immediateHashes;        ///< Contents of the groups drawn without one
+    bool                    isDrawingGrid;          ///< Is the grid drawn on the screen ?
+    TILES                   tiles;                  ///< Rasterized tiles
+    std::vector<TILE_KEY>   visibleTiles;           ///< Tiles covering the screen
+    VECTOR2I                tileOffset;             ///< Screen position of the tile (0, 0)
+    VECTOR2D                tileScale;              ///< World to tile pixels scale of the tiles
+    unsigned int            tileUpdateCounter;      ///< Number of tile updates
+    THREAD_POOL*            tilePool;               ///< Threads rasterizing the tiles
+    cairo_surface_t*        extentsSurface;         ///< Surface used to compute the group extents
+
     // Variables related to Cairo <-> wxWidgets
     cairo_matrix_t      cairoWorldScreenMatrix; ///< Cairo world to screen transformation matrix
     cairo_t*            currentContext;         ///< Currently used Cairo context for drawing
@@ -387,6 +459,46 @@ private:
     void drawPoly( const std::deque<VECTOR2D>& aPointList );
     void drawPoly( const VECTOR2D aPointList[], int aListSize );
 
+    /**
+     * @brief Executes the commands of a group (a small virtual machine), nested calls included.
+     * Only reads the groups, so it can be run on several contexts at once.
+     *
+     * @param aContext is the context to draw on.
+     * @param aGroupNumber is the group to draw.
+     * @param aState is the state changed by the commands.
+     */
+    void replayGroup( cairo_t* aContext, int aGroupNumber, REPLAY_STATE& aState ) const;
+
+    /// Returns the bounding box of a group, in world coordinates (computed when first needed)
+    const BOX2D& getGroupExtents( int aGroupNumber );
+
+    /// Sorts the groups of the draw list into the visible tiles, rasterizes the changed tiles
+    void updateTiles();
+
+    /// Rasterizes the groups of a draw list in a tile (run by the worker threads)
+    void rasterizeTile( TILE* aTile, TILE_KEY aKey, const std::vector<int>* aDrawList ) const;
+
+    /// Blits the visible tiles on the screen
+    void drawTiles();
+
+    /// Discards the tiles showing a given area (in world coordinates)
+    void invalidateTiles( const BOX2D& aArea );
+
+    /// Discards all the tiles
+    void clearTiles();
+
+    /**
+     * @brief Stores the actual path as a temporary group drawn in the tiles.
+     *
+     * The path is kept in world coordinates, with the current colors and line width. The
+     * temporary groups get the numbers below LAYER_BREAK and are identified in the tile
+     * signatures by a hash of their contents, so the tiles are kept if they do not change.
+     */
+    void storeImmediatePath();
+
+    /// Deletes the temporary groups made by storeImmediatePath()
+    void clearImmediateGroups();
+
     /**
      * @brief Returns a valid key that can be used as a new group number.
      *
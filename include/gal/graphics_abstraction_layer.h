@@ -32,6 +32,7 @@
 #include <limits>
 
 #include <math/matrix3x3.h>
+#include <math/box2.h>
 
 #include <gal/color4d.h>
 #include <gal/definitions.h>
@@ -40,6 +41,8 @@
 
 namespace KIGFX
 {
+class GROUP_BUILDER;
+
 /**
  * GridStyle: Type definition of the grid style
  */
@@ -253,6 +256,33 @@ public:
         return lineWidth;
     }
 
+    /// @brief Attributes used to draw the primitives.
+    struct ATTRIBUTES
+    {
+        bool    isFillEnabled;
+        bool    isStrokeEnabled;
+        COLOR4D fillColor;
+        COLOR4D strokeColor;
+        double  lineWidth;
+    };
+
+    /**
+     * @brief Get the attributes used to draw the primitives.
+     *
+     * @return the fill and stroke flags and colors, and the line width.
+     */
+    ATTRIBUTES GetAttributes() const;
+
+    /**
+     * @brief Set the attributes used to draw the primitives.
+     *
+     * Only the attributes that differ from the current ones are set, through the setters
+     * (so they are also stored in the group being created, if any).
+     *
+     * @param aAttributes are the attributes returned by GetAttributes().
+     */
+    void SetAttributes( const ATTRIBUTES& aAttributes );
+
     /**
      * @brief Set the depth of the layer (position on the z-axis)
      *
@@ -415,6 +445,14 @@ public:
      */
     virtual void ClearCache() {};
 
+    /**
+     * @brief Creates an object building the groups data on a worker thread.
+     *
+     * @return the builder (to be deleted by the caller), NULL if the GAL does not support it,
+     * then the recorded commands are replayed on the GAL itself.
+     */
+    virtual GROUP_BUILDER* CreateGroupBuilder() { return NULL; };
+
     // --------------------------------------------------------
     // Handling the world <-> screen transformation
     // --------------------------------------------------------
@@ -614,6 +652,16 @@ public:
      */
     virtual void ClearTarget( RENDER_TARGET aTarget ) {};
 
+    /**
+     * @brief Returns the area that has to be drawn on the cached target to cover a visible
+     * area. It is larger than the visible area when the cached target keeps more than the
+     * screen (eg. whole tiles).
+     *
+     * @param aVisibleArea is the visible area, in world coordinates.
+     * @return The area to be drawn, in world coordinates.
+     */
+    virtual BOX2D GetCachedArea( const BOX2D& aVisibleArea ) const { return aVisibleArea; };
+
     // -------------
     // Grid methods
     // -------------
@@ -718,7 +766,7 @@ public:
     }
 
     ///> @brief Draw the grid
-    void DrawGrid();
+    virtual void DrawGrid();
 
     /**
      * Function GetGridPoint()
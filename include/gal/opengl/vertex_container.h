@@ -43,8 +43,9 @@ public:
     /**
      * Function MakeContainer()
      * Returns a pointer to a new container of an appropriate type.
+     * @param aSize is the initial number of vertices (0 for the default size).
      */
-    static VERTEX_CONTAINER* MakeContainer( bool aCached );
+    static VERTEX_CONTAINER* MakeContainer( bool aCached, unsigned int aSize = 0 );
 
     virtual ~VERTEX_CONTAINER();
 
@@ -0,0 +1,228 @@
+/*
+ * This program source code file is part of KICAD, a free EDA CAD application.
+ *
+ * Copyright (C) 2012 Torsten Hueter, torstenhtr <at> gmx.de
+ * Copyright (C) 2012-2015 Kicad Developers, see change_log.txt for contributors.
+ * Copyright (C) 2013-2016 CERN
+ * @author Maciej Suminski <maciej.suminski@cern.ch>
+ *
+ * Graphics Abstraction Layer (GAL) drawing the primitives as triangles in a VERTEX_MANAGER
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VERTEX_GAL_H_
+#define VERTEX_GAL_H_
+
+#include <gal/graphics_abstraction_layer.h>
+#include <gal/recording_gal.h>
+#include <gal/opengl/vertex_manager.h>
+
+#include <deque>
+#include <vector>
+#include <boost/smart_ptr/shared_array.hpp>
+
+#ifndef CALLBACK
+#define CALLBACK
+#endif
+
+namespace KIGFX
+{
+/**
+ * @brief Class VERTEX_GAL turns the primitives into triangles stored in a VERTEX_MANAGER.
+ *
+ * It is the part of OPENGL_GAL that does not need an OpenGL context (polygons are tesselated
+ * with GLU, which works on the CPU), so it may run on worker threads as well, with a manager
+ * owned by the thread (see VERTEX_GROUP_BUILDER).
+ */
+class VERTEX_GAL : public GAL
+{
+public:
+    /**
+     * @brief Constructor VERTEX_GAL
+     *
+     * @param aManager is the manager storing the vertices, derived classes may switch it
+     * by changing currentManager.
+     */
+    VERTEX_GAL( VERTEX_MANAGER* aManager );
+
+    virtual ~VERTEX_GAL();
+
+    // ---------------
+    // Drawing methods
+    // ---------------
+
+    /// @copydoc GAL::DrawLine()
+    virtual void DrawLine( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint );
+
+    /// @copydoc GAL::DrawSegment()
+    virtual void DrawSegment( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint,
+                              double aWidth );
+
+    /// @copydoc GAL::DrawCircle()
+    virtual void DrawCircle( const VECTOR2D& aCenterPoint, double aRadius );
+
+    /// @copydoc GAL::DrawArc()
+    virtual void DrawArc( const VECTOR2D& aCenterPoint, double aRadius,
+                          double aStartAngle, double aEndAngle );
+
+    /// @copydoc GAL::DrawRectangle()
+    virtual void DrawRectangle( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint );
+
+    /// @copydoc GAL::DrawPolyline()
+    virtual void DrawPolyline( const std::deque<VECTOR2D>& aPointList );
+    virtual void DrawPolyline( const VECTOR2D aPointList[], int aListSize );
+
+    /// @copydoc GAL::DrawPolygon()
+    virtual void DrawPolygon( const std::deque<VECTOR2D>& aPointList );
+    virtual void DrawPolygon( const VECTOR2D aPointList[], int aListSize );
+
+    /// @copydoc GAL::DrawCurve()
+    virtual void DrawCurve( const VECTOR2D& startPoint, const VECTOR2D& controlPointA,
+                            const VECTOR2D& controlPointB, const VECTOR2D& endPoint );
+
+    // --------------
+    // Transformation
+    // --------------
+
+    /// @copydoc GAL::Rotate()
+    virtual void Rotate( double aAngle );
+
+    /// @copydoc GAL::Translate()
+    virtual void Translate( const VECTOR2D& aTranslation );
+
+    /// @copydoc GAL::Scale()
+    virtual void Scale( const VECTOR2D& aScale );
+
+    /// @copydoc GAL::Save()
+    virtual void Save();
+
+    /// @copydoc GAL::Restore()
+    virtual void Restore();
+
+    ///< Parameters passed to the GLU tesselator
+    typedef struct
+    {
+        /// Manager used for storing new vertices
+        VERTEX_MANAGER* vboManager;
+
+        /// Intersect points, that have to be freed after tessellation
+        std::deque< boost::shared_array<GLdouble> >& intersectPoints;
+    } TessParams;
+
+protected:
+    static const int    CIRCLE_POINTS   = 64;   ///< The number of points for circle approximation
+    static const int    CURVE_POINTS    = 32;   ///< The number of points for curve approximation
+
+    VERTEX_MANAGER*         currentManager;         ///< Currently used VERTEX_MANAGER
+
+    // Polygon tesselation
+    /// The tessellator
+    GLUtesselator*          tesselator;
+    /// Storage for intersecting points
+    std::deque< boost::shared_array<GLdouble> > tessIntersects;
+
+    /**
+     * @brief Draw a quad for the line.
+     *
+     * @param aStartPoint is the start point of the line.
+     * @param aEndPoint is the end point of the line.
+     */
+    void drawLineQuad( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint );
+
+    /**
+     * @brief Draw a semicircle. Depending on settings (isStrokeEnabled & isFilledEnabled) it runs
+     * the proper function (drawStrokedSemiCircle or drawFilledSemiCircle).
+     *
+     * @param aCenterPoint is the center point.
+     * @param aRadius is the radius of the semicircle.
+     * @param aAngle is the angle of the semicircle.
+     *
+     */
+    void drawSemiCircle( const VECTOR2D& aCenterPoint, double aRadius, double aAngle );
+
+    /**
+     * @brief Draw a filled semicircle.
+     *
+     * @param aCenterPoint is the center point.
+     * @param aRadius is the radius of the semicircle.
+     * @param aAngle is the angle of the semicircle.
+     *
+     */
+    void drawFilledSemiCircle( const VECTOR2D& aCenterPoint, double aRadius, double aAngle );
+
+    /**
+     * @brief Draw a stroked semicircle.
+     *
+     * @param aCenterPoint is the center point.
+     * @param aRadius is the radius of the semicircle.
+     * @param aAngle is the angle of the semicircle.
+     *
+     */
+    void drawStrokedSemiCircle( const VECTOR2D& aCenterPoint, double aRadius, double aAngle );
+};
+
+
+/**
+ * @brief Class VERTEX_GROUP_BUILDER generates the vertices of the groups on a worker thread.
+ *
+ * The recorded commands are replayed on a VERTEX_GAL writing to a noncached manager owned by
+ * the builder, so the triangles and the polygon tesselation are computed by the worker. The
+ * main thread only copies the ready vertices to the groups of the target manager.
+ */
+class VERTEX_GROUP_BUILDER : public GROUP_BUILDER
+{
+public:
+    /**
+     * @param aTarget is the manager storing the groups (usually the cached manager of
+     * OPENGL_GAL).
+     */
+    VERTEX_GROUP_BUILDER( const VERTEX_MANAGER& aTarget );
+
+    /// @copydoc GROUP_BUILDER::SyncState()
+    virtual void SyncState( const GAL& aGal );
+
+    /// @copydoc GROUP_BUILDER::Build()
+    virtual int Build( const RECORDING_GAL& aRecorder, int aBegin, int aEnd,
+                       double aLayerDepth );
+
+    /// @copydoc GROUP_BUILDER::AddToGroup()
+    virtual void AddToGroup( int aIndex ) const;
+
+private:
+    ///> Vertices of a group, stored in m_manager
+    struct CHUNK
+    {
+        unsigned int    m_offset;
+        unsigned int    m_size;
+    };
+
+    ///> Initial size of m_manager, grown as needed
+    static const unsigned int initialSize = 65536;
+
+    VERTEX_MANAGER          m_manager;
+    VERTEX_GAL              m_gal;
+    const VERTEX_MANAGER&   m_target;
+    std::vector<CHUNK>      m_chunks;
+
+    ///> Attributes each group is built from
+    GAL::ATTRIBUTES         m_attributes;
+};
+} // namespace KIGFX
+
+#endif  // VERTEX_GAL_H_
@@ -55,8 +55,9 @@ public:
      *
      * @param aCached says if vertices should be cached in GPU or system memory. For data that
      * does not change every frame, it is better to store vertices in GPU memory.
+     * @param aInitialSize is the number of vertices allocated at first (0 for the default).
      */
-    VERTEX_MANAGER( bool aCached );
+    VERTEX_MANAGER( bool aCached, unsigned int aInitialSize = 0 );
 
     /**
      * Function Vertex()
@@ -96,6 +97,23 @@ public:
      */
     void Vertices( const VERTEX aVertices[], unsigned int aSize ) const;
 
+    /**
+     * Function CopyVertices()
+     * adds already processed vertices to the currently set item. Unlike Vertices(), the
+     * color, shader and coordinates stored in aVertices are kept as they are.
+     *
+     * @param aVertices contains vertices to be added
+     * @param aSize is the number of vertices to be added.
+     */
+    void CopyVertices( const VERTEX aVertices[], unsigned int aSize ) const;
+
+    /**
+     * Function GetSize()
+     * returns the number of vertices stored so far (meaningful for noncached managers, as the
+     * cached ones return the size of their container).
+     */
+    unsigned int GetSize() const;
+
     /**
      * Function Color()
      * changes currently used color that will be applied to newly added vertices.
@@ -223,6 +241,20 @@ public:
         }
     }
 
+    /**
+     * Function ResetTransform()
+     * sets the identity transformation matrix and empties the transformation stack.
+     */
+    void ResetTransform()
+    {
+        m_transform = glm::mat4( 1.0f );
+
+        while( !m_transformStack.empty() )
+            m_transformStack.pop();
+
+        m_noTransform = true;
+    }
+
     /**
      * Function SetItem()
      * sets an item to start its modifications. After calling the function it is possible to add
@@ -273,6 +305,14 @@ public:
      */
     VERTEX* GetVertices( const VERTEX_ITEM& aItem ) const;
 
+    /**
+     * Function GetVertices()
+     * returns a pointer to the vertices stored starting from the given offset.
+     *
+     * @param aOffset is the offset of the first vertex.
+     */
+    VERTEX* GetVertices( unsigned int aOffset ) const;
+
     const glm::mat4& GetTransformation() const
     {
         return m_transform;
@@ -0,0 +1,238 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef RECORDING_GAL_H_
+#define RECORDING_GAL_H_
+
+#include <vector>
+
+#include <gal/graphics_abstraction_layer.h>
+
+namespace KIGFX
+{
+/**
+ * @brief Class RECORDING_GAL stores the drawing commands it receives, to replay them later
+ * on another GAL.
+ *
+ * It lets the painter run on worker threads, each one with its own RECORDING_GAL: all the
+ * work done by the painter, including laying out the stroke font texts (which are recorded
+ * as polylines), happens there. The commands are then replayed on the main thread, on the
+ * GAL that owns the groups, in the same order as they would have been issued without the
+ * recording. The commands are appended one after the other, so several items can be recorded
+ * in sequence and replayed one by one, using the positions returned by GetPosition().
+ *
+ * The state queried by the painter (world scale, line width) must be set up with
+ * SyncState() before drawing. Each cached item is drawn starting from the attributes copied
+ * by SyncState() (see RestoreAttributes()), so the result does not depend on the items
+ * drawn before it by the same worker.
+ */
+class RECORDING_GAL : public GAL
+{
+public:
+    RECORDING_GAL();
+
+    /// @brief Copies the view settings of aGal queried by the painters (scale, zoom, depth
+    /// range) and its drawing attributes.
+    void SyncState( const GAL& aGal );
+
+    /// @brief Restores the attributes copied by SyncState(), without recording any command.
+    void RestoreAttributes();
+
+    /// @brief Removes all the recorded commands, and frees their memory.
+    void Clear();
+
+    /// @brief Returns the position of the next recorded command.
+    int GetPosition() const
+    {
+        return m_commands.size();
+    }
+
+    /**
+     * @brief Replays commands on another GAL.
+     *
+     * @param aTarget is the GAL to draw on.
+     * @param aBegin is the position of the first command to replay.
+     * @param aEnd is the position following the last command to replay.
+     */
+    void Replay( GAL& aTarget, int aBegin, int aEnd ) const;
+
+    // -------------------------
+    // Recorded drawing commands
+    // -------------------------
+
+    /// @copydoc GAL::DrawLine()
+    virtual void DrawLine( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint );
+
+    /// @copydoc GAL::DrawSegment()
+    virtual void DrawSegment( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint,
+                              double aWidth );
+
+    /// @copydoc GAL::DrawCircle()
+    virtual void DrawCircle( const VECTOR2D& aCenterPoint, double aRadius );
+
+    /// @copydoc GAL::DrawArc()
+    virtual void DrawArc( const VECTOR2D& aCenterPoint, double aRadius,
+                          double aStartAngle, double aEndAngle );
+
+    /// @copydoc GAL::DrawRectangle()
+    virtual void DrawRectangle( const VECTOR2D& aStartPoint, const VECTOR2D& aEndPoint );
+
+    /// @copydoc GAL::DrawPolyline()
+    virtual void DrawPolyline( const std::deque<VECTOR2D>& aPointList );
+    virtual void DrawPolyline( const VECTOR2D aPointList[], int aListSize );
+
+    /// @copydoc GAL::DrawPolygon()
+    virtual void DrawPolygon( const std::deque<VECTOR2D>& aPointList );
+    virtual void DrawPolygon( const VECTOR2D aPointList[], int aListSize );
+
+    /// @copydoc GAL::DrawCurve()
+    virtual void DrawCurve( const VECTOR2D& startPoint, const VECTOR2D& controlPointA,
+                            const VECTOR2D& controlPointB, const VECTOR2D& endPoint );
+
+    // ----------------------
+    // Recorded state changes
+    // ----------------------
+
+    /// @copydoc GAL::SetIsFill()
+    virtual void SetIsFill( bool aIsFillEnabled );
+
+    /// @copydoc GAL::SetIsStroke()
+    virtual void SetIsStroke( bool aIsStrokeEnabled );
+
+    /// @copydoc GAL::SetFillColor()
+    virtual void SetFillColor( const COLOR4D& aColor );
+
+    /// @copydoc GAL::SetStrokeColor()
+    virtual void SetStrokeColor( const COLOR4D& aColor );
+
+    /// @copydoc GAL::SetLineWidth()
+    virtual void SetLineWidth( double aLineWidth );
+
+    /// @copydoc GAL::SetLayerDepth()
+    virtual void SetLayerDepth( double aLayerDepth );
+
+    /// @copydoc GAL::Transform()
+    virtual void Transform( const MATRIX3x3D& aTransformation );
+
+    /// @copydoc GAL::Rotate()
+    virtual void Rotate( double aAngle );
+
+    /// @copydoc GAL::Translate()
+    virtual void Translate( const VECTOR2D& aTranslation );
+
+    /// @copydoc GAL::Scale()
+    virtual void Scale( const VECTOR2D& aScale );
+
+    /// @copydoc GAL::Save()
+    virtual void Save();
+
+    /// @copydoc GAL::Restore()
+    virtual void Restore();
+
+private:
+    enum COMMAND_TYPE
+    {
+        CMD_LINE,               ///< 2 points
+        CMD_SEGMENT,            ///< 2 points, width
+        CMD_CIRCLE,             ///< center, radius
+        CMD_ARC,                ///< center, radius, start and end angles
+        CMD_RECTANGLE,          ///< 2 points
+        CMD_POLYLINE,           ///< points
+        CMD_POLYGON,            ///< points
+        CMD_CURVE,              ///< 4 points
+        CMD_SET_FILL,           ///< flag
+        CMD_SET_STROKE,         ///< flag
+        CMD_SET_FILL_COLOR,     ///< r, g, b, a
+        CMD_SET_STROKE_COLOR,   ///< r, g, b, a
+        CMD_SET_LINE_WIDTH,     ///< width
+        CMD_SET_LAYER_DEPTH,    ///< depth
+        CMD_TRANSFORM,          ///< matrix, stored in m_matrices
+        CMD_ROTATE,             ///< angle
+        CMD_TRANSLATE,          ///< 1 point
+        CMD_SCALE,              ///< 1 point
+        CMD_SAVE,
+        CMD_RESTORE
+    };
+
+    ///> A command, whose points are stored in m_points (or its matrix in m_matrices)
+    struct COMMAND
+    {
+        COMMAND_TYPE    m_type;
+        int             m_first;
+        int             m_pointCount;
+        double          m_params[4];
+    };
+
+    ///> Appends a command, returns it to store its parameters
+    COMMAND& addCommand( COMMAND_TYPE aType, int aPointCount = 0 );
+
+    std::vector<COMMAND>    m_commands;
+    std::vector<VECTOR2D>   m_points;
+    std::vector<MATRIX3x3D> m_matrices;
+
+    ///> Attributes each item is drawn from
+    ATTRIBUTES              m_attributes;
+};
+
+
+/**
+ * @brief Class GROUP_BUILDER turns recorded commands into the data of a GAL group, on a worker
+ * thread.
+ *
+ * Replaying the recorded commands on the main thread still leaves the backend work (e.g.
+ * generating the triangles) serial. A GAL supporting it returns a builder for each worker
+ * (GAL::CreateGroupBuilder()): the workers build the groups data with Build(), then the main
+ * thread adds it to the groups with AddToGroup(), which is a plain copy.
+ */
+class GROUP_BUILDER
+{
+public:
+    virtual ~GROUP_BUILDER() {}
+
+    /// @brief Copies the state of aGal used when drawing (depth range and attributes). Each
+    /// group is built starting from that state, with no transformation.
+    virtual void SyncState( const GAL& aGal ) = 0;
+
+    /**
+     * @brief Builds the data for recorded commands (called from a worker thread).
+     *
+     * @param aRecorder stores the commands.
+     * @param aBegin is the position of the first command.
+     * @param aEnd is the position following the last command.
+     * @param aLayerDepth is the depth of the layer the group is drawn on.
+     * @return index of the built data, to be passed to AddToGroup().
+     */
+    virtual int Build( const RECORDING_GAL& aRecorder, int aBegin, int aEnd,
+                       double aLayerDepth ) = 0;
+
+    /**
+     * @brief Adds data built by Build() to the group being created in the GAL (called from
+     * the main thread, between GAL::BeginGroup() and GAL::EndGroup()).
+     *
+     * @param aIndex is the value returned by Build().
+     */
+    virtual void AddToGroup( int aIndex ) const = 0;
+};
+}    // namespace KIGFX
+
+#endif /* RECORDING_GAL_H_ */
@@ -36,17 +36,21 @@
 
 #include <math/box2.h>
 
+#include <boost/shared_ptr.hpp>
+
+class STROKE_GLYPHS;
+
 namespace KIGFX
 {
 class GAL;
-
-typedef std::deque< std::deque<VECTOR2D> > GLYPH;
-typedef std::vector<GLYPH>                 GLYPH_LIST;
+struct STROKE_LINE_LAYOUT;
 
 /**
  * @brief Class STROKE_FONT implements stroke font drawing.
  *
- * A stroke font is composed of lines.
+ * A stroke font is composed of lines. The glyphs are decoded once and shared by all the
+ * instances (see STROKE_GLYPHS). The lines of text are laid out at unit glyph size and
+ * cached, the size, mirroring and italic slant are applied when drawing.
  */
 class STROKE_FONT
 {
@@ -144,12 +148,11 @@ public:
 
 private:
     GAL*                m_gal;                                    ///< Pointer to the GAL
-    GLYPH_LIST          m_glyphs;                                 ///< Glyph list
-    std::vector<BOX2D>  m_glyphBoundingBoxes;                     ///< Bounding boxes of the glyphs
+    boost::shared_ptr<const STROKE_GLYPHS> m_glyphs;              ///< Glyphs of the font
     VECTOR2D            m_glyphSize;                              ///< Size of the glyphs
     EDA_TEXT_HJUSTIFY_T m_horizontalJustify;                      ///< Horizontal justification
     EDA_TEXT_VJUSTIFY_T m_verticalJustify;                        ///< Vertical justification
-    bool                m_bold, m_italic, m_mirrored, m_overbar;  ///< Properties of text
+    bool                m_bold, m_italic, m_mirrored;             ///< Properties of text
 
     /**
      * @brief Returns a single line height using current settings.
@@ -159,13 +162,16 @@ private:
     int getInterline() const;
 
     /**
-     * @brief Compute the bounding box of a given glyph.
+     * @brief Returns the glyph index of a character ('?' for the ones missing in the font).
+     */
+    int glyphIndex( int aChar ) const;
+
+    /**
+     * @brief Returns the layout of a single line of text, from the layout cache.
      *
-     * @param aGlyph is the glyph.
-     * @param aGlyphBoundingX is the x-component of the bounding box size.
-     * @return is the complete bounding box size.
+     * @param aText is the text string.
      */
-    BOX2D computeBoundingBox( const GLYPH& aGlyph, const VECTOR2D& aGlyphBoundingX ) const;
+    boost::shared_ptr<const STROKE_LINE_LAYOUT> getLayout( const UTF8& aText ) const;
 
     /**
      * @brief Draws a single line of text. Multiline texts should be split before using the
@@ -175,14 +181,6 @@ private:
      */
     void drawSingleLineText( const UTF8& aText );
 
-    /**
-     * @brief Compute the size of a given text.
-     *
-     * @param aText is the text string.
-     * @return is the text size.
-     */
-    VECTOR2D computeTextSize( const UTF8& aText ) const;
-
     /**
      * @brief Returns number of lines for a given text.
      *
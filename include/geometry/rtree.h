@@ -29,6 +29,8 @@
 #include <math.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <vector>
+#include <algorithm>
 
 #define ASSERT assert    // RTree uses ASSERT( condition )
 #ifndef rMin
@@ -120,6 +122,17 @@ public:
                  const ELEMTYPE     a_max[NUMDIMS],
                  const DATATYPE&    a_dataId );
 
+    /// Replace the contents of the tree with a set of entries, packed with the Sort-Tile-Recursive
+    /// algorithm: much faster than inserting them one by one, and the nodes overlap less.
+    /// \param a_count Number of entries
+    /// \param a_min Min of the bounding rects, NUMDIMS values per entry
+    /// \param a_max Max of the bounding rects, NUMDIMS values per entry
+    /// \param a_dataId Ids of the entries
+    void BulkLoad( int                  a_count,
+                   const ELEMTYPE*      a_min,
+                   const ELEMTYPE*      a_max,
+                   const DATATYPE*      a_dataId );
+
     /// Find all within search rectangle
     /// \param a_min Min of search bounding rect
     /// \param a_max Max of search bounding rect
@@ -160,6 +173,29 @@ public:
         return cnt;
     }
 
+    /// Like Search(), but the entries whose rects are smaller than a_minSize along all the
+    /// axes are passed to a_smallVisitor instead of a_visitor (e.g. too small to be drawn
+    /// with their details). The sizes are read from the rects of the leaves.
+    /// \return Returns the number of entries found (including the small ones)
+    template <class VISITOR, class SMALL_VISITOR>
+    int Search( const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS],
+                ELEMTYPE a_minSize, VISITOR& a_visitor, SMALL_VISITOR& a_smallVisitor )
+    {
+        Rect rect;
+
+        for( int axis = 0; axis<NUMDIMS; ++axis )
+        {
+            rect.m_min[axis]    = a_min[axis];
+            rect.m_max[axis]    = a_max[axis];
+        }
+
+        int cnt = 0;
+
+        Search( m_root, &rect, a_minSize, a_visitor, a_smallVisitor, cnt );
+
+        return cnt;
+    }
+
     /// Calculate Statistics
 
     Statistics CalcStats();
@@ -512,6 +548,80 @@ protected:
         return true; // Continue searching
     }
 
+    template <class VISITOR, class SMALL_VISITOR>
+    bool Search( Node* a_node, Rect* a_rect, ELEMTYPE a_minSize, VISITOR& a_visitor,
+                 SMALL_VISITOR& a_smallVisitor, int& a_foundCount )
+    {
+        ASSERT( a_node );
+        ASSERT( a_node->m_level >= 0 );
+        ASSERT( a_rect );
+
+        if( a_node->IsInternalNode() ) // This is an internal node in the tree
+        {
+            for( int index = 0; index < a_node->m_count; ++index )
+            {
+                if( Overlap( a_rect, &a_node->m_branch[index].m_rect ) )
+                {
+                    if( !Search( a_node->m_branch[index].m_child, a_rect, a_minSize, a_visitor,
+                                 a_smallVisitor, a_foundCount ) )
+                    {
+                        return false; // Don't continue searching
+                    }
+                }
+            }
+        }
+        else // This is a leaf node
+        {
+            for( int index = 0; index < a_node->m_count; ++index )
+            {
+                Rect& rect = a_node->m_branch[index].m_rect;
+
+                if( Overlap( a_rect, &rect ) )
+                {
+                    bool tooSmall = true;
+
+                    for( int axis = 0; axis < NUMDIMS; ++axis )
+                    {
+                        if( rect.m_max[axis] - rect.m_min[axis] >= a_minSize )
+                        {
+                            tooSmall = false;
+                            break;
+                        }
+                    }
+
+                    DATATYPE& id = a_node->m_branch[index].m_data;
+
+                    if( tooSmall ? !a_smallVisitor( id ) : !a_visitor( id ) )
+                        return false;
+
+                    a_foundCount++;
+                }
+            }
+        }
+
+        return true; // Continue searching
+    }
+
+    /// Orders branches along an axis by the centers of their rects (used by BulkLoad)
+    struct BranchCenterLess
+    {
+        BranchCenterLess( int a_axis ) : m_axis( a_axis ) {}
+
+        bool operator()( const Branch& a_a, const Branch& a_b ) const
+        {
+            return (double) a_a.m_rect.m_min[m_axis] + a_a.m_rect.m_max[m_axis] <
+                   (double) a_b.m_rect.m_min[m_axis] + a_b.m_rect.m_max[m_axis];
+        }
+
+        int m_axis;
+    };
+
+    void    PackNodes( Branch*                  a_branches,
+                       int                      a_count,
+                       int                      a_axis,
+                       int                      a_level,
+                       std::vector<Branch>&     a_parents );
+
     void    RemoveAllRec( Node* a_node );
     void    Reset();
     void    CountRec( Node* a_node, int& a_count );
@@ -691,6 +801,97 @@ void RTREE_QUAL::Remove( const ELEMTYPE     a_min[NUMDIMS],
 }
 
 
+RTREE_TEMPLATE
+void RTREE_QUAL::BulkLoad( int              a_count,
+                           const ELEMTYPE*  a_min,
+                           const ELEMTYPE*  a_max,
+                           const DATATYPE*  a_dataId )
+{
+    Reset();
+
+    std::vector<Branch> branches( a_count );
+
+    for( int i = 0; i < a_count; ++i )
+    {
+        for( int axis = 0; axis < NUMDIMS; ++axis )
+        {
+            branches[i].m_rect.m_min[axis] = a_min[i * NUMDIMS + axis];
+            branches[i].m_rect.m_max[axis] = a_max[i * NUMDIMS + axis];
+        }
+
+        branches[i].m_data = a_dataId[i];
+    }
+
+    // Packs the entries into leaves, then the leaves into their parents, until a single
+    // node remains: all the leaves are at the same level, as the tree requires
+    int level = 0;
+
+    while( branches.size() > MAXNODES )
+    {
+        std::vector<Branch> parents;
+
+        parents.reserve( branches.size() / MINNODES + 1 );
+        PackNodes( &branches[0], branches.size(), 0, level, parents );
+        branches.swap( parents );
+        ++level;
+    }
+
+    m_root = AllocNode();
+    m_root->m_level = level;
+    m_root->m_count = branches.size();
+    std::copy( branches.begin(), branches.end(), m_root->m_branch );
+}
+
+
+// Sort-Tile-Recursive packing: sorts the branches along a_axis and cuts them into
+// slabs, each one packed recursively along the next axes. Along the last axis, the runs
+// of branches are stored into new nodes of level a_level, added to a_parents. The sizes
+// of the slabs and nodes are balanced, so the nodes hold at least MINNODES branches.
+RTREE_TEMPLATE
+void RTREE_QUAL::PackNodes( Branch*                 a_branches,
+                            int                     a_count,
+                            int                     a_axis,
+                            int                     a_level,
+                            std::vector<Branch>&    a_parents )
+{
+    std::sort( a_branches, a_branches + a_count, BranchCenterLess( a_axis ) );
+
+    int nodeCount = ( a_count + MAXNODES - 1 ) / MAXNODES;
+
+    if( a_axis == NUMDIMS - 1 )
+    {
+        for( int i = 0; i < nodeCount; ++i )
+        {
+            int first = (int) ( (long long) a_count * i / nodeCount );
+            int last = (int) ( (long long) a_count * ( i + 1 ) / nodeCount );
+
+            Branch parent;
+
+            parent.m_child = AllocNode();
+            parent.m_child->m_level = a_level;
+            parent.m_child->m_count = last - first;
+            std::copy( a_branches + first, a_branches + last, parent.m_child->m_branch );
+            parent.m_rect = NodeCover( parent.m_child );
+            a_parents.push_back( parent );
+        }
+
+        return;
+    }
+
+    // as many slabs along each of the remaining axes
+    int slabCount = (int) ceil( pow( (double) nodeCount, 1.0 / ( NUMDIMS - a_axis ) ) );
+
+    for( int i = 0; i < slabCount; ++i )
+    {
+        int first = (int) ( (long long) a_count * i / slabCount );
+        int last = (int) ( (long long) a_count * ( i + 1 ) / slabCount );
+
+        if( last > first )
+            PackNodes( a_branches + first, last - first, a_axis + 1, a_level, a_parents );
+    }
+}
+
+
 RTREE_TEMPLATE
 int RTREE_QUAL::Search( const ELEMTYPE a_min[NUMDIMS],
                         const ELEMTYPE a_max[NUMDIMS],
@@ -0,0 +1,136 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef __SEG_ARRAY_H
+#define __SEG_ARRAY_H
+
+#include <vector>
+
+#include <geometry/seg.h>
+
+class SHAPE_LINE_CHAIN;
+
+/**
+ * Class SEG_ARRAY
+ *
+ * Stores a set of segments with their bounding boxes in structure-of-arrays form, so that a
+ * segment can be tested against all of them several at a time with SIMD instructions
+ * (SSE2 or AVX2, chosen at run time, with a scalar fallback).
+ *
+ * The SIMD kernels only reject the segments whose bounding boxes are too far from the tested
+ * segment. The remaining ones are checked with SEG::Collide() or SEG::SquaredDistance(), so
+ * the results are exactly those of the scalar code.
+ */
+class SEG_ARRAY
+{
+public:
+    typedef VECTOR2I::extended_type ecoord;
+
+    ///> Instruction sets of the kernels
+    enum KERNEL
+    {
+        SCALAR = 0,
+        SSE2,
+        AVX2
+    };
+
+    ///> Minimum number of segments for which building a SEG_ARRAY is worth it
+    static const int MinBatchSize = 16;
+
+    SEG_ARRAY()
+    {}
+
+    SEG_ARRAY( const SHAPE_LINE_CHAIN& aChain )
+    {
+        Add( aChain );
+    }
+
+    void Clear();
+    void Reserve( int aCount );
+
+    ///> Adds a segment at the end of the array
+    void Add( const SEG& aSeg );
+
+    ///> Adds all the segments of a line chain
+    void Add( const SHAPE_LINE_CHAIN& aChain );
+
+    int Size() const
+    {
+        return m_segs.size();
+    }
+
+    const SEG& operator[]( int aIndex ) const
+    {
+        return m_segs[aIndex];
+    }
+
+    /**
+     * Function Find()
+     *
+     * Returns the index of the first segment (starting from aStart) colliding with aSeg,
+     * with the same test as SHAPE_LINE_CHAIN::Collide(), or -1 if there is none.
+     */
+    int Find( const SEG& aSeg, int aClearance, int aStart = 0 ) const;
+
+    bool Collide( const SEG& aSeg, int aClearance ) const
+    {
+        return Find( aSeg, aClearance ) >= 0;
+    }
+
+    /**
+     * Function SquaredDistance()
+     *
+     * Returns the smallest squared distance between aSeg and the segments of the array
+     * (VECTOR2I::ECOORD_MAX if the array is empty).
+     */
+    ecoord SquaredDistance( const SEG& aSeg ) const;
+
+    int Distance( const SEG& aSeg ) const;
+
+    ///> Returns the kernel in use
+    static KERNEL Kernel();
+
+    ///> Returns the name of a kernel ("scalar", "sse2", "avx2")
+    static const char* KernelName( KERNEL aKernel );
+
+    /**
+     * Function SetKernel()
+     *
+     * Selects the kernel used by all the arrays, if the CPU supports it. Used to compare
+     * the kernels: the best one is selected by default.
+     * @return true if the kernel is available
+     */
+    static bool SetKernel( KERNEL aKernel );
+
+private:
+    ///> returns the first index in [aStart, Size()) whose bounding box overlaps the box
+    ///> (min x, min y, max x, max y) aBox, or Size()
+    int scan( int aStart, const int aBox[4] ) const;
+
+    std::vector<SEG> m_segs;
+
+    ///> bounding boxes of the segments
+    std::vector<int> m_minX, m_minY, m_maxX, m_maxY;
+};
+
+#endif    // __SEG_ARRAY_H
@@ -301,6 +301,20 @@ public:
      */
     virtual bool Draw( const VIEW_ITEM* aItem, int aLayer ) = 0;
 
+    /**
+     * Function Clone
+     * Creates a painter with the same settings, drawing on another GAL. It lets several
+     * threads draw items at the same time, so Draw() must not modify anything but the GAL
+     * of the painter.
+     * @param aGal is the GAL the new painter draws on.
+     * @return the new painter (owned by the caller), or NULL if the painter can't be used
+     * from several threads.
+     */
+    virtual PAINTER* Clone( GAL* aGal ) const
+    {
+        return NULL;
+    }
+
 protected:
     /// Instance of graphic abstraction layer that gives an interface to call
     /// commands used to draw (eg. DrawLine, DrawCircle, etc.)
@@ -0,0 +1,185 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file stroke_glyph_cache.h
+ * @brief Decoded stroke font glyphs and cache of laid out strings, shared by the GAL stroke
+ * font and by DrawGraphicText() (screen, plotters, 3D viewer and VRML exporter texts).
+ */
+
+#ifndef STROKE_GLYPH_CACHE_H
+#define STROKE_GLYPH_CACHE_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+
+/**
+ * Class STROKE_GLYPHS
+ * holds the glyphs of a Hershey style stroke font (such as newstroke_font), decoded once
+ * into a compact buffer: a glyph is a list of strokes, a stroke is a polyline stored as a
+ * range of 2 byte points.
+ *
+ * The points are in font units (21 units for the height of the capitals), with the x origin
+ * on the left side of the glyph and the y origin 10 units above the baseline, which is where
+ * both the GAL and the legacy text drawing code place them.
+ */
+class STROKE_GLYPHS
+{
+public:
+    struct POINT
+    {
+        signed char x, y;
+    };
+
+    struct GLYPH
+    {
+        int m_firstStroke;
+        int m_strokeCount;
+        int m_advance;          ///> advance width, in font units
+    };
+
+    /**
+     * Function Get
+     * returns the glyphs of aFont. The font is decoded on the first call, the next calls
+     * (from any thread) share the same instance.
+     */
+    static boost::shared_ptr<const STROKE_GLYPHS> Get( const char* const aFont[],
+                                                       int aGlyphCount );
+
+    int GlyphCount() const
+    {
+        return m_glyphs.size();
+    }
+
+    const GLYPH& Glyph( int aIndex ) const
+    {
+        return m_glyphs[aIndex];
+    }
+
+    int StrokeSize( int aStroke ) const
+    {
+        return m_strokeStart[aStroke + 1] - m_strokeStart[aStroke];
+    }
+
+    const POINT* StrokePoints( int aStroke ) const
+    {
+        return &m_points[m_strokeStart[aStroke]];
+    }
+
+private:
+    STROKE_GLYPHS( const char* const aFont[], int aGlyphCount );
+
+    std::vector<GLYPH>  m_glyphs;
+    std::vector<int>    m_strokeStart;  ///> first point of each stroke, and end of the last one
+    std::vector<POINT>  m_points;
+};
+
+
+/**
+ * Class STROKE_LAYOUT_CACHE
+ * keeps the layouts of the last aMaxSize strings, evicting the least recently used ones.
+ * It may be used by several threads. The layouts are shared pointers, so that a layout
+ * evicted while another thread draws it stays valid until it is released.
+ */
+template <class KEY, class LAYOUT>
+class STROKE_LAYOUT_CACHE
+{
+public:
+    typedef boost::shared_ptr<const LAYOUT> LAYOUT_PTR;
+
+    STROKE_LAYOUT_CACHE( int aMaxSize ) :
+        m_maxSize( aMaxSize )
+    {}
+
+    ///> Returns the layout of aKey, or a null pointer if it is not cached
+    LAYOUT_PTR Find( const KEY& aKey )
+    {
+        boost::mutex::scoped_lock lock( m_mutex );
+
+        typename ENTRIES::iterator it = m_entries.find( aKey );
+
+        if( it == m_entries.end() )
+            return LAYOUT_PTR();
+
+        // move the entry to the front of the LRU list
+        m_lru.splice( m_lru.begin(), m_lru, it->second.m_lruPos );
+
+        return it->second.m_layout;
+    }
+
+    void Add( const KEY& aKey, const LAYOUT_PTR& aLayout )
+    {
+        boost::mutex::scoped_lock lock( m_mutex );
+
+        typename ENTRIES::iterator it = m_entries.find( aKey );
+
+        if( it != m_entries.end() )
+        {
+            // another thread has laid out the same string in the meantime
+            it->second.m_layout = aLayout;
+            return;
+        }
+
+        it = m_entries.insert( typename ENTRIES::value_type( aKey, ENTRY() ) ).first;
+        m_lru.push_front( &it->first );
+        it->second.m_layout = aLayout;
+        it->second.m_lruPos = m_lru.begin();
+
+        if( (int) m_entries.size() > m_maxSize )
+        {
+            m_entries.erase( *m_lru.back() );
+            m_lru.pop_back();
+        }
+    }
+
+    void Clear()
+    {
+        boost::mutex::scoped_lock lock( m_mutex );
+
+        m_lru.clear();
+        m_entries.clear();
+    }
+
+private:
+    typedef std::list<const KEY*> LRU_LIST;
+
+    struct ENTRY
+    {
+        LAYOUT_PTR                  m_layout;
+        typename LRU_LIST::iterator m_lruPos;
+    };
+
+    typedef std::map<KEY, ENTRY> ENTRIES;
+
+    int             m_maxSize;
+    ENTRIES         m_entries;
+    LRU_LIST        m_lru;      ///> keys of m_entries, most recently used first
+    boost::mutex    m_mutex;
+};
+
+#endif  // STROKE_GLYPH_CACHE_H
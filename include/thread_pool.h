@@ -0,0 +1,151 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file thread_pool.h
+ * @brief A pool of worker threads executing queued jobs, with work stealing.
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/noncopyable.hpp>
+
+
+/**
+ * Class THREAD_POOL
+ * owns a fixed set of worker threads which execute the jobs given to Submit().
+ * Jobs must not throw.  A job must not touch any GUI object: results are expected
+ * to be stored by the job in a place known by the caller and committed on the main
+ * thread once Wait() returns true.
+ * <p>
+ * Each worker has its own job queue.  Jobs submitted by a running job go to the
+ * queue of its worker, which runs them last in, first out; an idle worker takes the
+ * oldest job of the shared queue, or steals the oldest job of another worker.
+ * Jobs submitted from outside the pool are started in the order of submission, so
+ * submitting the biggest jobs first keeps a big job from being the last one to run.
+ * </p><p>
+ * The queues are guarded by a single lock, so taking a job and counting it are done at
+ * once: an idle worker blocks until a job is submitted, and never spins.  Jobs are
+ * expected to be coarse enough for this lock not to matter.
+ * </p><p>
+ * A pool can be kept for the lifetime of its owner and used for several batches of
+ * jobs: idle workers cost nothing.
+ * </p>
+ */
+class THREAD_POOL : public boost::noncopyable
+{
+public:
+    typedef boost::function<void ()> JOB;
+
+    /**
+     * Constructor
+     * @param aThreadCount is the number of worker threads to start,
+     *                     0 to use the number of hardware threads.
+     */
+    THREAD_POOL( int aThreadCount = 0 );
+
+    /**
+     * Destructor
+     * drops the jobs not started yet and waits for the running ones to finish.
+     */
+    ~THREAD_POOL();
+
+    /**
+     * Function Submit
+     * queues a job, which will be run on the first idle worker.  When called from a
+     * job run by this pool, the job is queued on the current worker.
+     */
+    void Submit( const JOB& aJob );
+
+    /**
+     * Function Wait
+     * blocks until every submitted job is finished, or aTimeout milliseconds elapsed.
+     * It must not be called from a job run by this pool.
+     * @param aTimeout is the maximum time to wait, in milliseconds, or -1 to wait forever.
+     * @return true if every submitted job is finished.
+     */
+    bool Wait( int aTimeout = -1 );
+
+    /**
+     * Function CancelPending
+     * drops the jobs which have not been started yet.  Jobs already running are
+     * not interrupted.
+     */
+    void CancelPending();
+
+    /**
+     * Function GetFinishedCount
+     * @return the number of jobs run to completion since the pool was created.
+     */
+    int GetFinishedCount() const;
+
+    /**
+     * Function GetThreadCount
+     * @return the number of worker threads.
+     */
+    int GetThreadCount() const
+    {
+        return m_threadCount;
+    }
+
+    /**
+     * Function DefaultThreadCount
+     * @return the number of hardware threads, at least 1.
+     */
+    static int DefaultThreadCount();
+
+private:
+    ///> Worker thread main loop.
+    void worker( int aIndex );
+
+    ///> Takes a job from the queues, looking first at the queue of worker aIndex.
+    ///> m_lock must be held.
+    bool takeJob( int aIndex, JOB& aJob );
+
+    boost::thread_group         m_threads;
+
+    ///> Queue of each worker, the last one is the shared queue.  Guarded by m_lock.
+    std::vector<std::deque<JOB> >   m_queues;
+
+    ///> Index of the worker running in the current thread, if any.
+    boost::thread_specific_ptr<int> m_workerIndex;
+
+    mutable boost::mutex        m_lock;
+    boost::condition_variable   m_jobAvailable;
+    boost::condition_variable   m_jobFinished;
+
+    int     m_threadCount;
+    int     m_pending;          ///< number of queued jobs
+    int     m_running;          ///< number of jobs being currently executed
+    int     m_finished;         ///< number of jobs run to completion
+    bool    m_quit;
+};
+
+#endif  // THREAD_POOL_H_
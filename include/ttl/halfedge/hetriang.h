@@ -334,9 +334,12 @@ class EDGE_MST : public EDGE
 private:
     NODE_PTR m_target;
 
+    /// Index in the list of connections holding the edge (RN_LINKS)
+    unsigned int m_index;
+
 public:
     EDGE_MST( const NODE_PTR& aSource, const NODE_PTR& aTarget, unsigned int aWeight = 0 ) :
-        m_target( aTarget )
+        m_target( aTarget ), m_index( 0 )
     {
         m_sourceNode = aSource;
         m_weight = aWeight;
@@ -348,6 +351,18 @@ public:
         return m_target;
     }
 
+    /// Sets the index in the list of connections holding the edge
+    inline void SetIndex( unsigned int aIndex )
+    {
+        m_index = aIndex;
+    }
+
+    /// Returns the index in the list of connections holding the edge
+    inline unsigned int GetIndex() const
+    {
+        return m_index;
+    }
+
 private:
     EDGE_MST( const EDGE& aEdge )
     {
@@ -29,13 +29,19 @@
 #include <set>
 #include <boost/unordered/unordered_map.hpp>
 
+#include <boost/atomic.hpp>
+
 #include <math/box2.h>
 #include <gal/definitions.h>
 
+class THREAD_POOL;
+
 namespace KIGFX
 {
 class PAINTER;
 class GAL;
+class RECORDING_GAL;
+class GROUP_BUILDER;
 class VIEW_ITEM;
 class VIEW_GROUP;
 class VIEW_RTREE;
@@ -77,6 +83,15 @@ public:
      */
     void Add( VIEW_ITEM* aItem );
 
+    /**
+     * Function AddItems()
+     * Adds a set of VIEW_ITEMs to the view. The layers that do not contain any item yet are
+     * bulk loaded, which is much faster than adding the items one by one (e.g. a whole board).
+     * The items are cached when they are drawn for the first time.
+     * @param aItems: items to be added. No ownership is given
+     */
+    void AddItems( const std::vector<VIEW_ITEM*>& aItems );
+
     /**
      * Function Remove()
      * Removes a VIEW_ITEM from the view.
@@ -113,8 +128,7 @@ public:
     void CopySettings( const VIEW* aOtherView );
 
     /*
-     *  Convenience wrappers for adding multiple items
-     *  template <class T> void AddItems( const T& aItems );
+     *  Convenience wrapper for removing multiple items
      *  template <class T> void RemoveItems( const T& aItems );
      */
 
@@ -238,6 +252,17 @@ public:
         m_maxScale = aMaximum;
     }
 
+    /**
+     * Function SetMinItemSize()
+     * Sets the size on the screen below which the items of cached layers are drawn
+     * simplified, whatever their detail LOD (see VIEW_ITEM::ViewGetDetailLOD()).
+     * @param aPixels is the minimal size (in pixels) of the items, 0 to disable.
+     */
+    void SetMinItemSize( double aPixels )
+    {
+        m_minItemSize = aPixels;
+    }
+
     /**
      * Function SetCenter()
      * Sets the center point of the VIEW (i.e. the point in world space that will be drawn in the middle
@@ -464,10 +489,19 @@ public:
      * Function RecacheAllItems()
      * Rebuilds GAL display lists.
      * @param aForceNow decides if every item should be instantly recached. Otherwise items are
-     * going to be recached when they become visible.
+     * going to be recached when they become visible. When they are recached instantly and the
+     * painter supports it (see PAINTER::Clone()), the items are drawn by several threads, then
+     * added to the GAL cache.
      */
     void RecacheAllItems( bool aForceNow = false );
 
+    /**
+     * Function SetRecacheThreadCount()
+     * Sets the number of threads drawing the items in RecacheAllItems().
+     * @param aCount is the number of threads, 0 for the number of hardware threads.
+     */
+    void SetRecacheThreadCount( int aCount );
+
     /**
      * Function IsDynamic()
      * Tells if the VIEW is dynamic (ie. can be changed, for example displaying PCBs in a window)
@@ -519,6 +553,31 @@ public:
         m_dirtyTargets[aTarget] = true;
     }
 
+    /// Statistics of a layer in the last redraw
+    struct LAYER_DRAW_STATS
+    {
+        LAYER_DRAW_STATS() :
+            msecs( 0.0 ), drawn( 0 ), simplified( 0 ), tiny( 0 )
+        {}
+
+        double  msecs;          ///< time spent drawing the layer (PROFILE builds only)
+        int     drawn;          ///< number of items drawn with all their details
+        int     simplified;     ///< number of items drawn simplified (see ViewGetDetailLOD())
+        int     tiny;           ///< number of the simplified items smaller than the minimal
+                                ///< item size
+    };
+
+    /**
+     * Function GetLayerDrawStats()
+     * Returns the statistics of the layer in the last redraw (all zero if it was not redrawn),
+     * to measure the effect of the level of detail settings.
+     * @param aLayer is the layer.
+     */
+    const LAYER_DRAW_STATS& GetLayerDrawStats( int aLayer ) const
+    {
+        return m_layers.at( aLayer ).stats;
+    }
+
     /// Returns true if the layer is cached
     inline bool IsCached( int aLayer ) const
     {
@@ -574,6 +633,7 @@ private:
         int                     id;              ///< layer ID
         RENDER_TARGET           target;          ///< where the layer should be rendered
         std::set<int>           requiredLayers;  ///< layers that have to be enabled to show the layer
+        LAYER_DRAW_STATS        stats;           ///< statistics of the last redraw
     };
 
     // Convenience typedefs
@@ -585,6 +645,8 @@ private:
     // Function objects that need to access VIEW/VIEW_ITEM private/protected members
     struct clearLayerCache;
     struct recacheItem;
+    struct recordedItem;
+    struct gatherItems;
     struct drawItem;
     struct unlinkItem;
     struct updateItemsColor;
@@ -634,6 +696,17 @@ private:
      */
     void draw( VIEW_GROUP* aGroup, bool aImmediate = false );
 
+    /**
+     * Function drawSimplified()
+     * Draws items as rectangles filling their bounding boxes, in the color of the layer, as
+     * a substitute for items too small on the screen to show their details. The rectangles are
+     * drawn in immediate mode, so the cached groups of the items stay valid.
+     *
+     * @param aItems are the items to be drawn.
+     * @param aLayer is the layer which should be drawn.
+     */
+    void drawSimplified( const std::vector<VIEW_ITEM*>& aItems, int aLayer );
+
     ///* Sorts m_orderedLayers when layer rendering order has changed
     void sortLayers();
 
@@ -655,6 +728,14 @@ private:
     /// Updates all informations needed to draw an item
     void updateItemGeometry( VIEW_ITEM* aItem, int aLayer );
 
+    /// Draws all the items of the cached layers on worker threads, then caches them in the GAL
+    void recacheParallel();
+
+    /// Draws items from aItems with a worker painter, into m_recorders[aWorker], and builds
+    /// their groups data with aBuilder, if any (called from the worker threads)
+    void recordItems( std::vector<recordedItem>* aItems, boost::atomic<int>* aNext,
+                      int aWorker, PAINTER* aPainter, GROUP_BUILDER* aBuilder );
+
     /// Updates bounding box of an item
     void updateBbox( VIEW_ITEM* aItem );
 
@@ -697,6 +778,9 @@ private:
     /// Scale upper limit
     double m_maxScale;
 
+    /// Size on the screen (in pixels) below which the items of cached layers are simplified
+    double m_minItemSize;
+
     /// PAINTER contains information how do draw items
     PAINTER* m_painter;
 
@@ -715,6 +799,15 @@ private:
 
     /// Items to be updated
     std::vector<VIEW_ITEM*> m_needsUpdate;
+
+    /// Threads drawing the items in RecacheAllItems(), created when first needed
+    THREAD_POOL* m_recachePool;
+
+    /// Number of threads for RecacheAllItems(), 0 for the number of hardware threads
+    int m_recacheThreadCount;
+
+    /// GALs recording the items drawn by each recache thread
+    std::vector<RECORDING_GAL*> m_recorders;
 };
 } // namespace KIGFX
 
@@ -194,6 +194,18 @@ public:
         return 0;
     }
 
+    /**
+     * Function ViewGetDetailLOD()
+     * Returns the minimal VIEW scale that is sufficient for an item to be shown with all its
+     * details on a given layer. Below that scale (and above ViewGetLOD()), the item is drawn
+     * simplified, as a rectangle filling its bounding box.
+     */
+    virtual unsigned int ViewGetDetailLOD( int aLayer ) const
+    {
+        // By default always show all the details
+        return 0;
+    }
+
     /**
      * Function ViewUpdate()
      * For dynamic VIEWs, informs the associated VIEW that the graphical representation of
@@ -25,6 +25,10 @@
 #ifndef __VIEW_RTREE_H
 #define __VIEW_RTREE_H
 
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
 #include <math/box2.h>
 
 #include <geometry/rtree.h>
@@ -52,23 +56,77 @@ public:
         const int       mmin[2] = { bbox.GetX(), bbox.GetY() };
         const int       mmax[2] = { bbox.GetRight(), bbox.GetBottom() };
 
+        m_bboxes[aItem] = bbox;
         VIEW_RTREE_BASE::Insert( mmin, mmax, aItem );
     }
 
     /**
      * Function Remove()
      * Removes an item from the tree. Removal is done by comparing pointers, attepmting to remove a copy
-     * of the item will fail.
+     * of the item will fail. The item is searched with the bounding box it had when it was inserted
+     * (its geometry may have changed since), so only the branches covering it are visited.
      */
     void Remove( VIEW_ITEM* aItem )
     {
-        // const BOX2I&    bbox    = aItem->ViewBBox();
+        BBOX_MAP::iterator it = m_bboxes.find( aItem );
+
+        if( it == m_bboxes.end() )
+            return;
 
-        // FIXME: use cached bbox or ptr_map to speed up pointer <-> node lookups.
-        const int       mmin[2] = { INT_MIN, INT_MIN };
-        const int       mmax[2] = { INT_MAX, INT_MAX };
+        const BOX2I&    bbox    = it->second;
+        const int       mmin[2] = { bbox.GetX(), bbox.GetY() };
+        const int       mmax[2] = { bbox.GetRight(), bbox.GetBottom() };
 
         VIEW_RTREE_BASE::Remove( mmin, mmax, aItem );
+        m_bboxes.erase( it );
+    }
+
+    /**
+     * Function BulkLoad()
+     * Replaces the contents of the tree with a set of items, packed at once (see
+     * RTree::BulkLoad()). Much faster than inserting the items one by one, e.g. when
+     * a whole board is loaded.
+     */
+    void BulkLoad( const std::vector<VIEW_ITEM*>& aItems )
+    {
+        std::vector<int> mmin, mmax;
+
+        mmin.reserve( 2 * aItems.size() );
+        mmax.reserve( 2 * aItems.size() );
+        m_bboxes.clear();
+        m_bboxes.rehash( aItems.size() );
+
+        for( unsigned i = 0; i < aItems.size(); ++i )
+        {
+            const BOX2I& bbox = aItems[i]->ViewBBox();
+
+            mmin.push_back( bbox.GetX() );
+            mmin.push_back( bbox.GetY() );
+            mmax.push_back( bbox.GetRight() );
+            mmax.push_back( bbox.GetBottom() );
+            m_bboxes[aItems[i]] = bbox;
+        }
+
+        if( aItems.empty() )
+            VIEW_RTREE_BASE::RemoveAll();
+        else
+            VIEW_RTREE_BASE::BulkLoad( aItems.size(), &mmin[0], &mmax[0], &aItems[0] );
+    }
+
+    /**
+     * Function RemoveAll()
+     * Removes all the items from the tree.
+     */
+    void RemoveAll()
+    {
+        m_bboxes.clear();
+        VIEW_RTREE_BASE::RemoveAll();
+    }
+
+    ///> Returns true if the tree contains no item
+    bool Empty() const
+    {
+        return m_bboxes.empty();
     }
 
     /**
@@ -85,7 +143,27 @@ public:
         VIEW_RTREE_BASE::Search( mmin, mmax, aVisitor );
     }
 
+    /**
+     * Function Query()
+     * Executes a function object aVisitor for each item whose bounding box intersects
+     * with aBounds, and is not smaller than aMinSize in both dimensions, and aSmallVisitor
+     * for the other intersecting items.
+     */
+    template <class Visitor, class SmallVisitor>
+    void Query( const BOX2I& aBounds, int aMinSize, Visitor& aVisitor,
+                SmallVisitor& aSmallVisitor )
+    {
+        const int   mmin[2] = { aBounds.GetX(), aBounds.GetY() };
+        const int   mmax[2] = { aBounds.GetRight(), aBounds.GetBottom() };
+
+        VIEW_RTREE_BASE::Search( mmin, mmax, aMinSize, aVisitor, aSmallVisitor );
+    }
+
 private:
+    typedef boost::unordered_map<VIEW_ITEM*, BOX2I> BBOX_MAP;
+
+    ///> Bounding boxes of the items, as they were inserted
+    BBOX_MAP m_bboxes;
 };
 } // namespace KIGFX
 
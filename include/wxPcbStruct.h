@@ -51,6 +51,8 @@ class PCB_TARGET;
 class DIMENSION;
 class EDGE_MODULE;
 class DRC;
+class ZONE_FILL_TRACKER;
+class ONLINE_DRC;
 class ZONE_CONTAINER;
 class DRAWSEGMENT;
 class GENERAL_COLLECTOR;
@@ -95,6 +97,10 @@ protected:
 
     DRC* m_drc;                                 ///< the DRC controller, see drc.cpp
 
+    ZONE_FILL_TRACKER* m_zoneFillTracker;       ///< finds the zones to refill, see Fill_All_Zones()
+
+    ONLINE_DRC* m_onlineDrc;                    ///< updates the DRC markers while editing
+
     PARAM_CFG_ARRAY   m_configSettings;         ///< List of Pcbnew configuration settings.
 
     wxString          m_lastNetListRead;        ///< Last net list read with relative path.
@@ -1416,6 +1422,8 @@ public:
      * Function Fill_All_Zones
      *  Fill all zones on the board
      * The old fillings are removed
+     * When g_IncrementalZoneFilling is set, only the zones affected by the board
+     * changes made since the last complete fill are refilled.
      * @param aActiveWindow = the current active window, if a progress bar is shown
      *                      = NULL to do not display a progress bar
      * @param aVerbose = true to show error messages
@@ -1624,6 +1632,14 @@ public:
      */
     void AutoPlaceModule( MODULE* Module, int place_mode, wxDC* DC );
 
+    /**
+     * Function AnnealPlaceModules
+     * optimizes the placement of the footprints not locked within the PCB edges, by
+     * simulated annealing (see ANNEAL_PLACER): the ratsnest length is minimized, without
+     * overlapping footprints.
+     */
+    void AnnealPlaceModules( wxDC* DC );
+
     // Autorouting:
     int Solve( wxDC* DC, int two_sides );
     void Reset_Noroutable( wxDC* DC );
@@ -0,0 +1,861 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+/**
+ * @file anneal_placer.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+
+#include <profile.h>
+#include <thread_pool.h>
+
+#include <anneal_placer.h>
+
+
+// Probability of accepting the average uphill move at the initial temperature
+static const double initialAcceptance = 0.8;
+
+// Acceptance ratio the displacement window is adjusted to
+static const double targetAcceptance = 0.44;
+
+// Maximum number of temperature steps
+static const int maxSteps = 500;
+
+// The overlap weight starts at this fraction of PARAMS::m_overlapWeight, and grows by
+// overlapRamp at each temperature step: the footprints first cross each other freely,
+// then are pushed apart
+static const double initialOverlapWeight = 0.05;
+static const double overlapRamp = 1.06;
+
+// The annealing stops when the best cost did not improve during this many steps
+// with a low acceptance ratio
+static const int frozenSteps = 8;
+
+
+/**
+ * Class RANDOM
+ * is a small xorshift generator: each chain has its own, seeded from the chain index,
+ * so the chains do not depend on the threads running them.
+ */
+class RANDOM
+{
+public:
+    RANDOM( uint64_t aSeed )
+    {
+        // splitmix64, to spread the seed bits
+        uint64_t z = aSeed + 0x9E3779B97F4A7C15ULL;
+
+        z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+        m_state = ( z ^ ( z >> 31 ) ) | 1;
+    }
+
+    uint32_t Next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+
+        return ( m_state * 0x2545F4914F6CDD1DULL ) >> 32;
+    }
+
+    ///> Returns a number in [0, 1)
+    double Uniform()
+    {
+        return Next() * ( 1.0 / 4294967296.0 );
+    }
+
+    ///> Returns an integer in [0, aCount)
+    int Int( int aCount )
+    {
+        return (int) ( Uniform() * aCount );
+    }
+
+private:
+    uint64_t m_state;
+};
+
+
+/**
+ * Class CHAIN
+ * is one annealing chain: a placement, the cached cost of each net, and bins of the
+ * area listing the footprints, to find the overlaps.
+ */
+class ANNEAL_PLACER::CHAIN
+{
+public:
+    CHAIN( const ANNEAL_PLACER& aPlacer, unsigned aSeed );
+
+    void Run( const boost::atomic<bool>& aAbort );
+
+    double              m_bestCost;
+    double              m_bestWireLength;
+    double              m_bestOverlap;
+    std::vector<VECTOR2I> m_bestPositions;
+    std::vector<int>    m_bestOrientations;
+    long long           m_moves;
+
+private:
+    ///> Returns the box of footprint aIndex, inflated by half the clearance
+    BOX2I box( int aIndex ) const
+    {
+        const FOOTPRINT& fp = m_placer.m_footprints[aIndex];
+        BOX2I b = fp.m_shapes[m_orientations[aIndex]].m_box;
+
+        b.Move( m_positions[aIndex] );
+        b.Inflate( m_placer.m_params.m_clearance / 2 );
+
+        return b;
+    }
+
+    ///> Computes the length of net aIndex
+    double netCost( int aIndex ) const;
+
+    ///> Overlap area of footprint aIndex with the others and the outside of the area or board
+    double overlap( int aIndex );
+
+    ///> Overlap area of two footprints
+    double overlap( int aA, int aB ) const;
+
+    void binRange( const BOX2I& aBox, int& aCol0, int& aRow0, int& aCol1, int& aRow1 ) const;
+    void insert( int aIndex );
+    void remove( int aIndex );
+
+    ///> Recomputes all the costs
+    void evaluate( double& aWireLength, double& aOverlap );
+
+    ///> Tries a random move at temperature aTemperature (0 to evaluate the move only)
+    ///> @return the change of cost, if accepted
+    double move( double aTemperature, bool& aAccepted, bool aEvaluateOnly = false );
+
+    ///> Moves footprint aIndex, keeping it on the grid and in the area if possible
+    VECTOR2I clamp( int aIndex, int aOrientation, VECTOR2I aPosition ) const;
+
+    const ANNEAL_PLACER&    m_placer;
+    RANDOM                  m_random;
+
+    std::vector<VECTOR2I>   m_positions;
+    std::vector<int>        m_orientations;
+    std::vector<double>     m_netCosts;
+    double                  m_cost;
+    double                  m_overlapScale;     // overlap weight, per area unit
+    double                  m_finalScale;       // final overlap weight, for the best cost
+    int                     m_window;           // displacement range
+
+    std::vector< std::vector<int> > m_bins;
+    int                     m_binSize;
+    int                     m_binCols, m_binRows;
+
+    // stamps, to visit the nets and footprints once
+    std::vector<unsigned>   m_netStamps;
+    std::vector<unsigned>   m_footprintStamps;
+    unsigned                m_stamp;
+
+    // nets touched by the current move, and their new costs
+    std::vector<int>        m_touched;
+    std::vector<double>     m_touchedCosts;
+};
+
+
+ANNEAL_PLACER::CHAIN::CHAIN( const ANNEAL_PLACER& aPlacer, unsigned aSeed ) :
+    m_placer( aPlacer ),
+    m_random( aSeed ),
+    m_stamp( 0 )
+{
+    const std::vector<FOOTPRINT>& fps = aPlacer.m_footprints;
+    const BOX2I& area = aPlacer.m_params.m_area;
+
+    double meanArea = 0.0;
+
+    for( unsigned i = 0; i < fps.size(); i++ )
+    {
+        m_positions.push_back( fps[i].m_position );
+        m_orientations.push_back( fps[i].m_orientation );
+
+        const BOX2I& b = fps[i].m_shapes[fps[i].m_orientation].m_box;
+        meanArea += (double) b.GetWidth() * b.GetHeight();
+    }
+
+    // Overlaps cost m_overlapWeight per overlap length, the overlap length being the
+    // overlap area divided by the mean footprint size
+    double unit = std::max( 1.0, sqrt( meanArea / std::max<size_t>( 1, fps.size() ) ) );
+
+    m_finalScale = aPlacer.m_params.m_overlapWeight / unit;
+    m_overlapScale = m_finalScale;
+
+    // Bins of about two footprints wide, at most 256 x 256
+    int maxSide = std::max( area.GetWidth(), area.GetHeight() );
+
+    m_binSize = std::max( std::max( 1, maxSide / 256 ), (int) ( 2 * unit ) );
+    m_binCols = area.GetWidth() / m_binSize + 1;
+    m_binRows = area.GetHeight() / m_binSize + 1;
+    m_bins.resize( m_binCols * m_binRows );
+
+    for( unsigned i = 0; i < fps.size(); i++ )
+        insert( i );
+
+    m_netStamps.assign( aPlacer.m_nets.size(), 0 );
+    m_footprintStamps.assign( fps.size(), 0 );
+
+    m_netCosts.resize( aPlacer.m_nets.size() );
+
+    double wireLength, overlap;
+    evaluate( wireLength, overlap );
+
+    m_bestCost = m_cost;
+    m_bestWireLength = wireLength;
+    m_bestOverlap = overlap;
+    m_bestPositions = m_positions;
+    m_bestOrientations = m_orientations;
+    m_moves = 0;
+    m_window = maxSide;
+}
+
+
+double ANNEAL_PLACER::CHAIN::netCost( int aIndex ) const
+{
+    const NET& net = m_placer.m_nets[aIndex];
+    int count = net.size();
+    VECTOR2I pins[MaxTreePins];
+
+    if( count > MaxTreePins )
+    {
+        // half perimeter of the bounding box
+        BOX2I bbox;
+
+        for( int i = 0; i < count; i++ )
+        {
+            const PIN& pin = net[i];
+            const FOOTPRINT& fp = m_placer.m_footprints[pin.m_footprint];
+            VECTOR2I p = m_positions[pin.m_footprint] +
+                         fp.m_shapes[m_orientations[pin.m_footprint]].m_pins[pin.m_pin];
+
+            if( i == 0 )
+                bbox = BOX2I( p, VECTOR2I( 0, 0 ) );
+            else
+                bbox.Merge( p );
+        }
+
+        return (double) bbox.GetWidth() + bbox.GetHeight();
+    }
+
+    for( int i = 0; i < count; i++ )
+    {
+        const PIN& pin = net[i];
+        const FOOTPRINT& fp = m_placer.m_footprints[pin.m_footprint];
+
+        pins[i] = m_positions[pin.m_footprint] +
+                  fp.m_shapes[m_orientations[pin.m_footprint]].m_pins[pin.m_pin];
+    }
+
+    // Prim's minimum spanning tree, like the ratsnest
+    double dist[MaxTreePins];
+    bool   inTree[MaxTreePins];
+    double length = 0.0;
+
+    for( int i = 0; i < count; i++ )
+    {
+        dist[i] = ( pins[i] - pins[0] ).EuclideanNorm();
+        inTree[i] = false;
+    }
+
+    inTree[0] = true;
+
+    for( int k = 1; k < count; k++ )
+    {
+        int next = -1;
+
+        for( int i = 0; i < count; i++ )
+        {
+            if( !inTree[i] && ( next < 0 || dist[i] < dist[next] ) )
+                next = i;
+        }
+
+        inTree[next] = true;
+        length += dist[next];
+
+        for( int i = 0; i < count; i++ )
+        {
+            if( !inTree[i] )
+                dist[i] = std::min( dist[i], (double) ( pins[i] - pins[next] ).EuclideanNorm() );
+        }
+    }
+
+    return length;
+}
+
+
+double ANNEAL_PLACER::CHAIN::overlap( int aA, int aB ) const
+{
+    if( !( m_placer.m_footprints[aA].m_sides & m_placer.m_footprints[aB].m_sides ) )
+        return 0.0;
+
+    BOX2I a = box( aA );
+    BOX2I b = box( aB );
+
+    double w = std::min( a.GetRight(), b.GetRight() ) - std::max( a.GetLeft(), b.GetLeft() );
+    double h = std::min( a.GetBottom(), b.GetBottom() ) - std::max( a.GetTop(), b.GetTop() );
+
+    return w > 0 && h > 0 ? w * h : 0.0;
+}
+
+
+double ANNEAL_PLACER::CHAIN::overlap( int aIndex )
+{
+    BOX2I b = box( aIndex );
+
+    // the part of the footprint outside the area or the board
+    double result = m_placer.outsideArea( b );
+
+    int col0, row0, col1, row1;
+
+    binRange( b, col0, row0, col1, row1 );
+    m_stamp++;
+    m_footprintStamps[aIndex] = m_stamp;
+
+    for( int row = row0; row <= row1; row++ )
+    {
+        for( int col = col0; col <= col1; col++ )
+        {
+            const std::vector<int>& bin = m_bins[row * m_binCols + col];
+
+            for( unsigned i = 0; i < bin.size(); i++ )
+            {
+                int other = bin[i];
+
+                if( m_footprintStamps[other] == m_stamp )
+                    continue;
+
+                m_footprintStamps[other] = m_stamp;
+                result += overlap( aIndex, other );
+            }
+        }
+    }
+
+    return result;
+}
+
+
+void ANNEAL_PLACER::CHAIN::binRange( const BOX2I& aBox, int& aCol0, int& aRow0,
+                                     int& aCol1, int& aRow1 ) const
+{
+    const BOX2I& area = m_placer.m_params.m_area;
+
+    aCol0 = std::max( 0, ( aBox.GetLeft() - area.GetLeft() ) / m_binSize );
+    aRow0 = std::max( 0, ( aBox.GetTop() - area.GetTop() ) / m_binSize );
+    aCol1 = std::min( m_binCols - 1, std::max( 0, ( aBox.GetRight() - area.GetLeft() ) / m_binSize ) );
+    aRow1 = std::min( m_binRows - 1, std::max( 0, ( aBox.GetBottom() - area.GetTop() ) / m_binSize ) );
+    aCol0 = std::min( aCol0, aCol1 );
+    aRow0 = std::min( aRow0, aRow1 );
+}
+
+
+void ANNEAL_PLACER::CHAIN::insert( int aIndex )
+{
+    int col0, row0, col1, row1;
+
+    binRange( box( aIndex ), col0, row0, col1, row1 );
+
+    for( int row = row0; row <= row1; row++ )
+    {
+        for( int col = col0; col <= col1; col++ )
+            m_bins[row * m_binCols + col].push_back( aIndex );
+    }
+}
+
+
+void ANNEAL_PLACER::CHAIN::remove( int aIndex )
+{
+    int col0, row0, col1, row1;
+
+    binRange( box( aIndex ), col0, row0, col1, row1 );
+
+    for( int row = row0; row <= row1; row++ )
+    {
+        for( int col = col0; col <= col1; col++ )
+        {
+            std::vector<int>& bin = m_bins[row * m_binCols + col];
+            std::vector<int>::iterator it = std::find( bin.begin(), bin.end(), aIndex );
+
+            *it = bin.back();
+            bin.pop_back();
+        }
+    }
+}
+
+
+void ANNEAL_PLACER::CHAIN::evaluate( double& aWireLength, double& aOverlap )
+{
+    aWireLength = 0.0;
+    aOverlap = 0.0;
+
+    for( unsigned i = 0; i < m_netCosts.size(); i++ )
+    {
+        m_netCosts[i] = netCost( i );
+        aWireLength += m_netCosts[i];
+    }
+
+    // each overlap between two footprints is counted twice
+    double outside = 0.0;
+
+    for( unsigned i = 0; i < m_positions.size(); i++ )
+    {
+        double o = m_placer.outsideArea( box( i ) );
+
+        outside += o;
+        aOverlap += overlap( i ) - o;
+    }
+
+    aOverlap = aOverlap / 2 + outside;
+    m_cost = aWireLength + aOverlap * m_overlapScale;
+}
+
+
+VECTOR2I ANNEAL_PLACER::CHAIN::clamp( int aIndex, int aOrientation, VECTOR2I aPosition ) const
+{
+    const BOX2I& area = m_placer.m_params.m_area;
+    const BOX2I& b = m_placer.m_footprints[aIndex].m_shapes[aOrientation].m_box;
+    int grid = std::max( 1, m_placer.m_params.m_grid );
+
+    // keep the box in the area, if it fits
+    if( b.GetWidth() <= area.GetWidth() )
+        aPosition.x = std::max( area.GetLeft() - b.GetLeft(),
+                                std::min( area.GetRight() - b.GetRight(), aPosition.x ) );
+
+    if( b.GetHeight() <= area.GetHeight() )
+        aPosition.y = std::max( area.GetTop() - b.GetTop(),
+                                std::min( area.GetBottom() - b.GetBottom(), aPosition.y ) );
+
+    // snap to the grid, inwards
+    VECTOR2I center = area.Centre();
+
+    for( int axis = 0; axis < 2; axis++ )
+    {
+        int& c = axis ? aPosition.y : aPosition.x;
+        int  m = c % grid;
+
+        if( m < 0 )
+            m += grid;
+
+        if( m != 0 )
+            c += ( c < ( axis ? center.y : center.x ) ) ? grid - m : -m;
+    }
+
+    return aPosition;
+}
+
+
+double ANNEAL_PLACER::CHAIN::move( double aTemperature, bool& aAccepted, bool aEvaluateOnly )
+{
+    const std::vector<int>& movable = m_placer.m_movable;
+    int moved[2];
+    int count = 1;
+    VECTOR2I oldPos[2], newPos[2];
+    int oldOrient[2], newOrient[2];
+
+    moved[0] = movable[m_random.Int( movable.size() )];
+    oldPos[0] = newPos[0] = m_positions[moved[0]];
+    oldOrient[0] = newOrient[0] = m_orientations[moved[0]];
+
+    const FOOTPRINT& fp = m_placer.m_footprints[moved[0]];
+    double kind = m_random.Uniform();
+
+    if( kind < 0.15 && movable.size() > 1 )
+    {
+        // swap with another footprint
+        do
+            moved[1] = movable[m_random.Int( movable.size() )];
+        while( moved[1] == moved[0] );
+
+        count = 2;
+        oldPos[1] = m_positions[moved[1]];
+        oldOrient[1] = newOrient[1] = m_orientations[moved[1]];
+
+        // the footprints exchange their box centers
+        VECTOR2I c0 = fp.m_shapes[oldOrient[0]].m_box.Centre();
+        VECTOR2I c1 = m_placer.m_footprints[moved[1]].m_shapes[oldOrient[1]].m_box.Centre();
+
+        newPos[0] = clamp( moved[0], oldOrient[0], oldPos[1] + c1 - c0 );
+        newPos[1] = clamp( moved[1], oldOrient[1], oldPos[0] + c0 - c1 );
+    }
+    else if( kind < 0.25 && fp.m_shapes.size() > 1 )
+    {
+        // rotate around the box center
+        newOrient[0] = ( oldOrient[0] + 1 + m_random.Int( fp.m_shapes.size() - 1 ) ) %
+                       fp.m_shapes.size();
+
+        VECTOR2I c0 = fp.m_shapes[oldOrient[0]].m_box.Centre();
+        VECTOR2I c1 = fp.m_shapes[newOrient[0]].m_box.Centre();
+
+        newPos[0] = clamp( moved[0], newOrient[0], oldPos[0] + c0 - c1 );
+    }
+    else
+    {
+        VECTOR2I d( m_random.Int( 2 * m_window + 1 ) - m_window,
+                    m_random.Int( 2 * m_window + 1 ) - m_window );
+
+        newPos[0] = clamp( moved[0], oldOrient[0], oldPos[0] + d );
+    }
+
+    // The nets of the moved footprints
+    m_stamp++;
+    m_touched.clear();
+
+    double oldWire = 0.0;
+
+    for( int k = 0; k < count; k++ )
+    {
+        const std::vector<int>& nets = m_placer.m_footprintNets[moved[k]];
+
+        for( unsigned i = 0; i < nets.size(); i++ )
+        {
+            if( m_netStamps[nets[i]] != m_stamp )
+            {
+                m_netStamps[nets[i]] = m_stamp;
+                m_touched.push_back( nets[i] );
+                oldWire += m_netCosts[nets[i]];
+            }
+        }
+    }
+
+    double oldOverlap = overlap( moved[0] );
+
+    if( count == 2 )
+        oldOverlap += overlap( moved[1] ) - overlap( moved[0], moved[1] );
+
+    for( int k = 0; k < count; k++ )
+    {
+        remove( moved[k] );
+        m_positions[moved[k]] = newPos[k];
+        m_orientations[moved[k]] = newOrient[k];
+        insert( moved[k] );
+    }
+
+    double newOverlap = overlap( moved[0] );
+
+    if( count == 2 )
+        newOverlap += overlap( moved[1] ) - overlap( moved[0], moved[1] );
+
+    double newWire = 0.0;
+
+    m_touchedCosts.resize( m_touched.size() );
+
+    for( unsigned i = 0; i < m_touched.size(); i++ )
+    {
+        m_touchedCosts[i] = netCost( m_touched[i] );
+        newWire += m_touchedCosts[i];
+    }
+
+    double delta = newWire - oldWire + ( newOverlap - oldOverlap ) * m_overlapScale;
+
+    m_moves++;
+
+    aAccepted = !aEvaluateOnly &&
+                ( delta <= 0.0 || m_random.Uniform() < exp( -delta / aTemperature ) );
+
+    if( aAccepted )
+    {
+        for( unsigned i = 0; i < m_touched.size(); i++ )
+            m_netCosts[m_touched[i]] = m_touchedCosts[i];
+
+        m_cost += delta;
+    }
+    else
+    {
+        for( int k = count - 1; k >= 0; k-- )
+        {
+            remove( moved[k] );
+            m_positions[moved[k]] = oldPos[k];
+            m_orientations[moved[k]] = oldOrient[k];
+            insert( moved[k] );
+        }
+    }
+
+    return delta;
+}
+
+
+void ANNEAL_PLACER::CHAIN::Run( const boost::atomic<bool>& aAbort )
+{
+    const PARAMS& params = m_placer.m_params;
+    int movable = m_placer.m_movable.size();
+    int minWindow = std::max( params.m_grid, params.m_clearance );
+    int maxWindow = m_window;
+    bool accepted;
+
+    double wireLength, overlap;
+
+    m_overlapScale = m_finalScale * initialOverlapWeight;
+    evaluate( wireLength, overlap );
+
+    // Initial temperature: the average uphill move is accepted with initialAcceptance
+    double uphill = 0.0;
+    int uphillCount = 0;
+
+    for( int i = 0; i < std::max( 100, movable ); i++ )
+    {
+        double delta = move( 1.0, accepted, true );
+
+        if( delta > 0.0 )
+        {
+            uphill += delta;
+            uphillCount++;
+        }
+    }
+
+    if( uphillCount == 0 )
+        return;
+
+    double temperature = uphill / uphillCount / -log( initialAcceptance );
+    double finalTemperature = temperature * 1e-5;
+    int movesPerStep = std::max( 1, params.m_movesPerFootprint ) * movable;
+    int stalled = 0;
+
+    for( int step = 0; step < maxSteps && temperature > finalTemperature; step++ )
+    {
+        int acceptedCount = 0;
+
+        for( int i = 0; i < movesPerStep; i++ )
+        {
+            move( temperature, accepted );
+
+            if( accepted )
+                acceptedCount++;
+
+            if( ( i & 255 ) == 0 && aAbort )
+                break;
+        }
+
+        // Recompute the costs from scratch, to avoid drifting
+        evaluate( wireLength, overlap );
+
+        double ratio = (double) acceptedCount / movesPerStep;
+        double cost = wireLength + overlap * m_finalScale;
+
+        if( cost < m_bestCost )
+        {
+            m_bestCost = cost;
+            m_bestWireLength = wireLength;
+            m_bestOverlap = overlap;
+            m_bestPositions = m_positions;
+            m_bestOrientations = m_orientations;
+            stalled = 0;
+        }
+        else if( ratio < 0.01 )
+        {
+            stalled++;
+        }
+
+        if( aAbort || stalled >= frozenSteps )
+            break;
+
+        // Displacement window tracking the target acceptance ratio
+        m_window = (int) ( m_window * ( 1.0 - targetAcceptance + ratio ) );
+        m_window = std::max( minWindow, std::min( maxWindow, m_window ) );
+
+        temperature *= params.m_coolingRate;
+
+        m_overlapScale = std::min( m_finalScale, m_overlapScale * overlapRamp );
+        m_cost = wireLength + overlap * m_overlapScale;
+    }
+}
+
+
+ANNEAL_PLACER::ANNEAL_PLACER( const PARAMS& aParams ) :
+    m_params( aParams ),
+    m_cellRows( 0 ),
+    m_abort( false )
+{
+    int cols = m_params.m_cellCols;
+
+    if( m_params.m_cellSize <= 0 || cols <= 0 || m_params.m_outside.empty() )
+        return;
+
+    m_cellRows = m_params.m_outside.size() / cols;
+    m_outsideSums.assign( ( m_cellRows + 1 ) * ( cols + 1 ), 0 );
+
+    for( int row = 0; row < m_cellRows; row++ )
+    {
+        for( int col = 0; col < cols; col++ )
+        {
+            m_outsideSums[( row + 1 ) * ( cols + 1 ) + col + 1] =
+                    m_params.m_outside[row * cols + col] +
+                    m_outsideSums[row * ( cols + 1 ) + col + 1] +
+                    m_outsideSums[( row + 1 ) * ( cols + 1 ) + col] -
+                    m_outsideSums[row * ( cols + 1 ) + col];
+        }
+    }
+}
+
+
+double ANNEAL_PLACER::outsideArea( const BOX2I& aBox ) const
+{
+    const BOX2I& area = m_params.m_area;
+
+    int left = std::max( aBox.GetLeft(), area.GetLeft() );
+    int top = std::max( aBox.GetTop(), area.GetTop() );
+    int right = std::min( aBox.GetRight(), area.GetRight() );
+    int bottom = std::min( aBox.GetBottom(), area.GetBottom() );
+
+    double total = (double) aBox.GetWidth() * aBox.GetHeight();
+
+    if( right <= left || bottom <= top )
+        return total;
+
+    double result = total - (double) ( right - left ) * ( bottom - top );
+
+    if( m_outsideSums.empty() )
+        return result;
+
+    // The cells outside the board whose center is in the part inside the area. The
+    // center of cell (row, col) is at the area origin + (col, row) * m_cellSize.
+    int size = m_params.m_cellSize;
+    int cols = m_params.m_cellCols;
+    int col0 = std::max( 0, ( left - area.GetLeft() + size - 1 ) / size );
+    int row0 = std::max( 0, ( top - area.GetTop() + size - 1 ) / size );
+    int col1 = std::min( cols, ( right - area.GetLeft() ) / size + 1 );
+    int row1 = std::min( m_cellRows, ( bottom - area.GetTop() ) / size + 1 );
+
+    if( col1 <= col0 || row1 <= row0 )
+        return result;
+
+    int cells = m_outsideSums[row1 * ( cols + 1 ) + col1] -
+                m_outsideSums[row0 * ( cols + 1 ) + col1] -
+                m_outsideSums[row1 * ( cols + 1 ) + col0] +
+                m_outsideSums[row0 * ( cols + 1 ) + col0];
+
+    return result + (double) cells * size * size;
+}
+
+
+int ANNEAL_PLACER::AddFootprint( const FOOTPRINT& aFootprint )
+{
+    int index = m_footprints.size();
+
+    m_footprints.push_back( aFootprint );
+    m_footprintNets.push_back( std::vector<int>() );
+
+    if( !aFootprint.m_locked )
+        m_movable.push_back( index );
+
+    return index;
+}
+
+
+void ANNEAL_PLACER::AddNet( const NET& aNet )
+{
+    if( aNet.size() < 2 )
+        return;
+
+    int index = m_nets.size();
+
+    m_nets.push_back( aNet );
+
+    for( unsigned i = 0; i < aNet.size(); i++ )
+    {
+        std::vector<int>& nets = m_footprintNets[aNet[i].m_footprint];
+
+        if( nets.empty() || nets.back() != index )
+            nets.push_back( index );
+    }
+}
+
+
+void ANNEAL_PLACER::runChain( CHAIN* aChain )
+{
+    aChain->Run( m_abort );
+}
+
+
+bool ANNEAL_PLACER::Run()
+{
+    prof_counter counter;
+    prof_start( &counter );
+
+    m_stats = STATS();
+    m_abort = false;
+
+    if( m_movable.empty() )
+        return true;
+
+    int threads = m_params.m_threadCount > 0 ? m_params.m_threadCount
+                                             : THREAD_POOL::DefaultThreadCount();
+    int chainCount = std::max( 1, m_params.m_chainCount );
+
+    std::vector<CHAIN*> chains;
+
+    for( int i = 0; i < chainCount; i++ )
+        chains.push_back( new CHAIN( *this, m_params.m_seed + 7919 * i ) );
+
+    m_stats.m_initialCost = chains[0]->m_bestCost;
+
+    {
+        // The calling thread only waits, and polls the abort hook
+        THREAD_POOL pool( std::min( threads, chainCount ) );
+
+        for( int i = 0; i < chainCount; i++ )
+            pool.Submit( boost::bind( &ANNEAL_PLACER::runChain, this, chains[i] ) );
+
+        while( !pool.Wait( 100 ) )
+        {
+            if( m_abortHook && m_abortHook() )
+                m_abort = true;
+        }
+    }
+
+    int best = 0;
+
+    for( int i = 0; i < chainCount; i++ )
+    {
+        m_stats.m_moves += chains[i]->m_moves;
+
+        if( chains[i]->m_bestCost < chains[best]->m_bestCost )
+            best = i;
+    }
+
+    for( unsigned i = 0; i < m_footprints.size(); i++ )
+    {
+        m_footprints[i].m_position = chains[best]->m_bestPositions[i];
+        m_footprints[i].m_orientation = chains[best]->m_bestOrientations[i];
+    }
+
+    m_stats.m_finalCost = chains[best]->m_bestCost;
+    m_stats.m_wireLength = chains[best]->m_bestWireLength;
+    m_stats.m_overlap = chains[best]->m_bestOverlap;
+    m_stats.m_chains = chainCount;
+    m_stats.m_bestChain = best;
+
+    for( int i = 0; i < chainCount; i++ )
+        delete chains[i];
+
+    prof_end( &counter );
+    m_stats.m_msecs = counter.msecs();
+
+    return !m_abort;
+}
@@ -0,0 +1,224 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+/**
+ * @file anneal_placer.h
+ * @brief Footprint placement by simulated annealing.
+ */
+
+#ifndef ANNEAL_PLACER_H
+#define ANNEAL_PLACER_H
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+
+#include <math/vector2d.h>
+#include <math/box2.h>
+
+
+/**
+ * Class ANNEAL_PLACER
+ * places footprints in an area by simulated annealing, minimizing the length of the
+ * ratsnest plus a penalty for the footprints overlapping each other, the area edges or
+ * the cells outside the board outline.
+ *
+ * The moves are displacements (in a window shrinking with the temperature), swaps of two
+ * footprints and rotations. The cost of a move is computed incrementally: only the nets
+ * of the moved footprints are measured again, and the overlaps are searched in bins of
+ * the area. The ratsnest length of a net is the length of its minimum spanning tree, or
+ * its half perimeter for the nets with many pins.
+ *
+ * Several annealing chains, starting from the same placement with different random
+ * sequences, are run concurrently on a THREAD_POOL. The best result is kept. The number
+ * of chains is a parameter, not the number of threads, so the result does not depend on
+ * the number of threads.
+ */
+class ANNEAL_PLACER
+{
+public:
+    ///> Nets with more pins are measured by their half perimeter
+    static const int MaxTreePins = 16;
+
+    ///> Default number of annealing chains
+    static const int DefaultChainCount = 8;
+
+    /**
+     * Struct FOOTPRINT
+     * is a footprint to place (or a locked one, which is only an obstacle). Its shapes
+     * are given in the allowed orientations.
+     */
+    struct FOOTPRINT
+    {
+        ///> The footprint in one orientation, relative to its position
+        struct SHAPE
+        {
+            BOX2I                   m_box;      ///> bounding box
+            std::vector<VECTOR2I>   m_pins;     ///> pin positions
+        };
+
+        FOOTPRINT() :
+            m_orientation( 0 ),
+            m_sides( 1 ),
+            m_locked( false )
+        {}
+
+        VECTOR2I            m_position;
+        int                 m_orientation;  ///> index of the current shape
+        int                 m_sides;        ///> 1 for the front, 2 for the back, 3 for both
+        bool                m_locked;
+        std::vector<SHAPE>  m_shapes;       ///> allowed orientations, at least one
+    };
+
+    ///> A pin of a net: footprint index and pin index
+    struct PIN
+    {
+        PIN( int aFootprint = 0, int aPin = 0 ) :
+            m_footprint( aFootprint ),
+            m_pin( aPin )
+        {}
+
+        int m_footprint;
+        int m_pin;
+    };
+
+    typedef std::vector<PIN> NET;
+
+    struct PARAMS
+    {
+        PARAMS() :
+            m_grid( 1 ),
+            m_clearance( 0 ),
+            m_cellSize( 0 ),
+            m_cellCols( 0 ),
+            m_overlapWeight( 10.0 ),
+            m_movesPerFootprint( 20 ),
+            m_coolingRate( 0.92 ),
+            m_chainCount( DefaultChainCount ),
+            m_threadCount( 0 ),
+            m_seed( 1 )
+        {}
+
+        BOX2I       m_area;                 ///> the placement area
+        int         m_cellSize;             ///> size of the m_outside cells, 0 for none
+        int         m_cellCols;             ///> columns of m_outside
+        std::vector<bool> m_outside;        ///> cells outside the board, from m_area origin
+        int         m_grid;                 ///> positions are multiples of the grid
+        int         m_clearance;            ///> minimum distance between the footprints
+        double      m_overlapWeight;        ///> cost of an overlap, per overlap length
+        int         m_movesPerFootprint;    ///> moves per temperature step and footprint
+        double      m_coolingRate;          ///> temperature ratio between two steps
+        int         m_chainCount;           ///> number of chains, whatever the threads
+        int         m_threadCount;          ///> 0 for the number of hardware threads
+        unsigned    m_seed;
+    };
+
+    struct STATS
+    {
+        STATS() :
+            m_initialCost( 0.0 ),
+            m_finalCost( 0.0 ),
+            m_wireLength( 0.0 ),
+            m_overlap( 0.0 ),
+            m_chains( 0 ),
+            m_bestChain( 0 ),
+            m_moves( 0 ),
+            m_msecs( 0.0 )
+        {}
+
+        double      m_initialCost;
+        double      m_finalCost;
+        double      m_wireLength;   ///> ratsnest length of the result
+        double      m_overlap;      ///> overlap cost of the result
+        int         m_chains;
+        int         m_bestChain;
+        long long   m_moves;        ///> moves tried by all the chains
+        double      m_msecs;
+    };
+
+    ///> Called on the calling thread while the chains run, returns true to stop them
+    typedef boost::function<bool ()> ABORT_HOOK;
+
+    ANNEAL_PLACER( const PARAMS& aParams );
+
+    ///> @return the index of the footprint
+    int AddFootprint( const FOOTPRINT& aFootprint );
+
+    ///> Adds a net; nets with less than two pins are ignored
+    void AddNet( const NET& aNet );
+
+    void SetAbortHook( const ABORT_HOOK& aHook )
+    {
+        m_abortHook = aHook;
+    }
+
+    /**
+     * Function Run
+     * anneals the placement. The footprints are moved to the best placement found,
+     * even if aborted.
+     * @return false if aborted
+     */
+    bool Run();
+
+    const FOOTPRINT& Footprint( int aIndex ) const
+    {
+        return m_footprints[aIndex];
+    }
+
+    const STATS& Stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    class CHAIN;
+
+    ///> Runs a chain (on a worker thread)
+    void runChain( CHAIN* aChain );
+
+    ///> Area of aBox outside the placement area, or on the cells outside the board
+    double outsideArea( const BOX2I& aBox ) const;
+
+    PARAMS                              m_params;
+    std::vector<FOOTPRINT>              m_footprints;
+    std::vector<NET>                    m_nets;
+
+    ///> nets of each footprint
+    std::vector< std::vector<int> >     m_footprintNets;
+
+    ///> summed area table of PARAMS::m_outside, one more row and column
+    std::vector<int>                    m_outsideSums;
+    int                                 m_cellRows;
+
+    ///> indices of the footprints which are not locked
+    std::vector<int>                    m_movable;
+
+    ///> set to stop the chains
+    boost::atomic<bool>                 m_abort;
+    ABORT_HOOK                          m_abortHook;
+    STATS                               m_stats;
+};
+
+#endif  // ANNEAL_PLACER_H
@@ -30,6 +30,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
+#include <map>
+
 #include <fctsys.h>
 #include <class_drawpanel.h>
 #include <confirm.h>
@@ -41,6 +43,7 @@
 
 #include <autorout.h>
 #include <cell.h>
+#include <anneal_placer.h>
 #include <colors_selection.h>
 
 #include <class_board.h>
@@ -50,6 +53,9 @@
 #include <convert_to_biu.h>
 #include <base_units.h>
 #include <protos.h>
+#include <trigo.h>
+
+#include <boost/bind.hpp>
 
 
 #define GAIN            16
@@ -124,7 +130,16 @@ static void     CreateKeepOutRectangle( int ux0, int uy0, int ux1, int uy1,
                                         int marge, int aKeepOut, LSET aLayerMask );
 
 static MODULE*  PickModule( PCB_EDIT_FRAME* pcbframe, wxDC* DC );
-static int      propagate();
+static int      propagate( std::vector<bool>& aInside );
+
+/* Describes aModule for ANNEAL_PLACER, in its allowed orientations (given in aAngles,
+ * relative to its current orientation).
+ */
+static ANNEAL_PLACER::FOOTPRINT annealFootprint( MODULE* aModule, std::vector<double>& aAngles );
+
+/* Called while annealing: asks for confirmation if escape was pressed.
+ */
+static bool     abortPlacement( PCB_EDIT_FRAME* aFrame );
 
 void PCB_EDIT_FRAME::AutoPlaceModule( MODULE* Module, int place_mode, wxDC* DC )
 {
@@ -430,7 +445,7 @@ void drawPlacementRoutingMatrix( BOARD* aBrd, wxDC* DC )
             top_state       = RoutingMatrix.GetCell( ii, jj, TOP );
             bottom_state    = RoutingMatrix.GetCell( ii, jj, BOTTOM );
 
-            if( top_state & CELL_is_ZONE )
+            if( !( top_state & CELL_is_OUT ) )
                 color = BLUE;
 
             // obstacles
@@ -483,10 +498,6 @@ int genPlacementRoutingMatrix( BOARD* aBrd, EDA_MSG_PANEL* messagePanel )
 
     RoutingMatrix.InitRoutingMatrix();
 
-    // Display memory usage.
-    msg.Printf( wxT( "%d" ), RoutingMatrix.m_MemSize / 1024 );
-    messagePanel->SetMessage( 24, wxT( "Mem(Kb)" ), msg, CYAN );
-
     g_Route_Layer_BOTTOM = F_Cu;
 
     if( RoutingMatrix.m_RoutingLayersCount > 1 )
@@ -525,20 +536,34 @@ int genPlacementRoutingMatrix( BOARD* aBrd, EDA_MSG_PANEL* messagePanel )
         }
     }
 
-    // Mark cells of the routing matrix to CELL_is_ZONE
-    // (i.e. availlable cell to place a module )
-    // Init a starting point of attachment to the area.
-    RoutingMatrix.OrCell( RoutingMatrix.m_Nrows / 2, RoutingMatrix.m_Ncols / 2,
-                          BOTTOM, CELL_is_ZONE );
+    // Find the cells inside the board outline (i.e. availlable cells to place a module),
+    // from a starting point at the center.
+    int nCols = RoutingMatrix.m_Ncols;
+    std::vector<bool> inside( RoutingMatrix.m_Nrows * nCols, false );
+
+    inside[( RoutingMatrix.m_Nrows / 2 ) * nCols + nCols / 2] = true;
 
-    // find and mark all other availlable cells:
     for( int ii = 1; ii != 0; )
-        ii = propagate();
+        ii = propagate( inside );
+
+    // Only the cells outside are marked, so the tiles inside the board are not allocated
+    // until a module is placed on them.
+    for( int row = 0; row < RoutingMatrix.m_Nrows; row++ )
+    {
+        for( int col = 0; col < nCols; col++ )
+        {
+            if( !inside[row * nCols + col] )
+                RoutingMatrix.OrCell( row, col, BOTTOM, CELL_is_OUT );
+        }
+    }
 
     // Initialize top layer. to the same value as the bottom layer
-    if( RoutingMatrix.m_BoardSide[TOP] )
-        memcpy( RoutingMatrix.m_BoardSide[TOP], RoutingMatrix.m_BoardSide[BOTTOM],
-                nbCells * sizeof(MATRIX_CELL) );
+    if( RoutingMatrix.m_BoardSide[TOP].IsInitialized() )
+        RoutingMatrix.m_BoardSide[TOP].Copy( RoutingMatrix.m_BoardSide[BOTTOM] );
+
+    // Display memory usage (the tiles of the cells are allocated when written).
+    msg.Printf( wxT( "%d" ), RoutingMatrix.GetMemSize() / 1024 );
+    messagePanel->SetMessage( 24, wxT( "Mem(Kb)" ), msg, CYAN );
 
     return 1;
 }
@@ -797,7 +822,7 @@ int TstRectangle( BOARD* Pcb, const EDA_RECT& aRect, int side )
         {
             unsigned int data = RoutingMatrix.GetCell( row, col, side );
 
-            if( ( data & CELL_is_ZONE ) == 0 )
+            if( data & CELL_is_OUT )
                 return OUT_OF_BOARD;
 
             if( (data & CELL_is_MODULE) )
@@ -1161,10 +1186,22 @@ static MODULE* PickModule( PCB_EDIT_FRAME* pcbframe, wxDC* DC )
 }
 
 
+// State of a cell for propagate(): in the zone, or its obstacle bits
+#define CELL_ZONE 0x100
+
+static long cellState( const std::vector<bool>& aInside, int aRow, int aCol )
+{
+    if( aInside[aRow * RoutingMatrix.m_Ncols + aCol] )
+        return CELL_ZONE;
+
+    return RoutingMatrix.GetCell( aRow, aCol, BOTTOM ) & ( HOLE | CELL_is_EDGE );
+}
+
+
 /**
  * Function propagate
  * Used only in autoplace calculations
- * Uses the routing matrix to fill the cells within the zone
+ * Uses the routing matrix to fill aInside, the cells (row * m_Ncols + col) within the zone
  * Search and mark cells within the zone, and agree with DRC options.
  * Requirements:
  * Start from an initial point, to fill zone
@@ -1183,19 +1220,16 @@ static MODULE* PickModule( PCB_EDIT_FRAME* pcbframe, wxDC* DC )
  *
  *  This function can request some iterations
  *  Iterations are made until no cell is added to the zone.
- *  @return added cells count (i.e. which the attribute CELL_is_ZONE is set)
+ *  @return added cells count (i.e. which are set in aInside)
  */
-int propagate()
+int propagate( std::vector<bool>& aInside )
 {
     int     row, col;
     long    current_cell, old_cell_H;
     std::vector<long> pt_cell_V;
     int     nbpoints = 0;
 
-#define NO_CELL_ZONE (HOLE | CELL_is_EDGE | CELL_is_ZONE)
-
-    pt_cell_V.reserve( std::max( RoutingMatrix.m_Nrows, RoutingMatrix.m_Ncols ) );
-    fill( pt_cell_V.begin(), pt_cell_V.end(), 0 );
+    pt_cell_V.assign( std::max( RoutingMatrix.m_Nrows, RoutingMatrix.m_Ncols ), 0 );
 
     // Search from left to right and top to bottom.
     for( row = 0; row < RoutingMatrix.m_Nrows; row++ )
@@ -1204,14 +1238,14 @@ int propagate()
 
         for( col = 0; col < RoutingMatrix.m_Ncols; col++ )
         {
-            current_cell = RoutingMatrix.GetCell( row, col, BOTTOM ) & NO_CELL_ZONE;
+            current_cell = cellState( aInside, row, col );
 
             if( current_cell == 0 )    // a free cell is found
             {
-                if( (old_cell_H & CELL_is_ZONE) || (pt_cell_V[col] & CELL_is_ZONE) )
+                if( (old_cell_H & CELL_ZONE) || (pt_cell_V[col] & CELL_ZONE) )
                 {
-                    RoutingMatrix.OrCell( row, col, BOTTOM, CELL_is_ZONE );
-                    current_cell = CELL_is_ZONE;
+                    aInside[row * RoutingMatrix.m_Ncols + col] = true;
+                    current_cell = CELL_ZONE;
                     nbpoints++;
                 }
             }
@@ -1229,14 +1263,14 @@ int propagate()
 
         for( col = RoutingMatrix.m_Ncols - 1; col >= 0; col-- )
         {
-            current_cell = RoutingMatrix.GetCell( row, col, BOTTOM ) & NO_CELL_ZONE;
+            current_cell = cellState( aInside, row, col );
 
             if( current_cell == 0 )    // a free cell is found
             {
-                if( (old_cell_H & CELL_is_ZONE) || (pt_cell_V[col] & CELL_is_ZONE) )
+                if( (old_cell_H & CELL_ZONE) || (pt_cell_V[col] & CELL_ZONE) )
                 {
-                    RoutingMatrix.OrCell( row, col, BOTTOM, CELL_is_ZONE );
-                    current_cell = CELL_is_ZONE;
+                    aInside[row * RoutingMatrix.m_Ncols + col] = true;
+                    current_cell = CELL_ZONE;
                     nbpoints++;
                 }
             }
@@ -1254,14 +1288,14 @@ int propagate()
 
         for( row = RoutingMatrix.m_Nrows - 1; row >= 0; row-- )
         {
-            current_cell = RoutingMatrix.GetCell( row, col, BOTTOM ) & NO_CELL_ZONE;
+            current_cell = cellState( aInside, row, col );
 
             if( current_cell == 0 )    // a free cell is found
             {
-                if( (old_cell_H & CELL_is_ZONE) || (pt_cell_V[row] & CELL_is_ZONE) )
+                if( (old_cell_H & CELL_ZONE) || (pt_cell_V[row] & CELL_ZONE) )
                 {
-                    RoutingMatrix.OrCell( row, col, BOTTOM, CELL_is_ZONE );
-                    current_cell = CELL_is_ZONE;
+                    aInside[row * RoutingMatrix.m_Ncols + col] = true;
+                    current_cell = CELL_ZONE;
                     nbpoints++;
                 }
             }
@@ -1279,14 +1313,14 @@ int propagate()
 
         for( row = RoutingMatrix.m_Nrows - 1; row >= 0; row-- )
         {
-            current_cell = RoutingMatrix.GetCell( row, col, BOTTOM ) & NO_CELL_ZONE;
+            current_cell = cellState( aInside, row, col );
 
             if( current_cell == 0 )    // a free cell is found
             {
-                if( (old_cell_H & CELL_is_ZONE) || (pt_cell_V[row] & CELL_is_ZONE) )
+                if( (old_cell_H & CELL_ZONE) || (pt_cell_V[row] & CELL_ZONE) )
                 {
-                    RoutingMatrix.OrCell( row, col, BOTTOM, CELL_is_ZONE );
-                    current_cell = CELL_is_ZONE;
+                    aInside[row * RoutingMatrix.m_Ncols + col] = true;
+                    current_cell = CELL_ZONE;
                     nbpoints++;
                 }
             }
@@ -1297,3 +1331,213 @@ int propagate()
 
     return nbpoints;
 }
+
+
+static ANNEAL_PLACER::FOOTPRINT annealFootprint( MODULE* aModule, std::vector<double>& aAngles )
+{
+    ANNEAL_PLACER::FOOTPRINT fp;
+
+    fp.m_position = aModule->GetPosition();
+    fp.m_locked = aModule->IsLocked();
+    fp.m_sides = aModule->GetLayer() == B_Cu ? 2 : 1;
+
+    aAngles.clear();
+    aAngles.push_back( 0.0 );
+
+    if( aModule->GetPlacementCost90() != 0 )
+        aAngles.push_back( 900.0 );
+
+    if( aModule->GetPlacementCost180() != 0 )
+        aAngles.push_back( 1800.0 );
+
+    if( aModule->GetPlacementCost90() != 0 )
+        aAngles.push_back( 2700.0 );
+
+    EDA_RECT rect = aModule->GetFootprintRect();
+
+    rect.Move( -aModule->GetPosition() );
+
+    for( unsigned k = 0; k < aAngles.size(); k++ )
+    {
+        ANNEAL_PLACER::FOOTPRINT::SHAPE shape;
+        wxPoint a = rect.GetOrigin();
+        wxPoint b = rect.GetEnd();
+
+        RotatePoint( &a, aAngles[k] );
+        RotatePoint( &b, aAngles[k] );
+
+        shape.m_box = BOX2I( a, b - a );
+        shape.m_box.Normalize();
+
+        for( D_PAD* pad = aModule->Pads(); pad; pad = pad->Next() )
+        {
+            wxPoint pin = pad->GetPosition() - aModule->GetPosition();
+
+            RotatePoint( &pin, aAngles[k] );
+            shape.m_pins.push_back( pin );
+
+            // through hole footprints occupy both sides
+            if( pad->GetAttribute() == PAD_STANDARD || pad->GetAttribute() == PAD_HOLE_NOT_PLATED )
+                fp.m_sides = 3;
+        }
+
+        fp.m_shapes.push_back( shape );
+    }
+
+    return fp;
+}
+
+
+static bool abortPlacement( PCB_EDIT_FRAME* aFrame )
+{
+    wxYield();
+
+    if( !aFrame->GetCanvas()->GetAbortRequest() )
+        return false;
+
+    if( IsOK( aFrame, _( "Stop placement? The best placement found will be kept." ) ) )
+        return true;
+
+    aFrame->GetCanvas()->SetAbortRequest( false );
+    return false;
+}
+
+
+void PCB_EDIT_FRAME::AnnealPlaceModules( wxDC* DC )
+{
+    BOARD* pcb = GetBoard();
+
+    if( pcb->m_Modules == NULL )
+        return;
+
+    if( !IsOK( this, _( "Footprints NOT LOCKED will be moved" ) ) )
+        return;
+
+    // The cells outside the board outline, from the placement matrix: the outline
+    // bounding box alone lets the footprints leave a non rectangular board
+    LAYER_ID lay_tmp_BOTTOM = g_Route_Layer_BOTTOM;
+    LAYER_ID lay_tmp_TOP    = g_Route_Layer_TOP;
+
+    RoutingMatrix.m_GridRouting = (int) GetScreen()->GetGridSize().x;
+
+    if( RoutingMatrix.m_GridRouting < Millimeter2iu( 0.25 ) )
+        RoutingMatrix.m_GridRouting = Millimeter2iu( 0.25 );
+
+    if( genPlacementRoutingMatrix( pcb, m_messagePanel ) == 0 )
+        return;
+
+    m_canvas->SetAbortRequest( false );
+
+    ANNEAL_PLACER::PARAMS params;
+    const EDA_RECT& bbox = RoutingMatrix.m_BrdBox;
+
+    params.m_area = BOX2I( bbox.GetOrigin(), bbox.GetSize() );
+    params.m_cellSize = RoutingMatrix.m_GridRouting;
+    params.m_cellCols = RoutingMatrix.m_Ncols;
+    params.m_outside.resize( RoutingMatrix.m_Nrows * RoutingMatrix.m_Ncols );
+
+    for( int row = 0; row < RoutingMatrix.m_Nrows; row++ )
+    {
+        for( int col = 0; col < RoutingMatrix.m_Ncols; col++ )
+        {
+            params.m_outside[row * RoutingMatrix.m_Ncols + col] =
+                    ( RoutingMatrix.GetCell( row, col, BOTTOM ) & CELL_is_OUT ) != 0;
+        }
+    }
+
+    RoutingMatrix.UnInitRoutingMatrix();
+    g_Route_Layer_TOP    = lay_tmp_TOP;
+    g_Route_Layer_BOTTOM = lay_tmp_BOTTOM;
+
+    params.m_grid = std::max( 1, (int) GetScreen()->GetGridSize().x );
+    params.m_clearance = pcb->GetDesignSettings().GetDefault()->GetClearance();
+
+    ANNEAL_PLACER placer( params );
+
+    std::vector<MODULE*> modules;
+    std::vector< std::vector<double> > angles;
+    std::map<int, ANNEAL_PLACER::NET> nets;
+
+    for( MODULE* module = pcb->m_Modules; module; module = module->Next() )
+    {
+        angles.push_back( std::vector<double>() );
+
+        int index = placer.AddFootprint( annealFootprint( module, angles.back() ) );
+        int pin = 0;
+
+        modules.push_back( module );
+
+        for( D_PAD* pad = module->Pads(); pad; pad = pad->Next(), pin++ )
+        {
+            if( pad->GetNetCode() > 0 )
+                nets[pad->GetNetCode()].push_back( ANNEAL_PLACER::PIN( index, pin ) );
+        }
+    }
+
+    for( std::map<int, ANNEAL_PLACER::NET>::iterator it = nets.begin(); it != nets.end(); ++it )
+        placer.AddNet( it->second );
+
+    placer.SetAbortHook( boost::bind( abortPlacement, this ) );
+
+    SetStatusText( _( "Optimizing placement" ) );
+
+    {
+        wxBusyCursor dummy;
+
+        placer.Run();
+    }
+
+    // Undo command: prepare list
+    PICKED_ITEMS_LIST   newList;
+    ITEM_PICKER         picker( NULL, UR_CHANGED );
+
+    newList.m_Status = UR_CHANGED;
+
+    for( unsigned i = 0; i < modules.size(); i++ )
+    {
+        const ANNEAL_PLACER::FOOTPRINT& fp = placer.Footprint( i );
+
+        if( fp.m_locked || ( fp.m_orientation == 0 && fp.m_position == modules[i]->GetPosition() ) )
+            continue;
+
+        picker.SetItem( modules[i] );
+        newList.PushItem( picker );
+    }
+
+    if( newList.GetCount() )
+        SaveCopyInUndoList( newList, UR_CHANGED );
+
+    for( unsigned i = 0; i < modules.size(); i++ )
+    {
+        const ANNEAL_PLACER::FOOTPRINT& fp = placer.Footprint( i );
+        MODULE* module = modules[i];
+
+        if( fp.m_locked )
+            continue;
+
+        if( fp.m_orientation != 0 )
+            module->SetOrientation( module->GetOrientation() + angles[i][fp.m_orientation] );
+
+        module->SetPosition( wxPoint( fp.m_position.x, fp.m_position.y ) );
+        module->CalculateBoundingBox();
+    }
+
+    const ANNEAL_PLACER::STATS& stats = placer.Stats();
+    wxString msg;
+
+    m_messagePanel->EraseMsgBox();
+    msg.Printf( wxT( "%d" ), newList.GetCount() );
+    AppendMsgPanel( _( "Moved" ), msg, GREEN );
+    msg = LengthDoubleToString( stats.m_wireLength ) + wxT( " " ) + GetAbbreviatedUnitsLabel();
+    AppendMsgPanel( _( "Ratsnest length" ), msg, CYAN );
+    msg.Printf( wxT( "%.1f%%" ), 100.0 * stats.m_finalCost / std::max( 1.0, stats.m_initialCost ) );
+    AppendMsgPanel( _( "Cost" ), msg, BROWN );
+    msg.Printf( wxT( "%d" ), stats.m_chains );
+    AppendMsgPanel( _( "Chains" ), msg, BROWN );
+    msg.Printf( wxT( "%.0f ms" ), stats.m_msecs );
+    AppendMsgPanel( _( "Time" ), msg, BROWN );
+
+    pcb->m_Status_Pcb = 0;
+    m_canvas->Refresh();
+    OnModify();
+}
@@ -169,33 +169,19 @@ void PCB_EDIT_FRAME::Autoroute( wxDC* DC, int mode )
 
     m_messagePanel->EraseMsgBox();
 
-    /* Map the board */
     RoutingMatrix.m_RoutingLayersCount = 1;
 
     if( g_Route_Layer_TOP != g_Route_Layer_BOTTOM )
         RoutingMatrix.m_RoutingLayersCount = 2;
 
-    if( RoutingMatrix.InitRoutingMatrix() < 0 )
-    {
-        wxMessageBox( _( "No memory for autorouting" ) );
-        RoutingMatrix.UnInitRoutingMatrix();  /* Free memory. */
-        return;
-    }
-
-    SetStatusText( _( "Place Cells" ) );
-    PlaceCells( GetBoard(), -1, FORCE_PADS );
-
-    /* Construction of the track list for router. */
+    /* Construction of the track list for router. The board is mapped by Solve(),
+     * the routing matrix itself is not used. */
     RoutingMatrix.m_RouteCount = Build_Work( GetBoard() );
 
-    // DisplayRoutingMatrix( m_canvas, DC );
-
     Solve( DC, RoutingMatrix.m_RoutingLayersCount );
 
     /* Free memory. */
-    FreeQueue();
     InitWork();             /* Free memory for the list of router connections. */
-    RoutingMatrix.UnInitRoutingMatrix();
     stop = time( NULL ) - start;
     msg.Printf( wxT( "time = %d second%s" ), stop, ( stop == 1 ) ? wxT( "" ) : wxT( "s" ) );
     SetStatusText( msg );
@@ -217,61 +203,3 @@ void PCB_EDIT_FRAME::Reset_Noroutable( wxDC* DC )
     }
 }
 
-
-/* DEBUG Function: displays the routing matrix */
-void DisplayRoutingMatrix( EDA_DRAW_PANEL* panel, wxDC* DC )
-{
-    int dcell0;
-    EDA_COLOR_T color;
-
-    int maxi = 600 / RoutingMatrix.m_Ncols;
-    maxi = ( maxi * 3 ) / 4;
-
-    if( !maxi )
-        maxi = 1;
-
-    GRSetDrawMode( DC, GR_COPY );
-
-    for( int col = 0; col < RoutingMatrix.m_Ncols; col++ )
-    {
-        for( int row = 0; row < RoutingMatrix.m_Nrows; row++ )
-        {
-            color  = BLACK;
-            dcell0 = RoutingMatrix.GetCell( row, col, BOTTOM );
-
-            if( dcell0 & HOLE )
-                color = GREEN;
-
-#if 0
-            int dcell1 = 0;
-
-            if( RoutingMatrix.m_RoutingLayersCount )
-                dcell1 = GetCell( row, col, TOP );
-
-            if( dcell1 & HOLE )
-                color = RED;
-
-            dcell0 |= dcell1;
-#endif
-            if( !color && ( dcell0 & VIA_IMPOSSIBLE ) )
-                color = BLUE;
-
-            if( dcell0 & CELL_is_EDGE )
-                color = YELLOW;
-            else if( dcell0 & CELL_is_ZONE )
-                color = YELLOW;
-
-            #define DRAW_OFFSET_X -20
-            #define DRAW_OFFSET_Y 20
-//            if( color )
-            {
-                for( int i = 0; i < maxi; i++ )
-                    for( int j = 0; j < maxi; j++ )
-                        GRPutPixel( panel->GetClipBox(), DC,
-                                    ( col * maxi ) + i + DRAW_OFFSET_X,
-                                    ( row * maxi ) + j + DRAW_OFFSET_Y, color );
-
-            }
-        }
-    }
-}
@@ -33,6 +33,9 @@
 #define AUTOROUT_H
 
 
+#include <algorithm>
+#include <vector>
+
 #include <base_struct.h>
 #include <layers_id_colors_and_visibility.h>
 
@@ -65,19 +68,157 @@ enum AUTOPLACEROUTE_OPTIONS
 
 #define FORCE_PADS 1  /* Force placement of pads for any Netcode */
 
-/* search statistics */
-extern int OpenNodes;   /* total number of nodes opened */
-extern int ClosNodes;   /* total number of nodes closed */
-extern int MoveNodes;   /* total number of nodes moved */
-extern int MaxNodes;    /* maximum number of nodes opened at one time */
-
-
 /* Structures useful to the generation of board as bitmap. */
 typedef unsigned char MATRIX_CELL;
 typedef int  DIST_CELL;
 typedef char DIR_CELL;
 
 
+/**
+ * class MATRIX_PLANE
+ * stores the cells of one side of the routing matrix in square tiles, allocated on the
+ * first write of a non zero value. The tiles never written share a single empty tile,
+ * so only the parts of the board actually used (usually the pads and the keep out areas
+ * around footprints) take memory, and fine grids can be used on large boards.
+ */
+template <class CELL>
+class MATRIX_PLANE
+{
+public:
+    ///> Tiles are ( 1 << TILE_SHIFT ) cells square
+    static const int TILE_SHIFT = 6;
+    static const int TILE_MASK = ( 1 << TILE_SHIFT ) - 1;
+    static const int TILE_CELLS = 1 << ( 2 * TILE_SHIFT );
+
+    MATRIX_PLANE() :
+        m_tileCols( 0 ),
+        m_allocated( 0 )
+    {}
+
+    ~MATRIX_PLANE()
+    {
+        Clear();
+    }
+
+    /**
+     * Function Init
+     * sizes the plane to aRows x aCols cells, all of them set to 0
+     */
+    void Init( int aRows, int aCols )
+    {
+        Clear();
+
+        m_tileCols = ( aCols + TILE_MASK ) >> TILE_SHIFT;
+        m_empty.assign( TILE_CELLS, CELL( 0 ) );
+        m_tiles.assign( ( ( aRows + TILE_MASK ) >> TILE_SHIFT ) * m_tileCols, &m_empty[0] );
+    }
+
+    ///> Frees all the tiles
+    void Clear()
+    {
+        for( unsigned i = 0; i < m_tiles.size(); i++ )
+        {
+            if( m_tiles[i] != &m_empty[0] )
+                delete[] m_tiles[i];
+        }
+
+        m_tiles.clear();
+        m_empty.clear();
+        m_tileCols = 0;
+        m_allocated = 0;
+    }
+
+    bool IsInitialized() const
+    {
+        return !m_tiles.empty();
+    }
+
+    CELL Get( int aRow, int aCol ) const
+    {
+        return tile( aRow, aCol )[offset( aRow, aCol )];
+    }
+
+    void Set( int aRow, int aCol, CELL aValue )
+    {
+        CELL*& t = tile( aRow, aCol );
+
+        if( t == &m_empty[0] )
+        {
+            // Writing 0 in an empty tile changes nothing
+            if( aValue == CELL( 0 ) )
+                return;
+
+            t = new CELL[TILE_CELLS];
+            std::copy( m_empty.begin(), m_empty.end(), t );
+            m_allocated++;
+        }
+
+        t[offset( aRow, aCol )] = aValue;
+    }
+
+    ///> Makes this plane a copy of aOther, which must have the same size
+    void Copy( const MATRIX_PLANE& aOther )
+    {
+        for( unsigned i = 0; i < m_tiles.size(); i++ )
+        {
+            const CELL* src = aOther.m_tiles[i];
+
+            if( src == &aOther.m_empty[0] )
+            {
+                if( m_tiles[i] != &m_empty[0] )
+                {
+                    delete[] m_tiles[i];
+                    m_tiles[i] = &m_empty[0];
+                    m_allocated--;
+                }
+            }
+            else
+            {
+                if( m_tiles[i] == &m_empty[0] )
+                {
+                    m_tiles[i] = new CELL[TILE_CELLS];
+                    m_allocated++;
+                }
+
+                std::copy( src, src + TILE_CELLS, m_tiles[i] );
+            }
+        }
+    }
+
+    ///> Returns the memory used by the plane, in bytes
+    int MemSize() const
+    {
+        return ( m_allocated + 1 ) * TILE_CELLS * sizeof( CELL ) +
+               m_tiles.size() * sizeof( CELL* );
+    }
+
+private:
+    // Not copyable: the tiles are owned
+    MATRIX_PLANE( const MATRIX_PLANE& );
+    MATRIX_PLANE& operator=( const MATRIX_PLANE& );
+
+    CELL* const& tile( int aRow, int aCol ) const
+    {
+        return m_tiles[( aRow >> TILE_SHIFT ) * m_tileCols + ( aCol >> TILE_SHIFT )];
+    }
+
+    CELL*& tile( int aRow, int aCol )
+    {
+        return m_tiles[( aRow >> TILE_SHIFT ) * m_tileCols + ( aCol >> TILE_SHIFT )];
+    }
+
+    static int offset( int aRow, int aCol )
+    {
+        return ( ( aRow & TILE_MASK ) << TILE_SHIFT ) + ( aCol & TILE_MASK );
+    }
+
+    std::vector<CELL*>  m_tiles;        // the tiles, row by row, or &m_empty[0]
+    std::vector<CELL>   m_empty;        // the shared empty tile
+    int                 m_tileCols;     // number of tiles in a row
+    int                 m_allocated;    // number of allocated tiles
+};
+
+
 /**
  * class MATRIX_ROUTING_HEAD
  * handle the matrix routing that describes the actual board
@@ -85,17 +226,17 @@ typedef char DIR_CELL;
 class MATRIX_ROUTING_HEAD
 {
 public:
-    MATRIX_CELL* m_BoardSide[MAX_ROUTING_LAYERS_COUNT]; // the image map of 2 board sides
-    DIST_CELL*   m_DistSide[MAX_ROUTING_LAYERS_COUNT];  // the image map of 2 board sides:
-                                                        // distance to cells
-    DIR_CELL*    m_DirSide[MAX_ROUTING_LAYERS_COUNT];   // the image map of 2 board sides:
-                                                        // pointers back to source
+    // the image map of 2 board sides
+    MATRIX_PLANE<MATRIX_CELL> m_BoardSide[MAX_ROUTING_LAYERS_COUNT];
+    // the image map of 2 board sides: distance to cells
+    MATRIX_PLANE<DIST_CELL>   m_DistSide[MAX_ROUTING_LAYERS_COUNT];
+    // the image map of 2 board sides: pointers back to source
+    MATRIX_PLANE<DIR_CELL>    m_DirSide[MAX_ROUTING_LAYERS_COUNT];
     bool         m_InitMatrixDone;
     int          m_RoutingLayersCount;          // Number of layers for autorouting (0 or 1)
     int          m_GridRouting;                 // Size of grid for autoplace/autoroute
     EDA_RECT     m_BrdBox;                      // Actual board bounding box
     int          m_Nrows, m_Ncols;              // Matrix size
-    int          m_MemSize;                     // Memory requirement, just for statistics
     int          m_RouteCount;                  // Number of routes
 
 private:
@@ -134,7 +275,8 @@ public:
 
     /**
      * Function InitBoard
-     * initializes the data structures.
+     * initializes the data structures. The cells are allocated by tiles when they
+     * are written, see MATRIX_PLANE.
      *
      * @return the amount of memory used or -1 if default.
      */
@@ -142,6 +284,12 @@ public:
 
     void UnInitRoutingMatrix();
 
+    /**
+     * Function GetMemSize
+     * @return the memory currently used by the matrix, in bytes
+     */
+    int GetMemSize() const;
+
     // Initialize WriteCell to make the aLogicOp
     void SetCellOperation( int aLogicOp );
 
@@ -214,13 +362,6 @@ void TraceFilledRectangle( int ux0, int uy0, int ux1, int uy1,
                            double angle, LSET masque_layer,
                            int color, int op_logic );
 
-/* QUEUE.CPP */
-void FreeQueue();
-void InitQueue();
-void GetQueue( int *, int *, int *, int *, int * );
-bool  SetQueue( int, int, int, int, int, int, int );
-void ReSetQueue( int, int, int, int, int, int, int );
-
 /* WORK.CPP */
 void InitWork();
 void ReInitWork();
@@ -41,7 +41,7 @@
 #define CELL_is_MODULE 0x02  /* auto placement occupied by a module */
 #define CELL_is_EDGE   0x20  /* Area and auto-placement: limiting cell contour (Board, Zone) */
 #define CELL_is_FRIEND 0x40  /* Area and auto-placement: cell part of the net */
-#define CELL_is_ZONE   0x80  /* Area and auto-placement: cell available */
+#define CELL_is_OUT    0x80  /* Auto-placement: cell outside the board outline */
 
 /* Bit masks for presence of obstacles to autorouting */
 #define OCCUPE            1  /* Autorouting: obstacle tracks and vias. */
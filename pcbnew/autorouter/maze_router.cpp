@@ -0,0 +1,854 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file maze_router.cpp
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <queue>
+
+#include <boost/bind.hpp>
+
+#include <geometry/seg.h>
+#include <profile.h>
+#include <thread_pool.h>
+
+#include <maze_router.h>
+
+
+// The 8 directions, counterclockwise from east (rows go down)
+static const int dirRow[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+static const int dirCol[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+
+// Values of the "from" entries: how the search reached a state
+enum FROM_VALUE
+{
+    FROM_NONE   = 0,        // not reached yet
+    FROM_STEP   = 1,        // 1 + direction slot of the state the step came from
+    FROM_VIA    = 16,       // 16 + direction slot + 9 * layer of the state the via came from
+    FROM_SOURCE = 0xffff
+};
+
+
+MAZE_ROUTER::OBSTACLE MAZE_ROUTER::OBSTACLE::Segment( const VECTOR2I& aA, const VECTOR2I& aB,
+                                                      int aRadius, uint32_t aLayers,
+                                                      bool aBlocksVias, int aNet )
+{
+    OBSTACLE o;
+
+    o.m_shape = SEGMENT;
+    o.m_a = aA;
+    o.m_b = aB;
+    o.m_radius = aRadius;
+    o.m_layers = aLayers;
+    o.m_blocksVias = aBlocksVias;
+    o.m_net = aNet;
+    o.m_bbox = BOX2I( aA, aB - aA );
+    o.m_bbox.Normalize();
+    o.m_bbox.Inflate( aRadius );
+
+    return o;
+}
+
+
+MAZE_ROUTER::OBSTACLE MAZE_ROUTER::OBSTACLE::Rect( const VECTOR2I& aCenter,
+                                                   const VECTOR2I& aHalfSize, double aAngle,
+                                                   uint32_t aLayers, bool aBlocksVias, int aNet )
+{
+    OBSTACLE o;
+    double angle = aAngle * M_PI / 1800.0;
+
+    o.m_shape = RECT;
+    o.m_a = aCenter;
+    o.m_b = aHalfSize;
+    o.m_cos = cos( angle );
+    o.m_sin = sin( angle );
+    o.m_layers = aLayers;
+    o.m_blocksVias = aBlocksVias;
+    o.m_net = aNet;
+
+    int dx = (int) ceil( aHalfSize.x * fabs( o.m_cos ) + aHalfSize.y * fabs( o.m_sin ) );
+    int dy = (int) ceil( aHalfSize.x * fabs( o.m_sin ) + aHalfSize.y * fabs( o.m_cos ) );
+
+    o.m_bbox = BOX2I( aCenter - VECTOR2I( dx, dy ), VECTOR2I( 2 * dx, 2 * dy ) );
+
+    return o;
+}
+
+
+bool MAZE_ROUTER::OBSTACLE::IsNear( const VECTOR2I& aP, int aMargin ) const
+{
+    if( m_shape == SEGMENT )
+    {
+        VECTOR2I::extended_type d = (VECTOR2I::extended_type) aMargin + m_radius;
+
+        return SEG( m_a, m_b ).SquaredDistance( aP ) < d * d;
+    }
+
+    // Rotate the point in the frame of the rectangle, the same way as RotatePoint()
+    // with the opposite angle
+    double x = aP.x - m_a.x;
+    double y = aP.y - m_a.y;
+    double lx = fabs( x * m_cos - y * m_sin ) - m_b.x;
+    double ly = fabs( x * m_sin + y * m_cos ) - m_b.y;
+
+    lx = std::max( lx, 0.0 );
+    ly = std::max( ly, 0.0 );
+
+    return lx * lx + ly * ly < (double) aMargin * aMargin;
+}
+
+
+bool MAZE_ROUTER::WINDOW::Overlaps( const WINDOW& aOther, int aMargin ) const
+{
+    return m_row0 - aMargin < aOther.m_row0 + aOther.m_rows &&
+           aOther.m_row0 < m_row0 + m_rows + aMargin &&
+           m_col0 - aMargin < aOther.m_col0 + aOther.m_cols &&
+           aOther.m_col0 < m_col0 + m_cols + aMargin;
+}
+
+
+/**
+ * Class SEARCH
+ * is the search of a connection in a window: the obstacles of the window rasterized in
+ * bit planes, and the A* state.
+ */
+class MAZE_ROUTER::SEARCH
+{
+public:
+    SEARCH( const MAZE_ROUTER& aRouter, const CONNECTION& aConnection, const WINDOW& aWindow );
+
+    bool Run( ROUTE& aRoute );
+
+private:
+    ///> An entry of the open list
+    struct NODE
+    {
+        int m_f, m_g, m_index;
+
+        bool operator<( const NODE& aOther ) const
+        {
+            // std::priority_queue returns the largest element: lowest cost first,
+            // then the deepest node
+            if( m_f != aOther.m_f )
+                return m_f > aOther.m_f;
+
+            return m_g < aOther.m_g;
+        }
+    };
+
+    // A search state is a cell and the direction of the step which reached it, so the
+    // turn costs are exact. The source and the cells reached by a via have no direction.
+    static const int DirSlots = 9;
+    static const int NoDir = 8;
+
+    ///> Cost and origin of a reached state
+    struct STATE
+    {
+        STATE() : m_cost( INT_MAX ), m_from( FROM_NONE ) {}
+
+        int         m_cost;
+        uint16_t    m_from;
+    };
+
+    // The states are stored by pages of PageSize x PageSize cells of a layer, allocated
+    // when first reached: a search on the whole grid seldom explores more than a fraction
+    // of its layers * rows * cols * DirSlots states
+    static const int PageBits = 5;
+    static const int PageSize = 1 << PageBits;
+    static const int PageMask = PageSize - 1;
+
+    void rasterize();
+
+    ///> Returns the page of state aIndex in aPage, and its offset in the page
+    int stateOffset( int aIndex, int& aPage ) const
+    {
+        int cell = aIndex / DirSlots;
+        int col = cell % m_cols;
+        int row = ( cell / m_cols ) % m_rows;
+        int layer = cell / ( m_cols * m_rows );
+
+        aPage = ( layer * m_pageRows + ( row >> PageBits ) ) * m_pageCols + ( col >> PageBits );
+
+        return ( ( ( row & PageMask ) << PageBits ) + ( col & PageMask ) ) * DirSlots +
+               aIndex % DirSlots;
+    }
+
+    ///> Returns state aIndex, allocating its page if needed
+    STATE& state( int aIndex )
+    {
+        int page;
+        int offset = stateOffset( aIndex, page );
+
+        if( m_pages[page].empty() )
+            m_pages[page].resize( PageSize * PageSize * DirSlots );
+
+        return m_pages[page][offset];
+    }
+
+    ///> Returns state aIndex, which must have been reached
+    const STATE& reached( int aIndex ) const
+    {
+        int page;
+        int offset = stateOffset( aIndex, page );
+
+        return m_pages[page][offset];
+    }
+
+    int index( int aLayer, int aRow, int aCol, int aDir ) const
+    {
+        return ( ( aLayer * m_rows + aRow ) * m_cols + aCol ) * DirSlots + aDir;
+    }
+
+    // Bit planes 0 .. layerCount - 1 hold the cells blocked for tracks on each layer,
+    // plane layerCount the cells blocked for vias
+    bool isSet( int aPlane, int aRow, int aCol ) const
+    {
+        return m_planes[( aPlane * m_rows + aRow ) * m_words + ( aCol >> 5 )] & ( 1u << ( aCol & 31 ) );
+    }
+
+    void set( int aPlane, int aRow, int aCol )
+    {
+        m_planes[( aPlane * m_rows + aRow ) * m_words + ( aCol >> 5 )] |= 1u << ( aCol & 31 );
+    }
+
+    bool isEnd( int aRow, int aCol ) const
+    {
+        return ( aRow == m_sourceRow && aCol == m_sourceCol ) ||
+               ( aRow == m_targetRow && aCol == m_targetCol );
+    }
+
+    bool blocked( int aLayer, int aRow, int aCol ) const
+    {
+        return isSet( aLayer, aRow, aCol ) && !isEnd( aRow, aCol );
+    }
+
+    int heuristic( int aLayer, int aRow, int aCol ) const;
+
+    void push( int aIndex, int aG, int aFrom, int aLayer, int aRow, int aCol );
+
+    VECTOR2I position( int aRow, int aCol ) const
+    {
+        const PARAMS& p = m_router.m_params;
+
+        return p.m_origin + VECTOR2I( ( m_window.m_col0 + aCol ) * p.m_gridSize,
+                                      ( m_window.m_row0 + aRow ) * p.m_gridSize );
+    }
+
+    void buildRoute( int aTarget, ROUTE& aRoute ) const;
+
+    const MAZE_ROUTER&          m_router;
+    const CONNECTION&           m_connection;
+    WINDOW                      m_window;
+    int                         m_rows, m_cols, m_layers, m_words;
+    int                         m_sourceRow, m_sourceCol, m_targetRow, m_targetCol;
+
+    std::vector<uint32_t>       m_planes;
+    int                         m_pageRows, m_pageCols;
+    std::vector< std::vector<STATE> > m_pages;
+    std::priority_queue<NODE>   m_open;
+};
+
+
+MAZE_ROUTER::SEARCH::SEARCH( const MAZE_ROUTER& aRouter, const CONNECTION& aConnection,
+                             const WINDOW& aWindow ) :
+    m_router( aRouter ),
+    m_connection( aConnection ),
+    m_window( aWindow )
+{
+    m_rows = aWindow.m_rows;
+    m_cols = aWindow.m_cols;
+    m_layers = aRouter.m_params.m_layerCount;
+    m_words = ( m_cols + 31 ) / 32;
+    m_pageRows = ( m_rows + PageMask ) >> PageBits;
+    m_pageCols = ( m_cols + PageMask ) >> PageBits;
+
+    m_sourceRow = aConnection.m_sourceRow - aWindow.m_row0;
+    m_sourceCol = aConnection.m_sourceCol - aWindow.m_col0;
+    m_targetRow = aConnection.m_targetRow - aWindow.m_row0;
+    m_targetCol = aConnection.m_targetCol - aWindow.m_col0;
+}
+
+
+void MAZE_ROUTER::SEARCH::rasterize()
+{
+    const PARAMS& p = m_router.m_params;
+    const int trackMargin = p.m_clearance + p.m_trackWidth / 2;
+    const int viaMargin = p.m_clearance + p.m_viaDiameter / 2;
+    const int margin = std::max( trackMargin, viaMargin );
+    const uint32_t layerMask = p.m_layerCount >= 32 ? ~0u : ( 1u << p.m_layerCount ) - 1;
+
+    m_planes.assign( ( m_layers + 1 ) * m_rows * m_words, 0 );
+
+    BOX2I area( position( 0, 0 ), position( m_rows - 1, m_cols - 1 ) - position( 0, 0 ) );
+    area.Inflate( margin );
+
+    // The obstacles of the bins covering the window, each one once and in order
+    std::vector<int> candidates;
+    int binRow0, binCol0, binRow1, binCol1;
+
+    m_router.binRange( area, binRow0, binCol0, binRow1, binCol1 );
+
+    for( int row = binRow0; row <= binRow1; row++ )
+    {
+        for( int col = binCol0; col <= binCol1; col++ )
+        {
+            const std::vector<int>& bin = m_router.m_bins[row * m_router.m_binCols + col];
+
+            candidates.insert( candidates.end(), bin.begin(), bin.end() );
+        }
+    }
+
+    std::sort( candidates.begin(), candidates.end() );
+    candidates.erase( std::unique( candidates.begin(), candidates.end() ), candidates.end() );
+
+    for( unsigned i = 0; i < candidates.size(); i++ )
+    {
+        const OBSTACLE& o = m_router.m_obstacles[candidates[i]];
+        uint32_t layers = o.m_layers & layerMask;
+
+        // The items of the routed net are not obstacles, except the unconnected ones
+        if( o.m_net == m_connection.m_net && o.m_net > 0 )
+            continue;
+
+        if( !layers && !o.m_blocksVias )
+            continue;
+
+        if( !area.Intersects( o.m_bbox ) )
+            continue;
+
+        // cells whose center is within margin of the bounding box
+        BOX2I box( o.m_bbox );
+        box.Inflate( margin );
+
+        VECTOR2I lo = box.GetOrigin() - position( 0, 0 );
+        VECTOR2I hi = box.GetEnd() - position( 0, 0 );
+
+        int col0 = std::max( 0, (int) ceil( (double) lo.x / p.m_gridSize ) );
+        int row0 = std::max( 0, (int) ceil( (double) lo.y / p.m_gridSize ) );
+        int col1 = std::min( m_cols - 1, (int) floor( (double) hi.x / p.m_gridSize ) );
+        int row1 = std::min( m_rows - 1, (int) floor( (double) hi.y / p.m_gridSize ) );
+
+        for( int row = row0; row <= row1; row++ )
+        {
+            for( int col = col0; col <= col1; col++ )
+            {
+                VECTOR2I pos = position( row, col );
+
+                if( layers && o.IsNear( pos, trackMargin ) )
+                {
+                    for( int layer = 0; layer < m_layers; layer++ )
+                    {
+                        if( layers & ( 1u << layer ) )
+                            set( layer, row, col );
+                    }
+                }
+
+                if( o.m_blocksVias && !isSet( m_layers, row, col ) && o.IsNear( pos, viaMargin ) )
+                    set( m_layers, row, col );
+            }
+        }
+    }
+}
+
+
+int MAZE_ROUTER::SEARCH::heuristic( int aLayer, int aRow, int aCol ) const
+{
+    // Octile distance, and a via if the target can't be reached on this layer: never more
+    // than the actual cost, so the first route found is the cheapest one
+    int dr = std::abs( aRow - m_targetRow );
+    int dc = std::abs( aCol - m_targetCol );
+    int h = StepCost * std::max( dr, dc ) + ( 14 - StepCost ) * std::min( dr, dc );
+
+    if( !( m_connection.m_targetLayers & ( 1u << aLayer ) ) )
+        h += m_router.m_params.m_viaCost;
+
+    return h;
+}
+
+
+void MAZE_ROUTER::SEARCH::push( int aIndex, int aG, int aFrom, int aLayer, int aRow, int aCol )
+{
+    STATE& s = state( aIndex );
+
+    if( aG >= s.m_cost )
+        return;
+
+    s.m_cost = aG;
+    s.m_from = aFrom;
+
+    NODE node;
+    node.m_g = aG;
+    node.m_f = aG + heuristic( aLayer, aRow, aCol );
+    node.m_index = aIndex;
+
+    m_open.push( node );
+}
+
+
+bool MAZE_ROUTER::SEARCH::Run( ROUTE& aRoute )
+{
+    const PARAMS& p = m_router.m_params;
+
+    rasterize();
+
+    m_pages.clear();
+    m_pages.resize( m_layers * m_pageRows * m_pageCols );
+
+    for( int layer = 0; layer < m_layers; layer++ )
+    {
+        if( m_connection.m_sourceLayers & ( 1u << layer ) )
+            push( index( layer, m_sourceRow, m_sourceCol, NoDir ), 0, FROM_SOURCE,
+                  layer, m_sourceRow, m_sourceCol );
+    }
+
+    while( !m_open.empty() )
+    {
+        NODE node = m_open.top();
+        m_open.pop();
+
+        // stale entry: the cell was reached again with a lower cost
+        if( node.m_g > reached( node.m_index ).m_cost )
+            continue;
+
+        aRoute.m_expanded++;
+
+        int dirSlot = node.m_index % DirSlots;
+        int cell = node.m_index / DirSlots;
+        int col = cell % m_cols;
+        int row = ( cell / m_cols ) % m_rows;
+        int layer = cell / ( m_cols * m_rows );
+
+        if( row == m_targetRow && col == m_targetCol &&
+            ( m_connection.m_targetLayers & ( 1u << layer ) ) )
+        {
+            buildRoute( node.m_index, aRoute );
+            aRoute.m_routed = true;
+            return true;
+        }
+
+        for( int dir = 0; dir < 8; dir++ )
+        {
+            int nr = row + dirRow[dir];
+            int nc = col + dirCol[dir];
+
+            if( nr < 0 || nr >= m_rows || nc < 0 || nc >= m_cols )
+                continue;
+
+            if( blocked( layer, nr, nc ) )
+                continue;
+
+            bool diagonal = dir & 1;
+
+            // a diagonal step must not cut the corner of an obstacle
+            if( diagonal && ( blocked( layer, row, nc ) || blocked( layer, nr, col ) ) )
+                continue;
+
+            int cost = node.m_g + ( diagonal ? 14 : StepCost );
+
+            if( dirSlot != NoDir )
+            {
+                int turn = std::abs( dir - dirSlot );
+
+                cost += std::min( turn, 8 - turn ) * p.m_turnCost;
+            }
+
+            push( index( layer, nr, nc, dir ), cost, FROM_STEP + dirSlot, layer, nr, nc );
+        }
+
+        // Through via: not twice in a row, not in the pads of the connection
+        if( m_layers > 1 && dirSlot != NoDir &&
+            !isEnd( row, col ) && !isSet( m_layers, row, col ) )
+        {
+            bool free = true;
+
+            for( int l = 0; l < m_layers && free; l++ )
+                free = !isSet( l, row, col );
+
+            for( int l = 0; l < m_layers && free; l++ )
+            {
+                if( l != layer )
+                    push( index( l, row, col, NoDir ), node.m_g + p.m_viaCost,
+                          FROM_VIA + layer * DirSlots + dirSlot, l, row, col );
+            }
+        }
+    }
+
+    return false;
+}
+
+
+void MAZE_ROUTER::SEARCH::buildRoute( int aTarget, ROUTE& aRoute ) const
+{
+    // Walk back from the target to the source, keeping the cells of the states
+    std::vector<int> path;
+
+    for( int idx = aTarget; ; )
+    {
+        int cell = idx / DirSlots;
+        int dir = idx % DirSlots;
+        int from = reached( idx ).m_from;
+        int col = cell % m_cols;
+        int row = ( cell / m_cols ) % m_rows;
+        int layer = cell / ( m_cols * m_rows );
+
+        path.push_back( cell );
+
+        if( from == FROM_SOURCE )
+            break;
+        else if( from >= FROM_VIA )
+        {
+            int prev = from - FROM_VIA;
+
+            idx = index( prev / DirSlots, row, col, prev % DirSlots );
+        }
+        else
+            idx = index( layer, row - dirRow[dir], col - dirCol[dir], from - FROM_STEP );
+    }
+
+    std::reverse( path.begin(), path.end() );
+
+    // Merge the steps in the same direction into segments
+    int layer = path[0] / ( m_cols * m_rows );
+    VECTOR2I prev = position( ( path[0] / m_cols ) % m_rows, path[0] % m_cols );
+    VECTOR2I runStart = prev;
+    VECTOR2I runDir;
+    ROUTE::SEGMENT seg;
+
+    if( m_connection.m_sourcePos != prev )
+    {
+        seg.m_a = m_connection.m_sourcePos;
+        seg.m_b = prev;
+        seg.m_layer = layer;
+        aRoute.m_segments.push_back( seg );
+    }
+
+    for( unsigned i = 1; i < path.size(); i++ )
+    {
+        int l = path[i] / ( m_cols * m_rows );
+        VECTOR2I pos = position( ( path[i] / m_cols ) % m_rows, path[i] % m_cols );
+
+        if( l != layer )
+        {
+            if( runStart != prev )
+            {
+                seg.m_a = runStart;
+                seg.m_b = prev;
+                seg.m_layer = layer;
+                aRoute.m_segments.push_back( seg );
+            }
+
+            aRoute.m_vias.push_back( pos );
+            layer = l;
+            runStart = pos;
+            runDir = VECTOR2I( 0, 0 );
+            continue;
+        }
+
+        VECTOR2I dir = pos - prev;
+
+        if( runDir != VECTOR2I( 0, 0 ) && dir != runDir )
+        {
+            seg.m_a = runStart;
+            seg.m_b = prev;
+            seg.m_layer = layer;
+            aRoute.m_segments.push_back( seg );
+            runStart = prev;
+        }
+
+        runDir = dir;
+        prev = pos;
+    }
+
+    if( runStart != prev )
+    {
+        seg.m_a = runStart;
+        seg.m_b = prev;
+        seg.m_layer = layer;
+        aRoute.m_segments.push_back( seg );
+    }
+
+    if( m_connection.m_targetPos != prev )
+    {
+        seg.m_a = prev;
+        seg.m_b = m_connection.m_targetPos;
+        seg.m_layer = layer;
+        aRoute.m_segments.push_back( seg );
+    }
+}
+
+
+MAZE_ROUTER::MAZE_ROUTER( const PARAMS& aParams ) :
+    m_params( aParams )
+{
+    int reach = m_params.m_clearance + std::max( m_params.m_trackWidth, m_params.m_viaDiameter );
+
+    m_interactionMargin = reach / std::max( 1, m_params.m_gridSize ) + 2;
+
+    m_binRows = std::max( 1, ( m_params.m_rows + BinCells - 1 ) / BinCells );
+    m_binCols = std::max( 1, ( m_params.m_cols + BinCells - 1 ) / BinCells );
+    m_bins.resize( m_binRows * m_binCols );
+}
+
+
+void MAZE_ROUTER::binRange( const BOX2I& aBox, int& aRow0, int& aCol0,
+                            int& aRow1, int& aCol1 ) const
+{
+    const int binSize = BinCells * std::max( 1, m_params.m_gridSize );
+    VECTOR2I lo = aBox.GetOrigin() - m_params.m_origin;
+    VECTOR2I hi = aBox.GetEnd() - m_params.m_origin;
+
+    // the obstacles outside of the grid go to the border bins
+    aRow0 = std::min( std::max( 0, (int) floor( (double) lo.y / binSize ) ), m_binRows - 1 );
+    aCol0 = std::min( std::max( 0, (int) floor( (double) lo.x / binSize ) ), m_binCols - 1 );
+    aRow1 = std::min( std::max( 0, (int) floor( (double) hi.y / binSize ) ), m_binRows - 1 );
+    aCol1 = std::min( std::max( 0, (int) floor( (double) hi.x / binSize ) ), m_binCols - 1 );
+}
+
+
+void MAZE_ROUTER::AddObstacle( const OBSTACLE& aObstacle )
+{
+    int index = m_obstacles.size();
+    int row0, col0, row1, col1;
+
+    m_obstacles.push_back( aObstacle );
+    binRange( aObstacle.m_bbox, row0, col0, row1, col1 );
+
+    for( int row = row0; row <= row1; row++ )
+    {
+        for( int col = col0; col <= col1; col++ )
+            m_bins[row * m_binCols + col].push_back( index );
+    }
+}
+
+
+int MAZE_ROUTER::AddConnection( const CONNECTION& aConnection )
+{
+    m_connections.push_back( aConnection );
+    m_routed.push_back( false );
+
+    return m_connections.size() - 1;
+}
+
+
+MAZE_ROUTER::WINDOW MAZE_ROUTER::window( int aIndex, bool aFullGrid ) const
+{
+    WINDOW w;
+
+    w.m_row0 = 0;
+    w.m_col0 = 0;
+    w.m_rows = m_params.m_rows;
+    w.m_cols = m_params.m_cols;
+
+    if( aFullGrid )
+        return w;
+
+    // The bounding box of the ends, with a margin of half its size for the detours
+    const CONNECTION& c = m_connections[aIndex];
+    int row0 = std::min( c.m_sourceRow, c.m_targetRow );
+    int col0 = std::min( c.m_sourceCol, c.m_targetCol );
+    int row1 = std::max( c.m_sourceRow, c.m_targetRow );
+    int col1 = std::max( c.m_sourceCol, c.m_targetCol );
+    int margin = std::max( m_params.m_windowMargin, std::max( row1 - row0, col1 - col0 ) / 2 );
+
+    w.m_row0 = std::max( 0, row0 - margin );
+    w.m_col0 = std::max( 0, col0 - margin );
+    w.m_rows = std::min( m_params.m_rows, row1 + margin + 1 ) - w.m_row0;
+    w.m_cols = std::min( m_params.m_cols, col1 + margin + 1 ) - w.m_col0;
+
+    return w;
+}
+
+
+void MAZE_ROUTER::nextBatch( std::vector<int>& aPending, bool aFullGrid,
+                             std::vector<int>& aBatch )
+{
+    // A connection joins the batch if its window is far from the windows of the batch,
+    // and from the windows of the connections it skips, which must be routed before it
+    const unsigned maxBatch = 4 * std::max( 1, m_params.m_threadCount > 0 ?
+                                               m_params.m_threadCount :
+                                               THREAD_POOL::DefaultThreadCount() );
+    const unsigned maxScan = 16 * maxBatch;
+
+    std::vector<WINDOW> claimed;
+    std::vector<int> rest;
+
+    aBatch.clear();
+
+    for( unsigned i = 0; i < aPending.size(); i++ )
+    {
+        int idx = aPending[i];
+
+        if( aBatch.size() >= maxBatch || i >= maxScan )
+        {
+            rest.push_back( idx );
+            continue;
+        }
+
+        WINDOW w = window( idx, aFullGrid );
+        bool free = true;
+
+        for( unsigned j = 0; j < claimed.size() && free; j++ )
+            free = !claimed[j].Overlaps( w, m_interactionMargin );
+
+        claimed.push_back( w );
+
+        if( free )
+            aBatch.push_back( idx );
+        else
+            rest.push_back( idx );
+    }
+
+    aPending.swap( rest );
+}
+
+
+void MAZE_ROUTER::search( int aIndex, WINDOW aWindow, ROUTE* aRoute ) const
+{
+    SEARCH search( *this, m_connections[aIndex], aWindow );
+
+    search.Run( *aRoute );
+}
+
+
+void MAZE_ROUTER::addRoute( const ROUTE& aRoute, int aNet )
+{
+    const uint32_t allLayers = m_params.m_layerCount >= 32 ? ~0u :
+                               ( 1u << m_params.m_layerCount ) - 1;
+
+    for( unsigned i = 0; i < aRoute.m_segments.size(); i++ )
+    {
+        const ROUTE::SEGMENT& s = aRoute.m_segments[i];
+
+        AddObstacle( OBSTACLE::Segment( s.m_a, s.m_b, m_params.m_trackWidth / 2,
+                                        1u << s.m_layer, true, aNet ) );
+    }
+
+    for( unsigned i = 0; i < aRoute.m_vias.size(); i++ )
+    {
+        AddObstacle( OBSTACLE::Segment( aRoute.m_vias[i], aRoute.m_vias[i],
+                                        m_params.m_viaDiameter / 2, allLayers, true, aNet ) );
+    }
+}
+
+
+bool MAZE_ROUTER::Route()
+{
+    prof_counter counter;
+    prof_start( &counter );
+
+    m_stats = STATS();
+
+    THREAD_POOL* pool = NULL;
+
+    if( m_params.m_threadCount != 1 )
+        pool = new THREAD_POOL( m_params.m_threadCount );
+
+    std::vector<int> pending, failed, batch;
+    bool aborted = false;
+
+    for( unsigned i = 0; i < m_connections.size(); i++ )
+    {
+        if( !m_routed[i] )
+            pending.push_back( i );
+    }
+
+    // First pass in windows around the connections, concurrently, then the connections
+    // which failed on the whole grid
+    for( int pass = 0; pass < 2 && !aborted; pass++ )
+    {
+        bool fullGrid = pass == 1;
+
+        while( !pending.empty() )
+        {
+            if( m_abortHook && m_abortHook() )
+            {
+                aborted = true;
+                break;
+            }
+
+            nextBatch( pending, fullGrid, batch );
+
+            std::vector<ROUTE> routes( batch.size() );
+
+            if( pool && batch.size() > 1 )
+            {
+                for( unsigned i = 0; i < batch.size(); i++ )
+                    pool->Submit( boost::bind( &MAZE_ROUTER::search, this, batch[i],
+                                               window( batch[i], fullGrid ), &routes[i] ) );
+
+                pool->Wait();
+            }
+            else
+            {
+                for( unsigned i = 0; i < batch.size(); i++ )
+                    search( batch[i], window( batch[i], fullGrid ), &routes[i] );
+            }
+
+            m_stats.m_batches++;
+
+            for( unsigned i = 0; i < batch.size(); i++ )
+            {
+                int idx = batch[i];
+
+                m_stats.m_expanded += routes[i].m_expanded;
+
+                if( !routes[i].m_routed )
+                {
+                    // a search on the whole grid will not do better
+                    if( !fullGrid )
+                    {
+                        WINDOW w = window( idx, false );
+
+                        if( w.m_rows < m_params.m_rows || w.m_cols < m_params.m_cols )
+                            failed.push_back( idx );
+                    }
+
+                    continue;
+                }
+
+                m_routed[idx] = true;
+                m_stats.m_routed++;
+                addRoute( routes[i], m_connections[idx].m_net );
+
+                if( m_commitHook )
+                    m_commitHook( idx, routes[i] );
+            }
+        }
+
+        pending.swap( failed );
+        failed.clear();
+    }
+
+    delete pool;
+
+    m_stats.m_failed = std::count( m_routed.begin(), m_routed.end(), false );
+
+    prof_end( &counter );
+    m_stats.m_msecs = counter.msecs();
+
+    return !aborted;
+}
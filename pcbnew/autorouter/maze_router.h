@@ -0,0 +1,281 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file maze_router.h
+ * @brief Multi-layer grid router (A* search), routing independent connections concurrently.
+ */
+
+#ifndef MAZE_ROUTER_H
+#define MAZE_ROUTER_H
+
+#include <vector>
+#include <stdint.h>
+
+#include <boost/function.hpp>
+
+#include <math/vector2d.h>
+#include <math/box2.h>
+
+
+/**
+ * Class MAZE_ROUTER
+ * routes connections between grid cells on up to 32 copper layers, with through vias.
+ *
+ * The board is described by a list of obstacles (pads, tracks, vias, board edges), each
+ * one owned by a net. Each connection is searched with A* (octile distance, plus the cost
+ * of a via when the target is not reachable on the current layer) inside a window of the
+ * routing grid around its ends. The search states include the direction of the incoming
+ * step, so the route found is the cheapest one including the turn costs; only the states
+ * reached are stored, so the memory used follows the area explored, not the window size.
+ * The window is rasterized before the search into bit planes (one per layer for the tracks,
+ * one for the vias) from the obstacles of the other nets, found through bins of BinCells
+ * cells, so the searches do not share any state.
+ *
+ * Connections whose windows are far enough apart can't interfere: they are searched
+ * concurrently on a THREAD_POOL, by batches. After each batch, the routes are committed
+ * in the order of the connections and added to the obstacles. The connections which could
+ * not be routed in their window are retried on the whole grid, one at a time.
+ */
+class MAZE_ROUTER
+{
+public:
+    ///> Maximum number of routing layers
+    static const int MaxLayers = 32;
+
+    ///> Cost of a step between two orthogonal neighbors; a diagonal step costs 14
+    static const int StepCost = 10;
+
+    /**
+     * Struct OBSTACLE
+     * is a copper (or board edge) shape the routes must keep away from, unless they
+     * are on the same net.
+     */
+    struct OBSTACLE
+    {
+        enum SHAPE
+        {
+            SEGMENT,    ///> segment with round ends (tracks, vias, round and oval pads)
+            RECT        ///> rotated rectangle (rectangular pads, texts)
+        };
+
+        OBSTACLE() :
+            m_shape( SEGMENT ),
+            m_radius( 0 ),
+            m_cos( 1.0 ),
+            m_sin( 0.0 ),
+            m_layers( 0 ),
+            m_blocksVias( false ),
+            m_net( -1 )
+        {}
+
+        ///> Creates a segment obstacle of half width aRadius (a circle if aA == aB)
+        static OBSTACLE Segment( const VECTOR2I& aA, const VECTOR2I& aB, int aRadius,
+                                 uint32_t aLayers, bool aBlocksVias, int aNet );
+
+        ///> Creates a rectangle obstacle, centered on aCenter and rotated by aAngle
+        ///> (in tenths of degrees, counterclockwise)
+        static OBSTACLE Rect( const VECTOR2I& aCenter, const VECTOR2I& aHalfSize,
+                              double aAngle, uint32_t aLayers, bool aBlocksVias, int aNet );
+
+        ///> Returns true if the distance between aP and the obstacle is less than aMargin
+        bool IsNear( const VECTOR2I& aP, int aMargin ) const;
+
+        SHAPE       m_shape;
+        VECTOR2I    m_a;            ///> segment start, or rectangle center
+        VECTOR2I    m_b;            ///> segment end, or rectangle half size
+        int         m_radius;       ///> segment half width
+        double      m_cos, m_sin;   ///> rectangle orientation
+        uint32_t    m_layers;       ///> routing layers (bit i for layer i) covered
+        bool        m_blocksVias;   ///> true if on any copper layer, routing or not
+        int         m_net;
+        BOX2I       m_bbox;         ///> bounding box of the shape
+    };
+
+    /**
+     * Struct CONNECTION
+     * is a pair of cells to connect. The route ends at the board positions of the
+     * connected items, joined to the cells by a straight segment.
+     */
+    struct CONNECTION
+    {
+        int         m_sourceRow, m_sourceCol;
+        int         m_targetRow, m_targetCol;
+        VECTOR2I    m_sourcePos, m_targetPos;
+        uint32_t    m_sourceLayers;     ///> layers on which the route may start
+        uint32_t    m_targetLayers;     ///> layers on which the route may end
+        int         m_net;
+    };
+
+    ///> A routed connection, in board coordinates
+    struct ROUTE
+    {
+        struct SEGMENT
+        {
+            VECTOR2I m_a, m_b;
+            int      m_layer;
+        };
+
+        ROUTE() : m_routed( false ), m_expanded( 0 ) {}
+
+        bool                    m_routed;
+        std::vector<SEGMENT>    m_segments;
+        std::vector<VECTOR2I>   m_vias;
+        int                     m_expanded;     ///> number of cells expanded by the search
+    };
+
+    ///> Grid, design rules and costs
+    struct PARAMS
+    {
+        PARAMS() :
+            m_rows( 0 ),
+            m_cols( 0 ),
+            m_gridSize( 1 ),
+            m_layerCount( 1 ),
+            m_trackWidth( 0 ),
+            m_viaDiameter( 0 ),
+            m_clearance( 0 ),
+            m_viaCost( 50 * StepCost ),
+            m_turnCost( StepCost / 4 ),
+            m_windowMargin( 10 ),
+            m_threadCount( 0 )
+        {}
+
+        VECTOR2I    m_origin;           ///> board position of the cell (0, 0)
+        int         m_rows, m_cols;
+        int         m_gridSize;
+        int         m_layerCount;
+        int         m_trackWidth;
+        int         m_viaDiameter;
+        int         m_clearance;
+        int         m_viaCost;          ///> cost of a via, in StepCost units
+        int         m_turnCost;         ///> cost of a 45 degree turn
+        int         m_windowMargin;     ///> minimum margin of the search windows, in cells
+        int         m_threadCount;      ///> 0 for the number of hardware threads
+    };
+
+    ///> Results of Route()
+    struct STATS
+    {
+        STATS() : m_routed( 0 ), m_failed( 0 ), m_batches( 0 ), m_expanded( 0 ), m_msecs( 0.0 ) {}
+
+        int         m_routed;
+        int         m_failed;
+        int         m_batches;
+        long long   m_expanded;
+        double      m_msecs;
+    };
+
+    ///> Called on the calling thread with each routed connection (index in the order of
+    ///> AddConnection()), in the order of the connections
+    typedef boost::function<void ( int aIndex, const ROUTE& aRoute )> COMMIT_HOOK;
+
+    ///> Called on the calling thread between the batches, returns true to stop routing
+    typedef boost::function<bool ()> ABORT_HOOK;
+
+    MAZE_ROUTER( const PARAMS& aParams );
+
+    void AddObstacle( const OBSTACLE& aObstacle );
+
+    ///> Adds a connection to route. The connections are routed in the order they are added.
+    ///> @return the index of the connection
+    int AddConnection( const CONNECTION& aConnection );
+
+    void SetCommitHook( const COMMIT_HOOK& aHook )
+    {
+        m_commitHook = aHook;
+    }
+
+    void SetAbortHook( const ABORT_HOOK& aHook )
+    {
+        m_abortHook = aHook;
+    }
+
+    /**
+     * Function Route
+     * routes all the connections. The routed ones are added to the obstacles, and
+     * passed to the commit hook.
+     * @return false if aborted
+     */
+    bool Route();
+
+    ///> Returns true if connection aIndex was routed
+    bool IsRouted( int aIndex ) const
+    {
+        return m_routed[aIndex];
+    }
+
+    const STATS& Stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    ///> A rectangle of cells, used as search window
+    struct WINDOW
+    {
+        int m_row0, m_col0;
+        int m_rows, m_cols;
+
+        bool Overlaps( const WINDOW& aOther, int aMargin ) const;
+    };
+
+    class SEARCH;
+
+    ///> Size of the obstacle bins, in cells
+    static const int BinCells = 32;
+
+    ///> Returns the range of bins covering aBox (clamped to the grid)
+    void binRange( const BOX2I& aBox, int& aRow0, int& aCol0, int& aRow1, int& aCol1 ) const;
+
+    ///> Returns the search window of connection aIndex, the whole grid if aFullGrid
+    WINDOW window( int aIndex, bool aFullGrid ) const;
+
+    ///> Picks the next batch of connections among aPending, removed from it
+    void nextBatch( std::vector<int>& aPending, bool aFullGrid, std::vector<int>& aBatch );
+
+    ///> Searches connection aIndex, in aWindow, into aRoute (run by the worker threads)
+    void search( int aIndex, WINDOW aWindow, ROUTE* aRoute ) const;
+
+    ///> Adds the tracks and vias of a route to the obstacles
+    void addRoute( const ROUTE& aRoute, int aNet );
+
+    PARAMS                  m_params;
+    std::vector<OBSTACLE>   m_obstacles;
+
+    ///> indices of the obstacles overlapping each bin, row by row
+    std::vector< std::vector<int> > m_bins;
+    int                     m_binRows, m_binCols;
+
+    std::vector<CONNECTION> m_connections;
+    std::vector<bool>       m_routed;
+
+    ///> minimal distance between two windows for their routes not to interfere, in cells
+    int                     m_interactionMargin;
+
+    COMMIT_HOOK             m_commitHook;
+    ABORT_HOOK              m_abortHook;
+    STATS                   m_stats;
+};
+
+#endif  // MAZE_ROUTER_H
@@ -128,6 +128,10 @@ void PCB_EDIT_FRAME::OnPlaceOrRouteFootprints( wxCommandEvent& event )
         AutoPlaceModule( NULL, PLACE_INCREMENTAL, &dc );
         break;
 
+    case ID_POPUP_PCB_AUTOPLACE_ANNEAL_MODULES:
+        AnnealPlaceModules( &dc );
+        break;
+
     case ID_POPUP_PCB_SPREAD_ALL_MODULES:
         if( !IsOK( this,
                    _("Not locked footprints inside the board will be moved. OK?") ) )
@@ -31,6 +31,7 @@
 
 /**
  * @file solve.cpp
+ * @brief Routes the work list with MAZE_ROUTER
  */
 
 #include <fctsys.h>
@@ -39,1310 +40,465 @@
 #include <wxPcbStruct.h>
 #include <gr_basic.h>
 #include <macros.h>
+#include <trigo.h>
+
+#include <boost/bind.hpp>
 
 #include <class_board.h>
+#include <class_module.h>
 #include <class_track.h>
+#include <class_drawsegment.h>
+#include <class_edge_mod.h>
+#include <class_pcb_text.h>
 
 #include <pcbnew.h>
 #include <protos.h>
 #include <autorout.h>
 #include <cell.h>
+#include <maze_router.h>
 
 
-static int Autoroute_One_Track( PCB_EDIT_FRAME* pcbframe,
-                                wxDC*           DC,
-                                int             two_sides,
-                                int             row_source,
-                                int             col_source,
-                                int             row_target,
-                                int             col_target,
-                                RATSNEST_ITEM*  pt_rat );
-
-static int Retrace( PCB_EDIT_FRAME* pcbframe,
-                    wxDC*           DC,
-                    int,
-                    int,
-                    int,
-                    int,
-                    int,
-                    int              net_code );
-
-static void OrCell_Trace( BOARD* pcb,
-                          int    col,
-                          int    row,
-                          int    side,
-                          int    orient,
-                          int    current_net_code );
-
-static void AddNewTrace( PCB_EDIT_FRAME* pcbframe, wxDC* DC );
-
-
-static int            segm_oX, segm_oY;
-static int            segm_fX, segm_fY; /* Origin and position of the current
-                                         * trace segment. */
-static RATSNEST_ITEM* pt_cur_ch;
-static int            s_Clearance;  // Clearance value used in autorouter
+// Arcs and circles of the board outlines are approximated by segments of 10 degrees
+static const int ARC_APPROX_ANGLE = 100;
 
 static PICKED_ITEMS_LIST s_ItemsListPicker;
 
-int OpenNodes;       // total number of nodes opened
-int ClosNodes;       // total number of nodes closed
-int MoveNodes;       // total number of nodes moved
-int MaxNodes;        // maximum number of nodes opened at one time
-
-#define NOSUCCESS       0
-#define STOP_FROM_ESC   -1
-#define ERR_MEMORY      -2
-#define SUCCESS         1
-#define TRIVIAL_SUCCESS 2
-
-/*
-** visit neighboring cells like this (where [9] is on the other side):
-**
-**  +---+---+---+
-**  | 1 | 2 | 3 |
-**  +---+---+---+
-**  | 4 |[9]| 5 |
-**  +---+---+---+
-**  | 6 | 7 | 8 |
-**  +---+---+---+
-*/
 
-/* for visiting neighbors on the same side: increments/decrements coord of
- * [] [0] = row [] (1] = col was added to the coord of the midpoint for
- * Get the coord of the 8 neighboring points.
+/* Returns the routing layer bits (bit i for aRouteLayers[i]) of a layer set
  */
-static const int delta[8][2] =
-{
-    {  1, -1 },     // northwest
-    {  1, 0  },     // north
-    {  1, 1  },     // northeast
-    {  0, -1 },     // west
-    {  0, 1  },     // east
-    { -1, -1 },     // southwest
-    { -1, 0  },     // south
-    { -1, 1  }      // southeast
-};
-
-static const int ndir[8] =
-{
-    // for building paths back to source
-    FROM_SOUTHEAST, FROM_SOUTH,     FROM_SOUTHWEST,
-    FROM_EAST,      FROM_WEST,
-    FROM_NORTHEAST, FROM_NORTH,     FROM_NORTHWEST
-};
-
-// blocking masks for neighboring cells
-#define BLOCK_NORTHEAST ( DIAG_NEtoSW | BENT_StoNE | BENT_WtoNE \
-                          | ANGLE_NEtoSE | ANGLE_NWtoNE         \
-                          | SHARP_NtoNE | SHARP_EtoNE | HOLE )
-#define BLOCK_SOUTHEAST ( DIAG_SEtoNW | BENT_NtoSE | BENT_WtoSE \
-                          | ANGLE_NEtoSE | ANGLE_SEtoSW         \
-                          | SHARP_EtoSE | SHARP_StoSE | HOLE )
-#define BLOCK_SOUTHWEST ( DIAG_NEtoSW | BENT_NtoSW | BENT_EtoSW \
-                          | ANGLE_SEtoSW | ANGLE_SWtoNW         \
-                          | SHARP_StoSW | SHARP_WtoSW | HOLE )
-#define BLOCK_NORTHWEST ( DIAG_SEtoNW | BENT_EtoNW | BENT_StoNW \
-                          | ANGLE_SWtoNW | ANGLE_NWtoNE         \
-                          | SHARP_WtoNW | SHARP_NtoNW | HOLE )
-#define BLOCK_NORTH     ( LINE_VERTICAL | BENT_NtoSE | BENT_NtoSW      \
-                          | BENT_EtoNW | BENT_WtoNE                    \
-                          | BENT_StoNE | BENT_StoNW                    \
-                          | CORNER_NORTHEAST | CORNER_NORTHWEST        \
-                          | ANGLE_NEtoSE | ANGLE_SWtoNW | ANGLE_NWtoNE \
-                          | DIAG_NEtoSW | DIAG_SEtoNW                  \
-                          | SHARP_NtoNE | SHARP_NtoNW                  \
-                          | SHARP_EtoNE | SHARP_WtoNW | HOLE )
-#define BLOCK_EAST      ( LINE_HORIZONTAL | BENT_EtoSW | BENT_EtoNW    \
-                          | BENT_NtoSE | BENT_StoNE                    \
-                          | BENT_WtoNE | BENT_WtoSE                    \
-                          | CORNER_NORTHEAST | CORNER_SOUTHEAST        \
-                          | ANGLE_NEtoSE | ANGLE_SEtoSW | ANGLE_NWtoNE \
-                          | DIAG_NEtoSW | DIAG_SEtoNW                  \
-                          | SHARP_EtoNE | SHARP_EtoSE                  \
-                          | SHARP_NtoNE | SHARP_StoSE | HOLE )
-#define BLOCK_SOUTH     ( LINE_VERTICAL | BENT_StoNE | BENT_StoNW      \
-                          | BENT_EtoSW | BENT_WtoSE                    \
-                          | BENT_NtoSE | BENT_NtoSW                    \
-                          | CORNER_SOUTHEAST | CORNER_SOUTHWEST        \
-                          | ANGLE_NEtoSE | ANGLE_SWtoNW | ANGLE_SEtoSW \
-                          | DIAG_NEtoSW | DIAG_SEtoNW                  \
-                          | SHARP_StoSE | SHARP_StoSW                  \
-                          | SHARP_EtoSE | SHARP_WtoSW | HOLE )
-#define BLOCK_WEST      ( LINE_HORIZONTAL | BENT_WtoNE | BENT_WtoSE    \
-                          | BENT_NtoSW | BENT_StoNW                    \
-                          | BENT_EtoSW | BENT_EtoNW                    \
-                          | CORNER_SOUTHWEST | CORNER_NORTHWEST        \
-                          | ANGLE_SWtoNW | ANGLE_SEtoSW | ANGLE_NWtoNE \
-                          | DIAG_NEtoSW | DIAG_SEtoNW                  \
-                          | SHARP_WtoSW | SHARP_WtoNW                  \
-                          | SHARP_NtoNW | SHARP_StoSW | HOLE )
-
-struct block
-{
-    int  r1, c1;
-    long b1;
-    int  r2, c2;
-    long b2;
-};
-
-// blocking masks for diagonal traces
-static struct block blocking[8] =
-{ {
-      0, -1,
-      BLOCK_NORTHEAST,
-      1, 0,
-      BLOCK_SOUTHWEST
-  },
-  {
-      0, 0, 0,
-      0, 0, 0
-  },
-  {
-      1, 0,
-      BLOCK_SOUTHEAST,
-      0, 1,
-      BLOCK_NORTHWEST
-  },
-  {
-      0, 0, 0,
-      0, 0, 0
-  },
-  {
-      0, 0, 0,
-      0, 0, 0
-  },
-  {
-      0, -1,
-      BLOCK_SOUTHEAST,
-      -1, 0,
-      BLOCK_NORTHWEST
-  },
-  {
-      0, 0, 0,
-      0, 0, 0
-  },
-  {
-      -1, 0,
-      BLOCK_NORTHEAST,
-      0, 1,
-      BLOCK_SOUTHWEST
-  } };
-
-// mask for hole-related blocking effects
-static struct
+static uint32_t routingLayerBits( LSET aLayers, const std::vector<LAYER_ID>& aRouteLayers )
 {
-    long trace;
-    int  present;
-} selfok2[8] =
-{
-    { HOLE_NORTHWEST, 0 },
-    { HOLE_NORTH,     0 },
-    { HOLE_NORTHEAST, 0 },
-    { HOLE_WEST,      0 },
-    { HOLE_EAST,      0 },
-    { HOLE_SOUTHWEST, 0 },
-    { HOLE_SOUTH,     0 },
-    { HOLE_SOUTHEAST, 0 }
-};
-
-static long newmask[8] =
-{
-    // patterns to mask out in neighbor cells
-    0,
-    CORNER_NORTHWEST | CORNER_NORTHEAST,
-    0,
-    CORNER_NORTHWEST | CORNER_SOUTHWEST,
-    CORNER_NORTHEAST | CORNER_SOUTHEAST,
-    0,
-    CORNER_SOUTHWEST | CORNER_SOUTHEAST,
-    0
-};
+    uint32_t bits = 0;
 
-
-/* Route all traces
- * :
- *  1 if OK
- * -1 if escape (stop being routed) request
- * -2 if default memory allocation
- */
-int PCB_EDIT_FRAME::Solve( wxDC* DC, int aLayersCount )
-{
-    int           current_net_code;
-    int           row_source, col_source, row_target, col_target;
-    int           success, nbsucces = 0, nbunsucces = 0;
-    NETINFO_ITEM* net;
-    bool          stop = false;
-    wxString      msg;
-    int           routedCount = 0;      // routed ratsnest count
-    bool          two_sides = aLayersCount == 2;
-
-    m_canvas->SetAbortRequest( false );
-
-    s_Clearance = GetBoard()->GetDesignSettings().GetDefault()->GetClearance();
-
-    // Prepare the undo command info
-    s_ItemsListPicker.ClearListAndDeleteItems();  // Should not be necessary, but...
-
-    // go until no more work to do
-    GetWork( &row_source, &col_source, &current_net_code,
-             &row_target, &col_target, &pt_cur_ch ); // First net to route.
-
-    for( ; row_source != ILLEGAL; GetWork( &row_source, &col_source,
-                                           &current_net_code, &row_target,
-                                           &col_target,
-                                           &pt_cur_ch ) )
+    for( unsigned i = 0; i < aRouteLayers.size(); i++ )
     {
-        // Test to stop routing ( escape key pressed )
-        wxYield();
-
-        if( m_canvas->GetAbortRequest() )
-        {
-            if( IsOK( this, _( "Abort routing?" ) ) )
-            {
-                success = STOP_FROM_ESC;
-                stop    = true;
-                break;
-            }
-            else
-            {
-                m_canvas->SetAbortRequest( false );
-            }
-        }
-
-        EraseMsgBox();
-
-        routedCount++;
-        net = GetBoard()->FindNet( current_net_code );
-
-        if( net )
-        {
-            msg.Printf( wxT( "[%8.8s]" ), GetChars( net->GetNetname() ) );
-            AppendMsgPanel( wxT( "Net route" ), msg, BROWN );
-            msg.Printf( wxT( "%d / %d" ), routedCount, RoutingMatrix.m_RouteCount );
-            AppendMsgPanel( wxT( "Activity" ), msg, BROWN );
-        }
-
-        segm_oX = GetBoard()->GetBoundingBox().GetX() + (RoutingMatrix.m_GridRouting * col_source);
-        segm_oY = GetBoard()->GetBoundingBox().GetY() + (RoutingMatrix.m_GridRouting * row_source);
-        segm_fX = GetBoard()->GetBoundingBox().GetX() + (RoutingMatrix.m_GridRouting * col_target);
-        segm_fY = GetBoard()->GetBoundingBox().GetY() + (RoutingMatrix.m_GridRouting * row_target);
-
-        // Draw segment.
-        GRLine( m_canvas->GetClipBox(), DC,
-                segm_oX, segm_oY, segm_fX, segm_fY,
-                0, WHITE );
-        pt_cur_ch->m_PadStart->Draw( m_canvas, DC, GR_OR | GR_HIGHLIGHT );
-        pt_cur_ch->m_PadEnd->Draw( m_canvas, DC, GR_OR | GR_HIGHLIGHT );
-
-        success = Autoroute_One_Track( this, DC,
-                                       two_sides, row_source, col_source,
-                                       row_target, col_target, pt_cur_ch );
-
-        switch( success )
-        {
-        case NOSUCCESS:
-            pt_cur_ch->m_Status |= CH_UNROUTABLE;
-            nbunsucces++;
-            break;
-
-        case STOP_FROM_ESC:
-            stop = true;
-            break;
-
-        case ERR_MEMORY:
-            stop = true;
-            break;
-
-        default:
-            nbsucces++;
-            break;
-        }
-
-        msg.Printf( wxT( "%d" ), nbsucces );
-        AppendMsgPanel( wxT( "OK" ), msg, GREEN );
-        msg.Printf( wxT( "%d" ), nbunsucces );
-        AppendMsgPanel( wxT( "Fail" ), msg, RED );
-        msg.Printf( wxT( "  %d" ), GetBoard()->GetUnconnectedNetCount() );
-        AppendMsgPanel( wxT( "Not Connected" ), msg, CYAN );
-
-        // Delete routing from display.
-        pt_cur_ch->m_PadStart->Draw( m_canvas, DC, GR_AND );
-        pt_cur_ch->m_PadEnd->Draw( m_canvas, DC, GR_AND );
-
-        if( stop )
-            break;
+        if( aLayers[aRouteLayers[i]] )
+            bits |= 1u << i;
     }
 
-    SaveCopyInUndoList( s_ItemsListPicker, UR_UNSPECIFIED );
-    s_ItemsListPicker.ClearItemsList(); // s_ItemsListPicker is no more owner of picked items
-
-    return SUCCESS;
+    return bits;
 }
 
 
-/* Route a trace on the BOARD.
- * Parameters:
- * 1 side / 2 sides (0 / 1)
- * Coord source (row, col)
- * Coord destination (row, col)
- * Net_code
- * Pointer to the ratsnest reference
- *
- * Returns:
- * SUCCESS if routed
- * TRIVIAL_SUCCESS if pads are connected by overlay (no track needed)
- * If failure NOSUCCESS
- * Escape STOP_FROM_ESC if demand
- * ERR_MEMORY if memory allocation failed.
- */
-static int Autoroute_One_Track( PCB_EDIT_FRAME* pcbframe,
-                                wxDC*           DC,
-                                int             two_sides,
-                                int             row_source,
-                                int             col_source,
-                                int             row_target,
-                                int             col_target,
-                                RATSNEST_ITEM*  pt_rat )
+static void addPadObstacle( MAZE_ROUTER& aRouter, D_PAD* aPad,
+                            const std::vector<LAYER_ID>& aRouteLayers )
 {
-    int          r, c, side, d, apx_dist, nr, nc;
-    int          result, skip;
-    int          i;
-    long         curcell, newcell, buddy, lastopen, lastclos, lastmove;
-    int          newdist, olddir, _self;
-    int          current_net_code;
-    int          marge;
-    LSET         padLayerMaskStart;    // Mask layers belonging to the starting pad.
-    LSET         padLayerMaskEnd;      // Mask layers belonging to the ending pad.
-
-    LSET         topLayerMask( g_Route_Layer_TOP );
-
-    LSET         bottomLayerMask( g_Route_Layer_BOTTOM );
-
-    LSET         routeLayerMask;       // Mask two layers for routing.
-
-    LSET         tab_mask[2];           // Enables the calculation of the mask layer being
-                                        // tested. (side = TOP or BOTTOM)
-    int          start_mask_layer = 0;
-    wxString     msg;
-
-    // @todo this could be a bottle neck
-    LSET all_cu = LSET::AllCuMask( pcbframe->GetBoard()->GetCopperLayerCount() );
-
-    wxBusyCursor dummy_cursor;      // Set an hourglass cursor while routing a
-                                    // track
-
-    result = NOSUCCESS;
-
-    marge = s_Clearance + ( pcbframe->GetDesignSettings().GetCurrentTrackWidth() / 2 );
-
-    // clear direction flags
-    i = RoutingMatrix.m_Nrows * RoutingMatrix.m_Ncols * sizeof(DIR_CELL);
-
-    if( two_sides )
-        memset( RoutingMatrix.m_DirSide[TOP], FROM_NOWHERE, i );
-    memset( RoutingMatrix.m_DirSide[BOTTOM], FROM_NOWHERE, i );
-
-    lastopen = lastclos = lastmove = 0;
-
-    // Set tab_masque[side] for final test of routing.
-    if( two_sides )
-        tab_mask[TOP] = topLayerMask;
-    tab_mask[BOTTOM] = bottomLayerMask;
-
-    // Set active layers mask.
-    routeLayerMask = topLayerMask | bottomLayerMask;
-
-    pt_cur_ch = pt_rat;
-
-    current_net_code  = pt_rat->GetNet();
-    padLayerMaskStart = pt_cur_ch->m_PadStart->GetLayerSet();
+    LSET     layers = aPad->GetLayerSet() & LSET::AllCuMask();
+    uint32_t bits = routingLayerBits( layers, aRouteLayers );
+    VECTOR2I pos( aPad->ShapePos() );
+    int      net = aPad->GetNetCode();
 
-    padLayerMaskEnd = pt_cur_ch->m_PadEnd->GetLayerSet();
-
-
-    /* First Test if routing possible ie if the pads are accessible
-     * on the routing layers.
-     */
-    if( ( routeLayerMask & padLayerMaskStart ) == 0 )
-        goto end_of_route;
-
-    if( ( routeLayerMask & padLayerMaskEnd ) == 0 )
-        goto end_of_route;
+    if( !layers.any() )
+        return;
 
-    /* Then test if routing possible ie if the pads are accessible
-     * On the routing grid (1 grid point must be in the pad)
-     */
+    switch( aPad->GetShape() )
     {
-        int cX = ( RoutingMatrix.m_GridRouting * col_source )
-                 + pcbframe->GetBoard()->GetBoundingBox().GetX();
-        int cY = ( RoutingMatrix.m_GridRouting * row_source )
-                 + pcbframe->GetBoard()->GetBoundingBox().GetY();
-        int dx = pt_cur_ch->m_PadStart->GetSize().x / 2;
-        int dy = pt_cur_ch->m_PadStart->GetSize().y / 2;
-        int px = pt_cur_ch->m_PadStart->GetPosition().x;
-        int py = pt_cur_ch->m_PadStart->GetPosition().y;
-
-        if( ( ( int( pt_cur_ch->m_PadStart->GetOrientation() ) / 900 ) & 1 ) != 0 )
-            std::swap( dx, dy );
-
-        if( ( abs( cX - px ) > dx ) || ( abs( cY - py ) > dy ) )
-            goto end_of_route;
-
-        cX = ( RoutingMatrix.m_GridRouting * col_target )
-             + pcbframe->GetBoard()->GetBoundingBox().GetX();
-        cY = ( RoutingMatrix.m_GridRouting * row_target )
-             + pcbframe->GetBoard()->GetBoundingBox().GetY();
-        dx = pt_cur_ch->m_PadEnd->GetSize().x / 2;
-        dy = pt_cur_ch->m_PadEnd->GetSize().y / 2;
-        px = pt_cur_ch->m_PadEnd->GetPosition().x;
-        py = pt_cur_ch->m_PadEnd->GetPosition().y;
-
-        if( ( ( int( pt_cur_ch->m_PadEnd->GetOrientation() ) / 900) & 1 ) != 0 )
-            std::swap( dx, dy );
-
-        if( ( abs( cX - px ) > dx ) || ( abs( cY - py ) > dy ) )
-            goto end_of_route;
-    }
+    case PAD_SHAPE_CIRCLE:
+        aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Segment( pos, pos, aPad->GetSize().x / 2,
+                                                             bits, true, net ) );
+        break;
 
-    // Test the trivial case: direct connection overlay pads.
-    if( row_source == row_target  && col_source == col_target &&
-            ( padLayerMaskEnd & padLayerMaskStart & all_cu ).any() )
+    case PAD_SHAPE_OVAL:
     {
-        result = TRIVIAL_SUCCESS;
-        goto end_of_route;
-    }
+        // a segment between the centers of the rounded ends
+        wxSize  size = aPad->GetSize();
+        int     radius = std::min( size.x, size.y ) / 2;
+        wxPoint offset;
 
-    // Placing the bit to remove obstacles on 2 pads to a link.
-    pcbframe->SetStatusText( wxT( "Gen Cells" ) );
+        if( size.x > size.y )
+            offset.x = size.x / 2 - radius;
+        else
+            offset.y = size.y / 2 - radius;
 
-    PlacePad( pt_cur_ch->m_PadStart, CURRENT_PAD, marge, WRITE_OR_CELL );
-    PlacePad( pt_cur_ch->m_PadEnd, CURRENT_PAD, marge, WRITE_OR_CELL );
+        RotatePoint( &offset, aPad->GetOrientation() );
 
-    // Regenerates the remaining barriers (which may encroach on the
-    // placement bits precedent)
-    i = pcbframe->GetBoard()->GetPadCount();
+        aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Segment( pos - VECTOR2I( offset ),
+                                                             pos + VECTOR2I( offset ),
+                                                             radius, bits, true, net ) );
+        break;
+    }
 
-    for( unsigned ii = 0; ii < pcbframe->GetBoard()->GetPadCount(); ii++ )
+    default:
     {
-        D_PAD* ptr = pcbframe->GetBoard()->GetPad( ii );
+        // rectangles, and the bounding rectangle of the trapezoids
+        VECTOR2I half( aPad->GetSize().x / 2, aPad->GetSize().y / 2 );
 
-        if( ( pt_cur_ch->m_PadStart != ptr ) && ( pt_cur_ch->m_PadEnd != ptr ) )
+        if( aPad->GetShape() == PAD_SHAPE_TRAPEZOID )
         {
-            PlacePad( ptr, ~CURRENT_PAD, marge, WRITE_AND_CELL );
+            half.x += std::abs( aPad->GetDelta().y ) / 2;
+            half.y += std::abs( aPad->GetDelta().x ) / 2;
         }
-    }
-
-    InitQueue(); // initialize the search queue
-    apx_dist = RoutingMatrix.GetApxDist( row_source, col_source, row_target, col_target );
 
-    // Initialize first search.
-    if( two_sides )   // Preferred orientation.
-    {
-        if( abs( row_target - row_source ) > abs( col_target - col_source ) )
-        {
-            if( ( padLayerMaskStart & topLayerMask ).any() )
-            {
-                start_mask_layer = 2;
-
-                if( SetQueue( row_source, col_source, TOP, 0, apx_dist,
-                              row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-
-            if( ( padLayerMaskStart & bottomLayerMask ).any() )
-            {
-                start_mask_layer |= 1;
-
-                if( SetQueue( row_source, col_source, BOTTOM, 0, apx_dist,
-                              row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-        }
-        else
-        {
-            if( ( padLayerMaskStart & bottomLayerMask ).any() )
-            {
-                start_mask_layer = 1;
-
-                if( SetQueue( row_source, col_source, BOTTOM, 0, apx_dist,
-                              row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-
-            if( ( padLayerMaskStart & topLayerMask ).any() )
-            {
-                start_mask_layer |= 2;
-
-                if( SetQueue( row_source, col_source, TOP, 0, apx_dist,
-                              row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-        }
+        aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Rect( pos, half, aPad->GetOrientation(),
+                                                          bits, true, net ) );
+        break;
     }
-    else if( ( padLayerMaskStart & bottomLayerMask ).any() )
-    {
-        start_mask_layer = 1;
-
-        if( SetQueue( row_source, col_source, BOTTOM, 0, apx_dist, row_target, col_target ) == 0 )
-        {
-            return ERR_MEMORY;
-        }
     }
+}
 
-    // search until success or we exhaust all possibilities
-    GetQueue( &r, &c, &side, &d, &apx_dist );
 
-    for( ; r != ILLEGAL; GetQueue( &r, &c, &side, &d, &apx_dist ) )
-    {
-        curcell = RoutingMatrix.GetCell( r, c, side );
+/* Adds a board outline or a graphic item on a copper layer (also used for the
+ * outlines of the footprints)
+ */
+static void addDrawSegmentObstacle( MAZE_ROUTER& aRouter, DRAWSEGMENT* aSegment,
+                                    const std::vector<LAYER_ID>& aRouteLayers )
+{
+    LAYER_ID layer = aSegment->GetLayer();
+    uint32_t bits;
 
-        if( curcell & CURRENT_PAD )
-            curcell &= ~HOLE;
+    if( layer == Edge_Cuts )
+        bits = routingLayerBits( LSET::AllCuMask(), aRouteLayers );
+    else if( IsCopperLayer( layer ) )
+        bits = routingLayerBits( LSET( layer ), aRouteLayers );
+    else
+        return;
 
-        if( (r == row_target) && (c == col_target)  // success if layer OK
-           && (tab_mask[side] & padLayerMaskEnd).any() )
-        {
-            // Remove link.
-            GRSetDrawMode( DC, GR_XOR );
-            GRLine( pcbframe->GetCanvas()->GetClipBox(),
-                    DC,
-                    segm_oX,
-                    segm_oY,
-                    segm_fX,
-                    segm_fY,
-                    0,
-                    WHITE );
-
-            // Generate trace.
-            if( Retrace( pcbframe, DC, row_source, col_source,
-                         row_target, col_target, side, current_net_code ) )
-            {
-                result = SUCCESS;   // Success : Route OK
-            }
-
-            break;                  // Routing complete.
-        }
+    int radius = aSegment->GetWidth() / 2;
 
-        if( pcbframe->GetCanvas()->GetAbortRequest() )
+    switch( aSegment->GetShape() )
+    {
+    case S_CIRCLE:
+    case S_ARC:
+    {
+        wxPoint center = aSegment->GetCenter();
+        wxPoint start = aSegment->GetShape() == S_ARC ? aSegment->GetArcStart()
+                                                      : aSegment->GetEnd();
+        double  angle = aSegment->GetShape() == S_ARC ? aSegment->GetAngle() : 3600.0;
+        int     count = std::max( 1, KiROUND( std::abs( angle ) / ARC_APPROX_ANGLE ) );
+        double  step = angle / count;
+
+        // the chords are inside the arc: inflate them by the sagitta
+        int     sagitta = KiROUND( aSegment->GetRadius() *
+                                   ( 1.0 - cos( DECIDEG2RAD( step / 2 ) ) ) ) + 1;
+        wxPoint prev = start;
+
+        for( int i = 1; i <= count; i++ )
         {
-            result = STOP_FROM_ESC;
-            break;
-        }
+            wxPoint next = start;
 
-        // report every COUNT new nodes or so
-        #define COUNT 20000
+            RotatePoint( &next, center, -step * i );
 
-        if( ( OpenNodes - lastopen > COUNT )
-           || ( ClosNodes - lastclos > COUNT )
-           || ( MoveNodes - lastmove > COUNT ) )
-        {
-            lastopen = OpenNodes;
-            lastclos = ClosNodes;
-            lastmove = MoveNodes;
-            msg.Printf( wxT( "Activity: Open %d   Closed %d   Moved %d" ),
-                        OpenNodes, ClosNodes, MoveNodes );
-            pcbframe->SetStatusText( msg );
+            aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Segment( prev, next, radius + sagitta,
+                                                                 bits, true, -1 ) );
+            prev = next;
         }
 
-        _self = 0;
-
-        if( curcell & HOLE )
-        {
-            _self = 5;
-
-            // set 'present' bits
-            for( i = 0; i < 8; i++ )
-            {
-                selfok2[i].present = 0;
+        break;
+    }
 
-                if( curcell & selfok2[i].trace )
-                    selfok2[i].present = 1;
-            }
-        }
+    default:
+        aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Segment( aSegment->GetStart(),
+                                                             aSegment->GetEnd(),
+                                                             radius, bits, true, -1 ) );
+        break;
+    }
+}
 
-        for( i = 0; i < 8; i++ ) // consider neighbors
-        {
-            nr = r + delta[i][0];
-            nc = c + delta[i][1];
-
-            // off the edge?
-            if( nr < 0 || nr >= RoutingMatrix.m_Nrows ||
-                nc < 0 || nc >= RoutingMatrix.m_Ncols )
-                continue;  // off the edge
-
-            if( _self == 5 && selfok2[i].present )
-                continue;
-
-            newcell = RoutingMatrix.GetCell( nr, nc, side );
-
-            if( newcell & CURRENT_PAD )
-                newcell &= ~HOLE;
-
-            // check for non-target hole
-            if( newcell & HOLE )
-            {
-                if( nr != row_target || nc != col_target )
-                    continue;
-            }
-            // check for traces
-            else if( newcell & HOLE & ~(newmask[i]) )
-            {
-                continue;
-            }
-
-            // check blocking on corner neighbors
-            if( delta[i][0] && delta[i][1] )
-            {
-                // check first buddy
-                buddy = RoutingMatrix.GetCell( r + blocking[i].r1, c + blocking[i].c1, side );
-
-                if( buddy & CURRENT_PAD )
-                    buddy &= ~HOLE;
-
-                if( buddy & HOLE )
-                    continue;
-
-//              if (buddy & (blocking[i].b1)) continue;
-                // check second buddy
-                buddy = RoutingMatrix.GetCell( r + blocking[i].r2, c + blocking[i].c2, side );
-
-                if( buddy & CURRENT_PAD )
-                    buddy &= ~HOLE;
-
-                if( buddy & HOLE )
-                    continue;
-
-//              if (buddy & (blocking[i].b2)) continue;
-            }
-
-            olddir  = RoutingMatrix.GetDir( r, c, side );
-            newdist = d + RoutingMatrix.CalcDist( ndir[i], olddir,
-                                    ( olddir == FROM_OTHERSIDE ) ?
-                                    RoutingMatrix.GetDir( r, c, 1 - side ) : 0, side );
-
-            // if (a) not visited yet, or (b) we have
-            // found a better path, add it to queue
-            if( !RoutingMatrix.GetDir( nr, nc, side ) )
-            {
-                RoutingMatrix.SetDir( nr, nc, side, ndir[i] );
-                RoutingMatrix.SetDist( nr, nc, side, newdist );
-
-                if( SetQueue( nr, nc, side, newdist,
-                              RoutingMatrix.GetApxDist( nr, nc, row_target, col_target ),
-                              row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-            else if( newdist < RoutingMatrix.GetDist( nr, nc, side ) )
-            {
-                RoutingMatrix.SetDir( nr, nc, side, ndir[i] );
-                RoutingMatrix.SetDist( nr, nc, side, newdist );
-                ReSetQueue( nr, nc, side, newdist,
-                            RoutingMatrix.GetApxDist( nr, nc, row_target, col_target ),
-                            row_target, col_target );
-            }
-        }
 
-        //* Test the other layer. *
-        if( two_sides )
-        {
-            olddir = RoutingMatrix.GetDir( r, c, side );
-
-            if( olddir == FROM_OTHERSIDE )
-                continue;   // useless move, so don't bother
-
-            if( curcell )   // can't drill via if anything here
-                continue;
-
-            // check for holes or traces on other side
-            if( ( newcell = RoutingMatrix.GetCell( r, c, 1 - side ) ) != 0 )
-                continue;
-
-            // check for nearby holes or traces on both sides
-            for( skip = 0, i = 0; i < 8; i++ )
-            {
-                nr = r + delta[i][0]; nc = c + delta[i][1];
-
-                if( nr < 0 || nr >= RoutingMatrix.m_Nrows ||
-                    nc < 0 || nc >= RoutingMatrix.m_Ncols )
-                    continue;  // off the edge !!
-
-                if( RoutingMatrix.GetCell( nr, nc, side ) /* & blocking2[i] */ )
-                {
-                    skip = 1; // can't drill via here
-                    break;
-                }
-
-                if( RoutingMatrix.GetCell( nr, nc, 1 - side ) /* & blocking2[i] */ )
-                {
-                    skip = 1; // can't drill via here
-                    break;
-                }
-            }
-
-            if( skip )      // neighboring hole or trace?
-                continue;   // yes, can't drill via here
-
-            newdist = d + RoutingMatrix.CalcDist( FROM_OTHERSIDE, olddir, 0, side );
-
-            /*  if (a) not visited yet,
-             *  or (b) we have found a better path,
-             *  add it to queue */
-            if( !RoutingMatrix.GetDir( r, c, 1 - side ) )
-            {
-                RoutingMatrix.SetDir( r, c, 1 - side, FROM_OTHERSIDE );
-                RoutingMatrix.SetDist( r, c, 1 - side, newdist );
-
-                if( SetQueue( r, c, 1 - side, newdist, apx_dist, row_target, col_target ) == 0 )
-                {
-                    return ERR_MEMORY;
-                }
-            }
-            else if( newdist < RoutingMatrix.GetDist( r, c, 1 - side ) )
-            {
-                RoutingMatrix.SetDir( r, c, 1 - side, FROM_OTHERSIDE );
-                RoutingMatrix.SetDist( r, c, 1 - side, newdist );
-                ReSetQueue( r, c,
-                            1 - side,
-                            newdist,
-                            apx_dist,
-                            row_target,
-                            col_target );
-            }
-        }     // Finished attempt to route on other layer.
-    }
+static void addTextObstacle( MAZE_ROUTER& aRouter, TEXTE_PCB* aText,
+                             const std::vector<LAYER_ID>& aRouteLayers )
+{
+    if( aText->GetText().Length() == 0 || !IsCopperLayer( aText->GetLayer() ) )
+        return;
 
-end_of_route:
-    PlacePad( pt_cur_ch->m_PadStart, ~CURRENT_PAD, marge, WRITE_AND_CELL );
-    PlacePad( pt_cur_ch->m_PadEnd, ~CURRENT_PAD, marge, WRITE_AND_CELL );
+    // the text box is not rotated: the text is rotated around its position
+    EDA_RECT box = aText->GetTextBox( -1 );
+    wxPoint  center = box.Centre();
+    int      margin = aText->GetThickness() / 2;
 
-    msg.Printf( wxT( "Activity: Open %d   Closed %d   Moved %d"),
-                OpenNodes, ClosNodes, MoveNodes );
-    pcbframe->SetStatusText( msg );
+    RotatePoint( &center, aText->GetTextPosition(), aText->GetOrientation() );
 
-    return result;
+    aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Rect( center,
+            VECTOR2I( box.GetWidth() / 2 + margin, box.GetHeight() / 2 + margin ),
+            aText->GetOrientation(), routingLayerBits( LSET( aText->GetLayer() ), aRouteLayers ),
+            true, -1 ) );
 }
 
 
-static long bit[8][9] =
+static void addTrackObstacle( MAZE_ROUTER& aRouter, TRACK* aTrack,
+                              const std::vector<LAYER_ID>& aRouteLayers )
 {
-    // OT=Otherside
-    // N, NE, E, SE, S, SW, W, NW, OT
-// N
-    { LINE_VERTICAL,
-      BENT_StoNE,
-      CORNER_SOUTHEAST,
-      SHARP_StoSE,
-      0,
-      SHARP_StoSW,
-      CORNER_SOUTHWEST,
-      BENT_StoNW,
-      ( HOLE | HOLE_SOUTH )
-    },
-// NE
-    {
-        BENT_NtoSW,
-        DIAG_NEtoSW,
-        BENT_EtoSW,
-        ANGLE_SEtoSW,
-        SHARP_StoSW,
-        0,
-        SHARP_WtoSW,
-        ANGLE_SWtoNW,
-        ( HOLE | HOLE_SOUTHWEST )
-    },
-// E
-    {
-        CORNER_NORTHWEST,
-        BENT_WtoNE,
-        LINE_HORIZONTAL,
-        BENT_WtoSE,
-        CORNER_SOUTHWEST,
-        SHARP_WtoSW,
-        0,
-        SHARP_WtoNW,
-        ( HOLE | HOLE_WEST )
-    },
-// SE
-    {
-        SHARP_NtoNW,
-        ANGLE_NWtoNE,
-        BENT_EtoNW,
-        DIAG_SEtoNW,
-        BENT_StoNW,
-        ANGLE_SWtoNW,
-        SHARP_WtoNW,
-        0,
-        ( HOLE | HOLE_NORTHWEST )
-    },
-// S
-    {
-        0,
-        SHARP_NtoNE,
-        CORNER_NORTHEAST,
-        BENT_NtoSE,
-        LINE_VERTICAL,
-        BENT_NtoSW,
-        CORNER_NORTHWEST,
-        SHARP_NtoNW,
-        ( HOLE | HOLE_NORTH )
-    },
-// SW
-    {
-        SHARP_NtoNE,
-        0,
-        SHARP_EtoNE,
-        ANGLE_NEtoSE,
-        BENT_StoNE,
-        DIAG_NEtoSW,
-        BENT_WtoNE,
-        ANGLE_NWtoNE,
-        ( HOLE | HOLE_NORTHEAST )
-    },
-// W
-    {
-        CORNER_NORTHEAST,
-        SHARP_EtoNE,
-        0,
-        SHARP_EtoSE,
-        CORNER_SOUTHEAST,
-        BENT_EtoSW,
-        LINE_HORIZONTAL,
-        BENT_EtoNW,
-        ( HOLE | HOLE_EAST )
-    },
-// NW
-    {
-        BENT_NtoSE,
-        ANGLE_NEtoSE,
-        SHARP_EtoSE,
-        0,
-        SHARP_StoSE,
-        ANGLE_SEtoSW,
-        BENT_WtoSE,
-        DIAG_SEtoNW,
-        ( HOLE | HOLE_SOUTHEAST )
-    }
-};
+    aRouter.AddObstacle( MAZE_ROUTER::OBSTACLE::Segment( aTrack->GetStart(), aTrack->GetEnd(),
+            aTrack->GetWidth() / 2, routingLayerBits( aTrack->GetLayerSet(), aRouteLayers ),
+            true, aTrack->GetNetCode() ) );
+}
 
 
-/* work from target back to source, actually laying the traces
- *  Parameters:
- *      start on side target_side, of coordinates row_target, col_target.
- *      arrive on side masque_layer_start, coordinate row_source, col_source
- * The search is done in reverse routing, the point of arrival (target) to
- * the starting point (source)
- * The router.
- *
- * Target_side = symbol (TOP / BOTTOM) of departure
- * = Mask_layer_source mask layers Arrival
- *
- * Returns:
- * 0 if error
- * > 0 if Ok
+/* Returns true if the grid point (aRow, aCol) is inside aPad: the route starts from it.
  */
-static int Retrace( PCB_EDIT_FRAME* pcbframe, wxDC* DC,
-                    int row_source, int col_source,
-                    int row_target, int col_target, int target_side,
-                    int current_net_code )
+static bool gridPointInPad( D_PAD* aPad, int aRow, int aCol )
 {
-    int  r0, c0, s0;
-    int  r1, c1, s1;    // row, col, starting side.
-    int  r2, c2, s2;    // row, col, ending side.
-    int  x, y = -1;
-    long b;
+    int dx = aPad->GetSize().x / 2;
+    int dy = aPad->GetSize().y / 2;
+    int cx = RoutingMatrix.GetBrdCoordOrigin().x + RoutingMatrix.m_GridRouting * aCol;
+    int cy = RoutingMatrix.GetBrdCoordOrigin().y + RoutingMatrix.m_GridRouting * aRow;
 
-    r1 = row_target;
-    c1 = col_target;    // start point is target ( end point is source )
-    s1 = target_side;
-    r0 = c0 = s0 = ILLEGAL;
+    if( ( ( int( aPad->GetOrientation() ) / 900 ) & 1 ) != 0 )
+        std::swap( dx, dy );
 
-    wxASSERT( g_CurrentTrackList.GetCount() == 0 );
-
-    do
-    {
-        // find where we came from to get here
-        r2 = r1; c2 = c1; s2 = s1;
-        x  = RoutingMatrix.GetDir( r1, c1, s1 );
-
-        switch( x )
-        {
-        case FROM_NORTH:
-            r2++;
-            break;
-
-        case FROM_EAST:
-            c2++;
-            break;
-
-        case FROM_SOUTH:
-            r2--;
-            break;
-
-        case FROM_WEST:
-            c2--;
-            break;
-
-        case FROM_NORTHEAST:
-            r2++;
-            c2++;
-            break;
-
-        case FROM_SOUTHEAST:
-            r2--;
-            c2++;
-            break;
-
-        case FROM_SOUTHWEST:
-            r2--;
-            c2--;
-            break;
-
-        case FROM_NORTHWEST:
-            r2++;
-            c2--;
-            break;
-
-        case FROM_OTHERSIDE:
-            s2 = 1 - s2;
-            break;
-
-        default:
-            wxMessageBox( wxT( "Retrace: internal error: no way back" ) );
-            return 0;
-        }
-
-        if( r0 != ILLEGAL )
-            y = RoutingMatrix.GetDir( r0, c0, s0 );
-
-        // see if target or hole
-        if( ( ( r1 == row_target ) && ( c1 == col_target ) ) || ( s1 != s0 ) )
-        {
-            int p_dir;
-
-            switch( x )
-            {
-            case FROM_NORTH:
-                p_dir = HOLE_NORTH;
-                break;
-
-            case FROM_EAST:
-                p_dir = HOLE_EAST;
-                break;
+    return abs( cx - aPad->GetPosition().x ) <= dx && abs( cy - aPad->GetPosition().y ) <= dy;
+}
 
-            case FROM_SOUTH:
-                p_dir = HOLE_SOUTH;
-                break;
 
-            case FROM_WEST:
-                p_dir = HOLE_WEST;
-                break;
+/* Called by the router after each batch: asks for confirmation if escape was pressed.
+ */
+static bool abortRouting( PCB_EDIT_FRAME* aFrame )
+{
+    wxYield();
 
-            case FROM_NORTHEAST:
-                p_dir = HOLE_NORTHEAST;
-                break;
+    if( !aFrame->GetCanvas()->GetAbortRequest() )
+        return false;
 
-            case FROM_SOUTHEAST:
-                p_dir = HOLE_SOUTHEAST;
-                break;
+    if( IsOK( aFrame, _( "Abort routing?" ) ) )
+        return true;
 
-            case FROM_SOUTHWEST:
-                p_dir = HOLE_SOUTHWEST;
-                break;
+    aFrame->GetCanvas()->SetAbortRequest( false );
+    return false;
+}
 
-            case FROM_NORTHWEST:
-                p_dir = HOLE_NORTHWEST;
-                break;
 
-            case FROM_OTHERSIDE:
-            default:
-                DisplayError( pcbframe, wxT( "Retrace: error 1" ) );
-                return 0;
-            }
+/* Inserts the tracks and vias of a route in the board.
+ */
+static void commitRoute( PCB_EDIT_FRAME* aFrame, wxDC* aDC,
+                         const std::vector<LAYER_ID>& aRouteLayers,
+                         const std::vector<RATSNEST_ITEM*>& aRatsnest,
+                         int aIndex, const MAZE_ROUTER::ROUTE& aRoute )
+{
+    BOARD*         pcb = aFrame->GetBoard();
+    RATSNEST_ITEM* rats = aRatsnest[aIndex];
+    int            netcode = rats->GetNet();
 
-            OrCell_Trace( pcbframe->GetBoard(), r1, c1, s1, p_dir, current_net_code );
-        }
-        else
-        {
-            if( ( y == FROM_NORTH || y == FROM_NORTHEAST
-                  || y == FROM_EAST || y == FROM_SOUTHEAST
-                  || y == FROM_SOUTH || y == FROM_SOUTHWEST
-                  || y == FROM_WEST || y == FROM_NORTHWEST )
-               && ( x == FROM_NORTH || x == FROM_NORTHEAST
-                    || x == FROM_EAST || x == FROM_SOUTHEAST
-                    || x == FROM_SOUTH || x == FROM_SOUTHWEST
-                    || x == FROM_WEST || x == FROM_NORTHWEST
-                    || x == FROM_OTHERSIDE )
-               && ( ( b = bit[y - 1][x - 1] ) != 0 ) )
-            {
-                OrCell_Trace( pcbframe->GetBoard(), r1, c1, s1, b, current_net_code );
-
-                if( b & HOLE )
-                    OrCell_Trace( pcbframe->GetBoard(), r2, c2, s2, HOLE, current_net_code );
-            }
-            else
-            {
-                wxMessageBox( wxT( "Retrace: error 2" ) );
-                return 0;
-            }
-        }
+    std::vector<TRACK*> newTracks;
 
-        if( ( r2 == row_source ) && ( c2 == col_source ) ) // see if source
-        {
-            int p_dir;
+    for( unsigned i = 0; i < aRoute.m_segments.size(); i++ )
+    {
+        const MAZE_ROUTER::ROUTE::SEGMENT& s = aRoute.m_segments[i];
+        TRACK* track = new TRACK( pcb );
+
+        track->SetState( TRACK_AR, true );
+        track->SetLayer( aRouteLayers[s.m_layer] );
+        track->SetStart( wxPoint( s.m_a.x, s.m_a.y ) );
+        track->SetEnd( wxPoint( s.m_b.x, s.m_b.y ) );
+        track->SetWidth( pcb->GetDesignSettings().GetCurrentTrackWidth() );
+        track->SetNetCode( netcode );
+        newTracks.push_back( track );
+    }
 
-            switch( x )
-            {
-            case FROM_NORTH:
-                p_dir = HOLE_SOUTH;
-                break;
+    if( !newTracks.empty() )
+    {
+        TRACK* first = newTracks.front();
+        TRACK* last = newTracks.back();
 
-            case FROM_EAST:
-                p_dir = HOLE_WEST;
-                break;
+        first->start = pcb->GetPad( first, ENDPOINT_START );
 
-            case FROM_SOUTH:
-                p_dir = HOLE_NORTH;
-                break;
+        if( first->start )
+            first->SetState( BEGIN_ONPAD, true );
 
-            case FROM_WEST:
-                p_dir = HOLE_EAST;
-                break;
+        last->end = pcb->GetPad( last, ENDPOINT_END );
 
-            case FROM_NORTHEAST:
-                p_dir = HOLE_SOUTHWEST;
-                break;
+        if( last->end )
+            last->SetState( END_ONPAD, true );
+    }
 
-            case FROM_SOUTHEAST:
-                p_dir = HOLE_NORTHWEST;
-                break;
+    // The router only places through vias
+    for( unsigned i = 0; i < aRoute.m_vias.size(); i++ )
+    {
+        VIA* via = new VIA( pcb );
+
+        via->SetState( TRACK_AR, true );
+        via->SetViaType( VIA_THROUGH );
+        via->SetLayerPair( F_Cu, B_Cu );
+        via->SetStart( wxPoint( aRoute.m_vias[i].x, aRoute.m_vias[i].y ) );
+        via->SetEnd( via->GetStart() );
+        via->SetWidth( pcb->GetDesignSettings().GetCurrentViaSize() );
+        via->SetNetCode( netcode );
+        newTracks.push_back( via );
+    }
 
-            case FROM_SOUTHWEST:
-                p_dir = HOLE_NORTHEAST;
-                break;
+    if( newTracks.empty() )
+        return;
 
-            case FROM_NORTHWEST:
-                p_dir = HOLE_SOUTHEAST;
-                break;
+    TRACK* insertBeforeMe = newTracks[0]->GetBestInsertPoint( pcb );
 
-            case FROM_OTHERSIDE:
-            default:
-                wxMessageBox( wxT( "Retrace: error 3" ) );
-                return 0;
-            }
+    for( unsigned i = 0; i < newTracks.size(); i++ )
+    {
+        ITEM_PICKER picker( newTracks[i], UR_NEW );
+        s_ItemsListPicker.PushItem( picker );
+        pcb->m_Track.Insert( newTracks[i], insertBeforeMe );
+    }
 
-            OrCell_Trace( pcbframe->GetBoard(), r2, c2, s2, p_dir, current_net_code );
-        }
+    DrawTraces( aFrame->GetCanvas(), aDC, newTracks[0], newTracks.size(), GR_OR );
 
-        // move to next cell
-        r0 = r1;
-        c0 = c1;
-        s0 = s1;
-        r1 = r2;
-        c1 = c2;
-        s1 = s2;
-    } while( !( ( r2 == row_source ) && ( c2 == col_source ) ) );
-
-    AddNewTrace( pcbframe, DC );
-    return 1;
+    aFrame->TestNetConnection( aDC, netcode );
+    aFrame->GetScreen()->SetModify();
 }
 
 
-/* This function is used by Retrace and read the autorouting matrix data cells to create
- * the real track on the physical board
+/* Route all traces
+ * :
+ *  1 if OK
+ * -1 if escape (stop being routed) request
  */
-static void OrCell_Trace( BOARD* pcb, int col, int row,
-                          int side, int orient, int current_net_code )
+int PCB_EDIT_FRAME::Solve( wxDC* DC, int aLayersCount )
 {
-    if( orient == HOLE )  // placement of a via
-    {
-        VIA *newVia = new VIA( pcb );
-
-        g_CurrentTrackList.PushBack( newVia );
+    int           row_source, col_source, row_target, col_target;
+    int           current_net_code;
+    int           nbsucces = 0, nbunsucces = 0;
+    RATSNEST_ITEM* pt_cur_ch;
+    wxString      msg;
+    BOARD*        pcb = GetBoard();
+    wxBusyCursor  dummy_cursor;
 
-        g_CurrentTrackSegment->SetState( TRACK_AR, true );
-        g_CurrentTrackSegment->SetLayer( F_Cu );
+    m_canvas->SetAbortRequest( false );
 
-        g_CurrentTrackSegment->SetStart(wxPoint( pcb->GetBoundingBox().GetX() +
-                                                ( RoutingMatrix.m_GridRouting * row ),
-                                                pcb->GetBoundingBox().GetY() +
-                                                ( RoutingMatrix.m_GridRouting * col )));
-        g_CurrentTrackSegment->SetEnd( g_CurrentTrackSegment->GetStart() );
+    // Prepare the undo command info
+    s_ItemsListPicker.ClearListAndDeleteItems();  // Should not be necessary, but...
 
-        g_CurrentTrackSegment->SetWidth( pcb->GetDesignSettings().GetCurrentViaSize() );
-        newVia->SetViaType( pcb->GetDesignSettings().m_CurrentViaType );
+    // Routing layers: the selected layer pair, and the inner layers between them
+    std::vector<LAYER_ID> routeLayers;
 
-        g_CurrentTrackSegment->SetNetCode( current_net_code );
+    if( aLayersCount == 1 )
+    {
+        routeLayers.push_back( g_Route_Layer_BOTTOM );
     }
-    else    // placement of a standard segment
+    else
     {
-        TRACK *newTrack = new TRACK( pcb );
-        int    dx0, dy0, dx1, dy1;
-
-
-        g_CurrentTrackList.PushBack( newTrack );
-
-        g_CurrentTrackSegment->SetLayer( g_Route_Layer_BOTTOM );
+        LSET cu = LSET::AllCuMask( pcb->GetCopperLayerCount() );
+        int  first = std::min( g_Route_Layer_TOP, g_Route_Layer_BOTTOM );
+        int  last = std::max( g_Route_Layer_TOP, g_Route_Layer_BOTTOM );
 
-        if( side == TOP )
-            g_CurrentTrackSegment->SetLayer( g_Route_Layer_TOP );
-
-        g_CurrentTrackSegment->SetState( TRACK_AR, true );
-        g_CurrentTrackSegment->SetEnd( wxPoint( pcb->GetBoundingBox().GetX() +
-                                         ( RoutingMatrix.m_GridRouting * row ),
-                                         pcb->GetBoundingBox().GetY() +
-                                         ( RoutingMatrix.m_GridRouting * col )));
-        g_CurrentTrackSegment->SetNetCode( current_net_code );
-
-        if( g_CurrentTrackSegment->Back() == NULL ) // Start trace.
+        for( int layer = first; layer <= last; layer++ )
         {
-            g_CurrentTrackSegment->SetStart( wxPoint( segm_fX, segm_fY ) );
+            if( cu[layer] )
+                routeLayers.push_back( (LAYER_ID) layer );
+        }
+    }
 
-            // Placement on the center of the pad if outside grid.
-            dx1 = g_CurrentTrackSegment->GetEnd().x - g_CurrentTrackSegment->GetStart().x;
-            dy1 = g_CurrentTrackSegment->GetEnd().y - g_CurrentTrackSegment->GetStart().y;
+    MAZE_ROUTER::PARAMS params;
 
-            dx0 = pt_cur_ch->m_PadEnd->GetPosition().x - g_CurrentTrackSegment->GetStart().x;
-            dy0 = pt_cur_ch->m_PadEnd->GetPosition().y - g_CurrentTrackSegment->GetStart().y;
+    params.m_origin      = RoutingMatrix.GetBrdCoordOrigin();
+    params.m_rows        = RoutingMatrix.m_Nrows;
+    params.m_cols        = RoutingMatrix.m_Ncols;
+    params.m_gridSize    = RoutingMatrix.m_GridRouting;
+    params.m_layerCount  = routeLayers.size();
+    params.m_trackWidth  = GetDesignSettings().GetCurrentTrackWidth();
+    params.m_viaDiameter = GetDesignSettings().GetCurrentViaSize();
+    params.m_clearance   = pcb->GetDesignSettings().GetDefault()->GetClearance();
 
-            // If aligned, change the origin point.
-            if( abs( dx0 * dy1 ) == abs( dx1 * dy0 ) )
-            {
-                g_CurrentTrackSegment->SetStart( pt_cur_ch->m_PadEnd->GetPosition() );
-            }
-            else    // Creation of a supplemental segment
-            {
-                g_CurrentTrackSegment->SetStart( pt_cur_ch->m_PadEnd->GetPosition() );
+    MAZE_ROUTER router( params );
 
-                newTrack = (TRACK*)g_CurrentTrackSegment->Clone();
-                newTrack->SetStart( g_CurrentTrackSegment->GetEnd());
+    SetStatusText( wxT( "Gen Cells" ) );
 
-                g_CurrentTrackList.PushBack( newTrack );
-            }
-        }
-        else
+    for( unsigned ii = 0; ii < pcb->GetPadCount(); ii++ )
+        addPadObstacle( router, pcb->GetPad( ii ), routeLayers );
+
+    for( MODULE* module = pcb->m_Modules; module; module = module->Next() )
+    {
+        for( BOARD_ITEM* item = module->GraphicalItems(); item; item = item->Next() )
         {
-            if( g_CurrentTrackSegment->Back() )
-            {
-                g_CurrentTrackSegment->SetStart( g_CurrentTrackSegment->Back()->GetEnd() );
-            }
+            if( item->Type() == PCB_MODULE_EDGE_T )
+                addDrawSegmentObstacle( router, (EDGE_MODULE*) item, routeLayers );
         }
+    }
 
-        g_CurrentTrackSegment->SetWidth( pcb->GetDesignSettings().GetCurrentTrackWidth() );
-
-        if( g_CurrentTrackSegment->GetStart() != g_CurrentTrackSegment->GetEnd() )
+    for( BOARD_ITEM* item = pcb->m_Drawings; item; item = item->Next() )
+    {
+        switch( item->Type() )
         {
-            // Reduce aligned segments by one.
-            TRACK* oldTrack = g_CurrentTrackSegment->Back();
-
-            if( oldTrack &&  oldTrack->Type() != PCB_VIA_T )
-            {
-                dx1 = g_CurrentTrackSegment->GetEnd().x - g_CurrentTrackSegment->GetStart().x;
-                dy1 = g_CurrentTrackSegment->GetEnd().y - g_CurrentTrackSegment->GetStart().y;
-
-                dx0 = oldTrack->GetEnd().x - oldTrack->GetStart().x;
-                dy0 = oldTrack->GetEnd().y - oldTrack->GetStart().y;
+        case PCB_LINE_T:
+            addDrawSegmentObstacle( router, (DRAWSEGMENT*) item, routeLayers );
+            break;
 
-                if( abs( dx0 * dy1 ) == abs( dx1 * dy0 ) )
-                {
-                    oldTrack->SetEnd( g_CurrentTrackSegment->GetEnd() );
+        case PCB_TEXT_T:
+            addTextObstacle( router, (TEXTE_PCB*) item, routeLayers );
+            break;
 
-                    delete g_CurrentTrackList.PopBack();
-                }
-            }
+        default:
+            break;
         }
     }
-}
 
+    for( TRACK* track = pcb->m_Track; track; track = track->Next() )
+        addTrackObstacle( router, track, routeLayers );
 
-/* Insert the new track created in the list of tracks.
- * amend the points of beginning and end of the track so that they are
- * connected
- * Center on pads even if they are off grid.
- */
-static void AddNewTrace( PCB_EDIT_FRAME* pcbframe, wxDC* DC )
-{
-    if( g_FirstTrackSegment == NULL )
-        return;
-
-    int dx0, dy0, dx1, dy1;
-    int marge, via_marge;
-    EDA_DRAW_PANEL* panel = pcbframe->GetCanvas();
-    PCB_SCREEN* screen = pcbframe->GetScreen();
-
-    marge = s_Clearance + ( pcbframe->GetDesignSettings().GetCurrentTrackWidth() / 2 );
-    via_marge = s_Clearance + ( pcbframe->GetDesignSettings().GetCurrentViaSize() / 2 );
+    // Queue the work list, shortest connections first
+    std::vector<RATSNEST_ITEM*> ratsnest;
 
-    dx1 = g_CurrentTrackSegment->GetEnd().x - g_CurrentTrackSegment->GetStart().x;
-    dy1 = g_CurrentTrackSegment->GetEnd().y - g_CurrentTrackSegment->GetStart().y;
-
-    // Place on center of pad if off grid.
-    dx0 = pt_cur_ch->m_PadStart->GetPosition().x - g_CurrentTrackSegment->GetStart().x;
-    dy0 = pt_cur_ch->m_PadStart->GetPosition().y - g_CurrentTrackSegment->GetStart().y;
-
-    // If aligned, change the origin point.
-    if( abs( dx0 * dy1 ) == abs( dx1 * dy0 ) )
-    {
-        g_CurrentTrackSegment->SetEnd( pt_cur_ch->m_PadStart->GetPosition() );
-    }
-    else
+    for( GetWork( &row_source, &col_source, &current_net_code,
+                  &row_target, &col_target, &pt_cur_ch );
+         row_source != ILLEGAL;
+         GetWork( &row_source, &col_source, &current_net_code,
+                  &row_target, &col_target, &pt_cur_ch ) )
     {
-        TRACK* newTrack = (TRACK*)g_CurrentTrackSegment->Clone();
+        MAZE_ROUTER::CONNECTION c;
+        LSET startLayers = pt_cur_ch->m_PadStart->GetLayerSet();
+        LSET endLayers = pt_cur_ch->m_PadEnd->GetLayerSet();
+
+        c.m_sourceRow = row_source;
+        c.m_sourceCol = col_source;
+        c.m_targetRow = row_target;
+        c.m_targetCol = col_target;
+        c.m_sourcePos = pt_cur_ch->m_PadStart->GetPosition();
+        c.m_targetPos = pt_cur_ch->m_PadEnd->GetPosition();
+        c.m_sourceLayers = routingLayerBits( startLayers, routeLayers );
+        c.m_targetLayers = routingLayerBits( endLayers, routeLayers );
+        c.m_net = current_net_code;
+
+        // The pads must be on the routing layers, and contain their grid point
+        if( !c.m_sourceLayers || !c.m_targetLayers ||
+            !gridPointInPad( pt_cur_ch->m_PadStart, row_source, col_source ) ||
+            !gridPointInPad( pt_cur_ch->m_PadEnd, row_target, col_target ) )
+        {
+            pt_cur_ch->m_Status |= CH_UNROUTABLE;
+            nbunsucces++;
+            continue;
+        }
 
-        newTrack->SetEnd( pt_cur_ch->m_PadStart->GetPosition() );
-        newTrack->SetStart( g_CurrentTrackSegment->GetEnd() );
+        // Trivial case: the pads overlap
+        if( row_source == row_target && col_source == col_target &&
+            ( startLayers & endLayers & LSET::AllCuMask() ).any() )
+        {
+            nbsucces++;
+            continue;
+        }
 
-        g_CurrentTrackList.PushBack( newTrack );
+        ratsnest.push_back( pt_cur_ch );
+        router.AddConnection( c );
     }
 
-    g_FirstTrackSegment->start = pcbframe->GetBoard()->GetPad( g_FirstTrackSegment,
-            ENDPOINT_START );
-
-    if( g_FirstTrackSegment->start )
-        g_FirstTrackSegment->SetState( BEGIN_ONPAD, true );
+    router.SetCommitHook( boost::bind( commitRoute, this, DC, boost::cref( routeLayers ),
+                                       boost::cref( ratsnest ), _1, _2 ) );
+    router.SetAbortHook( boost::bind( abortRouting, this ) );
 
-    g_CurrentTrackSegment->end = pcbframe->GetBoard()->GetPad( g_CurrentTrackSegment,
-            ENDPOINT_END );
+    SetStatusText( _( "Routing" ) );
 
-    if( g_CurrentTrackSegment->end )
-        g_CurrentTrackSegment->SetState( END_ONPAD, true );
+    bool completed = router.Route();
 
-    // Out the new track on the matrix board
-    for( TRACK* track = g_FirstTrackSegment; track; track = track->Next() )
+    for( unsigned ii = 0; ii < ratsnest.size(); ii++ )
     {
-        TraceSegmentPcb( track, HOLE, marge, WRITE_CELL );
-        TraceSegmentPcb( track, VIA_IMPOSSIBLE, via_marge, WRITE_OR_CELL );
+        if( !router.IsRouted( ii ) && completed )
+            ratsnest[ii]->m_Status |= CH_UNROUTABLE;
     }
 
-    // Insert new segments in  real board
-    int    netcode    = g_FirstTrackSegment->GetNetCode();
-    TRACK* firstTrack = g_FirstTrackSegment;
-    int    newCount   = g_CurrentTrackList.GetCount();
+    const MAZE_ROUTER::STATS& stats = router.Stats();
 
-    // Put entire new current segment list in BOARD
-    TRACK* track;
-    TRACK* insertBeforeMe = g_CurrentTrackSegment->GetBestInsertPoint( pcbframe->GetBoard() );
+    nbsucces += stats.m_routed;
 
-    while( ( track = g_CurrentTrackList.PopFront() ) != NULL )
-    {
-        ITEM_PICKER picker( track, UR_NEW );
-        s_ItemsListPicker.PushItem( picker );
-        pcbframe->GetBoard()->m_Track.Insert( track, insertBeforeMe );
-    }
+    if( completed )
+        nbunsucces += stats.m_failed;
 
-    DrawTraces( panel, DC, firstTrack, newCount, GR_OR );
+    EraseMsgBox();
+    msg.Printf( wxT( "%d" ), nbsucces );
+    AppendMsgPanel( wxT( "OK" ), msg, GREEN );
+    msg.Printf( wxT( "%d" ), nbunsucces );
+    AppendMsgPanel( wxT( "Fail" ), msg, RED );
+    msg.Printf( wxT( "  %d" ), pcb->GetUnconnectedNetCount() );
+    AppendMsgPanel( wxT( "Not Connected" ), msg, CYAN );
+    msg.Printf( wxT( "%.0f ms" ), stats.m_msecs );
+    AppendMsgPanel( wxT( "Time" ), msg, BROWN );
 
-    pcbframe->TestNetConnection( DC, netcode );
+    SaveCopyInUndoList( s_ItemsListPicker, UR_UNSPECIFIED );
+    s_ItemsListPicker.ClearItemsList(); // s_ItemsListPicker is no more owner of picked items
 
-    screen->SetModify();
+    return completed ? 1 : -1;
 }
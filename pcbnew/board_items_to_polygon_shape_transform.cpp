@@ -46,6 +46,7 @@
 #include <class_module.h>
 #include <class_edge_mod.h>
 #include <convert_basic_shapes_to_polygon.h>
+#include <clearance_poly_cache.h>
 
 // These variables are parameters used in addTextSegmToPoly.
 // But addTextSegmToPoly is a call-back function,
@@ -75,7 +76,7 @@ void BOARD::ConvertBrdLayerToPolygonalContours( LAYER_ID aLayer, SHAPE_POLY_SET&
         if( !track->IsOnLayer( aLayer ) )
             continue;
 
-        track->TransformShapeWithClearanceToPolygon( aOutlines,
+        m_clearancePolyCache->TransformShapeWithClearanceToPolygon( track, aOutlines,
                 0, segcountforcircle, correctionFactor );
     }
 
@@ -135,6 +136,10 @@ void MODULE::TransformPadsShapesWithClearanceToPolygon( LAYER_ID aLayer,
 {
     D_PAD* pad = Pads();
 
+    // Footprints outside of a board (in the library) have no cache
+    BOARD* board = GetBoard();
+    CLEARANCE_POLY_CACHE* polyCache = board ? board->GetClearancePolyCache() : NULL;
+
     wxSize margin;
     for( ; pad != NULL; pad = pad->Next() )
     {
@@ -184,8 +189,12 @@ void MODULE::TransformPadsShapesWithClearanceToPolygon( LAYER_ID aLayer,
             break;
         }
 
-        pad->BuildPadShapePolygon( aCornerBuffer, margin,
-                                   aCircleToSegmentsCount, aCorrectionFactor );
+        if( polyCache )
+            polyCache->BuildPadShapePolygon( pad, aCornerBuffer, margin,
+                                             aCircleToSegmentsCount, aCorrectionFactor );
+        else
+            pad->BuildPadShapePolygon( aCornerBuffer, margin,
+                                       aCircleToSegmentsCount, aCorrectionFactor );
     }
 }
 
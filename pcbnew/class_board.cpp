@@ -44,6 +44,7 @@
 #include <ratsnest_data.h>
 #include <ratsnest_viewitem.h>
 #include <worksheet_viewitem.h>
+#include <clearance_poly_cache.h>
 
 #include <pcbnew.h>
 #include <colors_selection.h>
@@ -107,6 +108,8 @@ BOARD::BOARD() :
 
     // Initialize ratsnest
     m_ratsnest = new RN_DATA( this );
+
+    m_clearancePolyCache = new CLEARANCE_POLY_CACHE;
 }
 
 
@@ -119,6 +122,7 @@ BOARD::~BOARD()
     }
 
     delete m_ratsnest;
+    delete m_clearancePolyCache;
 
     m_FullRatsnest.clear();
     m_LocalRatsnest.clear();
@@ -823,6 +827,7 @@ BOARD_ITEM* BOARD::Remove( BOARD_ITEM* aBoardItem )
     }
 
     m_ratsnest->Remove( aBoardItem );
+    m_clearancePolyCache->Remove( aBoardItem );
 
     return aBoardItem;
 }
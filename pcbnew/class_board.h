@@ -57,6 +57,7 @@ class MSG_PANEL_ITEM;
 class NETLIST;
 class REPORTER;
 class RN_DATA;
+class CLEARANCE_POLY_CACHE;
 class SHAPE_POLY_SET;
 
 // non-owning container of item candidates when searching for items on the same track.
@@ -191,6 +192,7 @@ private:
     EDA_RECT                m_BoundingBox;
     NETINFO_LIST            m_NetInfo;              ///< net info list (name, design constraints ..
     RN_DATA*                m_ratsnest;
+    CLEARANCE_POLY_CACHE*   m_clearancePolyCache;
 
     BOARD_DESIGN_SETTINGS   m_designSettings;
     ZONE_SETTINGS           m_zoneSettings;
@@ -314,6 +316,16 @@ public:
         return m_ratsnest;
     }
 
+    /**
+     * Function GetClearancePolyCache()
+     * returns the cache of the pad, track and via polygons used to fill zones,
+     * build the 3D view and plot the board.
+     */
+    CLEARANCE_POLY_CACHE* GetClearancePolyCache() const
+    {
+        return m_clearancePolyCache;
+    }
+
     /**
      * Function DeleteMARKERs
      * deletes ALL MARKERS from the board.
@@ -976,6 +976,22 @@ unsigned int D_PAD::ViewGetLOD( int aLayer ) const
 }
 
 
+unsigned int D_PAD::ViewGetDetailLOD( int aLayer ) const
+{
+    // Circles are a single primitive, there is nothing to simplify. Holes and netnames
+    // are either shown as they are or hidden.
+    if( m_padShape == PAD_SHAPE_CIRCLE || IsNetnameLayer( aLayer ) ||
+        aLayer == ITEM_GAL_LAYER( PADS_HOLES_VISIBLE ) )
+        return 0;
+
+    if( ( m_Size.x == 0 ) && ( m_Size.y == 0 ) )
+        return 0;
+
+    // Pads smaller than a few pixels are drawn as their bounding boxes
+    return ( Millimeter2iu( 15 ) / std::max( m_Size.x, m_Size.y ) );
+}
+
+
 const BOX2I D_PAD::ViewBBox() const
 {
     // Bounding box includes soldermask too
@@ -485,6 +485,9 @@ public:
     /// @copydoc VIEW_ITEM::ViewGetLOD()
     virtual unsigned int ViewGetLOD( int aLayer ) const;
 
+    /// @copydoc VIEW_ITEM::ViewGetDetailLOD()
+    virtual unsigned int ViewGetDetailLOD( int aLayer ) const;
+
     /// @copydoc VIEW_ITEM::ViewBBox()
     virtual const BOX2I ViewBBox() const;
 
@@ -484,6 +484,12 @@ unsigned int TEXTE_MODULE::ViewGetLOD( int aLayer ) const
                                     !m_view->IsLayerVisible( ITEM_GAL_LAYER( MOD_BK_VISIBLE ) ) ) )
         return MAX;
 
+    // Texts smaller than a few pixels are unreadable, and have a lot of strokes to draw
+    int size = std::max( m_Size.x, m_Size.y );
+
+    if( size > 0 )
+        return ( Millimeter2iu( 10 ) / size );
+
     return 0;
 }
 
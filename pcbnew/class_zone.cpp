@@ -109,6 +109,9 @@ ZONE_CONTAINER::~ZONE_CONTAINER()
 {
     delete m_Poly;
     m_Poly = NULL;
+
+    delete m_smoothedPoly;
+    m_smoothedPoly = NULL;
 }
 
 
@@ -118,6 +121,15 @@ EDA_ITEM* ZONE_CONTAINER::Clone() const
 }
 
 
+void ZONE_CONTAINER::SwapFilledAreas( ZONE_CONTAINER& aZone )
+{
+    std::swap( m_FilledPolysList, aZone.m_FilledPolysList );
+    std::swap( m_smoothedPoly, aZone.m_smoothedPoly );
+    std::swap( m_IsFilled, aZone.m_IsFilled );
+    m_FillSegmList.swap( aZone.m_FillSegmList );
+}
+
+
 bool ZONE_CONTAINER::UnFill()
 {
     bool change = ( !m_FilledPolysList.IsEmpty() ) ||
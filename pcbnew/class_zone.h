@@ -487,6 +487,14 @@ public:
         m_FilledPolysList = aPolysList;
     }
 
+    /**
+     * Function SwapFilledAreas
+     * exchanges the fill data (filled polygons, fill segments, smoothed outline and
+     * fill status) of this zone and aZone.  Used to commit the fill of a copy of this
+     * zone, built outside of the board.
+     */
+    void SwapFilledAreas( ZONE_CONTAINER& aZone );
+
     /**
      * Function GetSmoothedPoly
      * returns a pointer to the corner-smoothed version of
@@ -549,6 +557,13 @@ public:
 private:
     void buildFeatureHoleList( BOARD* aPcb, SHAPE_POLY_SET& aFeatures );
 
+    /**
+     * Function buildSmoothedPoly
+     * @return a new corner-smoothed copy of m_Poly, owned by the caller.
+     * Does not modify the zone, so it can be used while the zone is being filled.
+     */
+    CPolyLine* buildSmoothedPoly() const;
+
     CPolyLine*            m_Poly;                ///< Outline of the zone.
     CPolyLine*            m_smoothedPoly;        // Corner-smoothed version of m_Poly
     int                   m_cornerSmoothingType;
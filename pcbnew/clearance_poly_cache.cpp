@@ -0,0 +1,346 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file clearance_poly_cache.cpp
+ */
+
+#include <fctsys.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <class_board.h>
+#include <class_module.h>
+#include <class_pad.h>
+#include <class_track.h>
+
+#include <clearance_poly_cache.h>
+
+
+static void hashPoint( std::size_t& aSeed, const wxPoint& aPoint )
+{
+    boost::hash_combine( aSeed, aPoint.x );
+    boost::hash_combine( aSeed, aPoint.y );
+}
+
+
+static void hashSize( std::size_t& aSeed, const wxSize& aSize )
+{
+    boost::hash_combine( aSeed, aSize.x );
+    boost::hash_combine( aSeed, aSize.y );
+}
+
+
+CLEARANCE_POLY_CACHE::CLEARANCE_POLY_CACHE() :
+    m_hits( 0 ),
+    m_misses( 0 )
+{
+}
+
+
+CLEARANCE_POLY_CACHE::SHAPE_KEY::SHAPE_KEY() :
+    m_type( 0 ),
+    m_orient( 0.0 ),
+    m_shape( 0 )
+{
+}
+
+
+bool CLEARANCE_POLY_CACHE::SHAPE_KEY::operator==( const SHAPE_KEY& aOther ) const
+{
+    return m_type == aOther.m_type && m_start == aOther.m_start && m_end == aOther.m_end
+           && m_size == aOther.m_size && m_delta == aOther.m_delta
+           && m_orient == aOther.m_orient && m_shape == aOther.m_shape;
+}
+
+
+CLEARANCE_POLY_CACHE::SHAPE_KEY CLEARANCE_POLY_CACHE::shapeKey( const BOARD_ITEM* aItem )
+{
+    SHAPE_KEY key;
+
+    key.m_type = aItem->Type();
+
+    switch( aItem->Type() )
+    {
+    case PCB_PAD_T:
+    {
+        const D_PAD* pad = static_cast<const D_PAD*>( aItem );
+
+        key.m_start  = pad->GetPosition();
+        key.m_end    = pad->GetOffset();
+        key.m_size   = pad->GetSize();
+        key.m_delta  = pad->GetDelta();
+        key.m_orient = pad->GetOrientation();
+        key.m_shape  = pad->GetShape();
+        break;
+    }
+
+    case PCB_TRACE_T:
+    case PCB_VIA_T:
+    {
+        const TRACK* track = static_cast<const TRACK*>( aItem );
+
+        key.m_start = track->GetStart();
+        key.m_end   = track->GetEnd();
+        key.m_size  = wxSize( track->GetWidth(), track->GetWidth() );
+        break;
+    }
+
+    default:
+    {
+        EDA_RECT bbox = aItem->GetBoundingBox();
+
+        key.m_start = bbox.GetOrigin();
+        key.m_size  = bbox.GetSize();
+        break;
+    }
+    }
+
+    return key;
+}
+
+
+std::size_t CLEARANCE_POLY_CACHE::ShapeHash( const BOARD_ITEM* aItem )
+{
+    SHAPE_KEY   key = shapeKey( aItem );
+    std::size_t hash = 0;
+
+    boost::hash_combine( hash, key.m_type );
+    hashPoint( hash, key.m_start );
+    hashPoint( hash, key.m_end );
+    hashSize( hash, key.m_size );
+    hashSize( hash, key.m_delta );
+    boost::hash_combine( hash, key.m_orient );
+    boost::hash_combine( hash, key.m_shape );
+
+    return hash;
+}
+
+
+void CLEARANCE_POLY_CACHE::TransformShapeWithClearanceToPolygon( const D_PAD*    aPad,
+                                                                 SHAPE_POLY_SET& aCornerBuffer,
+                                                                 int             aClearanceValue,
+                                                                 int             aCircleToSegmentsCount,
+                                                                 double          aCorrectionFactor )
+{
+    ENTRY key;
+
+    key.m_kind = SHAPE_WITH_CLEARANCE;
+    key.m_inflate = wxSize( aClearanceValue, aClearanceValue );
+    key.m_segments = aCircleToSegmentsCount;
+    key.m_correction = aCorrectionFactor;
+
+    get( aPad, key, aCornerBuffer );
+}
+
+
+void CLEARANCE_POLY_CACHE::TransformShapeWithClearanceToPolygon( const TRACK*    aTrack,
+                                                                 SHAPE_POLY_SET& aCornerBuffer,
+                                                                 int             aClearanceValue,
+                                                                 int             aCircleToSegmentsCount,
+                                                                 double          aCorrectionFactor )
+{
+    ENTRY key;
+
+    key.m_kind = SHAPE_WITH_CLEARANCE;
+    key.m_inflate = wxSize( aClearanceValue, aClearanceValue );
+    key.m_segments = aCircleToSegmentsCount;
+    key.m_correction = aCorrectionFactor;
+
+    get( aTrack, key, aCornerBuffer );
+}
+
+
+void CLEARANCE_POLY_CACHE::BuildPadShapePolygon( const D_PAD*    aPad,
+                                                 SHAPE_POLY_SET& aCornerBuffer,
+                                                 wxSize          aInflateValue,
+                                                 int             aSegmentsPerCircle,
+                                                 double          aCorrectionFactor )
+{
+    ENTRY key;
+
+    key.m_kind = PAD_SHAPE_POLYGON;
+    key.m_inflate = aInflateValue;
+    key.m_segments = aSegmentsPerCircle;
+    key.m_correction = aCorrectionFactor;
+
+    get( aPad, key, aCornerBuffer );
+}
+
+
+void CLEARANCE_POLY_CACHE::build( const BOARD_ITEM* aItem, ENTRY& aEntry )
+{
+    if( aItem->Type() == PCB_PAD_T )
+    {
+        const D_PAD* pad = static_cast<const D_PAD*>( aItem );
+
+        if( aEntry.m_kind == PAD_SHAPE_POLYGON )
+            pad->BuildPadShapePolygon( aEntry.m_polys, aEntry.m_inflate,
+                                       aEntry.m_segments, aEntry.m_correction );
+        else
+            pad->TransformShapeWithClearanceToPolygon( aEntry.m_polys, aEntry.m_inflate.x,
+                                                       aEntry.m_segments, aEntry.m_correction );
+    }
+    else
+    {
+        const TRACK* track = static_cast<const TRACK*>( aItem );
+
+        track->TransformShapeWithClearanceToPolygon( aEntry.m_polys, aEntry.m_inflate.x,
+                                                     aEntry.m_segments, aEntry.m_correction );
+    }
+}
+
+
+void CLEARANCE_POLY_CACHE::get( const BOARD_ITEM* aItem, const ENTRY& aKey,
+                                SHAPE_POLY_SET& aCornerBuffer )
+{
+    SHAPE_KEY shape = shapeKey( aItem );
+
+    {
+        MUTLOCK lock( m_lock );
+
+        ITEM_MAP::const_iterator it = m_items.find( aItem );
+
+        if( it != m_items.end() && it->second.m_shape == shape )
+        {
+            const std::vector<ENTRY>& entries = it->second.m_entries;
+
+            for( unsigned ii = 0; ii < entries.size(); ii++ )
+            {
+                if( entries[ii].Matches( aKey.m_kind, aKey.m_inflate,
+                                         aKey.m_segments, aKey.m_correction ) )
+                {
+                    aCornerBuffer.Append( entries[ii].m_polys );
+                    m_hits++;
+                    return;
+                }
+            }
+        }
+    }
+
+    // Build the polygon without holding the lock, other threads can use the cache meanwhile
+    ENTRY entry = aKey;
+    build( aItem, entry );
+    aCornerBuffer.Append( entry.m_polys );
+
+    MUTLOCK lock( m_lock );
+
+    m_misses++;
+
+    ITEM_ENTRIES& cached = m_items[aItem];
+
+    if( cached.m_shape != shape )
+    {
+        // The item was modified (or is new): its old polygons are useless
+        cached.m_shape = shape;
+        cached.m_entries.clear();
+    }
+
+    for( unsigned ii = 0; ii < cached.m_entries.size(); ii++ )
+    {
+        // Already added by another thread
+        if( cached.m_entries[ii].Matches( aKey.m_kind, aKey.m_inflate,
+                                          aKey.m_segments, aKey.m_correction ) )
+            return;
+    }
+
+    if( cached.m_entries.size() >= MAX_ENTRIES_PER_ITEM )
+        cached.m_entries.erase( cached.m_entries.begin() );
+
+    cached.m_entries.push_back( entry );
+}
+
+
+void CLEARANCE_POLY_CACHE::Remove( const BOARD_ITEM* aItem )
+{
+    MUTLOCK lock( m_lock );
+
+    m_items.erase( aItem );
+
+    if( aItem->Type() == PCB_MODULE_T )
+    {
+        const MODULE* module = static_cast<const MODULE*>( aItem );
+
+        for( const D_PAD* pad = module->Pads();  pad;  pad = pad->Next() )
+            m_items.erase( pad );
+    }
+}
+
+
+void CLEARANCE_POLY_CACHE::Prune( const BOARD* aBoard )
+{
+    boost::unordered_set<const BOARD_ITEM*> onBoard;
+
+    for( const TRACK* track = aBoard->m_Track;  track;  track = track->Next() )
+        onBoard.insert( track );
+
+    for( const MODULE* module = aBoard->m_Modules;  module;  module = module->Next() )
+    {
+        for( const D_PAD* pad = module->Pads();  pad;  pad = pad->Next() )
+            onBoard.insert( pad );
+    }
+
+    MUTLOCK lock( m_lock );
+
+    for( ITEM_MAP::iterator it = m_items.begin();  it != m_items.end(); )
+    {
+        if( onBoard.count( it->first ) )
+            ++it;
+        else
+            it = m_items.erase( it );
+    }
+}
+
+
+void CLEARANCE_POLY_CACHE::Clear()
+{
+    MUTLOCK lock( m_lock );
+
+    m_items.clear();
+}
+
+
+int CLEARANCE_POLY_CACHE::GetHitCount() const
+{
+    MUTLOCK lock( m_lock );
+
+    return m_hits;
+}
+
+
+int CLEARANCE_POLY_CACHE::GetMissCount() const
+{
+    MUTLOCK lock( m_lock );
+
+    return m_misses;
+}
+
+
+void CLEARANCE_POLY_CACHE::ResetCounters()
+{
+    MUTLOCK lock( m_lock );
+
+    m_hits = 0;
+    m_misses = 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file clearance_poly_cache.h
+ * @brief Cache of the polygonal shapes (with clearance) of the board items.
+ */
+
+#ifndef CLEARANCE_POLY_CACHE_H
+#define CLEARANCE_POLY_CACHE_H
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <wx/gdicmn.h>
+
+#include <ki_mutex.h>
+#include <geometry/shape_poly_set.h>
+
+class BOARD;
+class BOARD_ITEM;
+class D_PAD;
+class TRACK;
+
+
+/**
+ * Class CLEARANCE_POLY_CACHE
+ * keeps the polygons built by TransformShapeWithClearanceToPolygon() and
+ * BuildPadShapePolygon() for pads, tracks and vias, so an item used several times
+ * (by the fill of each zone it overlaps, by the 3D viewer and by the plotter) is
+ * converted only once.
+ * <p>
+ * A cached polygon is identified by the item, the kind of shape, the inflate value,
+ * the number of segments per circle and the correction factor.  The layer is not
+ * part of the key: the shapes do not depend on it, only the inflate value does.
+ * Each item's polygons are stored with the parameters defining its shape (position,
+ * size, orientation...), compared in full on each lookup: the polygons are rebuilt
+ * as soon as the item is found modified, so the cache never returns a stale shape.
+ * </p><p>
+ * Items deleted without BOARD::Remove() (e.g. by the undo commands) keep their
+ * polygons until the next call to Prune().
+ * </p>
+ * The cache can be used by several threads at the same time.
+ */
+class CLEARANCE_POLY_CACHE
+{
+public:
+    CLEARANCE_POLY_CACHE();
+
+    /**
+     * Function TransformShapeWithClearanceToPolygon
+     * appends to aCornerBuffer the same polygons as
+     * aPad->TransformShapeWithClearanceToPolygon(), building them only if they are
+     * not already cached.
+     */
+    void TransformShapeWithClearanceToPolygon( const D_PAD*    aPad,
+                                               SHAPE_POLY_SET& aCornerBuffer,
+                                               int             aClearanceValue,
+                                               int             aCircleToSegmentsCount,
+                                               double          aCorrectionFactor );
+
+    /**
+     * Function TransformShapeWithClearanceToPolygon
+     * appends to aCornerBuffer the same polygons as
+     * aTrack->TransformShapeWithClearanceToPolygon() (for tracks and vias),
+     * building them only if they are not already cached.
+     */
+    void TransformShapeWithClearanceToPolygon( const TRACK*    aTrack,
+                                               SHAPE_POLY_SET& aCornerBuffer,
+                                               int             aClearanceValue,
+                                               int             aCircleToSegmentsCount,
+                                               double          aCorrectionFactor );
+
+    /**
+     * Function BuildPadShapePolygon
+     * appends to aCornerBuffer the same polygons as aPad->BuildPadShapePolygon(),
+     * building them only if they are not already cached.
+     */
+    void BuildPadShapePolygon( const D_PAD*    aPad,
+                               SHAPE_POLY_SET& aCornerBuffer,
+                               wxSize          aInflateValue,
+                               int             aSegmentsPerCircle,
+                               double          aCorrectionFactor );
+
+    /**
+     * Function Remove
+     * drops the polygons of aItem, and of its pads if it is a footprint.
+     * To be called when an item is removed from the board.
+     */
+    void Remove( const BOARD_ITEM* aItem );
+
+    /**
+     * Function Prune
+     * drops the polygons of the items which are no longer on aBoard.
+     */
+    void Prune( const BOARD* aBoard );
+
+    /**
+     * Function Clear
+     * drops every cached polygon.
+     */
+    void Clear();
+
+    /**
+     * Function ShapeHash
+     * @return a hash of the parameters defining the shape of aItem, which changes
+     * when the item is moved, rotated or resized.  Only the type and the bounding box
+     * are used for items other than pads, tracks and vias.
+     */
+    static std::size_t ShapeHash( const BOARD_ITEM* aItem );
+
+    ///> Number of polygons found in the cache
+    int GetHitCount() const;
+
+    ///> Number of polygons built, i.e. not found in the cache
+    int GetMissCount() const;
+
+    void ResetCounters();
+
+private:
+    enum SHAPE_KIND
+    {
+        SHAPE_WITH_CLEARANCE,       ///< TransformShapeWithClearanceToPolygon()
+        PAD_SHAPE_POLYGON           ///< D_PAD::BuildPadShapePolygon()
+    };
+
+    ///> A polygon and the parameters used to build it
+    struct ENTRY
+    {
+        SHAPE_KIND      m_kind;
+        wxSize          m_inflate;
+        int             m_segments;
+        double          m_correction;
+        SHAPE_POLY_SET  m_polys;
+
+        bool Matches( SHAPE_KIND aKind, const wxSize& aInflate, int aSegments,
+                      double aCorrection ) const
+        {
+            return m_kind == aKind && m_inflate == aInflate && m_segments == aSegments
+                   && m_correction == aCorrection;
+        }
+    };
+
+    ///> The parameters defining the shape of an item (unused ones are left to 0)
+    struct SHAPE_KEY
+    {
+        SHAPE_KEY();
+
+        int         m_type;
+        wxPoint     m_start;        ///< pad position or track start (bbox origin otherwise)
+        wxPoint     m_end;          ///< pad offset or track end
+        wxSize      m_size;         ///< pad size or track width (bbox size otherwise)
+        wxSize      m_delta;
+        double      m_orient;
+        int         m_shape;
+
+        bool operator==( const SHAPE_KEY& aOther ) const;
+        bool operator!=( const SHAPE_KEY& aOther ) const { return !( *this == aOther ); }
+    };
+
+    static SHAPE_KEY shapeKey( const BOARD_ITEM* aItem );
+
+    ///> The cached polygons of an item, valid as long as its shape is the same
+    struct ITEM_ENTRIES
+    {
+        SHAPE_KEY           m_shape;
+        std::vector<ENTRY>  m_entries;
+    };
+
+    typedef boost::unordered_map<const BOARD_ITEM*, ITEM_ENTRIES> ITEM_MAP;
+
+    ///> Builds the polygon of an entry, calling the item conversion function.
+    static void build( const BOARD_ITEM* aItem, ENTRY& aEntry );
+
+    ///> Appends the polygons described by aKey to aCornerBuffer, from the cache if possible.
+    void get( const BOARD_ITEM* aItem, const ENTRY& aKey, SHAPE_POLY_SET& aCornerBuffer );
+
+    ///> Maximum number of polygons kept for an item
+    static const unsigned MAX_ENTRIES_PER_ITEM = 8;
+
+    ITEM_MAP        m_items;
+    mutable MUTEX   m_lock;
+
+    int         m_hits;
+    int         m_misses;
+};
+
+#endif  // CLEARANCE_POLY_CACHE_H
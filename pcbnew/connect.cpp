@@ -34,6 +34,7 @@
 #include <wxBasePcbFrame.h>
 
 #include <pcbnew.h>
+#include <disjoint_set.h>
 
 // Helper classes to handle connection points
 #include <connect.h>
@@ -50,6 +51,7 @@ CONNECTIONS::CONNECTIONS( BOARD * aBrd )
     m_brd = aBrd;
     m_firstTrack = NULL;
     m_lastTrack = NULL;
+    m_hashCellSize = 1;
 }
 
 
@@ -225,6 +227,8 @@ void CONNECTIONS::CollectItemsNearTo( std::vector<CONNECTED_POINT*>& aList,
 void CONNECTIONS::BuildPadsCandidatesList()
 {
     m_candidates.clear();
+    m_hashStart.clear();        // the track ends hash is no longer valid
+    m_hashItems.clear();
     m_candidates.reserve( m_sortedPads.size() );
     for( unsigned ii = 0; ii < m_sortedPads.size(); ii++ )
     {
@@ -288,6 +292,109 @@ void CONNECTIONS::BuildTracksCandidatesList( TRACK* aBegin, TRACK* aEnd)
     // and for increasing Y coordinate when items have the same X coordinate
     // So candidates to the same location are consecutive in list.
     sort( m_candidates.begin(), m_candidates.end(), sortConnectedPointByXthenYCoordinates );
+
+    buildTracksCandidatesHash();
+}
+
+
+// Returns the grid cell containing aCoord (rounded towards -infinity)
+static inline int gridCell( int aCoord, int aCellSize )
+{
+    return aCoord >= 0 ? aCoord / aCellSize : -( ( -aCoord - 1 ) / aCellSize ) - 1;
+}
+
+
+int CONNECTIONS::hashBucket( int aCellX, int aCellY ) const
+{
+    unsigned hash = (unsigned) aCellX * 73856093U ^ (unsigned) aCellY * 19349663U;
+
+    // the bucket count is a power of 2
+    return hash & ( m_hashStart.size() - 2 );
+}
+
+
+void CONNECTIONS::buildTracksCandidatesHash()
+{
+    m_hashStart.clear();
+    m_hashItems.clear();
+
+    if( m_candidates.empty() )
+        return;
+
+    // The cell size is larger than twice the biggest search distance (half of the track
+    // width), so the candidates near a point are in the 4 cells around it, at most.
+    int maxWidth = 0;
+
+    for( unsigned ii = 0; ii < m_candidates.size(); ii++ )
+        maxWidth = std::max( maxWidth, m_candidates[ii].GetTrack()->GetWidth() );
+
+    m_hashCellSize = maxWidth + 1;
+
+    unsigned bucketCount = 1;
+
+    while( bucketCount < m_candidates.size() )
+        bucketCount <<= 1;
+
+    // Counting sort of the candidates by bucket: no allocation per bucket
+    m_hashStart.assign( bucketCount + 1, 0 );
+    m_hashItems.resize( m_candidates.size() );
+
+    std::vector<int> buckets( m_candidates.size() );
+
+    for( unsigned ii = 0; ii < m_candidates.size(); ii++ )
+    {
+        const wxPoint& pos = m_candidates[ii].GetPoint();
+
+        buckets[ii] = hashBucket( gridCell( pos.x, m_hashCellSize ),
+                                  gridCell( pos.y, m_hashCellSize ) );
+        m_hashStart[buckets[ii] + 1]++;
+    }
+
+    for( unsigned ii = 0; ii < bucketCount; ii++ )
+        m_hashStart[ii + 1] += m_hashStart[ii];
+
+    std::vector<int> fill( m_hashStart.begin(), m_hashStart.end() - 1 );
+
+    for( unsigned ii = 0; ii < m_candidates.size(); ii++ )
+        m_hashItems[fill[buckets[ii]]++] = ii;
+}
+
+
+void CONNECTIONS::collectTrackEndsNearTo( std::vector<CONNECTED_POINT*>& aList,
+                                          const wxPoint& aPosition, int aDistMax )
+{
+    int xmin = gridCell( aPosition.x - aDistMax, m_hashCellSize );
+    int xmax = gridCell( aPosition.x + aDistMax, m_hashCellSize );
+    int ymin = gridCell( aPosition.y - aDistMax, m_hashCellSize );
+    int ymax = gridCell( aPosition.y + aDistMax, m_hashCellSize );
+
+    int visited[4];
+    int visitedCount = 0;
+
+    for( int cx = xmin; cx <= xmax; cx++ )
+    {
+        for( int cy = ymin; cy <= ymax; cy++ )
+        {
+            int bucket = hashBucket( cx, cy );
+
+            // 2 cells can share the same bucket: scan it only once
+            if( std::find( visited, visited + visitedCount, bucket ) != visited + visitedCount )
+                continue;
+
+            visited[visitedCount++] = bucket;
+
+            for( int ii = m_hashStart[bucket]; ii < m_hashStart[bucket + 1]; ii++ )
+            {
+                CONNECTED_POINT* item = &m_candidates[m_hashItems[ii]];
+                wxPoint diff = item->GetPoint() - aPosition;
+
+                if( abs( diff.x ) > aDistMax || abs( diff.y ) > aDistMax )
+                    continue;
+
+                aList.push_back( item );
+            }
+        }
+    }
 }
 
 
@@ -354,7 +461,10 @@ int CONNECTIONS::SearchConnectedTracks( const TRACK* aTrack )
 
         tracks_candidates.clear();
 
-        CollectItemsNearTo( tracks_candidates, position, dist_max );
+        if( !m_hashStart.empty() && 2 * dist_max < m_hashCellSize )
+            collectTrackEndsNearTo( tracks_candidates, position, dist_max );
+        else
+            CollectItemsNearTo( tracks_candidates, position, dist_max );
 
         for( unsigned ii = 0; ii < tracks_candidates.size(); ii++ )
         {
@@ -489,83 +599,6 @@ void CONNECTIONS::Build_CurrNet_SubNets_Connections( TRACK* aFirstTrack, TRACK*
 }
 
 
-/**
- * Change a subnet value to a new value, in m_sortedPads pad list
- * After that, 2 cluster (or subnets) are merged into only one.
- * Note: the resulting subnet value is the smallest between aOldSubNet et aNewSubNet
- */
-int CONNECTIONS::Merge_PadsSubNets( int aOldSubNet, int aNewSubNet )
-{
-    int    change_count = 0;
-
-    if( aOldSubNet == aNewSubNet )
-        return 0;
-
-    if( (aOldSubNet > 0) && (aOldSubNet < aNewSubNet) )
-        std::swap( aOldSubNet, aNewSubNet );
-
-    // Examine connections between intersecting pads
-    for( unsigned ii = 0; ii < m_sortedPads.size(); ii++ )
-    {
-        D_PAD * curr_pad = m_sortedPads[ii];
-        if( curr_pad->GetSubNet() != aOldSubNet )
-            continue;
-
-        change_count++;
-        curr_pad->SetSubNet( aNewSubNet );
-    }
-
-    return change_count;
-}
-
-/*
- * Change a subnet value to a new value, for tracks and pads which are connected to.
- * The result is merging 2 clusters (or subnets) into only one cluster.
- * Note: the resulting sub net value is the smallest between aOldSubNet et aNewSubNet
- */
-int CONNECTIONS::Merge_SubNets( int aOldSubNet, int aNewSubNet )
-{
-    TRACK* curr_track;
-    int    change_count = 0;
-
-    if( aOldSubNet == aNewSubNet )
-        return 0;
-
-    if( (aOldSubNet > 0) && (aOldSubNet < aNewSubNet) )
-        std::swap( aOldSubNet, aNewSubNet );
-
-    curr_track = (TRACK*)m_firstTrack;
-
-    for( ; curr_track != NULL; curr_track = curr_track->Next() )
-    {
-        if( curr_track->GetSubNet() != aOldSubNet )
-        {
-            if( curr_track == m_lastTrack )
-                break;
-
-            continue;
-        }
-
-        change_count++;
-        curr_track->SetSubNet( aNewSubNet );
-
-        for( unsigned ii = 0; ii < curr_track->m_PadsConnected.size(); ii++ )
-        {
-            D_PAD * pad = curr_track->m_PadsConnected[ii];
-            if( pad->GetSubNet() == aOldSubNet )
-            {
-                pad->SetSubNet( curr_track->GetSubNet() );
-            }
-        }
-
-        if( curr_track == m_lastTrack )
-            break;
-    }
-
-    return change_count;
-}
-
-
 /* Test a list of track segments, to create or propagate a sub netcode to pads and
  * segments connected together.
  * The track list must be sorted by nets, and all segments
@@ -580,144 +613,71 @@ int CONNECTIONS::Merge_SubNets( int aOldSubNet, int aNewSubNet )
  */
 void CONNECTIONS::Propagate_SubNets()
 {
-    int sub_netcode = 1;
+    // Collect the tracks and pads. Until the clusters are known, the subnet member
+    // of each item is used to store its index in this list.
+    std::vector<BOARD_CONNECTED_ITEM*> items;
 
-    TRACK* curr_track = (TRACK*)m_firstTrack;
-    if( curr_track )
-        curr_track->SetSubNet( sub_netcode );
+    for( TRACK* track = (TRACK*) m_firstTrack; track != NULL; track = track->Next() )
+    {
+        track->SetSubNet( items.size() );
+        items.push_back( track );
 
-    // Examine connections between tracks and pads
-    for( ; curr_track != NULL; curr_track = curr_track->Next() )
+        if( track == m_lastTrack )
+            break;
+    }
+
+    unsigned trackCount = items.size();
+
+    for( unsigned ii = 0; ii < m_sortedPads.size(); ii++ )
     {
-        // First: handling connections to pads
-        for( unsigned ii = 0; ii < curr_track->m_PadsConnected.size(); ii++ )
+        m_sortedPads[ii]->SetSubNet( items.size() );
+        items.push_back( m_sortedPads[ii] );
+    }
+
+    DISJOINT_SET clusters( items.size() );
+
+    for( unsigned ii = 0; ii < items.size(); ii++ )
+    {
+        BOARD_CONNECTED_ITEM* item = items[ii];
+
+        // Connections to pads (for tracks and pads), then between tracks (for tracks)
+        for( unsigned jj = 0; jj < item->m_PadsConnected.size(); jj++ )
         {
-            D_PAD * pad = curr_track->m_PadsConnected[ii];
+            D_PAD* pad = item->m_PadsConnected[jj];
+            unsigned idx = pad->GetSubNet();
 
-            if( curr_track->GetSubNet() )        // the track segment is already a cluster member
-            {
-                if( pad->GetSubNet() > 0 )
-                {
-                    // The pad is already a cluster member, so we can merge the 2 clusters
-                    Merge_SubNets( pad->GetSubNet(), curr_track->GetSubNet() );
-                }
-                else
-                {
-                    /* The pad is not yet attached to a cluster , so we can add this pad to
-                     * the cluster */
-                    pad->SetSubNet( curr_track->GetSubNet() );
-                }
-            }
-            else                              // the track segment is not attached to a cluster
-            {
-                if( pad->GetSubNet() > 0 )
-                {
-                    // it is connected to a pad in a cluster, merge this track
-                    curr_track->SetSubNet( pad->GetSubNet() );
-                }
-                else
-                {
-                    /* it is connected to a pad not in a cluster, so we must create a new
-                     * cluster (only with the 2 items: the track and the pad) */
-                    sub_netcode++;
-                    curr_track->SetSubNet( sub_netcode );
-                    pad->SetSubNet( curr_track->GetSubNet() );
-                }
-            }
+            if( idx < items.size() && items[idx] == pad )
+                clusters.Union( ii, idx );
         }
 
-        // Test connections between segments
-        for( unsigned ii = 0; ii < curr_track->m_TracksConnected.size(); ii++ )
+        if( ii >= trackCount )
+            continue;
+
+        for( unsigned jj = 0; jj < item->m_TracksConnected.size(); jj++ )
         {
-            BOARD_CONNECTED_ITEM* track = curr_track->m_TracksConnected[ii];
+            TRACK* track = item->m_TracksConnected[jj];
+            unsigned idx = track->GetSubNet();
 
-            if( curr_track->GetSubNet() )   // The current track is already a cluster member
-            {
-                // The other track is already a cluster member, so we can merge the 2 clusters
-                if( track->GetSubNet() )
-                {
-                    Merge_SubNets( track->GetSubNet(), curr_track->GetSubNet() );
-                }
-                else
-                {
-                    // The other track is not yet attached to a cluster , so we can add this
-                    // other track to the cluster
-                    track->SetSubNet( curr_track->GetSubNet() );
-                }
-            }
-            else        // the current track segment is not yet attached to a cluster
-            {
-                if( track->GetSubNet() )
-                {
-                    // The other track is already a cluster member, so we can add
-                    // the current segment to the cluster
-                    curr_track->SetSubNet( track->GetSubNet() );
-                }
-                else
-                {
-                    // it is connected to an other segment not in a cluster, so we must
-                    // create a new cluster (only with the 2 track segments)
-                    sub_netcode++;
-                    curr_track->SetSubNet( sub_netcode );
-                    track->SetSubNet( curr_track->GetSubNet() );
-                }
-            }
+            if( idx < trackCount && items[idx] == track )
+                clusters.Union( ii, idx );
         }
-
-        if( curr_track == m_lastTrack )
-            break;
     }
 
-    // Examine connections between intersecting pads, and propagate
-    // sub_netcodes to intersecting pads
-    for( unsigned ii = 0; ii < m_sortedPads.size(); ii++ )
-    {
-        D_PAD* curr_pad = m_sortedPads[ii];
+    // Number the clusters from 1, in the item order.
+    // Items connected to nothing are not in a cluster (subnet 0), but the first track
+    // always gets the subnet 1.
+    std::vector<int> subnets( items.size(), 0 );
+    int sub_netcode = 0;
 
-        for( unsigned jj = 0; jj < curr_pad->m_PadsConnected.size(); jj++ )
-        {
-            D_PAD* pad = curr_pad->m_PadsConnected[jj];
-
-            if( curr_pad->GetSubNet() )   // the current pad is already attached to a cluster
-            {
-                if( pad->GetSubNet() > 0 )
-                {
-                    // The pad is already a cluster member, so we can merge the 2 clusters
-                    // Store the initial subnets, which will be modified by Merge_PadsSubNets
-                    int subnet1 = pad->GetSubNet();
-                    int subnet2 = curr_pad->GetSubNet();
+    for( unsigned ii = 0; ii < items.size(); ii++ )
+    {
+        int root = clusters.Find( ii );
+        bool inCluster = ( ii == 0 && trackCount > 0 ) || clusters.GetSetSize( root ) > 1;
 
-                    // merge subnets of pads only, even those not connected by tracks
-                    Merge_PadsSubNets( subnet1, subnet2 );
+        if( subnets[root] == 0 && inCluster )
+            subnets[root] = ++sub_netcode;
 
-                    // merge subnets of tracks (and pads, which are already merged)
-                    Merge_SubNets( subnet1, subnet2 );
-                }
-                else
-                {
-                    // The pad is not yet attached to a cluster,
-                    // so we can add this pad to the cluster
-                    pad->SetSubNet( curr_pad->GetSubNet() );
-                }
-            }
-            else   // the current pad is not attached to a cluster
-            {
-                if( pad->GetSubNet() > 0 )
-                {
-                    // the connected pad is in a cluster,
-                    // so we can add the current pad to the cluster
-                    curr_pad->SetSubNet( pad->GetSubNet() );
-                }
-                else
-                {
-                    // the connected pad is not in a cluster,
-                    // so we must create a new cluster, with the 2 pads.
-                    sub_netcode++;
-                    curr_pad->SetSubNet( sub_netcode );
-                    pad->SetSubNet( curr_pad->GetSubNet() );
-                }
-            }
-        }
+        items[ii]->SetSubNet( subnets[root] );
     }
 }
 
@@ -100,6 +100,12 @@ private:
     const TRACK * m_lastTrack;                  // The last track used to build m_Candidates
     std::vector<D_PAD*> m_sortedPads;           // list of sorted pads by X (then Y) coordinate
 
+    // Spatial hash of the track candidates, used to find the tracks connected to a track end.
+    // The candidates of the bucket ii are m_hashItems[m_hashStart[ii] .. m_hashStart[ii+1]-1]
+    std::vector<int> m_hashStart;               // first index in m_hashItems, for each bucket
+    std::vector<int> m_hashItems;               // indexes in m_candidates, grouped by bucket
+    int m_hashCellSize;                         // size of the grid cells hashed in buckets
+
 public:
     CONNECTIONS( BOARD * aBrd );
     ~CONNECTIONS() {};
@@ -220,6 +226,9 @@ public:
      * For a given net, if all tracks are created, there is only one cluster.
      * but if not all tracks are created, there are more than one cluster,
      * and some ratsnests will be left active.
+     * Clusters are built by a disjoint-set forest, in near linear time, and then
+     * numbered from 1. Items not connected to anything have a 0 subnet,
+     * except m_firstTrack.
      */
     void Propagate_SubNets();
 
@@ -236,28 +245,23 @@ private:
     int searchEntryPointInCandidatesList( const wxPoint & aPoint);
 
     /**
-     * Function Merge_SubNets
-     * Change a subnet old value to a new value, for tracks and pads which are connected to
-     * tracks from m_firstTrack to m_lastTrack and their connected pads.
-     * and modify the subnet parameter (change the old value to the new value).
-     * After that, 2 cluster (or subnets) are merged into only one.
-     * Note: the resulting sub net value is the smallest between aOldSubNet and aNewSubNet
-     * @return modification count
-     * @param aOldSubNet = subnet value to modify
-     * @param aNewSubNet = new subnet value for each item which have old_val as subnet value
+     * Function buildTracksCandidatesHash
+     * Builds the spatial hash of m_candidates (the track ends), used by
+     * SearchConnectedTracks() to find the candidates near a track end in constant time.
      */
-    int Merge_SubNets( int aOldSubNet, int aNewSubNet );
+    void buildTracksCandidatesHash();
 
     /**
-     * Function Merge_PadsSubNets
-     * Change a subnet value to a new value, in m_sortedPads pad list
-     * After that, 2 cluster (or subnets) are merged into only one.
-     * Note: the resulting subnet value is the smallest between aOldSubNet et aNewSubNet
-     * @return modification count
-     * @param aOldSubNet = subnet value to modify
-     * @param aNewSubNet = new subnet value for each item which have old_val as subnet value
+     * Function collectTrackEndsNearTo
+     * Same as CollectItemsNearTo(), but uses the spatial hash of the track ends
+     * and only finds the candidates in the cells near aPosition.
+     * 2 * aDistMax must be smaller than m_hashCellSize
      */
-    int Merge_PadsSubNets( int aOldSubNet, int aNewSubNet );
+    void collectTrackEndsNearTo( std::vector<CONNECTED_POINT*>& aList,
+                                 const wxPoint& aPosition, int aDistMax );
+
+    ///> Returns the bucket of the spatial hash containing the grid cell ( aCellX, aCellY )
+    int hashBucket( int aCellX, int aCellY ) const;
 };
 
 #endif      //  ifndef CONNECT_H
@@ -78,6 +78,11 @@ DIALOG_PNS_SETTINGS_BASE::DIALOG_PNS_SETTINGS_BASE( wxWindow* parent, wxWindowID
 	
 	bOptions->Add( m_violateDrc, 0, wxTOP|wxRIGHT|wxLEFT, 5 );
 	
+	m_parallelCandidates = new wxCheckBox( bOptions->GetStaticBox(), wxID_ANY, _("Try several paths in parallel"), wxDefaultPosition, wxDefaultSize, 0 );
+	m_parallelCandidates->SetToolTip( _("(Walk around mode only) - when enabled, the router evaluates both winding directions and both postures of the trace on several threads, and keeps the best path.") );
+	
+	bOptions->Add( m_parallelCandidates, 0, wxTOP|wxRIGHT|wxLEFT, 5 );
+	
 	m_suggestEnding = new wxCheckBox( bOptions->GetStaticBox(), wxID_ANY, _("Suggest track finish"), wxDefaultPosition, wxDefaultSize, 0 );
 	m_suggestEnding->Enable( false );
 	
@@ -51,6 +51,7 @@ class DIALOG_PNS_SETTINGS_BASE : public DIALOG_SHIM
 		wxCheckBox* m_autoNeckdown;
 		wxCheckBox* m_smoothDragged;
 		wxCheckBox* m_violateDrc;
+		wxCheckBox* m_parallelCandidates;
 		wxCheckBox* m_suggestEnding;
 		wxStaticLine* m_staticline1;
 		wxStaticText* m_effortLabel;
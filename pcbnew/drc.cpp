@@ -48,9 +48,13 @@
 
 #include <pcbnew.h>
 #include <drc_stuff.h>
+#include <drc_spatial_index.h>
+#include <thread_pool.h>
+#include <profile.h>
 
 #include <dialog_drc.h>
 #include <wx/progdlg.h>
+#include <boost/bind.hpp>
 
 
 void DRC::ShowDialog()
@@ -101,6 +105,22 @@ DRC::DRC( PCB_EDIT_FRAME* aPcbWindow )
 {
     m_mainWindow = aPcbWindow;
     m_pcb = aPcbWindow->GetBoard();
+
+    init();
+}
+
+
+DRC::DRC( BOARD* aBoard )
+{
+    m_mainWindow = NULL;
+    m_pcb = aBoard;
+
+    init();
+}
+
+
+void DRC::init()
+{
     m_ui  = 0;
 
     // establish initial values for everything:
@@ -303,7 +323,8 @@ void DRC::ListUnconnectedPads()
 void DRC::updatePointers()
 {
     // update my pointers, m_mainWindow is the only unchangeable one
-    m_pcb = m_mainWindow->GetBoard();
+    if( m_mainWindow )
+        m_pcb = m_mainWindow->GetBoard();
 
     if( m_ui )  // Use diag list boxes only in DRC dialog
     {
@@ -440,36 +461,120 @@ bool DRC::testNetClasses()
 }
 
 
-void DRC::testPad2Pad()
+/**
+ * Function findPadPairs
+ * finds the pairs of pads close enough to be tested, using a sweep and prune on the
+ * bounding boxes of the pads, inflated by their clearance.  A box contains the pad
+ * shape and its hole.
+ * @param aPads is the list of pads.
+ * @param aPairs receives the pairs of indexes in aPads (lower index first), sorted.
+ */
+static void findPadPairs( const std::vector<D_PAD*>& aPads,
+                          std::vector<std::pair<int, int> >& aPairs )
 {
-    std::vector<D_PAD*> sortedPads;
+    const int count = aPads.size();
 
-    m_pcb->GetSortedPadListByXthenYCoord( sortedPads );
+    std::vector<std::pair<int, int> > sweep( count );     // x min, pad index
+    std::vector<int> xmax( count ), ymin( count ), ymax( count );
 
-    // find the max size of the pads (used to stop the test)
-    int max_size = 0;
+    for( int ii = 0; ii < count; ++ii )
+    {
+        const D_PAD* pad = aPads[ii];
+
+        // The bounding circle of the pad is the one used by checkClearancePadToPad()
+        wxPoint shapePos = pad->ShapePos();
+        int     radius = pad->GetBoundingRadius();
+        EDA_RECT box( wxPoint( shapePos.x - radius, shapePos.y - radius ),
+                      wxSize( 2 * radius, 2 * radius ) );
+
+        if( pad->GetDrillSize().x )
+        {
+            int holeRadius = std::max( pad->GetDrillSize().x, pad->GetDrillSize().y ) / 2;
+            EDA_RECT hole( wxPoint( pad->GetPosition().x - holeRadius,
+                                    pad->GetPosition().y - holeRadius ),
+                           wxSize( 2 * holeRadius, 2 * holeRadius ) );
+
+            box.Merge( hole );
+        }
+
+        // +1 for the rounding errors, and for the 1 nm clearance of the holes
+        box.Inflate( pad->GetClearance() + 1 );
 
-    for( unsigned i = 0; i < sortedPads.size(); ++i )
+        sweep[ii] = std::make_pair( box.GetX(), ii );
+        xmax[ii] = box.GetRight();
+        ymin[ii] = box.GetY();
+        ymax[ii] = box.GetBottom();
+    }
+
+    std::sort( sweep.begin(), sweep.end() );
+
+    // Boxes in structure of arrays form and in sweep order, for the inner loop
+    std::vector<int> sx0( count ), sx1( count ), sy0( count ), sy1( count ), index( count );
+
+    for( int ii = 0; ii < count; ++ii )
     {
-        D_PAD* pad = sortedPads[i];
+        int pad = sweep[ii].second;
 
-        // GetBoundingRadius() is the radius of the minimum sized circle fully containing the pad
-        int radius = pad->GetBoundingRadius();
-        if( radius > max_size )
-            max_size = radius;
+        index[ii] = pad;
+        sx0[ii] = sweep[ii].first;
+        sx1[ii] = xmax[pad];
+        sy0[ii] = ymin[pad];
+        sy1[ii] = ymax[pad];
     }
 
-    // Test the pads
-    D_PAD** listEnd = &sortedPads[ sortedPads.size() ];
+    aPairs.clear();
 
-    for( unsigned i = 0; i< sortedPads.size(); ++i )
+    for( int ii = 0; ii < count; ++ii )
     {
-        D_PAD* pad = sortedPads[i];
+        // The boxes starting before the end of this one overlap it on the X axis
+        int last = std::upper_bound( sx0.begin() + ii + 1, sx0.end(), sx1[ii] ) - sx0.begin();
+        int top = sy0[ii];
+        int bottom = sy1[ii];
 
-        int    x_limit = max_size + pad->GetClearance() +
-                         pad->GetBoundingRadius() + pad->GetPosition().x;
+        for( int jj = ii + 1; jj < last; ++jj )
+        {
+            if( ( sy0[jj] <= bottom ) & ( sy1[jj] >= top ) )
+            {
+                aPairs.push_back( std::make_pair( std::min( index[ii], index[jj] ),
+                                                  std::max( index[ii], index[jj] ) ) );
+            }
+        }
+    }
+
+    std::sort( aPairs.begin(), aPairs.end() );
+}
+
+
+void DRC::testPad2Pad()
+{
+#ifdef PROFILE
+    prof_counter totalRealTime;
+    prof_start( &totalRealTime );
+#endif /* PROFILE */
+
+    std::vector<D_PAD*> sortedPads;
+
+    m_pcb->GetSortedPadListByXthenYCoord( sortedPads );
+
+    std::vector<std::pair<int, int> > pairs;
+    findPadPairs( sortedPads, pairs );
+
+    // Test each pad against the pads found near it and following it in the sorted list,
+    // in the list order, so the first error reported for a pad is the same as with a
+    // full scan of the list
+    std::vector<D_PAD*> candidates;
 
-        if( !doPadToPadsDrc( pad, &sortedPads[i], listEnd, x_limit ) )
+    for( unsigned i = 0; i < pairs.size(); )
+    {
+        int    ref = pairs[i].first;
+        D_PAD* pad = sortedPads[ref];
+
+        candidates.clear();
+
+        for( ; i < pairs.size() && pairs[i].first == ref; ++i )
+            candidates.push_back( sortedPads[pairs[i].second] );
+
+        if( !doPadToPadsDrc( pad, &candidates[0], &candidates[0] + candidates.size() ) )
         {
             wxASSERT( m_currentMarker );
             m_pcb->Add( m_currentMarker );
@@ -477,62 +582,195 @@ void DRC::testPad2Pad()
             m_currentMarker = 0;
         }
     }
+
+#ifdef PROFILE
+    prof_end( &totalRealTime );
+
+    wxLogDebug( wxT( "Pad clearances: %d pads, %d pairs tested in %.1f ms" ),
+                (int) sortedPads.size(), (int) pairs.size(), totalRealTime.msecs() );
+#endif /* PROFILE */
 }
 
 
 void DRC::testTracks( wxWindow *aActiveWindow, bool aShowProgressBar )
 {
-    wxProgressDialog * progressDialog = NULL;
-    const int delta = 500;  // This is the number of tests between 2 calls to the
-                            // progress bar
-    int count = 0;
-    for( TRACK* segm = m_pcb->m_Track; segm && segm->Next(); segm = segm->Next() )
-        count++;
+#ifdef PROFILE
+    prof_counter totalRealTime;
+    prof_start( &totalRealTime );
+#endif /* PROFILE */
 
-    int deltamax = count/delta;
+    DRC_SPATIAL_INDEX index;
+    index.Build( m_pcb );
 
-    if( aShowProgressBar && deltamax > 3 )
+    std::vector<MARKER_PCB*>    markers;
+    std::vector<int>            pairCounts;
+
+    THREAD_POOL pool;
+
+    const int jobCount = submitTrackJobs( pool, index, false, markers, pairCounts );
+    const int count = markers.size();
+
+    wxProgressDialog * progressDialog = NULL;
+
+    if( aShowProgressBar && jobCount > 3 )
     {
         progressDialog = new wxProgressDialog( _( "Track clearances" ), wxEmptyString,
-                                               deltamax, aActiveWindow,
+                                               jobCount, aActiveWindow,
                                                wxPD_AUTO_HIDE | wxPD_CAN_ABORT |
                                                wxPD_APP_MODAL | wxPD_ELAPSED_TIME );
         progressDialog->Update( 0, wxEmptyString );
     }
 
-    int ii = 0;
-    count = 0;
-
-    for( TRACK* segm = m_pcb->m_Track; segm && segm->Next(); segm = segm->Next() )
+    // The workers only create markers, they are added to the board here, in the
+    // track list order, so the result does not depend on the thread scheduling.
+    while( !pool.Wait( 100 ) )
     {
-        if ( ii++ > delta )
+        if( progressDialog )
         {
-            ii = 0;
-            count++;
+            int done = pool.GetFinishedCount();
 
-            if( progressDialog )
+            if( !progressDialog->Update( std::min( done, jobCount - 1 ), wxEmptyString ) )
             {
-                if( !progressDialog->Update( count, wxEmptyString ) )
-                    break;  // Aborted by user
+                pool.CancelPending();   // Aborted by user
+                pool.Wait();
+                break;
+            }
 #ifdef __WXMAC__
-                // Work around a dialog z-order issue on OS X
-                if( count == deltamax )
-                    aActiveWindow->Raise();
+            // Work around a dialog z-order issue on OS X
+            if( done == jobCount )
+                aActiveWindow->Raise();
 #endif
-            }
         }
+    }
 
-        if( !doTrackDrc( segm, segm->Next(), true ) )
+    for( int ii = 0; ii < count; ++ii )
+    {
+        if( markers[ii] )
         {
-            wxASSERT( m_currentMarker );
-            m_pcb->Add( m_currentMarker );
-            m_mainWindow->GetGalCanvas()->GetView()->Add( m_currentMarker );
-            m_currentMarker = 0;
+            m_pcb->Add( markers[ii] );
+            m_mainWindow->GetGalCanvas()->GetView()->Add( markers[ii] );
         }
     }
 
     if( progressDialog )
         progressDialog->Destroy();
+
+#ifdef PROFILE
+    prof_end( &totalRealTime );
+
+    int pairs = 0;
+
+    for( int job = 0; job < jobCount; ++job )
+        pairs += pairCounts[job];
+
+    wxLogDebug( wxT( "Track clearances: %d segments, %d pairs tested in %.1f ms "
+                     "(%.0f pairs/s, %d threads)" ),
+                count, pairs, totalRealTime.msecs(),
+                pairs / std::max( totalRealTime.msecs() / 1000.0, 0.001 ),
+                pool.GetThreadCount() );
+#endif /* PROFILE */
+}
+
+
+int DRC::submitTrackJobs( THREAD_POOL& aPool, const DRC_SPATIAL_INDEX& aIndex, bool aFullScan,
+                          std::vector<MARKER_PCB*>& aMarkers, std::vector<int>& aPairCounts )
+{
+    // As the full list scan did, the last segment is only tested against the other ones
+    // (when they are the reference segment), not on its own.
+    const int   count = std::max( 0, (int) aIndex.GetTracks().size() - 1 );
+    const int   jobSize = 500;   // number of segments tested by a single job
+    const int   jobCount = ( count + jobSize - 1 ) / jobSize;
+
+    aMarkers.assign( count, (MARKER_PCB*) NULL );
+    aPairCounts.assign( jobCount, 0 );
+
+    for( int job = 0; job < jobCount; ++job )
+    {
+        int first = job * jobSize;
+        int last  = std::min( first + jobSize, count );
+
+        aPool.Submit( boost::bind( &DRC::testTracksRange, this, &aIndex, first, last,
+                                   aFullScan, &aMarkers, &aPairCounts[job] ) );
+    }
+
+    return jobCount;
+}
+
+
+long long DRC::TestTracks( std::vector<MARKER_PCB*>& aMarkers, int aThreadCount, bool aFullScan )
+{
+    DRC_SPATIAL_INDEX index;
+    index.Build( m_pcb );
+
+    std::vector<int> pairCounts;
+
+    {
+        THREAD_POOL pool( aThreadCount );
+
+        submitTrackJobs( pool, index, aFullScan, aMarkers, pairCounts );
+        pool.Wait();
+    }
+
+    long long pairs = 0;
+
+    for( unsigned job = 0; job < pairCounts.size(); ++job )
+        pairs += pairCounts[job];
+
+    return pairs;
+}
+
+
+void DRC::testTracksRange( const DRC_SPATIAL_INDEX* aIndex, int aFirst, int aLast,
+                           bool aFullScan, std::vector<MARKER_PCB*>* aMarkers, int* aPairCount )
+{
+    // doTrackDrc() stores intermediate results in the DRC object, so each job
+    // needs its own one.
+    DRC checker( m_pcb );
+
+    const std::vector<TRACK*>&  tracks = aIndex->GetTracks();
+    std::vector<D_PAD*>         pads;
+    std::vector<TRACK*>         candidates;
+
+    // The reference scan uses the pad list of the legacy DRC, not the one of the index
+    if( aFullScan )
+        pads = m_pcb->GetPads();
+
+    D_PAD* const* allPads = pads.empty() ? NULL : &pads[0];
+    const int     allPadCount = pads.size();
+
+    for( int ii = aFirst; ii < aLast; ++ii )
+    {
+        TRACK*  segm = tracks[ii];
+        bool    ok;
+
+        if( aFullScan )
+        {
+            *aPairCount += allPadCount + tracks.size() - ii - 1;
+
+            ok = checker.doTrackDrc( segm, allPads, allPads + allPadCount,
+                                     &tracks[ii + 1], &tracks[0] + tracks.size() );
+        }
+        else
+        {
+            EDA_RECT area = DRC_SPATIAL_INDEX::TrackArea( segm, aIndex->GetMaxClearance() );
+
+            // Only the items close enough to be in conflict are tested, and only the
+            // segments located after segm in the list, like the full list scan did.
+            aIndex->QueryPads( area, pads );
+            aIndex->QueryTracks( area, segm->GetLayerSet(), ii, candidates );
+
+            *aPairCount += pads.size() + candidates.size();
+
+            ok = checker.doTrackDrc( segm, pads, candidates );
+        }
+
+        // Note: no wxASSERT here, this is not the GUI thread.
+        if( !ok )
+        {
+            (*aMarkers)[ii] = checker.m_currentMarker;
+            checker.m_currentMarker = NULL;
+        }
+    }
 }
 
 
@@ -841,7 +1079,7 @@ bool DRC::doTrackKeepoutDrc( TRACK* aRefSeg )
 }
 
 
-bool DRC::doPadToPadsDrc( D_PAD* aRefPad, D_PAD** aStart, D_PAD** aEnd, int x_limit )
+bool DRC::doPadToPadsDrc( D_PAD* aRefPad, D_PAD** aStart, D_PAD** aEnd )
 {
     const static LSET all_cu = LSET::AllCuMask();
 
@@ -871,11 +1109,6 @@ bool DRC::doPadToPadsDrc( D_PAD* aRefPad, D_PAD** aStart, D_PAD** aEnd, int x_li
         if( pad == aRefPad )
             continue;
 
-        // We can stop the test when pad->GetPosition().x > x_limit
-        // because the list is sorted by X values
-        if( pad->GetPosition().x > x_limit )
-            break;
-
         // No problem if pads which are on copper layers are on different copper layers,
         // (pads can be only on a technical layer, to build complex pads)
         // but their hole (if any ) can create DRC error because they are on all
@@ -43,6 +43,7 @@
 #include <class_track.h>
 #include <class_zone.h>
 #include <class_marker_pcb.h>
+#include <drc_spatial_index.h>
 #include <math_for_graphics.h>
 #include <polygon_test_point_inside.h>
 
@@ -147,6 +148,48 @@ bool trapezoid2pointDRC( wxPoint aTref[4], wxPoint aPcompare, int aDist )
 
 
 bool DRC::doTrackDrc( TRACK* aRefSeg, TRACK* aStart, bool testPads )
+{
+    // This is the interactive test, run while the tracks are edited in place: there is
+    // no up to date spatial index, so the items are culled by bounding box while walking
+    // the lists, and only the candidates go through the full test.  The culled items can't
+    // be in conflict, so the first error found is the same as with the whole lists.
+    EDA_RECT    refArea = DRC_SPATIAL_INDEX::TrackArea( aRefSeg, 0 );
+    LSET        refLayers = aRefSeg->GetLayerSet();
+    int         refNetCode = aRefSeg->GetNetCode();
+
+    m_padCandidates.clear();
+    m_trackCandidates.clear();
+
+    if( testPads )
+    {
+        for( unsigned ii = 0; ii < m_pcb->GetPadCount(); ++ii )
+        {
+            D_PAD*   pad = m_pcb->GetPad( ii );
+            EDA_RECT area = DRC_SPATIAL_INDEX::PadArea( pad, aRefSeg->GetClearance( pad ) );
+
+            if( area.Intersects( refArea ) )
+                m_padCandidates.push_back( pad );
+        }
+    }
+
+    for( TRACK* track = aStart; track; track = track->Next() )
+    {
+        // Same net or no common layer: never an error
+        if( track->GetNetCode() == refNetCode || !( refLayers & track->GetLayerSet() ).any() )
+            continue;
+
+        EDA_RECT area = DRC_SPATIAL_INDEX::TrackArea( track, aRefSeg->GetClearance( track ) );
+
+        if( area.Intersects( refArea ) )
+            m_trackCandidates.push_back( track );
+    }
+
+    return doTrackDrc( aRefSeg, m_padCandidates, m_trackCandidates );
+}
+
+
+bool DRC::doTrackDrc( TRACK* aRefSeg, D_PAD* const* aPadStart, D_PAD* const* aPadEnd,
+                      TRACK* const* aTrackStart, TRACK* const* aTrackEnd )
 {
     TRACK*    track;
     wxPoint   delta;           // lenght on X and Y axis of segments
@@ -270,62 +313,57 @@ bool DRC::doTrackDrc( TRACK* aRefSeg, TRACK* aStart, bool testPads )
     dummypad.SetLayerSet( LSET::AllCuMask() );     // Ensure the hole is on all layers
 
     // Compute the min distance to pads
-    if( testPads )
+    for( D_PAD* const* it = aPadStart;  it != aPadEnd;  ++it )
     {
-        unsigned pad_count = m_pcb->GetPadCount();
+        D_PAD* pad = *it;
 
-        for( unsigned ii = 0;  ii<pad_count;  ++ii )
+        /* No problem if pads are on an other layer,
+         * But if a drill hole exists	(a pad on a single layer can have a hole!)
+         * we must test the hole
+         */
+        if( !( pad->GetLayerSet() & layerMask ).any() )
         {
-            D_PAD* pad = m_pcb->GetPad( ii );
-
-            /* No problem if pads are on an other layer,
-             * But if a drill hole exists	(a pad on a single layer can have a hole!)
-             * we must test the hole
+            /* We must test the pad hole. In order to use the function
+             * checkClearanceSegmToPad(),a pseudo pad is used, with a shape and a
+             * size like the hole
              */
-            if( !( pad->GetLayerSet() & layerMask ).any() )
-            {
-                /* We must test the pad hole. In order to use the function
-                 * checkClearanceSegmToPad(),a pseudo pad is used, with a shape and a
-                 * size like the hole
-                 */
-                if( pad->GetDrillSize().x == 0 )
-                    continue;
-
-                dummypad.SetSize( pad->GetDrillSize() );
-                dummypad.SetPosition( pad->GetPosition() );
-                dummypad.SetShape( pad->GetDrillShape()  == PAD_DRILL_SHAPE_OBLONG ?
-                                   PAD_SHAPE_OVAL : PAD_SHAPE_CIRCLE );
-                dummypad.SetOrientation( pad->GetOrientation() );
-
-                m_padToTestPos = dummypad.GetPosition() - origin;
-
-                if( !checkClearanceSegmToPad( &dummypad, aRefSeg->GetWidth(),
-                                              netclass->GetClearance() ) )
-                {
-                    m_currentMarker = fillMarker( aRefSeg, pad,
-                                                  DRCE_TRACK_NEAR_THROUGH_HOLE, m_currentMarker );
-                    return false;
-                }
-
+            if( pad->GetDrillSize().x == 0 )
                 continue;
-            }
 
-            // The pad must be in a net (i.e pt_pad->GetNet() != 0 )
-            // but no problem if the pad netcode is the current netcode (same net)
-            if( pad->GetNetCode()                       // the pad must be connected
-               && net_code_ref == pad->GetNetCode() )   // the pad net is the same as current net -> Ok
-                continue;
+            dummypad.SetSize( pad->GetDrillSize() );
+            dummypad.SetPosition( pad->GetPosition() );
+            dummypad.SetShape( pad->GetDrillShape()  == PAD_DRILL_SHAPE_OBLONG ?
+                               PAD_SHAPE_OVAL : PAD_SHAPE_CIRCLE );
+            dummypad.SetOrientation( pad->GetOrientation() );
 
-            // DRC for the pad
-            shape_pos = pad->ShapePos();
-            m_padToTestPos = shape_pos - origin;
+            m_padToTestPos = dummypad.GetPosition() - origin;
 
-            if( !checkClearanceSegmToPad( pad, aRefSeg->GetWidth(), aRefSeg->GetClearance( pad ) ) )
+            if( !checkClearanceSegmToPad( &dummypad, aRefSeg->GetWidth(),
+                                          netclass->GetClearance() ) )
             {
                 m_currentMarker = fillMarker( aRefSeg, pad,
-                                              DRCE_TRACK_NEAR_PAD, m_currentMarker );
+                                              DRCE_TRACK_NEAR_THROUGH_HOLE, m_currentMarker );
                 return false;
             }
+
+            continue;
+        }
+
+        // The pad must be in a net (i.e pt_pad->GetNet() != 0 )
+        // but no problem if the pad netcode is the current netcode (same net)
+        if( pad->GetNetCode()                       // the pad must be connected
+           && net_code_ref == pad->GetNetCode() )   // the pad net is the same as current net -> Ok
+            continue;
+
+        // DRC for the pad
+        shape_pos = pad->ShapePos();
+        m_padToTestPos = shape_pos - origin;
+
+        if( !checkClearanceSegmToPad( pad, aRefSeg->GetWidth(), aRefSeg->GetClearance( pad ) ) )
+        {
+            m_currentMarker = fillMarker( aRefSeg, pad,
+                                          DRCE_TRACK_NEAR_PAD, m_currentMarker );
+            return false;
         }
     }
 
@@ -338,8 +376,10 @@ bool DRC::doTrackDrc( TRACK* aRefSeg, TRACK* aStart, bool testPads )
     // Test the reference segment with other track segments
     wxPoint segStartPoint;
     wxPoint segEndPoint;
-    for( track = aStart; track; track = track->Next() )
+    for( TRACK* const* it = aTrackStart;  it != aTrackEnd;  ++it )
     {
+        track = *it;
+
         // No problem if segments have the same net code:
         if( net_code_ref == track->GetNetCode() )
             continue;
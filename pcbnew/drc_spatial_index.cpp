@@ -0,0 +1,390 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file drc_spatial_index.cpp
+ */
+
+#include <fctsys.h>
+#include <algorithm>
+
+#include <class_board.h>
+#include <class_module.h>
+#include <class_track.h>
+#include <class_pad.h>
+
+#include <drc_spatial_index.h>
+
+
+/**
+ * Struct INDEX_COLLECTOR
+ * is the R-tree visitor storing the indexes of the items found by a query.
+ */
+struct INDEX_COLLECTOR
+{
+    INDEX_COLLECTOR( std::vector<int>& aResult ) :
+        m_result( aResult )
+    {
+    }
+
+    bool operator()( int aIndex )
+    {
+        m_result.push_back( aIndex );
+        return true;
+    }
+
+    std::vector<int>& m_result;
+};
+
+
+DRC_SPATIAL_INDEX::DRC_SPATIAL_INDEX()
+{
+    for( int i = 0; i < MAX_CU_LAYERS; ++i )
+        m_trackTrees[i] = NULL;
+
+    m_padTree = NULL;
+    m_maxClearance = 0;
+}
+
+
+DRC_SPATIAL_INDEX::~DRC_SPATIAL_INDEX()
+{
+    Clear();
+}
+
+
+void DRC_SPATIAL_INDEX::Clear()
+{
+    for( int i = 0; i < MAX_CU_LAYERS; ++i )
+    {
+        delete m_trackTrees[i];
+        m_trackTrees[i] = NULL;
+    }
+
+    delete m_padTree;
+    m_padTree = NULL;
+
+    m_tracks.clear();
+    m_pads.clear();
+    m_trackSlots.clear();
+    m_padSlots.clear();
+    m_freeTrackSlots.clear();
+    m_freePadSlots.clear();
+    m_slots.clear();
+    m_maxClearance = 0;
+}
+
+
+EDA_RECT DRC_SPATIAL_INDEX::TrackArea( const TRACK* aTrack, int aMargin )
+{
+    EDA_RECT area( aTrack->GetStart(), wxSize( 0, 0 ) );
+
+    area.SetEnd( aTrack->GetEnd() );
+    area.Normalize();
+
+    // + 1 to be sure rounding in the clearance tests never misses a candidate
+    area.Inflate( aTrack->GetWidth() / 2 + aMargin + 1 );
+
+    return area;
+}
+
+
+EDA_RECT DRC_SPATIAL_INDEX::PadArea( const D_PAD* aPad, int aMargin )
+{
+    EDA_RECT area( aPad->ShapePos(), wxSize( 0, 0 ) );
+    area.Inflate( aPad->GetBoundingRadius() );
+
+    // The hole is tested even if the pad is not on the layer of the other item
+    if( aPad->GetDrillSize().x > 0 )
+    {
+        EDA_RECT hole( aPad->GetPosition(), wxSize( 0, 0 ) );
+        hole.Inflate( std::max( aPad->GetDrillSize().x, aPad->GetDrillSize().y ) / 2 );
+        area.Merge( hole );
+    }
+
+    area.Inflate( aMargin + 1 );
+
+    return area;
+}
+
+
+void DRC_SPATIAL_INDEX::insert( INDEX_TREE* aTree, const EDA_RECT& aArea, int aSlot )
+{
+    const int mmin[2] = { aArea.GetX(), aArea.GetY() };
+    const int mmax[2] = { aArea.GetRight(), aArea.GetBottom() };
+
+    aTree->Insert( mmin, mmax, aSlot );
+}
+
+
+void DRC_SPATIAL_INDEX::remove( INDEX_TREE* aTree, const EDA_RECT& aArea, int aSlot )
+{
+    const int mmin[2] = { aArea.GetX(), aArea.GetY() };
+    const int mmax[2] = { aArea.GetRight(), aArea.GetBottom() };
+
+    aTree->Remove( mmin, mmax, aSlot );
+}
+
+
+void DRC_SPATIAL_INDEX::query( INDEX_TREE* aTree, const EDA_RECT& aArea,
+                               std::vector<int>& aResult )
+{
+    const int mmin[2] = { aArea.GetX(), aArea.GetY() };
+    const int mmax[2] = { aArea.GetRight(), aArea.GetBottom() };
+
+    INDEX_COLLECTOR collector( aResult );
+
+    aTree->Search( mmin, mmax, collector );
+}
+
+
+int DRC_SPATIAL_INDEX::allocSlot( std::vector<SLOT>& aSlots, std::vector<int>& aFreeSlots,
+                                  BOARD_CONNECTED_ITEM* aItem, const EDA_RECT& aArea )
+{
+    int slot;
+
+    if( aFreeSlots.empty() )
+    {
+        slot = aSlots.size();
+        aSlots.push_back( SLOT() );
+    }
+    else
+    {
+        slot = aFreeSlots.back();
+        aFreeSlots.pop_back();
+    }
+
+    aSlots[slot].m_item = aItem;
+    aSlots[slot].m_area = aArea;
+    aSlots[slot].m_layers = aItem->GetLayerSet();
+    aSlots[slot].m_position = -1;
+
+    return slot;
+}
+
+
+void DRC_SPATIAL_INDEX::Build( BOARD* aBoard )
+{
+    Clear();
+
+    for( TRACK* track = aBoard->m_Track; track; track = track->Next() )
+        Add( track );
+
+    for( MODULE* module = aBoard->m_Modules; module; module = module->Next() )
+    {
+        for( D_PAD* pad = module->Pads(); pad; pad = pad->Next() )
+            Add( pad );
+    }
+
+    UpdateOrder( aBoard );
+}
+
+
+void DRC_SPATIAL_INDEX::Add( BOARD_CONNECTED_ITEM* aItem )
+{
+    // An item indexed again replaces its former shape
+    Remove( aItem );
+
+    if( aItem->Type() == PCB_PAD_T )
+    {
+        D_PAD* pad = static_cast<D_PAD*>( aItem );
+
+        if( !m_padTree )
+            m_padTree = new INDEX_TREE;
+
+        // Note: GetBoundingRadius() caches its value on the first call: calling
+        // it here also ensures worker threads only ever read it.
+        EDA_RECT area = PadArea( pad, 0 );
+        int      slot = allocSlot( m_padSlots, m_freePadSlots, pad, area );
+
+        insert( m_padTree, area, slot );
+        m_slots[pad] = padSlot( slot );
+        return;
+    }
+
+    TRACK*   track = static_cast<TRACK*>( aItem );
+    EDA_RECT area = TrackArea( track, 0 );
+    int      slot = allocSlot( m_trackSlots, m_freeTrackSlots, track, area );
+
+    m_slots[track] = slot;
+
+    // Vias are stored in the tree of each layer they go through
+    for( LSEQ cu = m_trackSlots[slot].m_layers.CuStack();  cu;  ++cu )
+    {
+        LAYER_ID layer = *cu;
+
+        if( !m_trackTrees[layer] )
+            m_trackTrees[layer] = new INDEX_TREE;
+
+        insert( m_trackTrees[layer], area, slot );
+    }
+}
+
+
+void DRC_SPATIAL_INDEX::Remove( const BOARD_ITEM* aItem )
+{
+    boost::unordered_map<const BOARD_ITEM*, int>::iterator it = m_slots.find( aItem );
+
+    if( it == m_slots.end() )
+        return;
+
+    int slot = it->second;
+    m_slots.erase( it );
+
+    // The item itself may be deleted, it is not read
+    if( slot < 0 )
+    {
+        slot = padSlot( slot );
+        remove( m_padTree, m_padSlots[slot].m_area, slot );
+        m_padSlots[slot].m_item = NULL;
+        m_freePadSlots.push_back( slot );
+    }
+    else
+    {
+        SLOT& trackSlot = m_trackSlots[slot];
+
+        for( LSEQ cu = trackSlot.m_layers.CuStack();  cu;  ++cu )
+            remove( m_trackTrees[*cu], trackSlot.m_area, slot );
+
+        trackSlot.m_item = NULL;
+        m_freeTrackSlots.push_back( slot );
+    }
+}
+
+
+bool DRC_SPATIAL_INDEX::UpdateOrder( BOARD* aBoard )
+{
+    boost::unordered_map<const BOARD_ITEM*, int>::const_iterator it;
+
+    m_tracks.clear();
+    m_pads.clear();
+    m_maxClearance = 0;
+
+    for( TRACK* track = aBoard->m_Track; track; track = track->Next() )
+    {
+        it = m_slots.find( track );
+
+        if( it == m_slots.end() || it->second < 0 )
+            return false;
+
+        m_trackSlots[it->second].m_position = m_tracks.size();
+        m_tracks.push_back( track );
+
+        m_maxClearance = std::max( m_maxClearance, track->GetClearance( NULL ) );
+    }
+
+    // The pads are ranked in BOARD::GetPad() order (sorted by net name), the order of the
+    // legacy DRC, so the first error found for a segment is the same.  Pads missing from
+    // that list (not rebuilt since they were added) come last.
+    boost::unordered_map<const D_PAD*, unsigned> ranks;
+    std::vector< std::pair<unsigned, D_PAD*> > pads;
+
+    for( unsigned ii = 0; ii < aBoard->GetPadCount(); ++ii )
+        ranks[aBoard->GetPad( ii )] = ii;
+
+    for( MODULE* module = aBoard->m_Modules; module; module = module->Next() )
+    {
+        for( D_PAD* pad = module->Pads(); pad; pad = pad->Next() )
+        {
+            it = m_slots.find( pad );
+
+            if( it == m_slots.end() || it->second >= 0 )
+                return false;
+
+            boost::unordered_map<const D_PAD*, unsigned>::const_iterator rank = ranks.find( pad );
+
+            if( rank != ranks.end() )
+                pads.push_back( std::make_pair( rank->second, pad ) );
+            else
+                pads.push_back( std::make_pair( ranks.size() + pads.size(), pad ) );
+
+            m_maxClearance = std::max( m_maxClearance, pad->GetClearance( NULL ) );
+        }
+    }
+
+    std::sort( pads.begin(), pads.end() );
+
+    for( unsigned ii = 0; ii < pads.size(); ++ii )
+    {
+        it = m_slots.find( pads[ii].second );
+        m_padSlots[padSlot( it->second )].m_position = ii;
+        m_pads.push_back( pads[ii].second );
+    }
+
+    // Every indexed item must have been found
+    return m_tracks.size() + m_pads.size() == m_slots.size();
+}
+
+
+void DRC_SPATIAL_INDEX::sortByPosition( const std::vector<SLOT>& aSlots,
+                                        std::vector<int>& aFound )
+{
+    for( unsigned ii = 0; ii < aFound.size(); ++ii )
+        aFound[ii] = aSlots[aFound[ii]].m_position;
+
+    // Vias can be found once per layer, and the result must follow the board list order
+    std::sort( aFound.begin(), aFound.end() );
+    aFound.erase( std::unique( aFound.begin(), aFound.end() ), aFound.end() );
+}
+
+
+void DRC_SPATIAL_INDEX::QueryTracks( const EDA_RECT& aArea, LSET aLayers, int aAfter,
+                                     std::vector<TRACK*>& aResult ) const
+{
+    std::vector<int> found;
+
+    aResult.clear();
+
+    for( LSEQ cu = aLayers.CuStack();  cu;  ++cu )
+    {
+        INDEX_TREE* tree = m_trackTrees[*cu];
+
+        if( tree )
+            query( tree, aArea, found );
+    }
+
+    sortByPosition( m_trackSlots, found );
+
+    for( unsigned ii = 0; ii < found.size(); ++ii )
+    {
+        if( found[ii] > aAfter )
+            aResult.push_back( m_tracks[found[ii]] );
+    }
+}
+
+
+void DRC_SPATIAL_INDEX::QueryPads( const EDA_RECT& aArea, std::vector<D_PAD*>& aResult ) const
+{
+    std::vector<int> found;
+
+    aResult.clear();
+
+    if( !m_padTree )
+        return;
+
+    query( m_padTree, aArea, found );
+    sortByPosition( m_padSlots, found );
+
+    for( unsigned ii = 0; ii < found.size(); ++ii )
+        aResult.push_back( m_pads[found[ii]] );
+}
@@ -0,0 +1,207 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file drc_spatial_index.h
+ * @brief Spatial index of the board copper items, used to find DRC candidates.
+ */
+
+#ifndef DRC_SPATIAL_INDEX_H
+#define DRC_SPATIAL_INDEX_H
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <class_eda_rect.h>
+#include <layers_id_colors_and_visibility.h>
+#include <geometry/rtree.h>
+
+class BOARD;
+class BOARD_ITEM;
+class BOARD_CONNECTED_ITEM;
+class TRACK;
+class D_PAD;
+
+
+/**
+ * Class DRC_SPATIAL_INDEX
+ * keeps one R-tree of tracks and vias per copper layer and one R-tree of pads,
+ * so the DRC tests only the items which are close enough to violate a clearance,
+ * instead of the whole board.
+ *
+ * Items are stored by their index in the board lists (BOARD::m_Track order and
+ * BOARD::GetPad() order), and queries return them in that same order.  This
+ * keeps the DRC results (and the first error found for a given item) identical
+ * to a full scan of the lists.
+ *
+ * Queries do not modify the index, so several threads can run them concurrently
+ * once Build() has returned.  The index does not own the items.  When the board is
+ * modified, it can be rebuilt, or updated: the changed items are removed and added
+ * again (Remove() and Add()), then UpdateOrder() reads the new list positions.
+ */
+class DRC_SPATIAL_INDEX
+{
+public:
+    DRC_SPATIAL_INDEX();
+    ~DRC_SPATIAL_INDEX();
+
+    /**
+     * Function Build
+     * indexes all tracks, vias and pads of aBoard.
+     */
+    void Build( BOARD* aBoard );
+
+    /**
+     * Function Clear
+     * removes every item from the index.
+     */
+    void Clear();
+
+    /**
+     * Function Add
+     * indexes a track, via or pad, with its current shape.  Its list position is set
+     * by the next call to UpdateOrder(), which must be done before any query.
+     */
+    void Add( BOARD_CONNECTED_ITEM* aItem );
+
+    /**
+     * Function Remove
+     * removes an item from the index.  The item is not read, so it can have been
+     * modified or deleted since it was added.
+     */
+    void Remove( const BOARD_ITEM* aItem );
+
+    /**
+     * Function UpdateOrder
+     * reads the position of the indexed items in the lists of aBoard, and the biggest
+     * clearance.  Must be called after items were added to or removed from the index.
+     * @return false if the indexed items are not the tracks, vias and pads of aBoard;
+     *         the index must then be rebuilt.
+     */
+    bool UpdateOrder( BOARD* aBoard );
+
+    /**
+     * Function GetMaxClearance
+     * @return the biggest clearance used by an indexed item, i.e. the distance
+     * beyond which two items can never be in conflict.
+     */
+    int GetMaxClearance() const { return m_maxClearance; }
+
+    /**
+     * Function GetTracks
+     * @return the indexed tracks and vias, in board list order.
+     */
+    const std::vector<TRACK*>& GetTracks() const { return m_tracks; }
+
+    /**
+     * Function GetPads
+     * @return the indexed pads, in board list order.
+     */
+    const std::vector<D_PAD*>& GetPads() const { return m_pads; }
+
+    /**
+     * Function QueryTracks
+     * collects the tracks and vias whose bounding box intersects aArea on at least
+     * one of the copper layers of aLayers.
+     * @param aArea is the area to search.
+     * @param aLayers is the set of layers to search.
+     * @param aAfter is the list position of the first item to skip: only items located
+     *               after it in the track list are collected.  Use -1 to collect all.
+     * @param aResult receives the tracks, sorted by their position in the track list.
+     */
+    void QueryTracks( const EDA_RECT& aArea, LSET aLayers, int aAfter,
+                      std::vector<TRACK*>& aResult ) const;
+
+    /**
+     * Function QueryPads
+     * collects the pads whose shape or hole bounding box intersects aArea.  The pads
+     * are collected whatever their layers are, because pad holes go through all layers.
+     * @param aArea is the area to search.
+     * @param aResult receives the pads, sorted by their position in the board pad list.
+     */
+    void QueryPads( const EDA_RECT& aArea, std::vector<D_PAD*>& aResult ) const;
+
+    /**
+     * Function TrackArea
+     * @return the area covered by a track or via, enlarged by aMargin.
+     */
+    static EDA_RECT TrackArea( const TRACK* aTrack, int aMargin );
+
+    /**
+     * Function PadArea
+     * @return the area covered by the shape and the hole of a pad, enlarged by aMargin.
+     */
+    static EDA_RECT PadArea( const D_PAD* aPad, int aMargin );
+
+private:
+    typedef RTree<int, int, 2, float> INDEX_TREE;
+
+    ///> An indexed item.  The trees store the slot numbers, which do not change when
+    ///> other items are added or removed.
+    struct SLOT
+    {
+        BOARD_CONNECTED_ITEM*   m_item;         ///< NULL for a free slot
+        EDA_RECT                m_area;         ///< area the item is indexed with
+        LSET                    m_layers;       ///< copper layers of a track or via
+        int                     m_position;     ///< position in the board list
+    };
+
+    ///> Runs a query on aTree and appends the slots found to aResult.
+    static void query( INDEX_TREE* aTree, const EDA_RECT& aArea, std::vector<int>& aResult );
+
+    ///> Inserts a slot in the tree, using aArea as bounding box.
+    static void insert( INDEX_TREE* aTree, const EDA_RECT& aArea, int aSlot );
+
+    ///> Removes a slot from the tree, aArea being the bounding box it was inserted with.
+    static void remove( INDEX_TREE* aTree, const EDA_RECT& aArea, int aSlot );
+
+    ///> Stores aItem in a free slot of aSlots and returns the slot number.
+    int allocSlot( std::vector<SLOT>& aSlots, std::vector<int>& aFreeSlots,
+                   BOARD_CONNECTED_ITEM* aItem, const EDA_RECT& aArea );
+
+    ///> Replaces the slots in aFound by the position of their items, sorted and unique.
+    static void sortByPosition( const std::vector<SLOT>& aSlots, std::vector<int>& aFound );
+
+    std::vector<TRACK*>     m_tracks;
+    std::vector<D_PAD*>     m_pads;
+
+    std::vector<SLOT>       m_trackSlots;
+    std::vector<SLOT>       m_padSlots;
+    std::vector<int>        m_freeTrackSlots;
+    std::vector<int>        m_freePadSlots;
+
+    ///> Slot of each indexed item: in m_trackSlots, or in m_padSlots for the values
+    ///> encoded by padSlot()
+    boost::unordered_map<const BOARD_ITEM*, int> m_slots;
+
+    ///> Converts a pad slot to its m_slots value, and conversely
+    static int padSlot( int aSlot ) { return -1 - aSlot; }
+
+    INDEX_TREE*             m_trackTrees[MAX_CU_LAYERS];
+    INDEX_TREE*             m_padTree;
+
+    int                     m_maxClearance;
+};
+
+#endif  // DRC_SPATIAL_INDEX_H
@@ -91,6 +91,8 @@ class TRACK;
 class MARKER_PCB;
 class DRC_ITEM;
 class NETCLASS;
+class DRC_SPATIAL_INDEX;
+class THREAD_POOL;
 
 
 /**
@@ -152,6 +154,7 @@ typedef std::vector<DRC_ITEM*> DRC_LIST;
 class DRC
 {
     friend class DIALOG_DRC_CONTROL;
+    friend class ONLINE_DRC;
 
 private:
 
@@ -199,6 +202,13 @@ private:
 
     DRC_LIST            m_unconnected;  ///< list of unconnected pads, as DRC_ITEMs
 
+    ///> Candidates of the interactive track test, kept to reuse their storage
+    std::vector<D_PAD*> m_padCandidates;
+    std::vector<TRACK*> m_trackCandidates;
+
+    ///> Initializes the settings, used by the constructors
+    void init();
+
 
     /**
      * Function updatePointers
@@ -270,6 +280,8 @@ private:
     /**
      * Function testTracks
      * performs the DRC on all tracks.
+     * Each track is tested only against the pads and tracks found near it in a
+     * DRC_SPATIAL_INDEX, and the tracks are dispatched to a THREAD_POOL.
      * because this test can take a while, a progress bar can be displayed
      * @param aActiveWindow = the active window ued as parent for the progress bar
      * @param aShowProgressBar = true to show a progress bar
@@ -277,6 +289,38 @@ private:
      */
     void testTracks( wxWindow * aActiveWindow, bool aShowProgressBar );
 
+    /**
+     * Function submitTrackJobs
+     * queues the jobs testing the tracks of aIndex on aPool.
+     * @param aFullScan true to test each track against all the pads and the following
+     *                  tracks, as the DRC did before using the spatial index
+     * @param aMarkers Receives the marker of each track with a DRC error, at the track index
+     * @param aPairCounts Receives the number of item pairs tested by each job
+     * @return the number of jobs
+     */
+    int submitTrackJobs( THREAD_POOL& aPool, const DRC_SPATIAL_INDEX& aIndex, bool aFullScan,
+                         std::vector<MARKER_PCB*>& aMarkers, std::vector<int>& aPairCounts );
+
+    /**
+     * Function testTracksRange
+     * is the worker job of testTracks(): it tests the tracks aFirst to aLast - 1 of
+     * the index.  It runs on a worker thread, so it must not modify the board.
+     * @param aIndex The spatial index of the board items
+     * @param aFirst The index of the first track to test
+     * @param aLast The index after the last track to test
+     * @param aFullScan true to test the tracks against all the items, not only the
+     *                  ones found near them in the index
+     * @param aMarkers Receives the marker of each track with a DRC error, at the track index
+     * @param aPairCount Receives the number of item pairs tested
+     */
+    void testTracksRange( const DRC_SPATIAL_INDEX* aIndex, int aFirst, int aLast, bool aFullScan,
+                          std::vector<MARKER_PCB*>* aMarkers, int* aPairCount );
+
+    /**
+     * Function testPad2Pad
+     * performs the DRC between pads.  Each pad is only tested against the pads of
+     * which the bounding box, inflated by the clearance, overlaps its own one.
+     */
     void testPad2Pad();
 
     void testUnconnected();
@@ -294,17 +338,16 @@ private:
     /**
      * Function doPadToPadsDrc
      * tests the clearance between aRefPad and other pads.
-     * The pad list must be sorted by x coordinate.
      * @param aRefPad The pad to test
      * @param aStart The start of the pad list to test against
      * @param aEnd Marks the end of the list and is not included
-     * @param x_limit is used to stop the test (when the any pad's X coord exceeds this)
      */
-    bool doPadToPadsDrc( D_PAD* aRefPad, D_PAD** aStart, D_PAD** aEnd, int x_limit );
+    bool doPadToPadsDrc( D_PAD* aRefPad, D_PAD** aStart, D_PAD** aEnd );
 
     /**
      * Function DoTrackDrc
-     * tests the current segment.
+     * tests the current segment.  The items which are too far from it to be in conflict
+     * are skipped with a bounding box test.
      * @param aRefSeg The segment to test
      * @param aStart The head of a list of tracks to test against (usually BOARD::m_Track)
      * @param doPads true if should do pads test
@@ -313,6 +356,27 @@ private:
      */
     bool doTrackDrc( TRACK* aRefSeg, TRACK* aStart, bool doPads = true );
 
+    /**
+     * Function DoTrackDrc
+     * tests the current segment against a given set of items.
+     * @param aRefSeg The segment to test
+     * @param aPadStart, aPadEnd The pads to test against, in board pad list order
+     * @param aTrackStart, aTrackEnd The tracks to test against, in track list order
+     * @return bool - true if no poblems, else false and m_currentMarker is
+     *          filled in with the problem information.
+     */
+    bool doTrackDrc( TRACK* aRefSeg, D_PAD* const* aPadStart, D_PAD* const* aPadEnd,
+                     TRACK* const* aTrackStart, TRACK* const* aTrackEnd );
+
+    bool doTrackDrc( TRACK* aRefSeg, const std::vector<D_PAD*>& aPads,
+                     const std::vector<TRACK*>& aTracks )
+    {
+        D_PAD* const* pads = aPads.empty() ? NULL : &aPads[0];
+        TRACK* const* tracks = aTracks.empty() ? NULL : &aTracks[0];
+
+        return doTrackDrc( aRefSeg, pads, pads + aPads.size(), tracks, tracks + aTracks.size() );
+    }
+
     /**
      * Function doTrackKeepoutDrc
      * tests the current segment or via.
@@ -393,8 +457,28 @@ private:
 public:
     DRC( PCB_EDIT_FRAME* aPcbWindow );
 
+    /**
+     * Constructor
+     * creates a DRC working on aBoard without any window.  Only the tests which do
+     * not report to the user, such as TestTracks(), can be run.
+     */
+    DRC( BOARD* aBoard );
+
     ~DRC();
 
+    /**
+     * Function TestTracks
+     * runs the track and via clearance test of the full DRC on a THREAD_POOL, without
+     * any user interface and without adding the markers to the board.
+     * @param aMarkers Receives the markers found, in track list order.  The caller owns them.
+     * @param aThreadCount The number of worker threads, 0 for the number of hardware threads
+     * @param aFullScan true to test each track against all the pads and the following
+     *                  tracks, as the DRC did before using the spatial index (used as
+     *                  reference by drc_bench)
+     * @return the number of item pairs tested
+     */
+    long long TestTracks( std::vector<MARKER_PCB*>& aMarkers, int aThreadCount, bool aFullScan );
+
     /**
      * Function Drc
      * tests the current segment and returns the result and displays the error
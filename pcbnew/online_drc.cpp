@@ -0,0 +1,459 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file online_drc.cpp
+ */
+
+#include <fctsys.h>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <wxPcbStruct.h>
+#include <class_drawpanel.h>
+#include <class_draw_panel_gal.h>
+#include <view/view.h>
+#include <tool/tool_manager.h>
+
+#include <class_board.h>
+#include <class_module.h>
+#include <class_track.h>
+#include <class_pad.h>
+#include <class_marker_pcb.h>
+
+#include <pcbnew.h>
+#include <tools/common_actions.h>
+#include <drc_stuff.h>
+#include <drc_spatial_index.h>
+#include <clearance_poly_cache.h>
+#include <thread_pool.h>
+#include <profile.h>
+#include <online_drc.h>
+
+
+ONLINE_DRC::ONLINE_DRC( PCB_EDIT_FRAME* aFrame ) :
+    m_frame( aFrame ),
+    m_valid( false ),
+    m_index( new DRC_SPATIAL_INDEX )
+{
+}
+
+
+ONLINE_DRC::~ONLINE_DRC()
+{
+}
+
+
+void ONLINE_DRC::Schedule()
+{
+    if( g_OnlineDrc )
+        Start( UPDATE_DELAY, wxTIMER_ONE_SHOT );
+}
+
+
+void ONLINE_DRC::Notify()
+{
+    if( !g_OnlineDrc )
+        return;
+
+    // The markers must not change under a running command
+    if( isBusy() )
+        Schedule();
+    else
+        Update();
+}
+
+
+bool ONLINE_DRC::isBusy() const
+{
+    // The legacy canvas captures the mouse for the duration of a command, and draws
+    // the items being edited itself
+    if( !m_frame->IsGalCanvasActive() )
+        return m_frame->GetCanvas()->IsMouseCaptured();
+
+    // Between two commands, the selection tool is the only active tool
+    TOOL_MANAGER* toolMgr = m_frame->GetToolManager();
+    TOOL_BASE*    selectionTool = toolMgr->FindTool( "pcbnew.InteractiveSelection" );
+
+    return !selectionTool || toolMgr->GetCurrentToolId() != selectionTool->GetId();
+}
+
+
+void ONLINE_DRC::Clear()
+{
+    Stop();
+
+    // The markers belong to the board, they are not deleted here
+    m_states.clear();
+    m_index->Clear();
+    m_valid = false;
+}
+
+
+std::size_t ONLINE_DRC::itemHash( const BOARD_ITEM* aItem )
+{
+    const BOARD_CONNECTED_ITEM* item = static_cast<const BOARD_CONNECTED_ITEM*>( aItem );
+    std::size_t hash = CLEARANCE_POLY_CACHE::ShapeHash( aItem );
+
+    boost::hash_combine( hash, item->GetNetCode() );
+    boost::hash_combine( hash, item->GetClearance() );
+
+    LSET layers = aItem->GetLayerSet();
+
+    for( LSEQ seq = layers.Seq();  seq;  ++seq )
+        boost::hash_combine( hash, (int) *seq );
+
+    if( aItem->Type() == PCB_PAD_T )
+    {
+        const D_PAD* pad = static_cast<const D_PAD*>( aItem );
+
+        boost::hash_combine( hash, pad->GetDrillSize().x );
+        boost::hash_combine( hash, pad->GetDrillSize().y );
+        boost::hash_combine( hash, (int) pad->GetDrillShape() );
+
+        // Used to accept equivalent pads of a footprint
+        boost::hash_combine( hash, pad->GetParent() );
+        boost::hash_combine( hash, pad->GetPackedPadName() );
+    }
+
+    return hash;
+}
+
+
+void ONLINE_DRC::snapshot( BOARD* aBoard, STATE_MAP& aStates )
+{
+    aStates.clear();
+
+    for( TRACK* track = aBoard->m_Track;  track;  track = track->Next() )
+    {
+        ITEM_STATE& state = aStates[track];
+
+        state.m_hash = itemHash( track );
+        state.m_area = DRC_SPATIAL_INDEX::TrackArea( track, 0 );
+    }
+
+    for( MODULE* module = aBoard->m_Modules;  module;  module = module->Next() )
+    {
+        for( D_PAD* pad = module->Pads();  pad;  pad = pad->Next() )
+        {
+            ITEM_STATE& state = aStates[pad];
+
+            state.m_hash = itemHash( pad );
+            state.m_area = DRC_SPATIAL_INDEX::PadArea( pad, 0 );
+        }
+    }
+}
+
+
+bool ONLINE_DRC::hasMarker( const ITEM_STATE& aState, const MARKER_SET& aBoardMarkers )
+{
+    // The marker can have been deleted by the user or by the full DRC, and another
+    // one created at the same address
+    return aState.m_marker && aBoardMarkers.count( aState.m_marker )
+           && aState.m_marker->GetPos() == aState.m_markerPos
+           && aState.m_marker->GetReporter().GetErrorCode() == aState.m_markerCode;
+}
+
+
+void ONLINE_DRC::setMarker( ITEM_STATE& aState, MARKER_PCB* aMarker,
+                            const MARKER_SET& aBoardMarkers )
+{
+    BOARD*       board = m_frame->GetBoard();
+    KIGFX::VIEW* view = m_frame->GetGalCanvas()->GetView();
+
+    if( hasMarker( aState, aBoardMarkers ) )
+    {
+        // The selection tool and the legacy canvas must not keep a deleted marker
+        if( aState.m_marker->IsSelected() )
+            m_frame->GetToolManager()->RunAction( COMMON_ACTIONS::unselectItem, true,
+                                                  aState.m_marker );
+
+        if( m_frame->GetCurItem() == aState.m_marker )
+            m_frame->SetCurItem( NULL );
+
+        view->Remove( aState.m_marker );
+        board->Delete( aState.m_marker );
+    }
+
+    aState.m_marker = aMarker;
+
+    if( aMarker )
+    {
+        aState.m_markerPos = aMarker->GetPos();
+        aState.m_markerCode = aMarker->GetReporter().GetErrorCode();
+
+        board->Add( aMarker );
+        view->Add( aMarker );
+    }
+}
+
+
+void ONLINE_DRC::testTracks( const DRC_SPATIAL_INDEX* aIndex, const std::vector<int>* aTracks,
+                             int aFirst, int aLast, std::vector<MARKER_PCB*>* aMarkers )
+{
+    // doTrackDrc() stores intermediate results in the DRC object
+    DRC checker( m_frame );
+
+    const std::vector<TRACK*>&  tracks = aIndex->GetTracks();
+    std::vector<D_PAD*>         pads;
+    std::vector<TRACK*>         candidates;
+
+    for( int ii = aFirst; ii < aLast; ++ii )
+    {
+        int      position = (*aTracks)[ii];
+        TRACK*   segm = tracks[position];
+        EDA_RECT area = DRC_SPATIAL_INDEX::TrackArea( segm, aIndex->GetMaxClearance() );
+
+        // As the full DRC does, a segment is tested against the segments located
+        // after it in the track list
+        aIndex->QueryPads( area, pads );
+        aIndex->QueryTracks( area, segm->GetLayerSet(), position, candidates );
+
+        if( !checker.doTrackDrc( segm, pads, candidates ) )
+        {
+            (*aMarkers)[ii] = checker.m_currentMarker;
+            checker.m_currentMarker = NULL;
+        }
+    }
+}
+
+
+void ONLINE_DRC::Update()
+{
+    Stop();
+
+#ifdef PROFILE
+    prof_counter totalRealTime;
+    prof_start( &totalRealTime );
+#endif /* PROFILE */
+
+    BOARD* board = m_frame->GetBoard();
+
+    MARKER_SET boardMarkers;
+
+    for( int ii = 0; ii < board->GetMARKERCount(); ++ii )
+        boardMarkers.insert( board->GetMARKER( ii ) );
+
+    STATE_MAP current;
+    snapshot( board, current );
+
+    // Areas of the items added, removed or modified since the last update
+    std::vector<EDA_RECT> dirty;
+
+    // Items to be indexed again
+    std::vector<BOARD_CONNECTED_ITEM*> changed;
+
+    for( STATE_MAP::iterator it = current.begin(); it != current.end(); ++it )
+    {
+        STATE_MAP::iterator old = m_states.find( it->first );
+
+        if( old == m_states.end() )
+        {
+            dirty.push_back( it->second.m_area );
+            changed.push_back( static_cast<BOARD_CONNECTED_ITEM*>( it->first ) );
+            continue;
+        }
+
+        if( old->second.m_hash != it->second.m_hash )
+        {
+            dirty.push_back( old->second.m_area );
+            dirty.push_back( it->second.m_area );
+            changed.push_back( static_cast<BOARD_CONNECTED_ITEM*>( it->first ) );
+        }
+
+        // Kept unless the item is tested again
+        if( hasMarker( old->second, boardMarkers ) )
+        {
+            it->second.m_marker = old->second.m_marker;
+            it->second.m_markerPos = old->second.m_markerPos;
+            it->second.m_markerCode = old->second.m_markerCode;
+        }
+    }
+
+    for( STATE_MAP::iterator it = m_states.begin(); it != m_states.end(); ++it )
+    {
+        if( current.find( it->first ) == current.end() )
+        {
+            dirty.push_back( it->second.m_area );
+            setMarker( it->second, NULL, boardMarkers );
+            m_index->Remove( it->first );
+        }
+    }
+
+    m_states.swap( current );
+
+    if( m_valid && dirty.empty() )
+        return;
+
+    if( !m_valid )
+    {
+        m_index->Build( board );
+    }
+    else
+    {
+        // Only the modified items are indexed again.  The list positions of all the items
+        // are read again, as adding or removing a track moves the following ones.
+        for( unsigned ii = 0; ii < changed.size(); ++ii )
+            m_index->Add( changed[ii] );
+
+        if( !m_index->UpdateOrder( board ) )
+            m_index->Build( board );
+    }
+
+    const DRC_SPATIAL_INDEX& index = *m_index;
+
+    const std::vector<TRACK*>& tracks = index.GetTracks();
+    const std::vector<D_PAD*>& pads = index.GetPads();
+    const int margin = index.GetMaxClearance();
+
+    // Items close enough to a dirty area to be in conflict with an item in there
+    boost::unordered_set<const BOARD_ITEM*> toTest;
+
+    if( !m_valid )
+    {
+        toTest.insert( tracks.begin(), tracks.end() );
+        toTest.insert( pads.begin(), pads.end() );
+    }
+    else
+    {
+        std::vector<TRACK*> foundTracks;
+        std::vector<D_PAD*> foundPads;
+
+        for( unsigned ii = 0; ii < dirty.size(); ++ii )
+        {
+            EDA_RECT area = dirty[ii];
+            area.Inflate( margin );
+
+            index.QueryTracks( area, LSET::AllCuMask(), -1, foundTracks );
+            index.QueryPads( area, foundPads );
+
+            toTest.insert( foundTracks.begin(), foundTracks.end() );
+            toTest.insert( foundPads.begin(), foundPads.end() );
+        }
+    }
+
+    // Tracks, by position in the track list
+    std::vector<int> testedTracks;
+
+    for( unsigned ii = 0; ii < tracks.size(); ++ii )
+    {
+        if( toTest.count( tracks[ii] ) )
+            testedTracks.push_back( ii );
+    }
+
+    const int count = testedTracks.size();
+    const int jobSize = 500;
+    std::vector<MARKER_PCB*> markers( count, (MARKER_PCB*) NULL );
+
+    if( count > jobSize )
+    {
+        THREAD_POOL pool;
+
+        for( int first = 0; first < count; first += jobSize )
+        {
+            pool.Submit( boost::bind( &ONLINE_DRC::testTracks, this, &index, &testedTracks,
+                                      first, std::min( first + jobSize, count ), &markers ) );
+        }
+
+        pool.Wait();
+    }
+    else
+    {
+        testTracks( &index, &testedTracks, 0, count, &markers );
+    }
+
+    for( int ii = 0; ii < count; ++ii )
+    {
+        TRACK* track = tracks[testedTracks[ii]];
+        setMarker( m_states[track], markers[ii], boardMarkers );
+    }
+
+    // Pads, tested against the pads located after them in the pad list sorted by
+    // position, as DRC::testPad2Pad() does
+    std::vector<D_PAD*> sortedPads;
+    board->GetSortedPadListByXthenYCoord( sortedPads );
+
+    boost::unordered_map<const D_PAD*, int> rank;
+
+    for( unsigned ii = 0; ii < sortedPads.size(); ++ii )
+        rank[sortedPads[ii]] = ii;
+
+    DRC checker( m_frame );
+    std::vector<D_PAD*> found;
+    std::vector<std::pair<int, D_PAD*> > candidates;
+    int testedPads = 0;
+
+    for( unsigned ii = 0; ii < sortedPads.size(); ++ii )
+    {
+        D_PAD* pad = sortedPads[ii];
+
+        if( !toTest.count( pad ) )
+            continue;
+
+        testedPads++;
+
+        index.QueryPads( DRC_SPATIAL_INDEX::PadArea( pad, margin ), found );
+        candidates.clear();
+
+        for( unsigned jj = 0; jj < found.size(); ++jj )
+        {
+            int position = rank[found[jj]];
+
+            if( position > (int) ii )
+                candidates.push_back( std::make_pair( position, found[jj] ) );
+        }
+
+        std::sort( candidates.begin(), candidates.end() );
+
+        found.clear();
+
+        for( unsigned jj = 0; jj < candidates.size(); ++jj )
+            found.push_back( candidates[jj].second );
+
+        MARKER_PCB* marker = NULL;
+
+        if( !found.empty() && !checker.doPadToPadsDrc( pad, &found[0], &found[0] + found.size() ) )
+        {
+            marker = checker.m_currentMarker;
+            checker.m_currentMarker = NULL;
+        }
+
+        setMarker( m_states[pad], marker, boardMarkers );
+    }
+
+    m_valid = true;
+
+    if( m_frame->IsGalCanvasActive() )
+        m_frame->GetGalCanvas()->Refresh();
+    else
+        m_frame->GetCanvas()->Refresh();
+
+#ifdef PROFILE
+    prof_end( &totalRealTime );
+
+    wxLogDebug( wxT( "Online DRC: %d dirty areas, %d tracks and %d pads tested in %.1f ms" ),
+                (int) dirty.size(), count, testedPads, totalRealTime.msecs() );
+#endif /* PROFILE */
+}
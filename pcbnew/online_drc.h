@@ -0,0 +1,144 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file online_drc.h
+ * @brief Design rule check run while the board is edited.
+ */
+
+#ifndef ONLINE_DRC_H
+#define ONLINE_DRC_H
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <wx/timer.h>
+
+#include <class_eda_rect.h>
+
+class BOARD;
+class BOARD_ITEM;
+class MARKER_PCB;
+class PCB_EDIT_FRAME;
+class DRC_SPATIAL_INDEX;
+
+
+/**
+ * Class ONLINE_DRC
+ * keeps the clearance markers of tracks, vias and pads up to date while the board
+ * is edited, without running the whole DRC.
+ * <p>
+ * Schedule() is called each time a modification is committed (see
+ * PCB_EDIT_FRAME::OnModify(), which is also used by undo and redo).  Once the
+ * board has been left unchanged for UPDATE_DELAY ms and no command is running
+ * (see isBusy()), the items are compared to their state at the previous update:
+ * only the items added, removed or modified, and the items close enough to them to
+ * be in conflict, are checked again.  The result of
+ * the other items (their marker, if any) is kept.  The spatial index used to find
+ * these items is kept too, and updated with the modified items only.
+ * </p>
+ * The tests are the same as the tests of the full DRC (DRC::testTracks() and
+ * DRC::testPad2Pad()), so the markers are the same too.  The check runs on the
+ * GUI thread, as the board cannot be read while it is edited; the tracks are
+ * dispatched to a THREAD_POOL when there are many of them.
+ */
+class ONLINE_DRC : public wxTimer
+{
+public:
+    ONLINE_DRC( PCB_EDIT_FRAME* aFrame );
+    ~ONLINE_DRC();
+
+    /**
+     * Function Schedule
+     * requests an update, run once the board is left unmodified for UPDATE_DELAY ms.
+     * Does nothing if the online DRC is disabled (see g_OnlineDrc).
+     */
+    void Schedule();
+
+    /**
+     * Function Update
+     * checks the items modified since the last update, and their neighbours, and
+     * updates their markers.
+     */
+    void Update();
+
+    /**
+     * Function Clear
+     * forgets the state of the items and their markers, so the next update checks
+     * every item.  Must be called when the board is replaced.
+     */
+    void Clear();
+
+    ///> Called by the timer started by Schedule().
+    void Notify();
+
+    ///> Delay between the last modification and the update, in ms.
+    static const int UPDATE_DELAY = 300;
+
+private:
+    ///> State of a tested item, and the marker of its first error, if any.
+    struct ITEM_STATE
+    {
+        ITEM_STATE() : m_hash( 0 ), m_marker( NULL ), m_markerCode( 0 ) {}
+
+        std::size_t m_hash;         ///< hash of the item parameters used by the tests
+        EDA_RECT    m_area;         ///< area of the item shape and hole
+        MARKER_PCB* m_marker;       ///< owned by the board, which can delete it
+        wxPoint     m_markerPos;    ///< used to find out if m_marker still exists
+        int         m_markerCode;   ///< used to find out if m_marker still exists
+    };
+
+    typedef boost::unordered_map<BOARD_ITEM*, ITEM_STATE> STATE_MAP;
+    typedef boost::unordered_set<const MARKER_PCB*> MARKER_SET;
+
+    ///> Computes the state of the tracks, vias and pads of aBoard.
+    static void snapshot( BOARD* aBoard, STATE_MAP& aStates );
+
+    ///> Returns the hash of the parameters of aItem used by the tests.
+    static std::size_t itemHash( const BOARD_ITEM* aItem );
+
+    ///> Returns true while a command is running (a tool other than the selection tool in
+    ///> the GAL canvas, or a command of the legacy canvas): the update waits for its end.
+    bool isBusy() const;
+
+    ///> Returns true if aState still refers to a marker of the board.
+    static bool hasMarker( const ITEM_STATE& aState, const MARKER_SET& aBoardMarkers );
+
+    ///> Tests the tracks at aTracks[aFirst .. aLast - 1], run by a worker thread.
+    void testTracks( const DRC_SPATIAL_INDEX* aIndex, const std::vector<int>* aTracks,
+                     int aFirst, int aLast, std::vector<MARKER_PCB*>* aMarkers );
+
+    ///> Replaces the marker of an item, stored in aState, by aMarker (which can be NULL).
+    void setMarker( ITEM_STATE& aState, MARKER_PCB* aMarker, const MARKER_SET& aBoardMarkers );
+
+    PCB_EDIT_FRAME* m_frame;
+    STATE_MAP       m_states;
+    bool            m_valid;        ///< true once a state has been recorded
+
+    ///> Index of the items recorded in m_states
+    boost::scoped_ptr<DRC_SPATIAL_INDEX> m_index;
+};
+
+#endif  // ONLINE_DRC_H
@@ -126,32 +126,43 @@ PCB_DRAW_PANEL_GAL::~PCB_DRAW_PANEL_GAL()
 }
 
 
+static void appendItem( std::vector<KIGFX::VIEW_ITEM*>* aItems, BOARD_ITEM* aItem )
+{
+    aItems->push_back( aItem );
+}
+
+
 void PCB_DRAW_PANEL_GAL::DisplayBoard( const BOARD* aBoard )
 {
     m_view->Clear();
 
+    // The items are gathered first, so the view can build its spatial index at once
+    std::vector<KIGFX::VIEW_ITEM*> items;
+
     // Load zones
     for( int i = 0; i < aBoard->GetAreaCount(); ++i )
-        m_view->Add( (KIGFX::VIEW_ITEM*) ( aBoard->GetArea( i ) ) );
+        items.push_back( (KIGFX::VIEW_ITEM*) ( aBoard->GetArea( i ) ) );
 
     // Load drawings
     for( BOARD_ITEM* drawing = aBoard->m_Drawings; drawing; drawing = drawing->Next() )
-        m_view->Add( drawing );
+        items.push_back( drawing );
 
     // Load tracks
     for( TRACK* track = aBoard->m_Track; track; track = track->Next() )
-        m_view->Add( track );
+        items.push_back( track );
 
     // Load modules and its additional elements
     for( MODULE* module = aBoard->m_Modules; module; module = module->Next() )
     {
-        module->RunOnChildren( boost::bind( &KIGFX::VIEW::Add, m_view, _1 ) );
-        m_view->Add( module );
+        module->RunOnChildren( boost::bind( &appendItem, &items, _1 ) );
+        items.push_back( module );
     }
 
     // Segzones (equivalent of ZONE_CONTAINER for legacy boards)
     for( SEGZONE* zone = aBoard->m_Zone; zone; zone = zone->Next() )
-        m_view->Add( zone );
+        items.push_back( zone );
+
+    m_view->AddItems( items );
 
     // Ratsnest
     if( m_ratsnest )
@@ -211,6 +211,17 @@ PCB_PAINTER::PCB_PAINTER( GAL* aGal ) :
 }
 
 
+PAINTER* PCB_PAINTER::Clone( GAL* aGal ) const
+{
+    PCB_PAINTER* painter = new PCB_PAINTER( aGal );
+
+    painter->m_pcbSettings = m_pcbSettings;
+    painter->m_brightenedColor = m_brightenedColor;
+
+    return painter;
+}
+
+
 bool PCB_PAINTER::Draw( const VIEW_ITEM* aItem, int aLayer )
 {
     const EDA_ITEM* item = static_cast<const EDA_ITEM*>( aItem );
@@ -45,6 +45,8 @@
 #include <pcbnew.h>
 #include <pcbnew_id.h>
 #include <drc_stuff.h>
+#include <zone_fill_tracker.h>
+#include <online_drc.h>
 #include <layer_widget.h>
 #include <dialog_design_rules.h>
 #include <class_pcb_layer_widget.h>
@@ -326,6 +328,8 @@ PCB_EDIT_FRAME::PCB_EDIT_FRAME( KIWAY* aKiway, wxWindow* aParent ) :
     m_hasAutoSave = true;
     m_RecordingMacros = -1;
     m_microWaveToolBar = NULL;
+    m_zoneFillTracker = new ZONE_FILL_TRACKER;
+    m_onlineDrc = new ONLINE_DRC( this );
 
     m_rotationAngle = 900;
 
@@ -480,6 +484,8 @@ PCB_EDIT_FRAME::~PCB_EDIT_FRAME()
         m_Macros[i].m_Record.clear();
 
     delete m_drc;
+    delete m_zoneFillTracker;
+    delete m_onlineDrc;
 }
 
 
@@ -487,6 +493,11 @@ void PCB_EDIT_FRAME::SetBoard( BOARD* aBoard )
 {
     PCB_BASE_EDIT_FRAME::SetBoard( aBoard );
 
+    // The zone fill state of the previous board is meaningless for the new one
+    m_zoneFillTracker->Clear();
+    m_onlineDrc->Clear();
+    m_onlineDrc->Schedule();
+
     if( IsGalCanvasActive() )
     {
         aBoard->GetRatsnest()->Recalculate();
@@ -955,6 +966,8 @@ void PCB_EDIT_FRAME::OnModify( )
 {
     PCB_BASE_FRAME::OnModify();
 
+    m_onlineDrc->Schedule();
+
     EDA_3D_FRAME* draw3DFrame = Get3DViewerFrame();
 
     if( draw3DFrame )
@@ -95,6 +95,9 @@ wxString    g_DocModulesFileName = wxT( "footprints_doc/footprints.pdf" );
 DLIST<TRACK> g_CurrentTrackList;
 
 bool g_DumpZonesWhenFilling = false;
+bool g_ParallelZoneFilling = true;
+bool g_IncrementalZoneFilling = true;
+bool g_OnlineDrc = false;
 
 namespace PCB {
 
@@ -94,6 +94,9 @@ extern int      g_MagneticPadOption;
 extern int      g_MagneticTrackOption;
 
 extern bool     g_DumpZonesWhenFilling;
+extern bool     g_ParallelZoneFilling;   // Fill_All_Zones() uses a thread pool
+extern bool     g_IncrementalZoneFilling;    // Fill_All_Zones() only refills modified areas
+extern bool     g_OnlineDrc;             // clearance markers are updated while editing
 
 extern wxPoint  g_Offset_Module;         // Offset trace when moving footprint.
 
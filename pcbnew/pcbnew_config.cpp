@@ -428,6 +428,12 @@ PARAM_CFG_ARRAY& PCB_EDIT_FRAME::GetConfigurationSettings()
                                                         &g_TwoSegmentTrackBuild, true ) );
         m_configSettings.push_back( new PARAM_CFG_BOOL( true, wxT( "SegmPcb45Only" )
                                                         , &g_Segments_45_Only, true ) );
+        m_configSettings.push_back( new PARAM_CFG_BOOL( true, wxT( "ParallelZoneFill" ),
+                                                        &g_ParallelZoneFilling, true ) );
+        m_configSettings.push_back( new PARAM_CFG_BOOL( true, wxT( "IncrementalZoneFill" ),
+                                                        &g_IncrementalZoneFilling, true ) );
+        m_configSettings.push_back( new PARAM_CFG_BOOL( true, wxT( "OnlineDrc" ),
+                                                        &g_OnlineDrc, false ) );
     }
 
     return m_configSettings;
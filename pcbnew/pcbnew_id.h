@@ -240,6 +240,7 @@ enum pcbnew_ids
     ID_POPUP_PCB_AUTOPLACE_ALL_MODULES,
     ID_POPUP_PCB_AUTOPLACE_NEW_MODULES,
     ID_POPUP_PCB_AUTOPLACE_NEXT_MODULE,
+    ID_POPUP_PCB_AUTOPLACE_ANNEAL_MODULES,
 
     ID_POPUP_PCB_AUTOROUTE_COMMANDS,
     ID_POPUP_PCB_AUTOROUTE_ALL_MODULES,
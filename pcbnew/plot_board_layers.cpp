@@ -47,6 +47,7 @@
 #include <class_drawsegment.h>
 #include <class_mire.h>
 #include <class_dimension.h>
+#include <clearance_poly_cache.h>
 
 #include <pcbnew.h>
 #include <pcbplot.h>
@@ -712,6 +713,7 @@ void PlotSolderMaskLayer( BOARD *aBoard, PLOTTER* aPlotter,
         // use the global mask clearance for vias
         int via_clearance = aBoard->GetDesignSettings().m_SolderMaskMargin;
         int via_margin = via_clearance + inflate;
+        CLEARANCE_POLY_CACHE* polyCache = aBoard->GetClearancePolyCache();
 
         for( TRACK* track = aBoard->m_Track; track; track = track->Next() )
         {
@@ -733,10 +735,10 @@ void PlotSolderMaskLayer( BOARD *aBoard, PLOTTER* aPlotter,
             if( !( via_set & aLayerMask ).any() )
                 continue;
 
-            via->TransformShapeWithClearanceToPolygon( areas, via_margin,
+            polyCache->TransformShapeWithClearanceToPolygon( via, areas, via_margin,
                     circleToSegmentsCount,
                     correction );
-            via->TransformShapeWithClearanceToPolygon( initialPolys, via_clearance,
+            polyCache->TransformShapeWithClearanceToPolygon( via, initialPolys, via_clearance,
                     circleToSegmentsCount,
                     correction );
         }
@@ -27,10 +27,6 @@
  * @brief Class that computes missing connections on a PCB.
  */
 
-#ifdef USE_OPENMP
-#include <omp.h>
-#endif /* USE_OPENMP */
-
 #include <ratsnest_data.h>
 
 #include <class_board.h>
@@ -45,9 +41,13 @@
 #include <boost/bind.hpp>
 
 #include <geometry/shape_poly_set.h>
+#include <disjoint_set.h>
+#include <thread_pool.h>
 
 #include <cassert>
+#include <cmath>
 #include <algorithm>
+#include <functional>
 #include <limits>
 
 #ifdef PROFILE
@@ -72,12 +72,185 @@ static bool sortDistance( const RN_NODE_PTR& aOrigin, const RN_NODE_PTR& aNode1,
 }
 
 
-static bool sortWeight( const RN_EDGE_PTR& aEdge1, const RN_EDGE_PTR& aEdge2 )
+static bool sortWeight( const RN_EDGE_MST_PTR& aEdge1, const RN_EDGE_MST_PTR& aEdge2 )
 {
     return aEdge1->GetWeight() < aEdge2->GetWeight();
 }
 
 
+static bool sortNeighbourDistance( const std::pair<double, const RN_NODE_PTR*>& aFirst,
+                                   const std::pair<double, const RN_NODE_PTR*>& aSecond )
+{
+    return aFirst.first < aSecond.first;
+}
+
+
+// Returns true for triangulation edges that have to be removed: edges connecting
+// a removed node, or connecting two nodes that are going to be triangulated again
+static bool isEdgeReplaced( const RN_EDGE_MST_PTR& aEdge,
+                            const boost::unordered_set<const RN_NODE*>& aAlive,
+                            const boost::unordered_set<const RN_NODE*>& aRegion )
+{
+    const RN_NODE* source = aEdge->GetSourceNode().get();
+    const RN_NODE* target = aEdge->GetTargetNode().get();
+
+    if( !aAlive.count( source ) || !aAlive.count( target ) )
+        return true;
+
+    return aRegion.count( source ) && aRegion.count( target );
+}
+
+
+static bool sortNodeX( const RN_NODE_PTR* aNode1, const RN_NODE_PTR* aNode2 )
+{
+    return (*aNode1)->GetX() < (*aNode2)->GetX();
+}
+
+
+static bool compareNodeX( const RN_NODE_PTR* aNode, int aX )
+{
+    return (*aNode)->GetX() < aX;
+}
+
+
+static bool compareXNode( int aX, const RN_NODE_PTR* aNode )
+{
+    return aX < (*aNode)->GetX();
+}
+
+
+static bool sortNodeAddress( const RN_NODE_PTR& aNode1, const RN_NODE_PTR& aNode2 )
+{
+    return aNode1.get() < aNode2.get();
+}
+
+
+// Range of the nodes sorted by sortNodeX() whose X coordinate is in [aMin, aMax]
+static void nodeRangeX( const std::vector<const RN_NODE_PTR*>& aSorted, double aMin, double aMax,
+                        std::vector<const RN_NODE_PTR*>::const_iterator& aBegin,
+                        std::vector<const RN_NODE_PTR*>::const_iterator& aEnd )
+{
+    const double lo = std::numeric_limits<int>::min();
+    const double hi = std::numeric_limits<int>::max();
+
+    aBegin = std::lower_bound( aSorted.begin(), aSorted.end(),
+                               (int) std::max( lo, std::min( hi, floor( aMin ) ) ), compareNodeX );
+    aEnd = std::upper_bound( aBegin, aSorted.end(),
+                             (int) std::max( lo, std::min( hi, ceil( aMax ) ) ), compareXNode );
+}
+
+
+static double squaredDistance( const RN_NODE_PTR& aNode, double aX, double aY )
+{
+    double dx = aNode->GetX() - aX;
+    double dy = aNode->GetY() - aY;
+
+    return dx * dx + dy * dy;
+}
+
+
+// Finds the aCount nodes closest to aNode (excluding it), closest first, among the nodes
+// sorted by sortNodeX(). The nodes are scanned away from aNode along the X axis, until
+// the X distance alone is larger than the distance of the farthest node kept.
+static void findClosestNodes( const RN_NODE_PTR& aNode,
+                              const std::vector<const RN_NODE_PTR*>& aSorted, unsigned int aCount,
+                              std::vector<std::pair<double, const RN_NODE_PTR*> >& aClosest )
+{
+    const double x = aNode->GetX();
+    const double y = aNode->GetY();
+    std::vector<const RN_NODE_PTR*>::const_iterator left, right;
+
+    aClosest.clear();
+
+    if( aCount == 0 )
+        return;
+
+    left = right = std::lower_bound( aSorted.begin(), aSorted.end(), aNode->GetX(),
+                                     compareNodeX );
+
+    // aClosest is kept as a heap, the farthest node first
+    for( ;; )
+    {
+        double farthest = aClosest.size() < aCount ? std::numeric_limits<double>::max() :
+                          aClosest.front().first;
+        double rightDx = right != aSorted.end() ? (**right)->GetX() - x : 0.0;
+        double leftDx = left != aSorted.begin() ? x - (**( left - 1 ))->GetX() : 0.0;
+        const RN_NODE_PTR* candidate = NULL;
+
+        if( right != aSorted.end() && rightDx * rightDx <= farthest )
+            candidate = *right++;
+        else if( left != aSorted.begin() && leftDx * leftDx <= farthest )
+            candidate = *--left;
+        else
+            break;
+
+        if( candidate->get() == aNode.get() )
+            continue;
+
+        double distance = squaredDistance( *candidate, x, y );
+
+        if( aClosest.size() < aCount )
+        {
+            aClosest.push_back( std::make_pair( distance, candidate ) );
+            std::push_heap( aClosest.begin(), aClosest.end(), sortNeighbourDistance );
+        }
+        else if( distance < farthest )
+        {
+            std::pop_heap( aClosest.begin(), aClosest.end(), sortNeighbourDistance );
+            aClosest.back() = std::make_pair( distance, candidate );
+            std::push_heap( aClosest.begin(), aClosest.end(), sortNeighbourDistance );
+        }
+    }
+
+    std::sort_heap( aClosest.begin(), aClosest.end(), sortNeighbourDistance );
+}
+
+
+// Returns true if no node sorted by sortNodeX() lies strictly inside the circumcircle of
+// the triangle, so the triangle belongs to the Delaunay triangulation of all the nodes
+static bool isDelaunayTriangle( const RN_NODE_PTR& aA, const RN_NODE_PTR& aB,
+                                const RN_NODE_PTR& aC,
+                                const std::vector<const RN_NODE_PTR*>& aSorted )
+{
+    // Circumcenter, relative to aA
+    double bx = aB->GetX() - aA->GetX(), by = aB->GetY() - aA->GetY();
+    double cx = aC->GetX() - aA->GetX(), cy = aC->GetY() - aA->GetY();
+    double d = 2.0 * ( bx * cy - by * cx );
+
+    if( d == 0.0 )
+        return false;
+
+    double b2 = bx * bx + by * by;
+    double c2 = cx * cx + cy * cy;
+    double ux = ( cy * b2 - by * c2 ) / d;
+    double uy = ( bx * c2 - cx * b2 ) / d;
+    double r2 = ux * ux + uy * uy;
+    double r = sqrt( r2 );
+    double centerX = aA->GetX() + ux;
+    double centerY = aA->GetY() + uy;
+
+    // The nodes on the circle (e.g. the corners of a square) do not count: both diagonals
+    // are Delaunay edges then
+    double limit = r2 * ( 1.0 - 1e-9 );
+
+    std::vector<const RN_NODE_PTR*>::const_iterator it, end;
+    nodeRangeX( aSorted, centerX - r, centerX + r, it, end );
+
+    for( ; it != end; ++it )
+    {
+        const RN_NODE_PTR& node = **it;
+
+        if( node.get() == aA.get() || node.get() == aB.get() || node.get() == aC.get() )
+            continue;
+
+        if( squaredDistance( node, centerX, centerY ) < limit )
+            return false;
+    }
+
+    return true;
+}
+
+
 bool sortArea( const RN_POLY& aP1, const RN_POLY& aP2 )
 {
     return aP1.m_bbox.GetArea() < aP2.m_bbox.GetArea();
@@ -114,94 +287,97 @@ static bool isEdgeConnectingNode( const RN_EDGE_PTR& aEdge, const RN_NODE_PTR& a
 }
 
 
-static std::vector<RN_EDGE_MST_PTR>* kruskalMST( RN_LINKS::RN_EDGE_LIST& aEdges,
-                                                 std::vector<RN_NODE_PTR>& aNodes )
+// Returns the index of a node in the node list given to kruskalMST(), stored in its tag
+static inline int mstIndex( const RN_NODE_PTR& aNode, const std::vector<RN_NODE_PTR>& aNodes )
+{
+    int index = aNode->GetTag();
+
+    // A node which is not in the list cannot be connected
+    if( index < 0 || index >= (int) aNodes.size() || aNodes[index].get() != aNode.get() )
+        return -1;
+
+    return index;
+}
+
+
+static std::vector<RN_EDGE_MST_PTR>* kruskalMST( const RN_LINKS::RN_EDGE_VECTOR& aConnections,
+                                                 const std::vector<RN_EDGE_MST_PTR>& aEdges,
+                                                 const std::vector<RN_NODE_PTR>& aNodes )
 {
     unsigned int nodeNumber = aNodes.size();
-    unsigned int mstExpectedSize = nodeNumber - 1;
-    unsigned int mstSize = 0;
-    bool ratsnestLines = false;
 
     // The output
     std::vector<RN_EDGE_MST_PTR>* mst = new std::vector<RN_EDGE_MST_PTR>;
-    mst->reserve( mstExpectedSize );
 
-    // Set tags for marking cycles
-    boost::unordered_map<RN_NODE_PTR, int> tags;
-    unsigned int tag = 0;
-    BOOST_FOREACH( RN_NODE_PTR& node, aNodes )
+    // Subtrees of nodes connected together, to detect cycles in the graph.
+    // The tag of a node is its index in aNodes until the connected items are known.
+    DISJOINT_SET forest( nodeNumber );
+
+    for( unsigned int i = 0; i < nodeNumber; ++i )
+        aNodes[i]->SetTag( i );
+
+    // Existing connections are processed first, as their weight is 0.
+    // Triangulation edges with null weight are also considered as connections.
+    for( unsigned int i = 0; i < aConnections.size(); ++i )
     {
-        node->SetTag( tag );
-        tags[node] = tag++;
+        int src = mstIndex( aConnections[i]->GetSourceNode(), aNodes );
+        int trg = mstIndex( aConnections[i]->GetTargetNode(), aNodes );
+
+        if( src >= 0 && trg >= 0 )
+            forest.Union( src, trg );
     }
 
-    // Lists of nodes connected together (subtrees) to detect cycles in the graph
-    std::vector<std::list<int> > cycles( nodeNumber );
-    for( unsigned int i = 0; i < nodeNumber; ++i )
-        cycles[i].push_back( i );
+    unsigned int edge = 0;
+
+    for( ; edge < aEdges.size() && aEdges[edge]->GetWeight() == 0; ++edge )
+    {
+        int src = mstIndex( aEdges[edge]->GetSourceNode(), aNodes );
+        int trg = mstIndex( aEdges[edge]->GetTargetNode(), aNodes );
+
+        if( src >= 0 && trg >= 0 )
+            forest.Union( src, trg );
+    }
 
-    // Kruskal algorithm requires edges to be sorted by their weight
-    aEdges.sort( sortWeight );
+    // Nodes connected together get the same tag, once the ratsnest lines are found
+    std::vector<int> tags( nodeNumber );
+    unsigned int subtrees = 0;
 
-    while( mstSize < mstExpectedSize && !aEdges.empty() )
+    for( unsigned int i = 0; i < nodeNumber; ++i )
     {
-        RN_EDGE_PTR& dt = aEdges.front();
+        tags[i] = forest.Find( i );
 
-        int srcTag = tags[dt->GetSourceNode()];
-        int trgTag = tags[dt->GetTargetNode()];
+        if( tags[i] == (int) i )
+            ++subtrees;
+    }
 
-        // Check if by adding this edge we are going to join two different forests
-        if( srcTag != trgTag )
-        {
-            // Because edges are sorted by their weight, first we always process connected
-            // items (weight == 0). Once we stumble upon an edge with non-zero weight,
-            // it means that the rest of the lines are ratsnest.
-            if( !ratsnestLines && dt->GetWeight() != 0 )
-                ratsnestLines = true;
+    // Ratsnest lines join the remaining subtrees, shortest edges first
+    unsigned int mstExpectedSize = subtrees > 0 ? subtrees - 1 : 0;
+    mst->reserve( mstExpectedSize );
 
-            // Update tags
-            std::list<int>::iterator it, itEnd;
+    for( ; edge < aEdges.size() && mst->size() < mstExpectedSize; ++edge )
+    {
+        const RN_EDGE_MST_PTR& dt = aEdges[edge];
+        int src = mstIndex( dt->GetSourceNode(), aNodes );
+        int trg = mstIndex( dt->GetTargetNode(), aNodes );
 
-            if( ratsnestLines )
-            {
-                for( it = cycles[trgTag].begin(), itEnd = cycles[trgTag].end(); it != itEnd; ++it )
-                    tags[aNodes[*it]] = srcTag;
-            }
-            else
-            {
-                for( it = cycles[trgTag].begin(), itEnd = cycles[trgTag].end(); it != itEnd; ++it ) {
-                    tags[aNodes[*it]] = srcTag;
-                    aNodes[*it]->SetTag( srcTag );
-                }
-            }
+        if( src < 0 || trg < 0 )
+            continue;
 
-            // Move nodes that were marked with old tag to the list marked with the new tag
-            cycles[srcTag].splice( cycles[srcTag].end(), cycles[trgTag] );
+        // Check if by adding this edge we are going to join two different forests
+        if( forest.Find( src ) != forest.Find( trg ) )
+        {
+            forest.Union( src, trg );
 
-            if( ratsnestLines )
-            {
-                // Do a copy of edge, but make it RN_EDGE_MST. In contrary to RN_EDGE,
-                // RN_EDGE_MST saves both source and target node and does not require any other
-                // edges to exist for getting source/target nodes
-                RN_EDGE_MST_PTR newEdge = boost::make_shared<RN_EDGE_MST>( dt->GetSourceNode(),
-                                                                           dt->GetTargetNode(),
-                                                                           dt->GetWeight() );
-                mst->push_back( newEdge );
-                ++mstSize;
-            }
-            else
-            {
-                // Processing a connection, decrease the expected size of the ratsnest MST
-                --mstExpectedSize;
-            }
+            // Do a copy of edge, so it is not modified by further triangulation updates
+            RN_EDGE_MST_PTR newEdge = boost::make_shared<RN_EDGE_MST>( dt->GetSourceNode(),
+                                                                       dt->GetTargetNode(),
+                                                                       dt->GetWeight() );
+            mst->push_back( newEdge );
         }
-
-        // Remove the edge that was just processed
-        aEdges.erase( aEdges.begin() );
     }
 
-    // Probably we have discarded some of edges, so reduce the size
-    mst->resize( mstSize );
+    for( unsigned int i = 0; i < nodeNumber; ++i )
+        aNodes[i]->SetTag( tags[i] );
 
     return mst;
 }
@@ -288,14 +464,80 @@ void RN_NET::removeEdge( RN_EDGE_MST_PTR& aEdge, const BOARD_CONNECTED_ITEM* aPa
 }
 
 
+RN_POOL::~RN_POOL()
+{
+    BOOST_FOREACH( char* chunk, m_chunks )
+        delete[] chunk;
+}
+
+
+RN_POOL::BLOCKS& RN_POOL::getBlocks( size_t aSize )
+{
+    for( unsigned int i = 0; i < m_blocks.size(); ++i )
+    {
+        if( m_blocks[i].m_size == aSize )
+            return m_blocks[i];
+    }
+
+    BLOCKS blocks = { aSize, NULL };
+    m_blocks.push_back( blocks );
+
+    return m_blocks.back();
+}
+
+
+void* RN_POOL::Allocate( size_t aSize )
+{
+    size_t size = ( std::max( aSize, sizeof( void* ) ) + BLOCK_ALIGN - 1 ) & ~( BLOCK_ALIGN - 1 );
+    boost::mutex::scoped_lock lock( m_lock );
+    BLOCKS& blocks = getBlocks( size );
+
+    if( !blocks.m_freeList )
+    {
+        // new[] returns memory aligned for any fundamental type
+        char* chunk = new char[size * CHUNK_BLOCKS];
+        m_chunks.push_back( chunk );
+
+        for( int i = CHUNK_BLOCKS - 1; i >= 0; --i )
+        {
+            void* block = chunk + i * size;
+            *static_cast<void**>( block ) = blocks.m_freeList;
+            blocks.m_freeList = block;
+        }
+    }
+
+    void* block = blocks.m_freeList;
+    blocks.m_freeList = *static_cast<void**>( block );
+
+    return block;
+}
+
+
+void RN_POOL::Deallocate( void* aBlock, size_t aSize )
+{
+    size_t size = ( std::max( aSize, sizeof( void* ) ) + BLOCK_ALIGN - 1 ) & ~( BLOCK_ALIGN - 1 );
+    boost::mutex::scoped_lock lock( m_lock );
+    BLOCKS& blocks = getBlocks( size );
+
+    *static_cast<void**>( aBlock ) = blocks.m_freeList;
+    blocks.m_freeList = aBlock;
+}
+
+
 const RN_NODE_PTR& RN_LINKS::AddNode( int aX, int aY )
 {
-    RN_NODE_SET::iterator node;
-    bool wasNewElement;
+    uint32_t index = m_nodes.size();
+    std::pair<boost::unordered_map<uint64_t, uint32_t>::iterator, bool> it =
+            m_nodeIndex.insert( std::make_pair( nodeKey( aX, aY ), index ) );
+
+    if( !it.second )        // There is already a node with the same coordinates
+        return m_nodes[it.first->second];
 
-    boost::tie( node, wasNewElement ) = m_nodes.emplace( boost::make_shared<RN_NODE>( aX, aY ) );
+    m_nodes.push_back( boost::allocate_shared<RN_NODE>( RN_POOL_ALLOCATOR<RN_NODE>( m_pool ),
+                                                        aX, aY ) );
+    m_addedNodes.push_back( m_nodes.back() );
 
-    return *node;
+    return m_nodes.back();
 }
 
 
@@ -303,7 +545,25 @@ bool RN_LINKS::RemoveNode( const RN_NODE_PTR& aNode )
 {
     if( aNode->GetRefCount() == 0 )
     {
-        m_nodes.erase( aNode );
+        boost::unordered_map<uint64_t, uint32_t>::iterator it =
+                m_nodeIndex.find( nodeKey( aNode->GetX(), aNode->GetY() ) );
+
+        if( it != m_nodeIndex.end() && m_nodes[it->second].get() == aNode.get() )
+        {
+            uint32_t index = it->second;
+
+            m_removedNodes.push_back( aNode );
+            m_nodeIndex.erase( it );
+
+            // Fill the hole with the last node
+            if( index != m_nodes.size() - 1 )
+            {
+                m_nodes[index] = m_nodes.back();
+                m_nodeIndex[nodeKey( m_nodes[index]->GetX(), m_nodes[index]->GetY() )] = index;
+            }
+
+            m_nodes.pop_back();
+        }
 
         return true;
     }
@@ -312,11 +572,32 @@ bool RN_LINKS::RemoveNode( const RN_NODE_PTR& aNode )
 }
 
 
+void RN_LINKS::RemoveConnection( const RN_EDGE_MST_PTR& aEdge )
+{
+    uint32_t index = aEdge->GetIndex();
+
+    // The edge may have been removed already
+    if( index >= m_edges.size() || m_edges[index] != aEdge )
+        return;
+
+    // Fill the hole with the last edge
+    if( index != m_edges.size() - 1 )
+    {
+        m_edges[index] = m_edges.back();
+        m_edges[index]->SetIndex( index );
+    }
+
+    m_edges.pop_back();
+}
+
+
 RN_EDGE_MST_PTR RN_LINKS::AddConnection( const RN_NODE_PTR& aNode1, const RN_NODE_PTR& aNode2,
                                          unsigned int aDistance )
 {
     assert( aNode1 != aNode2 );
-    RN_EDGE_MST_PTR edge = boost::make_shared<RN_EDGE_MST>( aNode1, aNode2, aDistance );
+    RN_EDGE_MST_PTR edge = boost::allocate_shared<RN_EDGE_MST>(
+            RN_POOL_ALLOCATOR<RN_EDGE_MST>( m_pool ), aNode1, aNode2, aDistance );
+    edge->SetIndex( m_edges.size() );
     m_edges.push_back( edge );
 
     return edge;
@@ -325,8 +606,8 @@ RN_EDGE_MST_PTR RN_LINKS::AddConnection( const RN_NODE_PTR& aNode1, const RN_NOD
 
 void RN_NET::compute()
 {
-    const RN_LINKS::RN_NODE_SET& boardNodes = m_links.GetNodes();
-    const RN_LINKS::RN_EDGE_LIST& boardEdges = m_links.GetConnections();
+    const RN_LINKS::RN_NODE_VECTOR& boardNodes = m_links.GetNodes();
+    const RN_LINKS::RN_EDGE_VECTOR& boardEdges = m_links.GetConnections();
 
     // Special cases do not need complicated algorithms
     if( boardNodes.size() <= 2 )
@@ -336,37 +617,220 @@ void RN_NET::compute()
         // Check if the only possible connection exists
         if( boardEdges.size() == 0 && boardNodes.size() == 2 )
         {
-            RN_LINKS::RN_NODE_SET::iterator last = ++boardNodes.begin();
-
             // There can be only one possible connection, but it is missing
-            m_rnEdges->push_back( boost::make_shared<RN_EDGE_MST>( *boardNodes.begin(), *last ) );
+            m_rnEdges->push_back( boost::make_shared<RN_EDGE_MST>( boardNodes[0], boardNodes[1] ) );
         }
 
         // Set tags to nodes as connected
-        BOOST_FOREACH( RN_NODE_PTR node, boardNodes )
+        BOOST_FOREACH( const RN_NODE_PTR& node, boardNodes )
             node->SetTag( 0 );
 
+        m_triangulation.clear();
+        m_triangulationValid = false;
+        m_links.ClearChanges();
+
         return;
     }
 
-    // Move and sort (sorting speeds up) all nodes to a vector for the Delaunay triangulation
-    std::vector<RN_NODE_PTR> nodes( boardNodes.size() );
-    std::partial_sort_copy( boardNodes.begin(), boardNodes.end(), nodes.begin(), nodes.end() );
+    // Moving a few items changes only a few nodes, there is no need
+    // to triangulate the whole net again
+    if( !m_triangulationValid || !updateTriangulation() )
+    {
+        // Sorting speeds up the Delaunay triangulation
+        std::vector<RN_NODE_PTR> nodes( boardNodes.begin(), boardNodes.end() );
+        std::sort( nodes.begin(), nodes.end() );
+        triangulate( nodes );
+    }
+
+    m_links.ClearChanges();
+
+    // Get the minimal spanning tree
+    m_rnEdges.reset( kruskalMST( boardEdges, m_triangulation, boardNodes ) );
+}
+
 
+void RN_NET::triangulate( std::vector<RN_NODE_PTR>& aNodes )
+{
     TRIANGULATOR triangulator;
-    triangulator.CreateDelaunay( nodes.begin(), nodes.end() );
-    boost::scoped_ptr<RN_LINKS::RN_EDGE_LIST> triangEdges( triangulator.GetEdges() );
+    triangulator.CreateDelaunay( aNodes.begin(), aNodes.end() );
+    boost::scoped_ptr<std::list<RN_EDGE_PTR> > triangEdges( triangulator.GetEdges() );
 
-    // Compute weight/distance for edges resulting from triangulation
-    RN_LINKS::RN_EDGE_LIST::iterator eit, eitEnd;
-    for( eit = (*triangEdges).begin(), eitEnd = (*triangEdges).end(); eit != eitEnd; ++eit )
-        (*eit)->SetWeight( getDistance( (*eit)->GetSourceNode(), (*eit)->GetTargetNode() ) );
+    // Keep copies of the edges, with their weight, as the triangulation is discarded
+    m_triangulation.clear();
+    m_triangulation.reserve( triangEdges->size() );
 
-    // Add the currently existing connections list to the results of triangulation
-    std::copy( boardEdges.begin(), boardEdges.end(), std::front_inserter( *triangEdges ) );
+    BOOST_FOREACH( const RN_EDGE_PTR& edge, *triangEdges )
+    {
+        const RN_NODE_PTR& source = edge->GetSourceNode();
+        const RN_NODE_PTR& target = edge->GetTargetNode();
 
-    // Get the minimal spanning tree
-    m_rnEdges.reset( kruskalMST( *triangEdges, nodes ) );
+        m_triangulation.push_back( boost::make_shared<RN_EDGE_MST>( source, target,
+                                                                    getDistance( source, target ) ) );
+    }
+
+    std::sort( m_triangulation.begin(), m_triangulation.end(), sortWeight );
+
+    m_triangulationValid = true;
+    m_incrementalUpdates = 0;
+}
+
+
+bool RN_NET::updateTriangulation()
+{
+    const std::vector<RN_NODE_PTR>& added = m_links.GetAddedNodes();
+    const std::vector<RN_NODE_PTR>& removed = m_links.GetRemovedNodes();
+    const RN_LINKS::RN_NODE_VECTOR& boardNodes = m_links.GetNodes();
+    unsigned int changes = added.size() + removed.size();
+
+    if( changes == 0 )
+        return true;
+
+    if( changes > INCREMENTAL_MAX_CHANGES || changes * INCREMENTAL_MIN_RATIO > boardNodes.size()
+            || m_incrementalUpdates >= INCREMENTAL_MAX_UPDATES )
+        return false;
+
+    // Nodes are identified by their address, as a removed node may be
+    // replaced by a new one with the same coordinates
+    boost::unordered_set<const RN_NODE*> alive;
+    BOOST_FOREACH( const RN_NODE_PTR& node, boardNodes )
+        alive.insert( node.get() );
+
+    // Nodes sorted by their X coordinate, to look for the nodes close to a point
+    std::vector<const RN_NODE_PTR*> sorted( boardNodes.size() );
+
+    for( unsigned int i = 0; i < boardNodes.size(); ++i )
+        sorted[i] = &boardNodes[i];
+
+    std::sort( sorted.begin(), sorted.end(), sortNodeX );
+
+    // Nodes that have to be triangulated again: the added nodes with their closest
+    // neighbours, and the neighbours of the removed nodes
+    boost::unordered_set<const RN_NODE*> inRegion;
+    boost::unordered_set<const RN_NODE*> addedAlive;
+    std::vector<RN_NODE_PTR> region;
+    std::vector<RN_EDGE_MST_PTR> newEdges;
+    std::vector<std::pair<double, const RN_NODE_PTR*> > closest;
+
+    BOOST_FOREACH( const RN_NODE_PTR& node, added )
+    {
+        // an added node may already be in the region as a neighbour of another one
+        if( !alive.count( node.get() ) || !addedAlive.insert( node.get() ).second )
+            continue;
+
+        if( inRegion.insert( node.get() ).second )
+            region.push_back( node );
+
+        // The closest nodes are likely to be the new Delaunay neighbours
+        findClosestNodes( node, sorted, NEIGHBOUR_COUNT, closest );
+
+        for( unsigned int i = 0; i < closest.size(); ++i )
+        {
+            if( inRegion.insert( closest[i].second->get() ).second )
+                region.push_back( *closest[i].second );
+        }
+
+        // The closest node keeps the new node connected to the rest of the net,
+        // whatever the result of the local triangulation
+        if( !closest.empty() )
+            newEdges.push_back( boost::make_shared<RN_EDGE_MST>( node, *closest[0].second,
+                                    getDistance( node, *closest[0].second ) ) );
+    }
+
+    // Neighbours of the removed nodes, and the direct neighbours of the region nodes,
+    // so the region is surrounded by nodes which are not modified
+    std::vector<RN_NODE_PTR> ring;
+
+    BOOST_FOREACH( const RN_EDGE_MST_PTR& edge, m_triangulation )
+    {
+        const RN_NODE_PTR& source = edge->GetSourceNode();
+        const RN_NODE_PTR& target = edge->GetTargetNode();
+        bool sourceAlive = alive.count( source.get() );
+        bool targetAlive = alive.count( target.get() );
+
+        if( sourceAlive && ( !targetAlive || inRegion.count( target.get() ) ) )
+            ring.push_back( source );
+        else if( targetAlive && ( !sourceAlive || inRegion.count( source.get() ) ) )
+            ring.push_back( target );
+    }
+
+    BOOST_FOREACH( const RN_NODE_PTR& node, ring )
+    {
+        if( inRegion.insert( node.get() ).second )
+            region.push_back( node );
+    }
+
+    // Edges between region nodes are replaced by the triangulation of the region
+    std::vector<RN_EDGE_MST_PTR>::iterator newEnd;
+    newEnd = std::remove_if( m_triangulation.begin(), m_triangulation.end(),
+                             boost::bind( isEdgeReplaced, _1, boost::cref( alive ),
+                                          boost::cref( inRegion ) ) );
+    m_triangulation.erase( newEnd, m_triangulation.end() );
+
+    if( region.size() > 2 )
+    {
+        std::sort( region.begin(), region.end(), sortNodeAddress );
+
+        TRIANGULATOR triangulator;
+        triangulator.CreateDelaunay( region.begin(), region.end() );
+
+        // The edges of a removed node are replaced by edges between its neighbours, which
+        // are all in the region, and the Delaunay edges between region nodes are Delaunay
+        // edges of the region. The new edges of an added node are right only if its
+        // triangles are Delaunay triangles of the whole net, and surround it: otherwise
+        // some of its neighbours may be outside of the region.
+        BOOST_FOREACH( const RN_EDGE_PTR& leading, triangulator.GetLeadingEdges() )
+        {
+            const RN_EDGE_PTR edges[3] = { leading, leading->GetNextEdgeInFace(),
+                                           leading->GetNextEdgeInFace()->GetNextEdgeInFace() };
+            bool hasAdded = false;
+
+            for( int i = 0; i < 3; ++i )
+            {
+                if( !addedAlive.count( edges[i]->GetSourceNode().get() ) )
+                    continue;
+
+                hasAdded = true;
+
+                // An added node on the border of the region, which is not the whole net
+                if( region.size() < boardNodes.size() &&
+                        ( !edges[i]->GetTwinEdge() || !edges[( i + 2 ) % 3]->GetTwinEdge() ) )
+                    return false;
+            }
+
+            if( hasAdded && !isDelaunayTriangle( edges[0]->GetSourceNode(),
+                                                 edges[1]->GetSourceNode(),
+                                                 edges[2]->GetSourceNode(), sorted ) )
+                return false;
+        }
+
+        boost::scoped_ptr<std::list<RN_EDGE_PTR> > triangEdges( triangulator.GetEdges() );
+
+        BOOST_FOREACH( const RN_EDGE_PTR& edge, *triangEdges )
+        {
+            const RN_NODE_PTR& source = edge->GetSourceNode();
+            const RN_NODE_PTR& target = edge->GetTargetNode();
+
+            newEdges.push_back( boost::make_shared<RN_EDGE_MST>( source, target,
+                                                                 getDistance( source, target ) ) );
+        }
+    }
+    else if( region.size() == 2 )
+    {
+        newEdges.push_back( boost::make_shared<RN_EDGE_MST>( region[0], region[1],
+                                        getDistance( region[0], region[1] ) ) );
+    }
+
+    // Keep the edges sorted by weight
+    std::sort( newEdges.begin(), newEdges.end(), sortWeight );
+
+    unsigned int oldSize = m_triangulation.size();
+    m_triangulation.insert( m_triangulation.end(), newEdges.begin(), newEdges.end() );
+    std::inplace_merge( m_triangulation.begin(), m_triangulation.begin() + oldSize,
+                        m_triangulation.end(), sortWeight );
+
+    ++m_incrementalUpdates;
+
+    return true;
 }
 
 
@@ -406,22 +870,18 @@ bool RN_POLY::HitTest( const RN_NODE_PTR& aNode ) const
 {
     VECTOR2I p( aNode->GetX(), aNode->GetY() );
 
+    // Cheap test first, most of the nodes are far from the polygon
+    if( !m_bbox.Contains( p ) )
+        return false;
+
     return m_parentPolyset->Contains( p, m_subpolygonIndex );
 }
 
 
 void RN_NET::Update()
 {
-    // Add edges resulting from nodes being connected by zones
-    processZones();
-    processPads();
-
-    compute();
-
-    BOOST_FOREACH( RN_EDGE_MST_PTR& edge, *m_rnEdges )
-        validateEdge( edge );
-
-    m_dirty = false;
+    FindConnections( 0, BeginUpdate() );
+    EndUpdate();
 }
 
 
@@ -550,15 +1010,15 @@ void RN_NET::RemoveItem( const ZONE_CONTAINER* aZone )
 
 const RN_NODE_PTR RN_NET::GetClosestNode( const RN_NODE_PTR& aNode ) const
 {
-    const RN_LINKS::RN_NODE_SET& nodes = m_links.GetNodes();
-    RN_LINKS::RN_NODE_SET::const_iterator it, itEnd;
+    const RN_LINKS::RN_NODE_VECTOR& nodes = m_links.GetNodes();
+    RN_LINKS::RN_NODE_VECTOR::const_iterator it, itEnd;
 
     unsigned int minDistance = std::numeric_limits<unsigned int>::max();
     RN_NODE_PTR closest;
 
     for( it = nodes.begin(), itEnd = nodes.end(); it != itEnd; ++it )
     {
-        RN_NODE_PTR node = *it;
+        const RN_NODE_PTR& node = *it;
 
         // Obviously the distance between node and itself is the shortest,
         // that's why we have to skip it
@@ -580,15 +1040,15 @@ const RN_NODE_PTR RN_NET::GetClosestNode( const RN_NODE_PTR& aNode ) const
 const RN_NODE_PTR RN_NET::GetClosestNode( const RN_NODE_PTR& aNode,
                                           const RN_NODE_FILTER& aFilter ) const
 {
-    const RN_LINKS::RN_NODE_SET& nodes = m_links.GetNodes();
-    RN_LINKS::RN_NODE_SET::const_iterator it, itEnd;
+    const RN_LINKS::RN_NODE_VECTOR& nodes = m_links.GetNodes();
+    RN_LINKS::RN_NODE_VECTOR::const_iterator it, itEnd;
 
     unsigned int minDistance = std::numeric_limits<unsigned int>::max();
     RN_NODE_PTR closest;
 
     for( it = nodes.begin(), itEnd = nodes.end(); it != itEnd; ++it )
     {
-        RN_NODE_PTR node = *it;
+        const RN_NODE_PTR& node = *it;
 
         // Obviously the distance between node and itself is the shortest,
         // that's why we have to skip it
@@ -611,7 +1071,7 @@ const RN_NODE_PTR RN_NET::GetClosestNode( const RN_NODE_PTR& aNode,
 std::list<RN_NODE_PTR> RN_NET::GetClosestNodes( const RN_NODE_PTR& aNode, int aNumber ) const
 {
     std::list<RN_NODE_PTR> closest;
-    const RN_LINKS::RN_NODE_SET& nodes = m_links.GetNodes();
+    const RN_LINKS::RN_NODE_VECTOR& nodes = m_links.GetNodes();
 
     // Copy nodes
     BOOST_FOREACH( const RN_NODE_PTR& node, nodes )
@@ -635,7 +1095,7 @@ std::list<RN_NODE_PTR> RN_NET::GetClosestNodes( const RN_NODE_PTR& aNode,
                                                 const RN_NODE_FILTER& aFilter, int aNumber ) const
 {
     std::list<RN_NODE_PTR> closest;
-    const RN_LINKS::RN_NODE_SET& nodes = m_links.GetNodes();
+    const RN_LINKS::RN_NODE_VECTOR& nodes = m_links.GetNodes();
 
     // Copy nodes
     BOOST_FOREACH( const RN_NODE_PTR& node, nodes )
@@ -942,53 +1402,112 @@ int RN_DATA::GetUnconnectedCount() const
 }
 
 
-void RN_NET::processZones()
+unsigned int RN_NET::BeginUpdate()
 {
+    // Reset the connections made by zones and pads, they are searched again
+    m_updateZones.clear();
+
     for( ZONE_DATA_MAP::iterator it = m_zones.begin(); it != m_zones.end(); ++it )
     {
-        const ZONE_CONTAINER* zone = it->first;
         RN_ZONE_DATA& zoneData = it->second;
 
-        // Reset existing connections
-        BOOST_FOREACH( RN_EDGE_MST_PTR edge, zoneData.m_Edges )
+        BOOST_FOREACH( const RN_EDGE_MST_PTR& edge, zoneData.m_Edges )
             m_links.RemoveConnection( edge );
 
         zoneData.m_Edges.clear();
-        LSET layers = zone->GetLayerSet();
-
-        // Compute new connections
-        RN_LINKS::RN_NODE_SET candidates = m_links.GetNodes();
-        RN_LINKS::RN_NODE_SET::iterator point, pointEnd;
 
         // Sorting by area should speed up the processing, as smaller polygons are computed
-        // faster and may reduce the number of points for further checks
+        // faster and contain less nodes
         std::sort( zoneData.m_Polygons.begin(), zoneData.m_Polygons.end(), sortArea );
 
-        for( std::deque<RN_POLY>::iterator poly = zoneData.m_Polygons.begin(),
-                polyEnd = zoneData.m_Polygons.end(); poly != polyEnd; ++poly )
-        {
-            const RN_NODE_PTR& node = poly->GetNode();
+        m_updateZones.push_back( &*it );
+    }
+
+    m_updatePads.clear();
+
+    for( PAD_NODE_MAP::iterator it = m_pads.begin(); it != m_pads.end(); ++it )
+    {
+        BOOST_FOREACH( const RN_EDGE_MST_PTR& edge, it->second.m_Edges )
+            m_links.RemoveConnection( edge );
+
+        it->second.m_Edges.clear();
+        m_updatePads.push_back( &*it );
+    }
 
-            point = candidates.begin();
-            pointEnd = candidates.end();
+    // Nodes sorted by their X coordinate, so only the nodes close to a pad are tested.
+    // They point to the nodes stored in m_links, which are not modified until EndUpdate().
+    const RN_LINKS::RN_NODE_VECTOR& nodes = m_links.GetNodes();
 
-            while( point != pointEnd )
+    m_updateNodes.resize( nodes.size() );
+
+    for( unsigned int i = 0; i < nodes.size(); ++i )
+        m_updateNodes[i] = &nodes[i];
+
+    std::sort( m_updateNodes.begin(), m_updateNodes.end(), sortNodeX );
+
+    m_zoneHits.assign( m_updateZones.size() * m_updateNodes.size(), -1 );
+    m_padHits.resize( m_updatePads.size() );
+
+    // Items [0, node count[ are the nodes tested against the zones,
+    // the next ones are the pads looking for the nodes in their area
+    return m_updateNodes.size() + m_updatePads.size();
+}
+
+
+void RN_NET::FindConnections( unsigned int aFirst, unsigned int aLast ) const
+{
+    unsigned int nodeCount = m_updateNodes.size();
+
+    for( unsigned int i = aFirst; i < aLast; ++i )
+    {
+        if( i < nodeCount )
+        {
+            // A node is connected to the first subpolygon of each zone containing it
+            const RN_NODE_PTR& point = *m_updateNodes[i];
+
+            for( unsigned int zone = 0; zone < m_updateZones.size(); ++zone )
             {
-                if( *point != node && ( (*point)->GetLayers() & layers ).any()
-                        && poly->HitTest( *point ) )
-                {
-                    //(*point)->AddParent( zone );  // do not assign parent for helper links
+                const std::deque<RN_POLY>& polygons = m_updateZones[zone]->second.m_Polygons;
 
-                    RN_EDGE_MST_PTR connection = m_links.AddConnection( node, *point );
-                    zoneData.m_Edges.push_back( connection );
+                if( !( point->GetLayers() & m_updateZones[zone]->first->GetLayerSet() ).any() )
+                    continue;
 
-                    // This point already belongs to a polygon, we do not need to check it anymore
-                    point = candidates.erase( point );
-                    pointEnd = candidates.end();
+                for( unsigned int poly = 0; poly < polygons.size(); ++poly )
+                {
+                    if( point != polygons[poly].GetNode() && polygons[poly].HitTest( point ) )
+                    {
+                        m_zoneHits[zone * nodeCount + i] = poly;
+                        break;
+                    }
                 }
-                else
+            }
+        }
+        else
+        {
+            const D_PAD* pad = m_updatePads[i - nodeCount]->first;
+            const RN_NODE_PTR& node = m_updatePads[i - nodeCount]->second.m_Node;
+            std::vector<const RN_NODE_PTR*>& hits = m_padHits[i - nodeCount];
+
+            hits.clear();
+
+            LSET layers = pad->GetLayerSet();
+            wxPoint center = pad->ShapePos();
+            int radius = pad->GetBoundingRadius();
+
+            std::vector<const RN_NODE_PTR*>::const_iterator point, pointEnd;
+            point = std::lower_bound( m_updateNodes.begin(), m_updateNodes.end(),
+                                      center.x - radius, compareNodeX );
+            pointEnd = std::upper_bound( point, m_updateNodes.end(), center.x + radius,
+                                         compareXNode );
+
+            for( ; point != pointEnd; ++point )
+            {
+                const RN_NODE_PTR& candidate = **point;
+
+                if( candidate != node && ( candidate->GetLayers() & layers ).any() &&
+                        pad->HitTest( wxPoint( candidate->GetX(), candidate->GetY() ) ) )
                 {
-                    ++point;
+                    hits.push_back( *point );
                 }
             }
         }
@@ -996,39 +1515,48 @@ void RN_NET::processZones()
 }
 
 
-void RN_NET::processPads()
+void RN_NET::EndUpdate()
 {
-    for( PAD_NODE_MAP::iterator it = m_pads.begin(); it != m_pads.end(); ++it )
+    unsigned int nodeCount = m_updateNodes.size();
+
+    // Add edges resulting from nodes being connected by zones
+    for( unsigned int zone = 0; zone < m_updateZones.size(); ++zone )
     {
-        const D_PAD* pad = it->first;
-        RN_NODE_PTR node = it->second.m_Node;
-        std::deque<RN_EDGE_MST_PTR>& edges = it->second.m_Edges;
+        RN_ZONE_DATA& zoneData = m_updateZones[zone]->second;
 
-        // Reset existing connections
-        BOOST_FOREACH( RN_EDGE_MST_PTR edge, edges )
-            m_links.RemoveConnection( edge );
+        for( unsigned int i = 0; i < nodeCount; ++i )
+        {
+            int poly = m_zoneHits[zone * nodeCount + i];
 
-        LSET layers = pad->GetLayerSet();
-        const RN_LINKS::RN_NODE_SET& candidates = m_links.GetNodes();
-        RN_LINKS::RN_NODE_SET::iterator point, pointEnd;
+            //point->AddParent( zone );  // do not assign parent for helper links
 
-        point = candidates.begin();
-        pointEnd = candidates.end();
+            if( poly >= 0 )
+                zoneData.m_Edges.push_back( m_links.AddConnection(
+                        zoneData.m_Polygons[poly].GetNode(), *m_updateNodes[i] ) );
+        }
+    }
 
-        while( point != pointEnd )
-        {
-            if( *point != node && ( (*point)->GetLayers() & layers ).any() &&
-                    pad->HitTest( wxPoint( (*point)->GetX(), (*point)->GetY() ) ) )
-            {
-                //(*point)->AddParent( pad );   // do not assign parent for helper links
+    // Add additional edges to account for connections made by items located in pads areas
+    for( unsigned int pad = 0; pad < m_updatePads.size(); ++pad )
+    {
+        RN_PAD_DATA& padData = m_updatePads[pad]->second;
 
-                RN_EDGE_MST_PTR connection = m_links.AddConnection( node, *point );
-                edges.push_back( connection );
-            }
+        //candidate->AddParent( pad );   // do not assign parent for helper links
 
-            ++point;
-        }
+        BOOST_FOREACH( const RN_NODE_PTR* candidate, m_padHits[pad] )
+            padData.m_Edges.push_back( m_links.AddConnection( padData.m_Node, *candidate ) );
     }
+
+    m_updateNodes.clear();
+    m_updateZones.clear();
+    m_updatePads.clear();
+
+    compute();
+
+    BOOST_FOREACH( RN_EDGE_MST_PTR& edge, *m_rnEdges )
+        validateEdge( edge );
+
+    m_dirty = false;
 }
 
 
@@ -1236,26 +1764,47 @@ void RN_DATA::Recalculate( int aNet )
     prof_start( &totalRealTime );
 #endif
 
-        unsigned int i;
+        // Nets to be updated, with their node count
+        std::vector<std::pair<unsigned int, int> > dirtyNets;
+        unsigned int nodeCount = 0;
 
-#ifdef USE_OPENMP
-        #pragma omp parallel shared(netCount) private(i)
-        {
-            #pragma omp for schedule(guided, 1)
-#else /* USE_OPENMP */
+        // Start with net number 1, as 0 stands for not connected
+        for( unsigned int i = 1; i < netCount; ++i )
         {
-#endif
-            // Start with net number 1, as 0 stands for not connected
-            for( i = 1; i < netCount; ++i )
+            if( m_nets[i].IsDirty() )
             {
-                if( m_nets[i].IsDirty() )
-                    updateNet( i );
+                dirtyNets.push_back( std::make_pair( m_nets[i].GetNodeCount(), (int) i ) );
+                nodeCount += dirtyNets.back().first;
             }
-        }  /* end of parallel section */
+        }
+
+        // The biggest nets are started first, so a big net is not left alone at the end
+        std::sort( dirtyNets.begin(), dirtyNets.end(),
+                   std::greater<std::pair<unsigned int, int> >() );
+
+        if( nodeCount >= PARALLEL_MIN_NODES )
+        {
+            // The pool is kept for the next updates, its idle threads just sleep
+            if( !m_pool )
+                m_pool.reset( new THREAD_POOL );
+
+            for( unsigned int i = 0; i < dirtyNets.size(); ++i )
+                m_pool->Submit( boost::bind( &RN_DATA::updateNetJob, this, dirtyNets[i].second ) );
+
+            m_pool->Wait();
+        }
+        else
+        {
+            for( unsigned int i = 0; i < dirtyNets.size(); ++i )
+                updateNet( dirtyNets[i].second );
+        }
+
 #ifdef PROFILE
     prof_end( &totalRealTime );
 
-    wxLogDebug( wxT( "Recalculate all nets: %.1f ms" ), totalRealTime.msecs() );
+    wxLogDebug( wxT( "Recalculate all nets: %.1f ms (%d nets, %u nodes, biggest net: %u nodes)" ),
+                totalRealTime.msecs(), (int) dirtyNets.size(), nodeCount,
+                dirtyNets.empty() ? 0 : dirtyNets[0].first );
 #endif /* PROFILE */
     }
     else if( aNet > 0 )         // Recompute only specific net
@@ -1265,6 +1814,17 @@ void RN_DATA::Recalculate( int aNet )
 }
 
 
+RN_DATA::RN_DATA( const BOARD* aBoard ) :
+    m_board( aBoard )
+{
+}
+
+
+RN_DATA::~RN_DATA()
+{
+}
+
+
 void RN_DATA::updateNet( int aNetCode )
 {
     assert( aNetCode < (int) m_nets.size() );
@@ -1275,3 +1835,41 @@ void RN_DATA::updateNet( int aNetCode )
     m_nets[aNetCode].ClearSimple();
     m_nets[aNetCode].Update();
 }
+
+
+void RN_DATA::updateNetJob( int aNetCode )
+{
+    RN_NET& net = m_nets[aNetCode];
+
+    net.ClearSimple();
+
+    unsigned int count = net.BeginUpdate();
+
+    if( count < 2 * SPLIT_JOB_ITEMS )
+    {
+        net.FindConnections( 0, count );
+        net.EndUpdate();
+        return;
+    }
+
+    // The jobs are queued on this worker, so the idle workers steal them
+    unsigned int jobCount = ( count + SPLIT_JOB_ITEMS - 1 ) / SPLIT_JOB_ITEMS;
+    boost::shared_ptr<boost::atomic<int> > pending( new boost::atomic<int>( jobCount ) );
+
+    for( unsigned int first = 0; first < count; first += SPLIT_JOB_ITEMS )
+    {
+        m_pool->Submit( boost::bind( &RN_DATA::findConnectionsJob, this, aNetCode, first,
+                                     std::min( first + SPLIT_JOB_ITEMS, count ), pending ) );
+    }
+}
+
+
+void RN_DATA::findConnectionsJob( int aNetCode, unsigned int aFirst, unsigned int aLast,
+                                  boost::shared_ptr<boost::atomic<int> > aPending )
+{
+    m_nets[aNetCode].FindConnections( aFirst, aLast );
+
+    // The decrement orders the results of the other jobs before the update completion
+    if( --( *aPending ) == 0 )
+        m_nets[aNetCode].EndUpdate();
+}
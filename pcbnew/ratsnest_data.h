@@ -34,10 +34,17 @@
 #include <ttl/halfedge/hetraits.h>
 
 #include <math/box2.h>
+#include <stdint.h>
+#include <limits>
+#include <new>
 
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 
 class BOARD;
 class BOARD_ITEM;
@@ -48,6 +55,7 @@ class VIA;
 class TRACK;
 class ZONE_CONTAINER;
 class SHAPE_POLY_SET;
+class THREAD_POOL;
 
 ///> Types of items that are handled by the class
 enum RN_ITEM_TYPE
@@ -149,43 +157,166 @@ struct RN_NODE_OR_FILTER : public RN_NODE_FILTER
 };
 
 
-///> Functor comparing if two nodes are equal by their coordinates. It is required to make set of
-///> shared pointers work properly.
-struct RN_NODE_COMPARE : std::binary_function<RN_NODE_PTR, RN_NODE_PTR, bool>
+/**
+ * Class RN_POOL
+ * Allocates the nodes and connections of a net from contiguous chunks of fixed size blocks.
+ * Freed blocks are kept in a free list and reused by the next allocation of the same size.
+ * Each net has its own pool, so the threads updating different nets never wait for each other.
+ */
+class RN_POOL
 {
-    bool operator()( const RN_NODE_PTR& aNode1, const RN_NODE_PTR& aNode2 ) const
+public:
+    RN_POOL() {}
+    ~RN_POOL();
+
+    /**
+     * Function Allocate()
+     * Returns a block of at least aSize bytes.
+     */
+    void* Allocate( size_t aSize );
+
+    /**
+     * Function Deallocate()
+     * Returns a block obtained from Allocate() with the same size to its free list.
+     */
+    void Deallocate( void* aBlock, size_t aSize );
+
+private:
+    ///> Number of blocks in a chunk.
+    static const unsigned int CHUNK_BLOCKS = 256;
+
+    ///> Alignment of the blocks.
+    static const size_t BLOCK_ALIGN = 16;
+
+    ///> Blocks of a single size.
+    struct BLOCKS
     {
-        return aNode1 == aNode2;
-    }
+        size_t  m_size;
+        void*   m_freeList;         ///< Linked through the first word of the free blocks
+    };
+
+    ///> Returns the blocks of a given size (there are only a few sizes in use).
+    BLOCKS& getBlocks( size_t aSize );
+
+    std::vector<BLOCKS> m_blocks;
+    std::vector<char*> m_chunks;
+
+    ///> The last references to the nodes may be released by the users of the net.
+    boost::mutex m_lock;
+
+    // Shared by the copies of a net, not copied
+    RN_POOL( const RN_POOL& );
+    RN_POOL& operator=( const RN_POOL& );
 };
 
-///> Functor calculating hash for a given node. It is required to make set of shared pointers
-///> work properly.
-struct RN_NODE_HASH : std::unary_function<RN_NODE_PTR, std::size_t>
+
+/**
+ * Class RN_POOL_ALLOCATOR
+ * Standard allocator taking the memory from a RN_POOL, to be used with boost::allocate_shared().
+ * It keeps a reference to the pool, so the pool lives as long as any object allocated from it.
+ */
+template <class T>
+class RN_POOL_ALLOCATOR
 {
-    std::size_t operator()( const RN_NODE_PTR& aNode ) const
+public:
+    typedef T           value_type;
+    typedef T*          pointer;
+    typedef const T*    const_pointer;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef size_t      size_type;
+    typedef ptrdiff_t   difference_type;
+
+    template <class U>
+    struct rebind
     {
-        std::size_t hash = 2166136261u;
+        typedef RN_POOL_ALLOCATOR<U> other;
+    };
 
-        hash ^= aNode->GetX();
-        hash *= 16777619;
-        hash ^= aNode->GetY();
+    RN_POOL_ALLOCATOR( const boost::shared_ptr<RN_POOL>& aPool ) :
+        m_pool( aPool )
+    {}
+
+    template <class U>
+    RN_POOL_ALLOCATOR( const RN_POOL_ALLOCATOR<U>& aOther ) :
+        m_pool( aOther.m_pool )
+    {}
 
-        return hash;
+    pointer allocate( size_type aCount, const void* aHint = 0 )
+    {
+        return static_cast<pointer>( m_pool->Allocate( aCount * sizeof( T ) ) );
+    }
+
+    void deallocate( pointer aBlock, size_type aCount )
+    {
+        m_pool->Deallocate( aBlock, aCount * sizeof( T ) );
     }
+
+    void construct( pointer aBlock, const T& aValue )
+    {
+        new( aBlock ) T( aValue );
+    }
+
+    void destroy( pointer aBlock )
+    {
+        aBlock->~T();
+    }
+
+    pointer address( reference aValue ) const
+    {
+        return &aValue;
+    }
+
+    const_pointer address( const_reference aValue ) const
+    {
+        return &aValue;
+    }
+
+    size_type max_size() const
+    {
+        return std::numeric_limits<size_type>::max() / sizeof( T );
+    }
+
+    template <class U>
+    bool operator==( const RN_POOL_ALLOCATOR<U>& aOther ) const
+    {
+        return m_pool == aOther.m_pool;
+    }
+
+    template <class U>
+    bool operator!=( const RN_POOL_ALLOCATOR<U>& aOther ) const
+    {
+        return m_pool != aOther.m_pool;
+    }
+
+    boost::shared_ptr<RN_POOL> m_pool;
 };
 
 
 /**
  * Class RN_LINKS
  * Manages data describing nodes and connections for a given net.
+ * <p>
+ * Nodes and connections are stored in contiguous arrays. Nodes are located by their
+ * coordinates, connections keep their own 32-bit index in the array, so adding or removing
+ * an item does not need to scan the lists.
+ * </p><p>
+ * The arrays hold shared pointers rather than the objects: the triangulation (ttl) and
+ * the users of RN_NET keep references to the nodes and edges, which must stay valid when
+ * an item is removed. The objects themselves (with their reference counters) are allocated
+ * from a RN_POOL owned by the net.
+ * </p>
  */
 class RN_LINKS
 {
 public:
     // Helper typedefs
-    typedef boost::unordered_set<RN_NODE_PTR, RN_NODE_HASH, RN_NODE_COMPARE> RN_NODE_SET;
-    typedef std::list<RN_EDGE_PTR> RN_EDGE_LIST;
+    typedef std::vector<RN_NODE_PTR> RN_NODE_VECTOR;
+    typedef std::vector<RN_EDGE_MST_PTR> RN_EDGE_VECTOR;
+
+    RN_LINKS() :
+        m_pool( new RN_POOL )
+    {}
 
     /**
      * Function AddNode()
@@ -207,14 +338,43 @@ public:
 
     /**
      * Function GetNodes()
-     * Returns the set of currently used nodes.
-     * @return The set of currently used nodes.
+     * Returns the currently used nodes, in no particular order.
+     * @return The currently used nodes.
      */
-    const RN_NODE_SET& GetNodes() const
+    const RN_NODE_VECTOR& GetNodes() const
     {
         return m_nodes;
     }
 
+    /**
+     * Function GetAddedNodes()
+     * Returns the nodes added since the last call to ClearChanges(). Some of them may have
+     * been removed since then.
+     */
+    const std::vector<RN_NODE_PTR>& GetAddedNodes() const
+    {
+        return m_addedNodes;
+    }
+
+    /**
+     * Function GetRemovedNodes()
+     * Returns the nodes removed since the last call to ClearChanges().
+     */
+    const std::vector<RN_NODE_PTR>& GetRemovedNodes() const
+    {
+        return m_removedNodes;
+    }
+
+    /**
+     * Function ClearChanges()
+     * Clears the lists of added and removed nodes.
+     */
+    void ClearChanges()
+    {
+        m_addedNodes.clear();
+        m_removedNodes.clear();
+    }
+
     /**
      * Function AddConnection()
      * Adds a connection between two nodes and of given distance. Edges with distance equal 0 are
@@ -233,27 +393,40 @@ public:
      * Removes a connection described by a given edge pointer.
      * @param aEdge is a pointer to edge to be removed.
      */
-    void RemoveConnection( const RN_EDGE_PTR& aEdge )
-    {
-        m_edges.remove( aEdge );
-    }
+    void RemoveConnection( const RN_EDGE_MST_PTR& aEdge );
 
     /**
      * Function GetConnections()
-     * Returns the list of edges that currently connect nodes.
-     * @return the list of edges that currently connect nodes.
+     * Returns the edges that currently connect nodes, in no particular order.
+     * @return the edges that currently connect nodes.
      */
-    const RN_EDGE_LIST& GetConnections() const
+    const RN_EDGE_VECTOR& GetConnections() const
     {
         return m_edges;
     }
 
 protected:
-    ///> Set of nodes that are expected to be connected together (vias, tracks, pads).
-    RN_NODE_SET m_nodes;
+    ///> Returns the key used to locate a node with given coordinates.
+    static uint64_t nodeKey( int aX, int aY )
+    {
+        return ( (uint64_t) (uint32_t) aX << 32 ) | (uint32_t) aY;
+    }
+
+    ///> Nodes that are expected to be connected together (vias, tracks, pads).
+    RN_NODE_VECTOR m_nodes;
+
+    ///> Index in m_nodes of the nodes, by their coordinates.
+    boost::unordered_map<uint64_t, uint32_t> m_nodeIndex;
+
+    ///> Nodes added and removed since the last ClearChanges() call.
+    std::vector<RN_NODE_PTR> m_addedNodes;
+    std::vector<RN_NODE_PTR> m_removedNodes;
 
-    ///> List of edges that currently connect nodes.
-    RN_EDGE_LIST m_edges;
+    ///> Edges that currently connect nodes, each one knows its index (EDGE_MST::GetIndex()).
+    RN_EDGE_VECTOR m_edges;
+
+    ///> Memory of the nodes and edges.
+    boost::shared_ptr<RN_POOL> m_pool;
 };
 
 
@@ -319,7 +492,8 @@ class RN_NET
 {
 public:
     ///> Default constructor.
-    RN_NET() : m_dirty( true ), m_visible( true )
+    RN_NET() : m_dirty( true ), m_triangulationValid( false ), m_incrementalUpdates( 0 ),
+        m_visible( true )
     {}
 
     /**
@@ -363,6 +537,16 @@ public:
         return m_dirty;
     }
 
+    /**
+     * Function GetNodeCount()
+     * Returns the number of nodes of the net, which gives an estimate of the time needed
+     * to update its ratsnest.
+     */
+    unsigned int GetNodeCount() const
+    {
+        return m_links.GetNodes().size();
+    }
+
     /**
      * Function GetUnconnected()
      * Returns pointer to a vector of edges that makes ratsnest for a given net.
@@ -379,6 +563,30 @@ public:
      */
     void Update();
 
+    /**
+     * Function BeginUpdate()
+     * Starts an update split in several steps, so the search for the nodes connected by the
+     * zones and pads of a big net can be shared by several threads: FindConnections() has to
+     * be called for every item of [0, count[, then EndUpdate() completes the update.
+     * @return The number of items to be tested by FindConnections().
+     */
+    unsigned int BeginUpdate();
+
+    /**
+     * Function FindConnections()
+     * Finds the zones and pads connecting the items of a given range. It can be called
+     * concurrently for disjoint ranges, between BeginUpdate() and EndUpdate().
+     * @param aFirst is the first item to test.
+     * @param aLast is the item following the last one to test.
+     */
+    void FindConnections( unsigned int aFirst, unsigned int aLast ) const;
+
+    /**
+     * Function EndUpdate()
+     * Adds the connections found by FindConnections() and recomputes ratsnest for the net.
+     */
+    void EndUpdate();
+
     /**
      * Function AddItem()
      * Adds an appropriate node associated with selected pad, so it is
@@ -561,15 +769,34 @@ protected:
     ///> Removes all ratsnest edges for a given node.
     void clearNode( const RN_NODE_PTR& aNode );
 
-    ///> Adds appropriate edges for nodes that are connected by zones.
-    void processZones();
-
-    ///> Adds additional edges to account for connections made by items located in pads areas.
-    void processPads();
-
     ///> Recomputes ratsnset from scratch.
     void compute();
 
+    ///> Triangulates all the nodes of the net, and stores the edges in m_triangulation.
+    void triangulate( std::vector<RN_NODE_PTR>& aNodes );
+
+    ///> Updates m_triangulation after nodes were added or removed, re-triangulating only
+    ///> the nodes around the modified ones. m_triangulation keeps all the Delaunay edges
+    ///> of the nodes (and possibly a few edges which are not Delaunay any more), so the
+    ///> spanning tree is still minimal. Returns false, leaving m_triangulation invalid, if
+    ///> there are too many changes or if the triangles of an added node can't be checked
+    ///> (the node is on the border of the re-triangulated region, or a node of the net lies
+    ///> in their circumcircles): a full triangulation is needed then.
+    bool updateTriangulation();
+
+    ///> Maximum number of node changes handled by updateTriangulation()
+    static const unsigned int INCREMENTAL_MAX_CHANGES = 64;
+
+    ///> Maximum ratio of the node count to changed nodes handled by updateTriangulation()
+    static const unsigned int INCREMENTAL_MIN_RATIO = 8;
+
+    ///> Number of closest nodes triangulated again with an added node
+    static const unsigned int NEIGHBOUR_COUNT = 8;
+
+    ///> Number of updateTriangulation() calls before a full triangulation is required,
+    ///> to get rid of the edges which are not Delaunay any more
+    static const int INCREMENTAL_MAX_UPDATES = 64;
+
     ////> Stores information about connections for a given net.
     RN_LINKS m_links;
 
@@ -585,6 +812,16 @@ protected:
     ///> Flag indicating necessity of recalculation of ratsnest for a net.
     bool m_dirty;
 
+    ///> Edges of the Delaunay triangulation of the nodes, sorted by weight.
+    std::vector<RN_EDGE_MST_PTR> m_triangulation;
+
+    ///> Flag indicating that m_triangulation matches the nodes, apart from the changes
+    ///> stored in m_links.
+    bool m_triangulationValid;
+
+    ///> Number of updateTriangulation() calls since the last full triangulation.
+    int m_incrementalUpdates;
+
     ///> Structure to hold ratsnest data for ZONE_CONTAINER objects.
     typedef struct
     {
@@ -623,6 +860,18 @@ protected:
     ///> Map that associates groups of subpolygons in the ratsnest model to respective zones.
     ZONE_DATA_MAP m_zones;
 
+    ///> Nodes sorted by their X coordinate, zones and pads tested by the update in progress.
+    std::vector<const RN_NODE_PTR*> m_updateNodes;
+    std::vector<ZONE_DATA_MAP::value_type*> m_updateZones;
+    std::vector<PAD_NODE_MAP::value_type*> m_updatePads;
+
+    ///> Index of the first zone subpolygon containing a node, or -1, for each zone and node
+    ///> (zone index * node count + node index).
+    mutable std::vector<int> m_zoneHits;
+
+    ///> Nodes located in the area of each pad.
+    mutable std::vector<std::vector<const RN_NODE_PTR*> > m_padHits;
+
     ///> Visibility flag.
     bool m_visible;
 };
@@ -640,7 +889,9 @@ public:
      * Default constructor
      * @param aBoard is the board to be processed in order to look for unconnected items.
      */
-    RN_DATA( const BOARD* aBoard ) : m_board( aBoard ) {}
+    RN_DATA( const BOARD* aBoard );
+
+    ~RN_DATA();
 
     /**
      * Function Add()
@@ -764,6 +1015,12 @@ public:
     int GetUnconnectedCount() const;
 
 protected:
+    ///> Minimal number of nodes to update, for the nets to be updated by several threads.
+    static const unsigned int PARALLEL_MIN_NODES = 1000;
+
+    ///> Number of items tested by a job, when a big net is split in several jobs.
+    static const unsigned int SPLIT_JOB_ITEMS = 512;
+
     /**
      * Function updateNet()
      * Recomputes ratsnest for a single net.
@@ -771,11 +1028,28 @@ protected:
      */
     void updateNet( int aNetCode );
 
+    /**
+     * Function updateNetJob()
+     * Recomputes ratsnest for a single net, as a job of m_pool. The search for the connections
+     * made by the zones and pads of a big net is split in several jobs, queued on the current
+     * worker and stolen by the idle ones; the last of these jobs completes the update.
+     * @param aNetCode is the net number to be recomputed.
+     */
+    void updateNetJob( int aNetCode );
+
+    ///> Job searching the connections of a range of items of a net. The last job of the net
+    ///> to finish (aPending reaching 0) completes the update.
+    void findConnectionsJob( int aNetCode, unsigned int aFirst, unsigned int aLast,
+                             boost::shared_ptr<boost::atomic<int> > aPending );
+
     ///> Board to be processed.
     const BOARD* m_board;
 
     ///> Stores information about ratsnest grouped by net numbers.
     std::vector<RN_NET> m_nets;
+
+    ///> Worker threads updating the nets, started on the first parallel update.
+    boost::scoped_ptr<THREAD_POOL> m_pool;
 };
 
 #endif /* RATSNEST_DATA_H */
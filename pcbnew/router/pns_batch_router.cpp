@@ -0,0 +1,194 @@
+/*
+ * KiRouter - a push-and-(sometimes-)shove PCB router
+ *
+ * Copyright (C) 2015 KiCad Developers
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include <profile.h>
+#include <class_board.h>
+#include <ratsnest_data.h>
+
+#include "pns_batch_router.h"
+#include "pns_router.h"
+#include "pns_placement_algo.h"
+#include "pns_itemset.h"
+#include "pns_item.h"
+
+PNS_BATCH_ROUTER::PNS_BATCH_ROUTER( PNS_ROUTER* aRouter ) :
+    m_router( aRouter )
+{
+}
+
+
+void PNS_BATCH_ROUTER::collectConnections( RN_DATA* aRatsnest,
+                                           std::vector<CONNECTION>& aConnections ) const
+{
+    // The unconnected edges of a net form a spanning tree of its connected clusters, so
+    // routing one of them never makes another one useless: they are collected once, instead
+    // of after each commit.
+    for( int i = 1; i < aRatsnest->GetNetCount(); ++i )
+    {
+        const std::vector<RN_EDGE_MST_PTR>* edges = aRatsnest->GetNet( i ).GetUnconnected();
+
+        if( edges == NULL )
+            continue;
+
+        BOOST_FOREACH( const RN_EDGE_MST_PTR& edge, *edges )
+        {
+            const RN_NODE_PTR& source = edge->GetSourceNode();
+            const RN_NODE_PTR& target = edge->GetTargetNode();
+            CONNECTION c;
+
+            c.m_source = VECTOR2I( source->GetX(), source->GetY() );
+            c.m_target = VECTOR2I( target->GetX(), target->GetY() );
+            c.m_net = i;
+            c.m_length = ( c.m_target - c.m_source ).SquaredEuclideanNorm();
+
+            aConnections.push_back( c );
+        }
+    }
+
+    std::stable_sort( aConnections.begin(), aConnections.end() );
+}
+
+
+PNS_ITEM* PNS_BATCH_ROUTER::findItem( const VECTOR2I& aP, int aNet ) const
+{
+    // Pads and vias first, tracks are only used if there is nothing else at the point
+    static const PNS_ITEM::PnsKind kinds[] = { PNS_ITEM::SOLID, PNS_ITEM::VIA, PNS_ITEM::SEGMENT };
+
+    PNS_ITEMSET items = m_router->QueryHoverItems( aP );
+
+    for( int k = 0; k < 3; k++ )
+    {
+        BOOST_FOREACH( PNS_ITEM* item, items.Items() )
+        {
+            if( item->Kind() == kinds[k] && item->Net() == aNet )
+                return item;
+        }
+    }
+
+    return NULL;
+}
+
+
+bool PNS_BATCH_ROUTER::tryFix( const VECTOR2I& aTarget, PNS_ITEM* aEndItem )
+{
+    m_router->Move( aTarget, aEndItem );
+
+    // The walkaround and shove modes stop the head before the obstacles they could not
+    // get around or push away, so the connection is complete only if the head reached
+    // its target.
+    if( m_router->Placer()->CurrentEnd() != aTarget )
+        return false;
+
+    return m_router->FixRoute( aTarget, aEndItem );
+}
+
+
+bool PNS_BATCH_ROUTER::route( const CONNECTION& aConnection )
+{
+    PNS_ITEM* startItem = findItem( aConnection.m_source, aConnection.m_net );
+    PNS_ITEM* endItem = findItem( aConnection.m_target, aConnection.m_net );
+
+    if( !startItem || !endItem )
+    {
+        m_stats.m_unmatched++;
+        return false;
+    }
+
+    // Route on the first layer shared by both ends. The batch router does not place vias,
+    // so a track on any other layer would end dangling over the target (e.g. SMD pads
+    // on opposite sides of the board): leave such connections to the user.
+    const PNS_LAYERSET& ls = startItem->Layers();
+    const PNS_LAYERSET& le = endItem->Layers();
+
+    if( !ls.Overlaps( le ) )
+    {
+        m_stats.m_layerMismatch++;
+        return false;
+    }
+
+    int layer = std::max( ls.Start(), le.Start() );
+
+    if( m_sizesHook )
+    {
+        PNS_SIZES_SETTINGS sizes( m_router->Sizes() );
+
+        m_sizesHook( sizes, startItem );
+        m_router->UpdateSizes( sizes );
+    }
+
+    if( !m_router->StartRouting( aConnection.m_source, startItem, layer ) )
+        return false;
+
+    // The second attempt starts with the other direction (diagonal or straight first)
+    if( !tryFix( aConnection.m_target, endItem ) )
+    {
+        m_router->FlipPosture();
+
+        if( !tryFix( aConnection.m_target, endItem ) )
+        {
+            m_router->StopRouting();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+const PNS_BATCH_ROUTER::STATS& PNS_BATCH_ROUTER::RouteAll()
+{
+    m_stats = STATS();
+
+    std::vector<CONNECTION> connections;
+    collectConnections( m_router->GetBoard()->GetRatsnest(), connections );
+
+    // Only the line placer can route a connection, and committing the violations
+    // of the highlight collisions mode would make a mess of the board
+    PNS_ROUTER_MODE prevMode = m_router->Mode();
+    PNS_MODE prevRoutingMode = m_router->Settings().Mode();
+
+    m_router->SetMode( PNS_MODE_ROUTE_SINGLE );
+
+    if( prevRoutingMode == RM_MarkObstacles )
+        m_router->Settings().SetMode( RM_Walkaround );
+
+    BOOST_FOREACH( const CONNECTION& c, connections )
+    {
+        prof_counter counter;
+
+        prof_start( &counter );
+        bool routed = route( c );
+        prof_end( &counter );
+
+        m_stats.m_connections++;
+        m_stats.m_msecs += counter.msecs();
+
+        if( routed )
+            m_stats.m_routed++;
+    }
+
+    m_router->Settings().SetMode( prevRoutingMode );
+    m_router->SetMode( prevMode );
+
+    return m_stats;
+}
@@ -0,0 +1,142 @@
+/*
+ * KiRouter - a push-and-(sometimes-)shove PCB router
+ *
+ * Copyright (C) 2015 KiCad Developers
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PNS_BATCH_ROUTER_H
+#define __PNS_BATCH_ROUTER_H
+
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <math/vector2d.h>
+
+class PNS_ROUTER;
+class PNS_ITEM;
+class PNS_SIZES_SETTINGS;
+class RN_DATA;
+
+/**
+ * Class PNS_BATCH_ROUTER
+ *
+ * Routes the unconnected ratsnest lines of the board one after another, with the line
+ * placer of the interactive router: each connection is started at its source pad (or via,
+ * or track), moved to its target and fixed, exactly as if the user had clicked on both ends.
+ * The walkaround or shove mode of the router settings is used; the highlight collisions
+ * mode is replaced by walkaround, as it would commit DRC violations.
+ *
+ * The connections are routed shortest first, so the short fanout connections (e.g. BGA
+ * escapes) get the free space near the pads before the long ones. The routed tracks are
+ * committed to the board and stored in the undo buffer of the router.
+ */
+class PNS_BATCH_ROUTER
+{
+public:
+    ///> Callback preparing the track and via sizes for the connection starting at aStartItem
+    typedef boost::function<void( PNS_SIZES_SETTINGS& aSizes, const PNS_ITEM* aStartItem )> SIZES_HOOK;
+
+    ///> Results of a batch
+    struct STATS
+    {
+        STATS() :
+            m_connections( 0 ),
+            m_routed( 0 ),
+            m_unmatched( 0 ),
+            m_layerMismatch( 0 ),
+            m_msecs( 0.0 )
+        {}
+
+        ///> Ratio of the connections routed up to their target
+        double SuccessRate() const
+        {
+            return m_connections ? (double) m_routed / m_connections : 1.0;
+        }
+
+        ///> Mean routing time of a connection, in milliseconds
+        double MsecsPerConnection() const
+        {
+            return m_connections ? m_msecs / m_connections : 0.0;
+        }
+
+        ///> number of connections attempted and successfully routed
+        int m_connections;
+        int m_routed;
+
+        ///> number of connections with an end not found in the router world (e.g. a zone)
+        int m_unmatched;
+
+        ///> number of connections whose ends share no copper layer (a via would be needed)
+        int m_layerMismatch;
+
+        double m_msecs;
+    };
+
+    PNS_BATCH_ROUTER( PNS_ROUTER* aRouter );
+
+    void SetSizesHook( const SIZES_HOOK& aHook )
+    {
+        m_sizesHook = aHook;
+    }
+
+    /**
+     * Function RouteAll()
+     *
+     * Routes the unconnected ratsnest lines of all the nets. The router must be idle, with its
+     * world synchronized with the board.
+     * @return the results of the batch, also available through Stats()
+     */
+    const STATS& RouteAll();
+
+    const STATS& Stats() const
+    {
+        return m_stats;
+    }
+
+private:
+    ///> A ratsnest line to route
+    struct CONNECTION
+    {
+        VECTOR2I m_source;
+        VECTOR2I m_target;
+        int m_net;
+        VECTOR2I::extended_type m_length;
+
+        bool operator<( const CONNECTION& aOther ) const
+        {
+            return m_length < aOther.m_length;
+        }
+    };
+
+    ///> Collects the unconnected ratsnest lines of all the nets, shortest first
+    void collectConnections( RN_DATA* aRatsnest, std::vector<CONNECTION>& aConnections ) const;
+
+    ///> Returns the item of net aNet to start or end a track at aP, or NULL
+    PNS_ITEM* findItem( const VECTOR2I& aP, int aNet ) const;
+
+    ///> Routes a single connection, returns true if it was committed up to its target
+    bool route( const CONNECTION& aConnection );
+
+    ///> Moves the head to the target and fixes it if it was reached
+    bool tryFix( const VECTOR2I& aTarget, PNS_ITEM* aEndItem );
+
+    PNS_ROUTER* m_router;
+    SIZES_HOOK m_sizesHook;
+    STATS m_stats;
+};
+
+#endif
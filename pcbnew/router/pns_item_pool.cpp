@@ -0,0 +1,140 @@
+/*
+ * KiRouter - a push-and-(sometimes-)shove PCB router
+ *
+ * Copyright (C) 2015 KiCad Developers
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+
+#include "pns_item_pool.h"
+#include "pns_segment.h"
+#include "pns_line.h"
+#include "pns_via.h"
+
+// Number of items of the first block allocated by each pool (blocks grow then twice
+// bigger each time the pool is full)
+static const size_t PoolFirstBlock = 256;
+
+
+void PNS_ITEM_POOL::STATS::Add( const STATS& aOther )
+{
+    m_allocs += aOther.m_allocs;
+    m_frees += aOther.m_frees;
+    m_live += aOther.m_live;
+    m_peak += aOther.m_peak;
+    m_reserved += aOther.m_reserved;
+}
+
+
+PNS_ITEM_POOL::PNS_ITEM_POOL( size_t aItemSize ) :
+    m_itemSize( aItemSize ),
+    m_pool( aItemSize, PoolFirstBlock )
+{
+}
+
+
+void* PNS_ITEM_POOL::Alloc( size_t aSize )
+{
+    if( aSize != m_itemSize )
+        return ::operator new( aSize );
+
+    boost::mutex::scoped_lock lock( m_lock );
+
+    if( m_stats.m_live == m_stats.m_reserved )
+        m_stats.m_reserved += m_pool.get_next_size();
+
+    void* p = m_pool.malloc();
+
+    if( !p )
+        throw std::bad_alloc();
+
+    m_stats.m_allocs++;
+    m_stats.m_live++;
+
+    if( m_stats.m_live > m_stats.m_peak )
+        m_stats.m_peak = m_stats.m_live;
+
+    return p;
+}
+
+
+void PNS_ITEM_POOL::Free( void* aPtr, size_t aSize )
+{
+    if( !aPtr )
+        return;
+
+    if( aSize != m_itemSize )
+    {
+        ::operator delete( aPtr );
+        return;
+    }
+
+    boost::mutex::scoped_lock lock( m_lock );
+
+    m_pool.free( aPtr );
+    m_stats.m_frees++;
+    m_stats.m_live--;
+}
+
+
+PNS_ITEM_POOL::STATS PNS_ITEM_POOL::Stats() const
+{
+    boost::mutex::scoped_lock lock( m_lock );
+
+    return m_stats;
+}
+
+
+void PNS_ITEM_POOL::ResetStats()
+{
+    boost::mutex::scoped_lock lock( m_lock );
+
+    m_stats.m_allocs = 0;
+    m_stats.m_frees = 0;
+    m_stats.m_peak = m_stats.m_live;
+}
+
+
+PNS_ITEM_POOL& PNS_ITEM_POOL::Get( POOL_TYPE aType )
+{
+    // The pools are never destroyed, as items may still be freed by static destructors
+    static PNS_ITEM_POOL* pools[POOL_COUNT] =
+    {
+        new PNS_ITEM_POOL( sizeof( PNS_SEGMENT ) ),
+        new PNS_ITEM_POOL( sizeof( PNS_LINE ) ),
+        new PNS_ITEM_POOL( sizeof( PNS_VIA ) )
+    };
+
+    return *pools[aType];
+}
+
+
+PNS_ITEM_POOL::STATS PNS_ITEM_POOL::TotalStats()
+{
+    STATS total;
+
+    for( int i = 0; i < POOL_COUNT; i++ )
+        total.Add( Get( (POOL_TYPE) i ).Stats() );
+
+    return total;
+}
+
+
+void PNS_ITEM_POOL::ResetTotalStats()
+{
+    for( int i = 0; i < POOL_COUNT; i++ )
+        Get( (POOL_TYPE) i ).ResetStats();
+}
@@ -0,0 +1,121 @@
+/*
+ * KiRouter - a push-and-(sometimes-)shove PCB router
+ *
+ * Copyright (C) 2015 KiCad Developers
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PNS_ITEM_POOL_H
+#define __PNS_ITEM_POOL_H
+
+#include <cstddef>
+
+#include <boost/pool/pool.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+
+/**
+ * Class PNS_ITEM_POOL
+ *
+ * Memory pool for the items of a given type (PNS_SEGMENT, PNS_LINE, PNS_VIA), which are
+ * created and destroyed in large numbers by the shove and walkaround algorithms.
+ * The memory of the destroyed items is kept to be reused by the next ones, instead of
+ * being returned to the heap, so after the first few moves a routing session does not
+ * call malloc()/free() for its items anymore.
+ *
+ * The items declare class operators new and delete using the pool of their type, see
+ * PNS_ITEM_POOL::Get(). The pools may be used by several threads at the same time.
+ */
+class PNS_ITEM_POOL : public boost::noncopyable
+{
+public:
+    ///> Allocation counters
+    struct STATS
+    {
+        STATS() :
+            m_allocs( 0 ),
+            m_frees( 0 ),
+            m_live( 0 ),
+            m_peak( 0 ),
+            m_reserved( 0 )
+        {}
+
+        void Add( const STATS& aOther );
+
+        ///> number of items allocated/freed since the last reset
+        long long m_allocs;
+        long long m_frees;
+
+        ///> number of items currently allocated, and maximum since the last reset
+        long long m_live;
+        long long m_peak;
+
+        ///> number of items the pool can hold without growing
+        long long m_reserved;
+    };
+
+    ///> Types of pooled items
+    enum POOL_TYPE
+    {
+        SEGMENTS = 0,
+        LINES,
+        VIAS,
+        POOL_COUNT
+    };
+
+    PNS_ITEM_POOL( size_t aItemSize );
+
+    /**
+     * Function Alloc()
+     *
+     * Allocates memory for an item of aSize bytes. Items of another size than the one
+     * of the pool (i.e. of a derived class) are allocated from the heap.
+     */
+    void* Alloc( size_t aSize );
+
+    /**
+     * Function Free()
+     *
+     * Gives back the memory of an item allocated by Alloc() to the pool.
+     */
+    void Free( void* aPtr, size_t aSize );
+
+    STATS Stats() const;
+
+    /**
+     * Function ResetStats()
+     *
+     * Clears the allocation counters, and resets the peak count to the current number
+     * of items.
+     */
+    void ResetStats();
+
+    ///> Returns the pool of a type of items
+    static PNS_ITEM_POOL& Get( POOL_TYPE aType );
+
+    ///> Returns the sum of the counters of all the pools
+    static STATS TotalStats();
+
+    ///> Resets the counters of all the pools
+    static void ResetTotalStats();
+
+private:
+    size_t m_itemSize;
+    boost::pool<> m_pool;
+    STATS m_stats;
+    mutable boost::mutex m_lock;
+};
+
+#endif    // __PNS_ITEM_POOL_H
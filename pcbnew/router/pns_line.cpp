@@ -27,6 +27,7 @@
 #include "pns_node.h"
 #include "pns_via.h"
 #include "pns_utils.h"
+#include "pns_item_pool.h"
 
 #include <geometry/shape_rect.h>
 
@@ -81,6 +82,18 @@ PNS_LINE* PNS_LINE::Clone() const
 }
 
 
+void* PNS_LINE::operator new( size_t aSize )
+{
+    return PNS_ITEM_POOL::Get( PNS_ITEM_POOL::LINES ).Alloc( aSize );
+}
+
+
+void PNS_LINE::operator delete( void* aPtr, size_t aSize )
+{
+    PNS_ITEM_POOL::Get( PNS_ITEM_POOL::LINES ).Free( aPtr, aSize );
+}
+
+
 void PNS_LINE::Mark( int aMarker )
 {
     m_marker = aMarker;
@@ -148,6 +161,18 @@ PNS_SEGMENT* PNS_SEGMENT::Clone() const
 }
 
 
+void* PNS_SEGMENT::operator new( size_t aSize )
+{
+    return PNS_ITEM_POOL::Get( PNS_ITEM_POOL::SEGMENTS ).Alloc( aSize );
+}
+
+
+void PNS_SEGMENT::operator delete( void* aPtr, size_t aSize )
+{
+    PNS_ITEM_POOL::Get( PNS_ITEM_POOL::SEGMENTS ).Free( aPtr, aSize );
+}
+
+
 int PNS_LINE::CountCorners( int aAngles )
 {
     int count = 0;
@@ -98,6 +98,10 @@ public:
     /// @copydoc PNS_ITEM::Clone()
     virtual PNS_LINE* Clone() const;
 
+    ///> items are allocated from a PNS_ITEM_POOL
+    static void* operator new( size_t aSize );
+    static void operator delete( void* aPtr, size_t aSize );
+
     const PNS_LINE& operator=( const PNS_LINE& aOther );
 
     ///> Assigns a shape to the line (a polyline/line chain)
@@ -20,6 +20,9 @@
 
 #include <boost/foreach.hpp>
 #include <boost/optional.hpp>
+#include <boost/bind.hpp>
+
+#include <thread_pool.h>
 
 #include "trace.h"
 
@@ -29,10 +32,60 @@
 #include "pns_shove.h"
 #include "pns_utils.h"
 #include "pns_topology.h"
+#include "pns_optimizer.h"
 
 
 using boost::optional;
 
+/**
+ * Struct PNS_LINE_PLACER::WALK_CANDIDATE
+ *
+ * A candidate path of the walkaround mode: the walk around the obstacles in one winding
+ * direction, starting from the initial track in one of its two postures.
+ */
+struct PNS_LINE_PLACER::WALK_CANDIDATE
+{
+    WALK_CANDIDATE() :
+        m_viaOk( false ),
+        m_cw( true ),
+        m_done( false ),
+        m_colliding( true )
+    {}
+
+    ///> initial track and result of buildInitialLine() for it
+    PNS_LINE m_initial;
+    bool m_viaOk;
+
+    ///> winding direction of the walkaround
+    bool m_cw;
+
+    ///> resulting path, true if it reaches the cursor and if it still collides
+    PNS_LINE m_path;
+    bool m_done;
+    bool m_colliding;
+
+    PNS_COST_ESTIMATOR m_cost;
+
+    ///> returns true if this candidate is better than aOther
+    bool IsBetterThan( WALK_CANDIDATE& aOther )
+    {
+        if( m_colliding != aOther.m_colliding )
+            return !m_colliding;
+
+        if( m_done != aOther.m_done )
+            return m_done;
+
+        if( aOther.m_cost.IsBetter( m_cost, 1.0, 1.0 ) )
+            return true;
+
+        if( m_cost.IsBetter( aOther.m_cost, 1.0, 1.0 ) )
+            return false;
+
+        return m_cost.GetLengthCost() < aOther.m_cost.GetLengthCost();
+    }
+};
+
+
 PNS_LINE_PLACER::PNS_LINE_PLACER() :
     PNS_PLACEMENT_ALGO()
 {
@@ -51,6 +104,7 @@ PNS_LINE_PLACER::PNS_LINE_PLACER() :
     m_startItem = NULL;
     m_chainedPlacement = false;
     m_orthoMode = false;
+    m_candidatePool = NULL;
 }
 
 
@@ -58,6 +112,8 @@ PNS_LINE_PLACER::~PNS_LINE_PLACER()
 {
     if( m_shove )
         delete m_shove;
+
+    delete m_candidatePool;
 }
 
 
@@ -353,21 +409,9 @@ bool PNS_LINE_PLACER::mergeHead()
 }
 
 
-bool PNS_LINE_PLACER::rhWalkOnly( const VECTOR2I& aP, PNS_LINE& aNewHead )
+int PNS_LINE_PLACER::walkaroundEffort() const
 {
-    PNS_LINE initTrack( m_head );
-    PNS_LINE walkFull;
     int effort = 0;
-    bool rv = true, viaOk;
-
-    viaOk = buildInitialLine( aP, initTrack );
-
-    PNS_WALKAROUND walkaround( m_currentNode );
-
-    walkaround.SetSolidsOnly( false );
-    walkaround.SetIterationLimit( RoutingSettings().WalkaroundIterationLimit() );
-
-    PNS_WALKAROUND::WALKAROUND_STATUS wf = walkaround.Route( initTrack, walkFull, false );
 
     switch( RoutingSettings().OptimizerEffort() )
     {
@@ -384,6 +428,29 @@ bool PNS_LINE_PLACER::rhWalkOnly( const VECTOR2I& aP, PNS_LINE& aNewHead )
     if( RoutingSettings().SmartPads() )
         effort |= PNS_OPTIMIZER::SMART_PADS;
 
+    return effort;
+}
+
+
+bool PNS_LINE_PLACER::rhWalkOnly( const VECTOR2I& aP, PNS_LINE& aNewHead )
+{
+    if( RoutingSettings().ParallelCandidates() )
+        return rhWalkCandidates( aP, aNewHead );
+
+    PNS_LINE initTrack( m_head );
+    PNS_LINE walkFull;
+    int effort = walkaroundEffort();
+    bool rv = true, viaOk;
+
+    viaOk = buildInitialLine( aP, initTrack );
+
+    PNS_WALKAROUND walkaround( m_currentNode );
+
+    walkaround.SetSolidsOnly( false );
+    walkaround.SetIterationLimit( RoutingSettings().WalkaroundIterationLimit() );
+
+    PNS_WALKAROUND::WALKAROUND_STATUS wf = walkaround.Route( initTrack, walkFull, false );
+
     if( wf == PNS_WALKAROUND::STUCK )
     {
         walkFull = walkFull.ClipToNearestObstacle( m_currentNode );
@@ -409,6 +476,88 @@ bool PNS_LINE_PLACER::rhWalkOnly( const VECTOR2I& aP, PNS_LINE& aNewHead )
 }
 
 
+void PNS_LINE_PLACER::walkCandidate( WALK_CANDIDATE* aCandidate, int aEffort )
+{
+    // Runs in a worker thread: m_currentNode is only read here.
+    PNS_WALKAROUND walkaround( m_currentNode );
+    PNS_LINE& path = aCandidate->m_path;
+
+    walkaround.SetSolidsOnly( false );
+    walkaround.SetIterationLimit( RoutingSettings().WalkaroundIterationLimit() );
+    walkaround.SetForceWinding( true, aCandidate->m_cw );
+
+    PNS_WALKAROUND::WALKAROUND_STATUS wf = walkaround.Route( aCandidate->m_initial, path, false );
+
+    aCandidate->m_done = ( wf != PNS_WALKAROUND::STUCK );
+
+    if( !aCandidate->m_done )
+        path = path.ClipToNearestObstacle( m_currentNode );
+    else if( m_placingVia && aCandidate->m_viaOk )
+        path.AppendVia( makeVia( path.CPoint( -1 ) ) );
+
+    PNS_OPTIMIZER::Optimize( &path, aEffort, m_currentNode );
+
+    aCandidate->m_colliding = static_cast<bool>( m_currentNode->CheckColliding( &path ) );
+    aCandidate->m_cost.Add( path );
+}
+
+
+bool PNS_LINE_PLACER::rhWalkCandidates( const VECTOR2I& aP, PNS_LINE& aNewHead )
+{
+    // Both winding directions, for the current posture and for the inverted one
+    const int maxCandidates = 4;
+    WALK_CANDIDATE candidates[maxCandidates];
+    int count = 0;
+
+    for( int posture = 0; posture < 2; posture++ )
+    {
+        PNS_LINE initTrack( m_head );
+        bool viaOk = buildInitialLine( aP, initTrack, posture == 1 );
+
+        // straight (or empty) tracks have a single posture
+        if( posture == 1 && initTrack.CLine().CompareGeometry( candidates[0].m_initial.CLine() ) )
+            break;
+
+        for( int winding = 0; winding < 2; winding++ )
+        {
+            candidates[count].m_initial = initTrack;
+            candidates[count].m_viaOk = viaOk;
+            candidates[count].m_cw = ( winding == 0 );
+            count++;
+        }
+    }
+
+    if( !m_candidatePool )
+        m_candidatePool = new THREAD_POOL( std::min( maxCandidates, THREAD_POOL::DefaultThreadCount() ) );
+
+    int effort = walkaroundEffort();
+
+    for( int i = 0; i < count; i++ )
+        m_candidatePool->Submit( boost::bind( &PNS_LINE_PLACER::walkCandidate, this, &candidates[i], effort ) );
+
+    m_candidatePool->Wait();
+
+    WALK_CANDIDATE* best = &candidates[0];
+
+    for( int i = 1; i < count; i++ )
+    {
+        if( candidates[i].IsBetterThan( *best ) )
+            best = &candidates[i];
+    }
+
+    if( best->m_colliding )
+    {
+        aNewHead = m_head;
+        return false;
+    }
+
+    m_head = best->m_path;
+    aNewHead = best->m_path;
+
+    return true;
+}
+
+
 bool PNS_LINE_PLACER::rhMarkObstacles( const VECTOR2I& aP, PNS_LINE& aNewHead )
 {
     buildInitialLine( aP, m_head );
@@ -1022,10 +1171,14 @@ void PNS_LINE_PLACER::SetOrthoMode( bool aOrthoMode )
     m_orthoMode = aOrthoMode;
 }
 
-bool PNS_LINE_PLACER::buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead )
+bool PNS_LINE_PLACER::buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead, bool aInvertPosture )
 {
     SHAPE_LINE_CHAIN l;
 
+    // The inverted posture starts with a straight segment instead of a diagonal one
+    // (or the reverse).
+    DIRECTION_45 direction = aInvertPosture ? m_direction.Right() : m_direction;
+
     if( m_p_start == aP )
     {
         l.Clear();
@@ -1038,7 +1191,7 @@ bool PNS_LINE_PLACER::buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead )
         }
         else
         {
-            l = m_direction.BuildInitialTrace( m_p_start, aP );
+            l = direction.BuildInitialTrace( m_p_start, aP, aInvertPosture );
         }
 
         if( l.SegmentCount() > 1 && m_orthoMode )
@@ -1071,7 +1224,7 @@ bool PNS_LINE_PLACER::buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead )
 
     if( v.PushoutForce( m_currentNode, lead, force, solidsOnly, 40 ) )
     {
-        SHAPE_LINE_CHAIN line = m_direction.BuildInitialTrace( m_p_start, aP + force );
+        SHAPE_LINE_CHAIN line = direction.BuildInitialTrace( m_p_start, aP + force, aInvertPosture );
         aHead = PNS_LINE( aHead, line );
 
         v.SetPos( v.Pos() + force );
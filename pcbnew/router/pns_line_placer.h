@@ -31,6 +31,7 @@
 
 class PNS_SHOVE;
 class PNS_OPTIMIZER;
+class THREAD_POOL;
 class PNS_VIA;
 class PNS_NODE;
 
@@ -176,6 +177,8 @@ protected:
     void SizeSettingsChanged();
 
 private:
+    struct WALK_CANDIDATE;
+
     /**
      * Function route()
      *
@@ -323,6 +326,15 @@ private:
     ///> route step, walkaround mode
     bool rhWalkOnly( const VECTOR2I& aP, PNS_LINE& aNewHead);
 
+    ///> route step, walkaround mode, evaluating several candidate paths concurrently
+    bool rhWalkCandidates( const VECTOR2I& aP, PNS_LINE& aNewHead );
+
+    ///> walks around the obstacles in one direction from a candidate initial track
+    void walkCandidate( WALK_CANDIDATE* aCandidate, int aEffort );
+
+    ///> optimizer effort used for the walkaround results
+    int walkaroundEffort() const;
+
     ///> route step, shove mode
     bool rhShoveOnly( const VECTOR2I& aP, PNS_LINE& aNewHead);
 
@@ -331,7 +343,7 @@ private:
 
     const PNS_VIA makeVia ( const VECTOR2I& aP );
 
-    bool buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead );
+    bool buildInitialLine( const VECTOR2I& aP, PNS_LINE& aHead, bool aInvertPosture = false );
 
     ///> current routing direction
     DIRECTION_45 m_direction;
@@ -376,6 +388,9 @@ private:
     bool m_idle;
     bool m_chainedPlacement;
     bool m_orthoMode;
+
+    ///> threads evaluating the candidate paths (created on first use)
+    THREAD_POOL* m_candidatePool;
 };
 
 #endif    // __PNS_LINE_PLACER_H
@@ -18,6 +18,9 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
+#include <fstream>
+
 #include "pns_logger.h"
 #include "pns_item.h"
 #include "pns_via.h"
@@ -136,6 +139,65 @@ void PNS_LOGGER::Log( const VECTOR2I& aStart, const VECTOR2I& aEnd,
 }
 
 
+void PNS_LOGGER::LogEvent( const std::string& aType, const VECTOR2I& aP, const PNS_ITEM* aItem,
+                           const std::vector<int>& aArgs )
+{
+    m_theLog << "event " << aType << " " << aP.x << " " << aP.y << " ";
+
+    if( aItem )
+        m_theLog << aItem->Kind() << " " << aItem->Net() << " " << aItem->Layers().Start() <<
+                    " " << aItem->Layers().End();
+    else
+        m_theLog << "-1 -1 -1 -1";
+
+    for( unsigned i = 0; i < aArgs.size(); i++ )
+        m_theLog << " " << aArgs[i];
+
+    m_theLog << std::endl;
+}
+
+
+void PNS_LOGGER::LogEvent( const std::string& aType, const std::vector<int>& aArgs )
+{
+    m_theLog << "event " << aType;
+
+    for( unsigned i = 0; i < aArgs.size(); i++ )
+        m_theLog << " " << aArgs[i];
+
+    m_theLog << std::endl;
+}
+
+
+bool PNS_LOGGER::LoadEvents( const std::string& aFilename, std::vector<EVENT>& aEvents )
+{
+    std::ifstream f( aFilename.c_str() );
+
+    if( !f )
+        return false;
+
+    std::string line;
+
+    while( std::getline( f, line ) )
+    {
+        std::istringstream tokens( line );
+        std::string keyword;
+        EVENT event;
+
+        if( !( tokens >> keyword >> event.m_type ) || keyword != "event" )
+            continue;
+
+        int arg;
+
+        while( tokens >> arg )
+            event.m_args.push_back( arg );
+
+        aEvents.push_back( event );
+    }
+
+    return true;
+}
+
+
 void PNS_LOGGER::dumpShape( const SHAPE* aSh )
 {
     switch( aSh->Type() )
@@ -197,6 +259,10 @@ void PNS_LOGGER::Save( const std::string& aFilename )
 
     FILE* f = fopen( aFilename.c_str(), "wb" );
     printf( "Saving to '%s' [%p]\n", aFilename.c_str(), f );
+
+    if( !f )
+        return;
+
     const std::string s = m_theLog.str();
     fwrite( s.c_str(), 1, s.length(), f );
     fclose( f );
@@ -23,6 +23,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include <math/vector2d.h>
 
@@ -47,6 +48,35 @@ public:
     void Log( const VECTOR2I& aStart, const VECTOR2I& aEnd, int aKind = 0,
               const std::string aName = std::string() );
 
+    /**
+     * Function LogEvent()
+     *
+     * Records a router operation, so that a routing session can be replayed
+     * (see tools/pns_replay.cpp). The event is written as a line:
+     * "event <type> <x> <y> <item kind> <net> <first layer> <last layer> [<args>...]",
+     * the item fields being -1 if there is no item.
+     */
+    void LogEvent( const std::string& aType, const VECTOR2I& aP, const PNS_ITEM* aItem,
+                   const std::vector<int>& aArgs = std::vector<int>() );
+
+    ///> Records a router operation without position: "event <type> [<args>...]".
+    void LogEvent( const std::string& aType, const std::vector<int>& aArgs = std::vector<int>() );
+
+    ///> A router operation read from a log.
+    struct EVENT
+    {
+        std::string m_type;
+        std::vector<int> m_args;
+    };
+
+    /**
+     * Function LoadEvents()
+     *
+     * Reads the events stored in a log saved with Save(), ignoring the other lines.
+     * @return false if the file cannot be read.
+     */
+    static bool LoadEvents( const std::string& aFilename, std::vector<EVENT>& aEvents );
+
 private:
     void dumpShape( const SHAPE* aSh );
 
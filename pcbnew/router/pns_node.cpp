@@ -44,6 +44,95 @@ using boost::unordered_map;
 static boost::unordered_set<PNS_NODE*> allocNodes;
 #endif
 
+
+/**
+ * Struct PNS_NODE::DELTA
+ *
+ * Changes made by a branch with respect to the root, on top of the older changes (m_base).
+ * The flattened state of a branch is the one of its chain of deltas: the most recent
+ * delta having an item or a joint tag wins. Once shared by several branches
+ * (see PNS_NODE::Branch()), a delta is never modified again.
+ */
+struct PNS_NODE::DELTA
+{
+    DELTA( const DELTA_PTR& aBase = DELTA_PTR() ) :
+        m_base( aBase ),
+        m_chainLength( aBase ? aBase->m_chainLength + 1 : 1 )
+    {}
+
+    bool Empty() const
+    {
+        return m_items.Size() == 0 && m_removed.empty() && m_override.empty() &&
+               m_tags.empty();
+    }
+
+    ///> older changes
+    DELTA_PTR m_base;
+
+    ///> number of deltas of the chain, this one included
+    int m_chainLength;
+
+    ///> items added by this delta
+    PNS_INDEX m_items;
+
+    ///> items added by the older deltas and removed by this one
+    ITEM_SET m_removed;
+
+    ///> root items removed by this delta
+    ITEM_SET m_override;
+
+    ///> local joints of the tags of m_tags (hiding the joints of the older deltas
+    ///> with the same tags)
+    JOINT_MAP m_joints;
+    TAG_SET m_tags;
+};
+
+
+/**
+ * Struct PNS_NODE::DELTA_VISITOR
+ *
+ * Runs a visitor on the items found in a delta, skipping the items removed (or added
+ * again) by the more recent deltas of the chain.
+ */
+template <class Visitor>
+struct PNS_NODE::DELTA_VISITOR
+{
+    DELTA_VISITOR( Visitor& aVisitor, DELTA* aTop ) :
+        m_visitor( aVisitor ),
+        m_top( aTop ),
+        m_current( aTop ),
+        m_stopped( false )
+    {}
+
+    bool operator()( PNS_ITEM* aItem )
+    {
+        for( DELTA* d = m_top; d != m_current; d = d->m_base.get() )
+        {
+            if( d->m_items.Contains( aItem ) || d->m_removed.count( aItem ) )
+                return true;
+        }
+
+        if( !m_visitor( aItem ) )
+        {
+            m_stopped = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    Visitor& m_visitor;
+
+    ///> most recent delta
+    DELTA* m_top;
+
+    ///> delta being searched
+    DELTA* m_current;
+
+    ///> true once the visitor has asked to stop the search
+    bool m_stopped;
+};
+
 PNS_NODE::PNS_NODE()
 {
     TRACE( 0, "PNS_NODE::create %p", this );
@@ -55,6 +144,28 @@ PNS_NODE::PNS_NODE()
     m_pairingResolver = NULL;
     m_index = new PNS_INDEX;
     m_collisionFilter = NULL;
+    m_revision = 0;
+    m_cacheRevision = 0;
+
+#ifdef DEBUG
+    allocNodes.insert( this );
+#endif
+}
+
+
+PNS_NODE::PNS_NODE( PNS_NODE* aParent )
+{
+    TRACE( 0, "PNS_NODE::create %p", this );
+    m_depth = aParent->m_depth + 1;
+    m_root = aParent->m_root;
+    m_parent = aParent;
+    m_maxClearance = 800000;    // fixme: depends on how thick traces are.
+    m_clearanceResolver = aParent->m_clearanceResolver;
+    m_pairingResolver = NULL;
+    m_index = NULL;
+    m_collisionFilter = aParent->m_collisionFilter;
+    m_revision = 0;
+    m_cacheRevision = m_root->m_revision;
 
 #ifdef DEBUG
     allocNodes.insert( this );
@@ -84,10 +195,14 @@ PNS_NODE::~PNS_NODE()
 
     m_joints.clear();
 
-    for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
+    ITEM_VECTOR items;
+
+    localItems( items );
+
+    BOOST_FOREACH( PNS_ITEM* item, items )
     {
-        if( (*i)->BelongsTo( this ) )
-            delete *i;
+        if( item->BelongsTo( this ) )
+            delete item;
     }
 
     releaseGarbage();
@@ -118,6 +233,9 @@ void PNS_NODE::TemporallyOverrideClearance(bool aEnable, int aNetA, int aNetB, i
         return;
 
     m_clearanceResolver->Override(aEnable, aNetA, aNetB, aClearance);
+
+    // the cached query results depend on the clearances
+    m_root->invalidateCaches();
 }
 
 bool PNS_NODE::IsPairedNet(int aNet) const
@@ -147,36 +265,168 @@ int PNS_NODE::PairedNet(int aNet) const
 
 PNS_NODE* PNS_NODE::Branch()
 {
-    PNS_NODE* child = new PNS_NODE;
+    PNS_NODE* child = new PNS_NODE( this );
 
     TRACE( 0, "PNS_NODE::branch %p (parent %p)", child % this );
 
     m_children.insert( child );
 
-    child->m_depth = m_depth + 1;
-    child->m_parent = this;
-    child->m_clearanceResolver = m_clearanceResolver;
-    child->m_root = isRoot() ? this : m_root;
-    child->m_collisionFilter = m_collisionFilter;
+    m_root->m_stats.m_branches++;
 
     // immmediate offspring of the root branch needs not copy anything.
-    // For the rest, deep-copy joints, overridden item map and pointers
-    // to stored items.
+    // For the rest, the changes of this node are frozen and shared with
+    // the child, this node continuing on top of them with a new delta.
+    DELTA_PTR base;
+
     if( !isRoot() )
     {
-        JOINT_MAP::iterator j;
+        if( m_delta->m_chainLength >= MaxDeltaChain )
+            base = flatten();
+        else if( m_delta->Empty() )
+            base = m_delta->m_base;
+        else
+            base = m_delta;
+
+        if( base != m_delta->m_base )
+            m_delta.reset( new DELTA( base ) );
+    }
+
+    child->m_delta.reset( new DELTA( base ) );
+
+    TRACE( 2, "%d deltas", child->m_delta->m_chainLength );
+
+    return child;
+}
+
+
+PNS_NODE::DELTA_PTR PNS_NODE::flatten() const
+{
+    DELTA_PTR flat( new DELTA );
+    ITEM_VECTOR items;
+
+    localItems( items );
+
+    BOOST_FOREACH( PNS_ITEM* item, items )
+        flat->m_items.Add( item );
+
+    overriddenItems( flat->m_override );
+
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+    {
+        BOOST_FOREACH( const PNS_JOINT::HASH_TAG& tag, d->m_tags )
+        {
+            if( !flat->m_tags.insert( tag ).second )
+                continue;
+
+            std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range = d->m_joints.equal_range( tag );
+
+            flat->m_joints.insert( range.first, range.second );
+        }
+    }
+
+    return flat;
+}
+
+
+PNS_INDEX* PNS_NODE::localIndex()
+{
+    return isRoot() ? m_index : &m_delta->m_items;
+}
+
+
+void PNS_NODE::removeLocalItem( PNS_ITEM* aItem )
+{
+    DELTA* top = m_delta.get();
+
+    if( top->m_items.Contains( aItem ) )
+        top->m_items.Remove( aItem );
+
+    // still present in the older (shared) deltas: hide it
+    for( DELTA* d = top->m_base.get(); d; d = d->m_base.get() )
+    {
+        if( d->m_items.Contains( aItem ) )
+        {
+            top->m_removed.insert( aItem );
+            break;
+        }
+
+        if( d->m_removed.count( aItem ) )
+            break;
+    }
+}
 
+
+void PNS_NODE::localItems( ITEM_VECTOR& aItems ) const
+{
+    if( isRoot() )
+    {
         for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
-            child->m_index->Add( *i );
+            aItems.push_back( *i );
 
-        child->m_joints = m_joints;
-        child->m_override = m_override;
+        return;
     }
 
-    TRACE( 2, "%d items, %d joints, %d overrides",
-            child->m_index->Size() % child->m_joints.size() % child->m_override.size() );
+    if( !m_delta->m_base )
+    {
+        DELTA* d = m_delta.get();
 
-    return child;
+        for( PNS_INDEX::ITEM_SET::iterator i = d->m_items.begin(); i != d->m_items.end(); ++i )
+            aItems.push_back( *i );
+
+        return;
+    }
+
+    // items added or removed by the more recent deltas
+    ITEM_SET hidden;
+
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+    {
+        for( PNS_INDEX::ITEM_SET::iterator i = d->m_items.begin(); i != d->m_items.end(); ++i )
+        {
+            if( hidden.insert( *i ).second )
+                aItems.push_back( *i );
+        }
+
+        hidden.insert( d->m_removed.begin(), d->m_removed.end() );
+    }
+}
+
+
+void PNS_NODE::overriddenItems( ITEM_SET& aItems ) const
+{
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+        aItems.insert( d->m_override.begin(), d->m_override.end() );
+}
+
+
+bool PNS_NODE::overrides( PNS_ITEM* aItem ) const
+{
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+    {
+        if( d->m_override.count( aItem ) )
+            return true;
+    }
+
+    return false;
+}
+
+
+template <class Shape, class Visitor>
+void PNS_NODE::queryLocal( const Shape* aShape, int aMinDistance, Visitor& aVisitor ) const
+{
+    if( isRoot() )
+    {
+        m_index->Query( aShape, aMinDistance, aVisitor );
+        return;
+    }
+
+    DELTA_VISITOR<Visitor> filter( aVisitor, m_delta.get() );
+
+    for( DELTA* d = m_delta.get(); d && !filter.m_stopped; d = d->m_base.get() )
+    {
+        filter.m_current = d;
+        d->m_items.Query( aShape, aMinDistance, filter );
+    }
 }
 
 
@@ -288,20 +538,193 @@ struct PNS_NODE::OBSTACLE_VISITOR
 };
 
 
+bool PNS_NODE::QUERY_KEY::operator==( const QUERY_KEY& aOther ) const
+{
+    return m_kind == aOther.m_kind && m_a == aOther.m_a && m_b == aOther.m_b &&
+           m_width == aOther.m_width && m_layerStart == aOther.m_layerStart &&
+           m_layerEnd == aOther.m_layerEnd && m_net == aOther.m_net &&
+           m_kindMask == aOther.m_kindMask && m_limitCount == aOther.m_limitCount &&
+           m_forceClearance == aOther.m_forceClearance &&
+           m_differentNetsOnly == aOther.m_differentNetsOnly;
+}
+
+
+std::size_t PNS_NODE::CACHE_KEY_HASH::operator()( const HULL_KEY& aKey ) const
+{
+    std::size_t seed = 0;
+
+    boost::hash_combine( seed, aKey.m_item );
+    boost::hash_combine( seed, aKey.m_clearance );
+    boost::hash_combine( seed, aKey.m_walkaroundThickness );
+
+    return seed;
+}
+
+
+std::size_t PNS_NODE::CACHE_KEY_HASH::operator()( const QUERY_KEY& aKey ) const
+{
+    std::size_t seed = 0;
+
+    boost::hash_combine( seed, aKey.m_a.x );
+    boost::hash_combine( seed, aKey.m_a.y );
+    boost::hash_combine( seed, aKey.m_b.x );
+    boost::hash_combine( seed, aKey.m_b.y );
+    boost::hash_combine( seed, aKey.m_width );
+    boost::hash_combine( seed, aKey.m_layerStart );
+    boost::hash_combine( seed, aKey.m_net );
+    boost::hash_combine( seed, aKey.m_kindMask );
+
+    return seed;
+}
+
+
+void PNS_NODE::invalidateCaches()
+{
+    if( isRoot() )
+        m_revision++;
+
+    m_cacheRevision = m_root->m_revision;
+
+    if( !m_hullCache.empty() )
+        m_hullCache.clear();
+
+    if( !m_queryCache.empty() )
+        m_queryCache.clear();
+}
+
+
+void PNS_NODE::validateCaches()
+{
+    if( m_cacheRevision == m_root->m_revision &&
+        (int) ( m_hullCache.size() + m_queryCache.size() ) < MaxCacheSize )
+        return;
+
+    m_cacheRevision = m_root->m_revision;
+    m_hullCache.clear();
+    m_queryCache.clear();
+}
+
+
+const SHAPE_LINE_CHAIN PNS_NODE::cachedHull( const PNS_ITEM* aItem, int aClearance,
+                                             int aWalkaroundThickness )
+{
+    HULL_KEY key;
+
+    key.m_item = aItem;
+    key.m_clearance = aClearance;
+    key.m_walkaroundThickness = aWalkaroundThickness;
+
+    boost::mutex::scoped_lock lock( m_cacheMutex );
+
+    validateCaches();
+
+    HULL_CACHE::iterator it = m_hullCache.find( key );
+
+    if( it == m_hullCache.end() )
+    {
+        it = m_hullCache.insert( HULL_CACHE::value_type( key,
+                                 aItem->Hull( aClearance, aWalkaroundThickness ) ) ).first;
+    }
+
+    // returned by copy: another thread may empty the cache once the lock is released
+    return it->second;
+}
+
+
+bool PNS_NODE::queryKey( const PNS_ITEM* aItem, int aKindMask, int aLimitCount,
+                         bool aDifferentNetsOnly, int aForceClearance, QUERY_KEY& aKey ) const
+{
+    // a collision filter may change its answers between two queries
+    if( m_collisionFilter )
+        return false;
+
+    switch( aItem->Kind() )
+    {
+    case PNS_ITEM::SEGMENT:
+    {
+        const PNS_SEGMENT* seg = static_cast<const PNS_SEGMENT*>( aItem );
+
+        aKey.m_a = seg->Seg().A;
+        aKey.m_b = seg->Seg().B;
+        aKey.m_width = seg->Width();
+        break;
+    }
+
+    case PNS_ITEM::VIA:
+    {
+        const PNS_VIA* via = static_cast<const PNS_VIA*>( aItem );
+
+        aKey.m_a = via->Pos();
+        aKey.m_b = via->Pos();
+        aKey.m_width = via->Diameter();
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    aKey.m_kind = aItem->Kind();
+    aKey.m_layerStart = aItem->Layers().Start();
+    aKey.m_layerEnd = aItem->Layers().End();
+    aKey.m_net = aItem->Net();
+    aKey.m_kindMask = aKindMask;
+    aKey.m_limitCount = aLimitCount;
+    aKey.m_forceClearance = aForceClearance;
+    aKey.m_differentNetsOnly = aDifferentNetsOnly;
+
+    return true;
+}
+
+
 int PNS_NODE::QueryColliding( const PNS_ITEM* aItem,
         PNS_NODE::OBSTACLES& aObstacles, int aKindMask, int aLimitCount, bool aDifferentNetsOnly, int aForceClearance )
 {
-    OBSTACLE_VISITOR visitor( aObstacles, aItem, aKindMask, aDifferentNetsOnly );
-
 #ifdef DEBUG
     assert( allocNodes.find( this ) != allocNodes.end() );
 #endif
 
+    m_root->m_stats.m_collisionQueries.fetch_add( 1, boost::memory_order_relaxed );
+
+    // Segments and vias are looked up in the query cache first: the walkaround and
+    // the shove algorithms query the same head segments over and over.
+    QUERY_KEY key;
+    bool cacheable = queryKey( aItem, aKindMask, aLimitCount, aDifferentNetsOnly,
+                               aForceClearance, key );
+
+    if( cacheable )
+    {
+        boost::mutex::scoped_lock lock( m_cacheMutex );
+
+        validateCaches();
+
+        QUERY_CACHE::const_iterator it = m_queryCache.find( key );
+
+        if( it != m_queryCache.end() )
+        {
+            m_root->m_stats.m_cachedQueries.fetch_add( 1, boost::memory_order_relaxed );
+
+            BOOST_FOREACH( PNS_ITEM* item, it->second )
+            {
+                PNS_OBSTACLE obs;
+
+                obs.m_item = item;
+                obs.m_head = aItem;
+                aObstacles.push_back( obs );
+            }
+
+            return aObstacles.size();
+        }
+    }
+
+    int first = aObstacles.size();
+    OBSTACLE_VISITOR visitor( aObstacles, aItem, aKindMask, aDifferentNetsOnly );
+
     visitor.SetCountLimit( aLimitCount );
     visitor.SetWorld( this, NULL );
     visitor.m_forceClearance = aForceClearance;
     // first, look for colliding items in the local index
-    m_index->Query( aItem, m_maxClearance, visitor );
+    queryLocal( aItem, m_maxClearance, visitor );
 
     // if we haven't found enough items, look in the root branch as well.
     if( !isRoot() && ( visitor.m_matchCount < aLimitCount || aLimitCount < 0 ) )
@@ -310,6 +733,19 @@ int PNS_NODE::QueryColliding( const PNS_ITEM* aItem,
         m_root->m_index->Query( aItem, m_maxClearance, visitor );
     }
 
+    if( cacheable )
+    {
+        ITEM_VECTOR found;
+
+        for( unsigned i = first; i < aObstacles.size(); i++ )
+            found.push_back( aObstacles[i].m_item );
+
+        boost::mutex::scoped_lock lock( m_cacheMutex );
+
+        validateCaches();
+        m_queryCache[key] = found;
+    }
+
     return aObstacles.size();
 }
 
@@ -345,6 +781,10 @@ PNS_NODE::OPT_OBSTACLE PNS_NODE::NearestObstacle(   const PNS_LINE* aItem,
     nearest.m_item = NULL;
     nearest.m_distFirst = INT_MAX;
 
+    // an obstacle colliding with several segments of the line is found once per segment,
+    // but its hull needs to be intersected with the line only once
+    ITEM_SET visited;
+
     BOOST_FOREACH( PNS_OBSTACLE obs, obs_list )
     {
         VECTOR2I ip_first, ip_last;
@@ -353,11 +793,14 @@ PNS_NODE::OPT_OBSTACLE PNS_NODE::NearestObstacle(   const PNS_LINE* aItem,
         if( aRestrictedSet && aRestrictedSet->find( obs.m_item ) == aRestrictedSet->end() )
             continue;
 
+        if( !visited.insert( obs.m_item ).second )
+            continue;
+
         std::vector<SHAPE_LINE_CHAIN::INTERSECTION> isect_list;
 
         int clearance = GetClearance( obs.m_item, &aLine );
 
-        SHAPE_LINE_CHAIN hull = obs.m_item->Hull( clearance, aItem->Width() );
+        SHAPE_LINE_CHAIN hull = cachedHull( obs.m_item, clearance, aItem->Width() );
 
         if( aLine.EndsWithVia() )
         {
@@ -525,7 +968,7 @@ const PNS_ITEMSET PNS_NODE::HitTest( const VECTOR2I& aPoint ) const
     SHAPE_CIRCLE s( aPoint, 0 );
     HIT_VISITOR visitor( items, aPoint, this );
 
-    m_index->Query( &s, m_maxClearance, visitor );
+    queryLocal( &s, m_maxClearance, visitor );
 
     if( !isRoot() )    // fixme: could be made cleaner
     {
@@ -547,14 +990,14 @@ const PNS_ITEMSET PNS_NODE::HitTest( const VECTOR2I& aPoint ) const
 void PNS_NODE::addSolid( PNS_SOLID* aSolid )
 {
     linkJoint( aSolid->Pos(), aSolid->Layers(), aSolid->Net(), aSolid );
-    m_index->Add( aSolid );
+    localIndex()->Add( aSolid );
 }
 
 
 void PNS_NODE::addVia( PNS_VIA* aVia )
 {
     linkJoint( aVia->Pos(), aVia->Layers(), aVia->Net(), aVia );
-    m_index->Add( aVia );
+    localIndex()->Add( aVia );
 }
 
 
@@ -589,7 +1032,7 @@ void PNS_NODE::addLine( PNS_LINE* aLine, bool aAllowRedundant )
 
                 aLine->LinkSegment( pseg );
 
-                m_index->Add( pseg );
+                localIndex()->Add( pseg );
             }
         }
     }
@@ -612,12 +1055,14 @@ void PNS_NODE::addSegment( PNS_SEGMENT* aSeg, bool aAllowRedundant )
     linkJoint( aSeg->Seg().A, aSeg->Layers(), aSeg->Net(), aSeg );
     linkJoint( aSeg->Seg().B, aSeg->Layers(), aSeg->Net(), aSeg );
 
-    m_index->Add( aSeg );
+    localIndex()->Add( aSeg );
 }
 
 
 void PNS_NODE::Add( PNS_ITEM* aItem, bool aAllowRedundant )
 {
+    invalidateCaches();
+
     aItem->SetOwner( this );
 
     switch( aItem->Kind() )
@@ -646,16 +1091,22 @@ void PNS_NODE::Add( PNS_ITEM* aItem, bool aAllowRedundant )
 
 void PNS_NODE::doRemove( PNS_ITEM* aItem )
 {
+    invalidateCaches();
+
     // case 1: removing an item that is stored in the root node from any branch:
     // mark it as overridden, but do not remove
     if( aItem->BelongsTo( m_root ) && !isRoot() )
-        m_override.insert( aItem );
+        m_delta->m_override.insert( aItem );
 
-    // case 2: the item belongs to this branch or a parent, non-root branch,
-    // or the root itself and we are the root: remove from the index
-    else if( !aItem->BelongsTo( m_root ) || isRoot() )
+    // case 2: the root itself and we are the root: remove from the index
+    else if( isRoot() )
         m_index->Remove( aItem );
 
+    // case 3: the item belongs to this branch or a parent, non-root branch:
+    // remove it from the deltas
+    else
+        removeLocalItem( aItem );
+
     // the item belongs to this particular branch: un-reference it
     if( aItem->BelongsTo( this ) )
     {
@@ -703,13 +1154,15 @@ void PNS_NODE::removeVia( PNS_VIA* aVia )
     tag.net = net;
     tag.pos = p;
 
+    JOINT_MAP& joints = ownJoints( tag );
+
     bool split;
     do
     {
         split = false;
-        std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range = m_joints.equal_range( tag );
+        std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range = joints.equal_range( tag );
 
-        if( range.first == m_joints.end() )
+        if( range.first == joints.end() )
             break;
 
         // find and remove all joints containing the via to be removed
@@ -718,7 +1171,7 @@ void PNS_NODE::removeVia( PNS_VIA* aVia )
         {
             if( aVia->LayersOverlap ( &f->second ) )
             {
-                m_joints.erase( f );
+                joints.erase( f );
                 split = true;
                 break;
             }
@@ -957,29 +1410,88 @@ PNS_JOINT* PNS_NODE::FindJoint( const VECTOR2I& aPos, int aLayer, int aNet )
     tag.net = aNet;
     tag.pos = aPos;
 
-    JOINT_MAP::iterator f = m_joints.find( tag ), end = m_joints.end();
+    std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range;
+    JOINT_MAP* joints = localJoints( tag );
 
-    if( f == end && !isRoot() )
-    {
-        end = m_root->m_joints.end();
-        f = m_root->m_joints.find( tag );    // m_root->FindJoint(aPos, aLayer, aNet);
-    }
+    if( joints )
+        range = joints->equal_range( tag );
 
-    if( f == end )
-        return NULL;
+    if( ( !joints || range.first == range.second ) && !isRoot() )
+        range = m_root->m_joints.equal_range( tag );    // m_root->FindJoint(aPos, aLayer, aNet);
 
-    while( f != end )
+    for( JOINT_MAP::iterator f = range.first; f != range.second; ++f )
     {
         if( f->second.Layers().Overlaps( aLayer ) )
             return &f->second;
+    }
+
+    return NULL;
+}
+
 
-        ++f;
+PNS_NODE::JOINT_MAP* PNS_NODE::localJoints( const PNS_JOINT::HASH_TAG& aTag )
+{
+    if( isRoot() )
+        return &m_joints;
+
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+    {
+        if( d->m_tags.count( aTag ) )
+            return &d->m_joints;
     }
 
     return NULL;
 }
 
 
+PNS_NODE::JOINT_MAP& PNS_NODE::ownJoints( const PNS_JOINT::HASH_TAG& aTag )
+{
+    if( isRoot() )
+        return m_joints;
+
+    DELTA* top = m_delta.get();
+
+    if( !top->m_tags.insert( aTag ).second )
+        return top->m_joints;
+
+    // first modification of these joints since the last branching: copy them
+    // from the older delta defining them, if any.
+    for( DELTA* d = top->m_base.get(); d; d = d->m_base.get() )
+    {
+        if( d->m_tags.count( aTag ) )
+        {
+            std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range = d->m_joints.equal_range( aTag );
+
+            top->m_joints.insert( range.first, range.second );
+            break;
+        }
+    }
+
+    return top->m_joints;
+}
+
+
+int PNS_NODE::JointCount() const
+{
+    if( isRoot() )
+        return m_joints.size();
+
+    TAG_SET counted;
+    int count = 0;
+
+    for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+    {
+        BOOST_FOREACH( const PNS_JOINT::HASH_TAG& tag, d->m_tags )
+        {
+            if( counted.insert( tag ).second )
+                count += d->m_joints.count( tag );
+        }
+    }
+
+    return count;
+}
+
+
 void PNS_NODE::LockJoint( const VECTOR2I& aPos, const PNS_ITEM* aItem, bool aLock )
 {
     PNS_JOINT& jt = touchJoint( aPos, aItem->Layers(), aItem->Net() );
@@ -995,17 +1507,18 @@ PNS_JOINT& PNS_NODE::touchJoint( const VECTOR2I& aPos, const PNS_LAYERSET& aLaye
     tag.net = aNet;
 
     // try to find the joint in this node.
-    JOINT_MAP::iterator f = m_joints.find( tag );
+    JOINT_MAP& joints = ownJoints( tag );
+    JOINT_MAP::iterator f = joints.find( tag );
 
     std::pair<JOINT_MAP::iterator, JOINT_MAP::iterator> range;
 
     // not found and we are not root? find in the root and copy results here.
-    if( f == m_joints.end() && !isRoot() )
+    if( f == joints.end() && !isRoot() )
     {
         range = m_root->m_joints.equal_range( tag );
 
         for( f = range.first; f != range.second; ++f )
-            m_joints.insert( *f );
+            joints.insert( *f );
     }
 
     // now insert and combine overlapping joints
@@ -1016,9 +1529,9 @@ PNS_JOINT& PNS_NODE::touchJoint( const VECTOR2I& aPos, const PNS_LAYERSET& aLaye
     do
     {
         merged  = false;
-        range   = m_joints.equal_range( tag );
+        range   = joints.equal_range( tag );
 
-        if( range.first == m_joints.end() )
+        if( range.first == joints.end() )
             break;
 
         for( f = range.first; f != range.second; ++f )
@@ -1026,7 +1539,7 @@ PNS_JOINT& PNS_NODE::touchJoint( const VECTOR2I& aPos, const PNS_LAYERSET& aLaye
             if( aLayers.Overlaps( f->second.Layers() ) )
             {
                 jt.Merge( f->second );
-                m_joints.erase( f );
+                joints.erase( f );
                 merged = true;
                 break;
             }
@@ -1034,7 +1547,7 @@ PNS_JOINT& PNS_NODE::touchJoint( const VECTOR2I& aPos, const PNS_LAYERSET& aLaye
     }
     while( merged );
 
-    return m_joints.insert( TagJointPair( tag, jt ) )->second;
+    return joints.insert( TagJointPair( tag, jt ) )->second;
 }
 
 
@@ -1147,17 +1660,19 @@ void PNS_NODE::Dump( bool aLong )
 
 void PNS_NODE::GetUpdatedItems( ITEM_VECTOR& aRemoved, ITEM_VECTOR& aAdded )
 {
-    aRemoved.reserve( m_override.size() );
-    aAdded.reserve( m_index->Size() );
-
     if( isRoot() )
         return;
 
-    BOOST_FOREACH( PNS_ITEM* item, m_override )
+    ITEM_SET overridden;
+
+    overriddenItems( overridden );
+    aRemoved.reserve( overridden.size() );
+    aAdded.reserve( m_delta->m_items.Size() );
+
+    BOOST_FOREACH( PNS_ITEM* item, overridden )
         aRemoved.push_back( item );
 
-    for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
-        aAdded.push_back( *i );
+    localItems( aAdded );
 }
 
 void PNS_NODE::releaseChildren()
@@ -1193,15 +1708,20 @@ void PNS_NODE::Commit( PNS_NODE* aNode )
     if( aNode->isRoot() )
         return;
 
-    BOOST_FOREACH( PNS_ITEM* item, aNode->m_override )
+    ITEM_SET overridden;
+    ITEM_VECTOR added;
+
+    aNode->overriddenItems( overridden );
+    aNode->localItems( added );
+
+    BOOST_FOREACH( PNS_ITEM* item, overridden )
     Remove( item );
 
-    for( PNS_INDEX::ITEM_SET::iterator i = aNode->m_index->begin();
-         i != aNode->m_index->end(); ++i )
+    BOOST_FOREACH( PNS_ITEM* item, added )
     {
-        (*i)->SetRank( -1 );
-        (*i)->Unmark();
-        Add( *i );
+        item->SetRank( -1 );
+        item->Unmark();
+        Add( item );
     }
 
     releaseChildren();
@@ -1218,16 +1738,39 @@ void PNS_NODE::KillChildren()
 
 void PNS_NODE::AllItemsInNet( int aNet, std::set<PNS_ITEM*>& aItems )
 {
-    PNS_ITEM_LIST* l_cur = m_index->GetItemsForNet( aNet );
-
-    if( l_cur )
+    if( isRoot() )
     {
-        BOOST_FOREACH( PNS_ITEM*item, *l_cur )
-            aItems.insert( item );
-    }
+        PNS_ITEM_LIST* l_cur = m_index->GetItemsForNet( aNet );
 
-    if( !isRoot() )
+        if( l_cur )
+        {
+            BOOST_FOREACH( PNS_ITEM*item, *l_cur )
+                aItems.insert( item );
+        }
+    }
+    else
     {
+        // items added or removed by the more recent deltas
+        ITEM_SET hidden;
+
+        for( DELTA* d = m_delta.get(); d; d = d->m_base.get() )
+        {
+            PNS_ITEM_LIST* l_cur = d->m_items.GetItemsForNet( aNet );
+
+            if( l_cur )
+            {
+                BOOST_FOREACH( PNS_ITEM*item, *l_cur )
+                {
+                    if( !hidden.count( item ) )
+                        aItems.insert( item );
+                }
+
+                hidden.insert( l_cur->begin(), l_cur->end() );
+            }
+
+            hidden.insert( d->m_removed.begin(), d->m_removed.end() );
+        }
+
         PNS_ITEM_LIST* l_root = m_root->m_index->GetItemsForNet( aNet );
 
         if( l_root )
@@ -1240,20 +1783,28 @@ void PNS_NODE::AllItemsInNet( int aNet, std::set<PNS_ITEM*>& aItems )
 
 void PNS_NODE::ClearRanks( int aMarkerMask )
 {
-    for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
+    ITEM_VECTOR items;
+
+    localItems( items );
+
+    BOOST_FOREACH( PNS_ITEM* item, items )
     {
-        (*i)->SetRank( -1 );
-        (*i)->Mark( (*i)->Marker() & (~aMarkerMask) );
+        item->SetRank( -1 );
+        item->Mark( item->Marker() & (~aMarkerMask) );
     }
 }
 
 
 int PNS_NODE::FindByMarker( int aMarker, PNS_ITEMSET& aItems )
 {
-    for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
+    ITEM_VECTOR items;
+
+    localItems( items );
+
+    BOOST_FOREACH( PNS_ITEM* item, items )
     {
-        if( (*i)->Marker() & aMarker )
-            aItems.Add( *i );
+        if( item->Marker() & aMarker )
+            aItems.Add( item );
     }
 
     return 0;
@@ -1263,12 +1814,15 @@ int PNS_NODE::FindByMarker( int aMarker, PNS_ITEMSET& aItems )
 int PNS_NODE::RemoveByMarker( int aMarker )
 {
     std::list<PNS_ITEM*> garbage;
+    ITEM_VECTOR items;
+
+    localItems( items );
 
-    for( PNS_INDEX::ITEM_SET::iterator i = m_index->begin(); i != m_index->end(); ++i )
+    BOOST_FOREACH( PNS_ITEM* item, items )
     {
-        if ( (*i)->Marker() & aMarker )
+        if ( item->Marker() & aMarker )
         {
-            garbage.push_back( *i );
+            garbage.push_back( item );
         }
     }
 
@@ -1317,5 +1871,5 @@ void PNS_NODE::SetCollisionFilter( PNS_COLLISION_FILTER* aFilter )
 
 PNS_ITEM_LIST *PNS_NODE::GetItemsForNet(int aNet)
 {
-    return m_index->GetItemsForNet( aNet );
+    return localIndex()->GetItemsForNet( aNet );
 }
@@ -27,6 +27,9 @@
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <geometry/shape.h>
 #include <geometry/shape_line_chain.h>
@@ -120,6 +123,14 @@ struct PNS_COLLISION_FILTER {
  * - assembly of lines connecting joints, finding loops and unique paths
  * - lightweight cloning/branching (for recursive optimization and shove
  * springback)
+ *
+ * A branch stores its changes with respect to the root as a chain of deltas. Branch() freezes
+ * the deltas of the parent, which are then shared by the parent and the new branch,
+ * so branching does not copy anything. The chain is flattened once it gets longer
+ * than MaxDeltaChain, to keep the lookups (which search each delta) fast.
+ *
+ * Each node caches the results of the collision queries of segments and vias, and the
+ * hulls of the obstacles found by NearestObstacle(), until the node or the root is modified.
  **/
 class PNS_NODE
 {
@@ -147,6 +158,7 @@ public:
     void SetMaxClearance( int aClearance )
     {
         m_maxClearance = aClearance;
+        invalidateCaches();
     }
 
     // FIXME: Hack for Diff pair placer
@@ -156,6 +168,14 @@ public:
     void SetClearanceResolver( PNS_CLEARANCE_RESOLVER* aSolver )
     {
         m_clearanceResolver = aSolver;
+        m_root->invalidateCaches();
+    }
+
+    ///> Empties the hull and query caches of the whole tree. To be called when the
+    ///> state of the clearance resolver changes (differential pair gap, sizes).
+    void InvalidateCaches()
+    {
+        m_root->invalidateCaches();
     }
 
     //> Returns true if aNet is part of a paired net
@@ -173,11 +193,8 @@ public:
         m_pairingResolver = aResolver;
     }
 
-    ///> Returns the number of joints
-    int JointCount() const
-    {
-        return m_joints.size();
-    }
+    ///> Returns the number of joints (for a branch, the number of joints it has modified)
+    int JointCount() const;
 
     ///> Returns the number of nodes in the inheritance chain (wrs to the root node)
     int Depth() const
@@ -185,6 +202,31 @@ public:
         return m_depth;
     }
 
+    ///> Counters of the work done on a node hierarchy, used for profiling. They are
+    ///> atomic, as the nodes may be queried by several threads at the same time.
+    struct STATS
+    {
+        STATS() : m_branches( 0 ), m_collisionQueries( 0 ), m_cachedQueries( 0 ) {}
+
+        boost::atomic<int> m_branches;          ///< nodes branched (see Branch())
+        boost::atomic<int> m_collisionQueries;  ///< calls to QueryColliding()
+        boost::atomic<int> m_cachedQueries;     ///< ... answered from the query cache
+    };
+
+    ///> Returns the counters of the whole hierarchy, kept by the root node
+    const STATS& Stats() const
+    {
+        return m_root->m_stats;
+    }
+
+    ///> Resets the counters of the whole hierarchy
+    void ResetStats()
+    {
+        m_root->m_stats.m_branches = 0;
+        m_root->m_stats.m_collisionQueries = 0;
+        m_root->m_stats.m_cachedQueries = 0;
+    }
+
     /**
      * Function QueryColliding()
      *
@@ -396,7 +438,8 @@ public:
     /**
      * Function GetItemsForNet()
      *
-     * Returns list of all items in a given net.
+     * Returns list of all items in a given net. For a branch, only the items added since
+     * its last call to Branch() are listed.
      */
     PNS_ITEM_LIST* GetItemsForNet( int aNet );
 
@@ -407,8 +450,63 @@ public:
 
 private:
     struct OBSTACLE_VISITOR;
+    struct DELTA;
+    template <class Visitor> struct DELTA_VISITOR;
+
     typedef boost::unordered_multimap<PNS_JOINT::HASH_TAG, PNS_JOINT> JOINT_MAP;
     typedef JOINT_MAP::value_type TagJointPair;
+    typedef boost::unordered_set<PNS_JOINT::HASH_TAG> TAG_SET;
+    typedef boost::unordered_set<PNS_ITEM*> ITEM_SET;
+    typedef boost::shared_ptr<DELTA> DELTA_PTR;
+
+    ///> Key of the hull cache: obstacle, clearance and walkaround thickness
+    struct HULL_KEY
+    {
+        const PNS_ITEM* m_item;
+        int m_clearance;
+        int m_walkaroundThickness;
+
+        bool operator==( const HULL_KEY& aOther ) const
+        {
+            return m_item == aOther.m_item && m_clearance == aOther.m_clearance &&
+                   m_walkaroundThickness == aOther.m_walkaroundThickness;
+        }
+    };
+
+    ///> Key of the query cache: the geometry of a segment or via and the
+    ///> parameters of QueryColliding()
+    struct QUERY_KEY
+    {
+        int m_kind;
+        VECTOR2I m_a, m_b;
+        int m_width;
+        int m_layerStart, m_layerEnd;
+        int m_net;
+        int m_kindMask;
+        int m_limitCount;
+        int m_forceClearance;
+        bool m_differentNetsOnly;
+
+        bool operator==( const QUERY_KEY& aOther ) const;
+    };
+
+    struct CACHE_KEY_HASH
+    {
+        std::size_t operator()( const HULL_KEY& aKey ) const;
+        std::size_t operator()( const QUERY_KEY& aKey ) const;
+    };
+
+    typedef boost::unordered_map<HULL_KEY, SHAPE_LINE_CHAIN, CACHE_KEY_HASH> HULL_CACHE;
+    typedef boost::unordered_map<QUERY_KEY, ITEM_VECTOR, CACHE_KEY_HASH> QUERY_CACHE;
+
+    ///> Number of entries after which the caches of a node are emptied
+    static const int MaxCacheSize = 4096;
+
+    ///> Number of deltas after which the chain of a branch is flattened
+    static const int MaxDeltaChain = 8;
+
+    ///> creates a branch of aParent
+    PNS_NODE( PNS_NODE* aParent );
 
     /// nodes are not copyable
     PNS_NODE( const PNS_NODE& aB );
@@ -438,6 +536,47 @@ private:
     void removeVia( PNS_VIA* aVia );
 
     void doRemove( PNS_ITEM* aItem );
+
+    ///> returns the index storing the items added to this node
+    PNS_INDEX* localIndex();
+
+    ///> returns the map holding the local joints of the tag (NULL if there are none)
+    JOINT_MAP* localJoints( const PNS_JOINT::HASH_TAG& aTag );
+
+    ///> returns the joint map storing the joints of the tag modified by this node,
+    ///> copying them to the last delta of a branch if needed
+    JOINT_MAP& ownJoints( const PNS_JOINT::HASH_TAG& aTag );
+
+    ///> removes an item added by one of the deltas of the branch
+    void removeLocalItem( PNS_ITEM* aItem );
+
+    ///> stores the items added by the branch (or all the items of the root)
+    void localItems( ITEM_VECTOR& aItems ) const;
+
+    ///> stores the root items overridden by the branch
+    void overriddenItems( ITEM_SET& aItems ) const;
+
+    ///> runs a query on the items added by the branch (or on all the items of the root)
+    template <class Shape, class Visitor>
+    void queryLocal( const Shape* aShape, int aMinDistance, Visitor& aVisitor ) const;
+
+    ///> merges all the deltas of the branch into a single one
+    DELTA_PTR flatten() const;
+
+    ///> returns the hull of an obstacle, computing it only on the first request
+    const SHAPE_LINE_CHAIN cachedHull( const PNS_ITEM* aItem, int aClearance,
+                                       int aWalkaroundThickness );
+
+    ///> fills the query cache key of aItem, returns false if the item kind is not cached
+    bool queryKey( const PNS_ITEM* aItem, int aKindMask, int aLimitCount,
+                   bool aDifferentNetsOnly, int aForceClearance, QUERY_KEY& aKey ) const;
+
+    ///> empties the caches of the node (and of all the branches, for the root node)
+    void invalidateCaches();
+
+    ///> empties the caches of the node if the root has been modified since they were filled
+    void validateCaches();
+
     void unlinkParent();
     void releaseChildren();
     void releaseGarbage();
@@ -449,10 +588,7 @@ private:
 
     ///> checks if this branch contains an updated version of the m_item
     ///> from the root branch.
-    bool overrides( PNS_ITEM* aItem ) const
-    {
-        return m_override.find( aItem ) != m_override.end();
-    }
+    bool overrides( PNS_ITEM* aItem ) const;
 
     PNS_SEGMENT* findRedundantSegment( PNS_SEGMENT* aSeg );
 
@@ -467,9 +603,13 @@ private:
                      bool            aStopAtLockedJoints );
 
     ///> hash table with the joints, linking the items. Joints are hashed by
-    ///> their position, layer set and net.
+    ///> their position, layer set and net. Used by the root node only.
     JOINT_MAP m_joints;
 
+    ///> changes of a branch: its last delta, owned by this node only, the older ones
+    ///> being shared with other branches. NULL for the root node.
+    DELTA_PTR m_delta;
+
     ///> node this node was branched from
     PNS_NODE* m_parent;
 
@@ -479,9 +619,6 @@ private:
     ///> list of nodes branched from this one
     std::set<PNS_NODE*> m_children;
 
-    ///> hash of root's items that have been changed in this node
-    boost::unordered_set<PNS_ITEM*> m_override;
-
     ///> worst case item-item clearance
     int m_maxClearance;
 
@@ -491,7 +628,7 @@ private:
     //> Net pairing resolver
     PNS_PAIRING_RESOLVER* m_pairingResolver;
 
-    ///> Geometric/Net index of the items
+    ///> Geometric/Net index of the items. Used by the root node only.
     PNS_INDEX* m_index;
 
     ///> depth of the node (number of parent nodes in the inheritance chain)
@@ -501,6 +638,25 @@ private:
     PNS_COLLISION_FILTER* m_collisionFilter;
 
     boost::unordered_set<PNS_ITEM*> m_garbageItems;
+
+    ///> profiling counters, used in the root node only
+    STATS m_stats;
+
+    ///> hulls of the obstacles found by NearestObstacle()
+    HULL_CACHE m_hullCache;
+
+    ///> obstacles found by QueryColliding() for segments and vias
+    QUERY_CACHE m_queryCache;
+
+    ///> locks the caches, which are filled by the queries (possibly run by several threads)
+    boost::mutex m_cacheMutex;
+
+    ///> incremented when the root is modified, which invalidates the caches of all the
+    ///> branches. Used by the root node only.
+    int m_revision;
+
+    ///> value of m_root->m_revision when the caches of the node were last emptied
+    int m_cacheRevision;
 };
 
 #endif
@@ -52,6 +52,7 @@
 #include "pns_meander_placer.h"
 #include "pns_meander_skew_placer.h"
 #include "pns_dp_meander_placer.h"
+#include "pns_logger.h"
 
 #include <router/router_preview_item.h>
 
@@ -358,6 +359,9 @@ public:
 
     void AddLine( const SHAPE_LINE_CHAIN& aLine, int aType, int aWidth )
     {
+        if( !m_items )
+            return;
+
         ROUTER_PREVIEW_ITEM* pitem = new ROUTER_PREVIEW_ITEM( NULL, m_items );
 
         pitem->Line( aLine, aWidth, aType );
@@ -625,6 +629,9 @@ void PNS_ROUTER::SyncWorld()
         return;
     }
 
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "sync" );
+
     ClearWorld();
 
     m_world = new PNS_NODE();
@@ -685,7 +692,7 @@ PNS_ROUTER::PNS_ROUTER()
     m_view = NULL;
     m_snappingEnabled  = false;
     m_gridHelper = NULL;
-
+    m_eventLogger = NULL;
 }
 
 
@@ -800,11 +807,16 @@ const VECTOR2I PNS_ROUTER::SnapToItem( PNS_ITEM* aItem, VECTOR2I aP, bool& aSpli
             anchor = s.A;
         else if( ( aP - s.B ).EuclideanNorm() < w / 2 )
             anchor = s.B;
-        else
+        else if( m_gridHelper )
         {
             anchor = m_gridHelper->AlignToSegment ( aP, s );
             aSplitsSegment = (anchor != s.A && anchor != s.B );
         }
+        else
+        {
+            anchor = s.NearestPoint( aP );
+            aSplitsSegment = (anchor != s.A && anchor != s.B );
+        }
 
         break;
     }
@@ -822,6 +834,14 @@ bool PNS_ROUTER::StartDragging( const VECTOR2I& aP, PNS_ITEM* aStartItem )
     if( !aStartItem || aStartItem->OfKind( PNS_ITEM::SOLID ) )
         return false;
 
+    if( m_eventLogger )
+    {
+        logSettings();
+        m_eventLogger->LogEvent( "drag", aP, aStartItem );
+    }
+
+    PNS_ITEM_POOL::ResetTotalStats();
+
     m_dragger = new PNS_DRAGGER();
     m_dragger->SetInitialWorld( m_world );
 
@@ -842,8 +862,65 @@ PNS_ROUTING_SETTINGS &PNS_ROUTER::Settings()
     return m_settings;
 }
 
+
+void PNS_ROUTER::logSizes()
+{
+    std::vector<int> args;
+
+    args.push_back( m_sizes.TrackWidth() );
+    args.push_back( m_sizes.DiffPairWidth() );
+    args.push_back( m_sizes.DiffPairGap() );
+    args.push_back( m_sizes.DiffPairViaGap() );
+    args.push_back( m_sizes.DiffPairViaGapSameAsTraceGap() );
+    args.push_back( m_sizes.ViaDiameter() );
+    args.push_back( m_sizes.ViaDrill() );
+    args.push_back( m_sizes.ViaType() );
+
+    // Each pair is stored twice (top -> bottom and bottom -> top)
+    const std::map<int, int>& pairs = m_sizes.LayerPairs();
+
+    for( std::map<int, int>::const_iterator it = pairs.begin(); it != pairs.end(); ++it )
+    {
+        args.push_back( it->first );
+        args.push_back( it->second );
+    }
+
+    m_eventLogger->LogEvent( "sizes", args );
+}
+
+
+void PNS_ROUTER::logSettings()
+{
+    // Each tool has its own router: the state of this one is recorded with each
+    // operation, as the events of several routers can be logged together
+    m_eventLogger->LogEvent( "mode", std::vector<int>( 1, m_mode ) );
+    logSizes();
+
+    std::vector<int> args;
+
+    args.push_back( m_settings.Mode() );
+    args.push_back( m_settings.OptimizerEffort() );
+    args.push_back( m_settings.ShoveVias() );
+    args.push_back( m_settings.RemoveLoops() );
+    args.push_back( m_settings.SmartPads() );
+    args.push_back( m_settings.SuggestFinish() );
+    args.push_back( m_settings.JumpOverObstacles() );
+    args.push_back( m_settings.CanViolateDRC() );
+    args.push_back( m_settings.SmoothDraggedSegments() );
+    args.push_back( m_settings.FreeAngleMode() );
+    args.push_back( m_settings.InlineDragEnabled() );
+    args.push_back( m_settings.StartDiagonal() );
+    args.push_back( m_settings.ShoveIterationLimit() );
+    args.push_back( m_settings.ShoveTimeLimit() );
+    args.push_back( m_settings.WalkaroundIterationLimit() );
+    args.push_back( m_settings.ParallelCandidates() );
+
+    m_eventLogger->LogEvent( "settings", args );
+}
+
 bool PNS_ROUTER::StartRouting( const VECTOR2I& aP, PNS_ITEM* aStartItem, int aLayer )
 {
+    PNS_ITEM_POOL::ResetTotalStats();
     m_clearanceResolver->UseDpGap( false );
 
     switch( m_mode )
@@ -869,6 +946,10 @@ bool PNS_ROUTER::StartRouting( const VECTOR2I& aP, PNS_ITEM* aStartItem, int aLa
         return false;
     }
 
+    // The cached hulls and collisions of the previous session may have been computed
+    // with the other gap setting
+    m_world->InvalidateCaches();
+
     // FIXME: it's not our business to set the minimum size here
     m_sizes.SetMinimumTrackWidth(m_board->GetDesignSettings().m_TrackMinWidth);
 
@@ -882,6 +963,13 @@ bool PNS_ROUTER::StartRouting( const VECTOR2I& aP, PNS_ITEM* aStartItem, int aLa
     if (SnappingEnabled())
         startPoint = SnapToItem( aStartItem, startPoint, dummy);
 
+    // The snapped point is recorded, so the replay does not depend on the grid
+    if( m_eventLogger )
+    {
+        logSettings();
+        m_eventLogger->LogEvent( "start", startPoint, aStartItem, std::vector<int>( 1, aLayer ) );
+    }
+
     bool rv = m_placer->Start( startPoint, aStartItem );
     SetFailureReason(m_placer->FailureReason());
 
@@ -917,6 +1005,10 @@ void PNS_ROUTER::eraseView()
 
 void PNS_ROUTER::DisplayItem( const PNS_ITEM* aItem, int aColor, int aClearance )
 {
+    // No view (e.g. the router is replaying a session)
+    if( !m_previewItems )
+        return;
+
     ROUTER_PREVIEW_ITEM* pitem = new ROUTER_PREVIEW_ITEM( aItem, m_previewItems );
 
     if( aColor >= 0 )
@@ -941,6 +1033,9 @@ void PNS_ROUTER::DisplayItems( const PNS_ITEMSET& aItems )
 
 void PNS_ROUTER::Move( const VECTOR2I& aP, PNS_ITEM* endItem )
 {
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "move", aP, endItem );
+
     switch( m_state )
     {
     case ROUTE_TRACK:
@@ -1038,6 +1133,13 @@ void PNS_ROUTER::UpdateSizes ( const PNS_SIZES_SETTINGS& aSizes )
 {
     m_sizes = aSizes;
 
+    if( m_eventLogger )
+        logSizes();
+
+    // the differential pair gap is a clearance of the resolver
+    if( m_world )
+        m_world->InvalidateCaches();
+
     // Change track/via size settings
     if( m_state == ROUTE_TRACK)
     {
@@ -1099,7 +1201,9 @@ void PNS_ROUTER::CommitRouting( PNS_NODE* aNode )
 
         if( parent )
         {
-            m_view->Remove( parent );
+            if( m_view )
+                m_view->Remove( parent );
+
             m_board->Remove( parent );
             m_undoBuffer.PushItem( ITEM_PICKER( parent, UR_DELETED ) );
         }
@@ -1149,7 +1253,10 @@ void PNS_ROUTER::CommitRouting( PNS_NODE* aNode )
         {
             item->SetParent( newBI );
             newBI->ClearFlags();
-            m_view->Add( newBI );
+
+            if( m_view )
+                m_view->Add( newBI );
+
             m_board->Add( newBI );
             m_undoBuffer.PushItem( ITEM_PICKER( newBI, UR_NEW ) );
             newBI->ViewUpdate( KIGFX::VIEW_ITEM::GEOMETRY );
@@ -1175,6 +1282,9 @@ bool PNS_ROUTER::FixRoute( const VECTOR2I& aP, PNS_ITEM* aEndItem )
 {
     bool rv = false;
 
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "fix", aP, aEndItem );
+
     switch( m_state )
     {
     case ROUTE_TRACK:
@@ -1221,6 +1331,9 @@ void PNS_ROUTER::StopRouting()
     if( !RoutingInProgress() )
         return;
 
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "stop" );
+
     if( m_placer )
         delete m_placer;
 
@@ -1235,6 +1348,9 @@ void PNS_ROUTER::StopRouting()
     m_state = IDLE;
     m_world->KillChildren();
     m_world->ClearRanks();
+
+    TRACE( 1, "%d item allocations, peak %d items, %d items reserved",
+           AllocStats().m_allocs % AllocStats().m_peak % AllocStats().m_reserved );
 }
 
 PNS_NODE *PNS_ROUTER::GetWorld() const
@@ -1245,6 +1361,9 @@ PNS_NODE *PNS_ROUTER::GetWorld() const
 
 void PNS_ROUTER::FlipPosture()
 {
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "flip" );
+
     if( m_state == ROUTE_TRACK )
     {
         m_placer->FlipPosture();
@@ -1254,6 +1373,9 @@ void PNS_ROUTER::FlipPosture()
 
 void PNS_ROUTER::SwitchLayer( int aLayer )
 {
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "layer", std::vector<int>( 1, aLayer ) );
+
     switch( m_state )
     {
     case ROUTE_TRACK:
@@ -1267,6 +1389,9 @@ void PNS_ROUTER::SwitchLayer( int aLayer )
 
 void PNS_ROUTER::ToggleViaPlacement()
 {
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "via" );
+
     if( m_state == ROUTE_TRACK )
     {
         bool toggle = !m_placer->IsPlacingVia();
@@ -1326,6 +1451,9 @@ bool PNS_ROUTER::IsPlacingVia() const
 
 void PNS_ROUTER::SetOrthoMode( bool aEnable )
 {
+    if( m_eventLogger )
+        m_eventLogger->LogEvent( "ortho", std::vector<int>( 1, aEnable ) );
+
     if( !m_placer )
         return;
 
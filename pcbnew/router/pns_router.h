@@ -34,6 +34,7 @@
 #include "pns_item.h"
 #include "pns_itemset.h"
 #include "pns_node.h"
+#include "pns_item_pool.h"
 
 class BOARD;
 class BOARD_ITEM;
@@ -58,6 +59,7 @@ class PCBNEW_PAIRING_RESOLVER;
 class PCBNEW_DEBUG_DECORATOR;
 class PNS_SHOVE;
 class PNS_DRAGGER;
+class PNS_LOGGER;
 
 namespace KIGFX
 {
@@ -186,6 +188,25 @@ public:
         m_gridHelper = aGridHelper;
     }
 
+    /**
+     * Sets the logger recording the routing operations (mode and settings changes,
+     * start/move/fix of routing and dragging, etc.), so that they can be replayed
+     * without the GUI. NULL (the default) disables the recording.
+     */
+    void SetEventLogger( PNS_LOGGER* aLogger )
+    {
+        m_eventLogger = aLogger;
+    }
+
+    /**
+     * Returns the allocation counters of the router items (segments, lines and vias),
+     * since the start of the current (or last) routing or dragging operation.
+     */
+    PNS_ITEM_POOL::STATS AllocStats() const
+    {
+        return PNS_ITEM_POOL::TotalStats();
+    }
+
     // Error management
     void SetFailureReason ( const wxString& aReason );
     const wxString& FailureReason() const;
@@ -214,6 +235,13 @@ private:
 
     void clearViewFlags();
 
+    ///> Records the mode, the sizes and the routing settings (which can be changed
+    ///> directly through Settings()).
+    void logSettings();
+
+    ///> Records the sizes settings.
+    void logSizes();
+
     int MatchDpSuffix( wxString aNetName, wxString& aComplementNet, wxString& aBaseDpName ) const;
 
     // optHoverItem queryHoverItemEx(const VECTOR2I& aP);
@@ -260,6 +288,9 @@ private:
     wxString m_failureReason;
 
     GRID_HELPER *m_gridHelper;
+
+    ///> Records the routing operations, if not NULL
+    PNS_LOGGER* m_eventLogger;
 };
 
 #endif
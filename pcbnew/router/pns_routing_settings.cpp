@@ -39,6 +39,7 @@ PNS_ROUTING_SETTINGS::PNS_ROUTING_SETTINGS()
     m_canViolateDRC = false;
     m_freeAngleMode = false;
     m_inlineDragEnabled = false;
+    m_parallelCandidates = false;
 }
 
 const DIRECTION_45 PNS_ROUTING_SETTINGS::InitialDirection() const
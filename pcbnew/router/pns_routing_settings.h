@@ -132,6 +132,11 @@ public:
     void SetInlineDragEnabled ( bool aEnable ) { m_inlineDragEnabled = aEnable; }
     bool InlineDragEnabled( ) const { return m_inlineDragEnabled; }
 
+    ///> Evaluate several candidate paths (winding directions, postures) concurrently
+    ///> in walkaround mode, keeping the best one.
+    void SetParallelCandidates( bool aEnable ) { m_parallelCandidates = aEnable; }
+    bool ParallelCandidates() const { return m_parallelCandidates; }
+
 private:
     bool m_shoveVias;
     bool m_startDiagonal;
@@ -144,6 +149,7 @@ private:
     bool m_canViolateDRC;
     bool m_freeAngleMode;
     bool m_inlineDragEnabled;
+    bool m_parallelCandidates;
 
     PNS_MODE m_routingMode;
     PNS_OPTIMIZATION_EFFORT m_optimizerEffort;
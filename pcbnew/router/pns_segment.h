@@ -62,6 +62,10 @@ public:
 
     PNS_SEGMENT* Clone() const;
 
+    ///> items are allocated from a PNS_ITEM_POOL
+    static void* operator new( size_t aSize );
+    static void operator delete( void* aPtr, size_t aSize );
+
     const SHAPE* Shape() const
     {
         return static_cast<const SHAPE*>( &m_seg );
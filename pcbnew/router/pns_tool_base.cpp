@@ -49,6 +49,7 @@
 #include "pns_tool_base.h"
 #include "pns_segment.h"
 #include "pns_router.h"
+#include "pns_logger.h"
 #include "pns_meander_placer.h" // fixme: move settings to separate header
 #include "pns_tune_status_popup.h"
 #include "trace.h"
@@ -62,6 +63,40 @@ TOOL_ACTION PNS_TOOL_BASE::ACT_RouterOptions( "pcbnew.InteractiveRouter.RouterOp
                                             _( "Shows a dialog containing router options." ), tools_xpm );
 
 
+/**
+ * Returns the logger recording the operations of the routers, or NULL if they are not
+ * recorded. The recording is enabled by setting the KICAD_PNS_EVENT_LOG environment
+ * variable to the name of the file to write, which can then be replayed with the
+ * pns_replay tool. The log is shared by all the router tools, as they edit the same board.
+ */
+static PNS_LOGGER* eventLogger()
+{
+    static bool        initialized = false;
+    static PNS_LOGGER* logger = NULL;
+
+    if( !initialized )
+    {
+        wxString filename;
+
+        if( wxGetEnv( wxT( "KICAD_PNS_EVENT_LOG" ), &filename ) && !filename.IsEmpty() )
+            logger = new PNS_LOGGER;
+
+        initialized = true;
+    }
+
+    return logger;
+}
+
+
+static void saveEventLog()
+{
+    wxString filename;
+
+    if( eventLogger() && wxGetEnv( wxT( "KICAD_PNS_EVENT_LOG" ), &filename ) )
+        eventLogger()->Save( std::string( filename.fn_str() ) );
+}
+
+
 PNS_TOOL_BASE::PNS_TOOL_BASE( const std::string& aToolName ) :
     TOOL_INTERACTIVE( aToolName )
 {
@@ -82,6 +117,8 @@ PNS_TOOL_BASE::PNS_TOOL_BASE( const std::string& aToolName ) :
 
 PNS_TOOL_BASE::~PNS_TOOL_BASE()
 {
+    saveEventLog();
+
     delete m_router;
     delete m_gridHelper;
 }
@@ -91,7 +128,10 @@ PNS_TOOL_BASE::~PNS_TOOL_BASE()
 void PNS_TOOL_BASE::Reset( RESET_REASON aReason )
 {
     if( m_router )
+    {
+        saveEventLog();
         delete m_router;
+    }
 
     if( m_gridHelper)
         delete m_gridHelper;
@@ -101,6 +141,7 @@ void PNS_TOOL_BASE::Reset( RESET_REASON aReason )
     m_board = getModel<BOARD>();
 
     m_router = new PNS_ROUTER;
+    m_router->SetEventLogger( eventLogger() );
 
     m_router->ClearWorld();
     m_router->SetBoard( m_board );
@@ -21,6 +21,7 @@
 #include "pns_via.h"
 #include "pns_node.h"
 #include "pns_utils.h"
+#include "pns_item_pool.h"
 
 #include <geometry/shape_rect.h>
 
@@ -95,6 +96,18 @@ PNS_VIA* PNS_VIA::Clone() const
 }
 
 
+void* PNS_VIA::operator new( size_t aSize )
+{
+    return PNS_ITEM_POOL::Get( PNS_ITEM_POOL::VIAS ).Alloc( aSize );
+}
+
+
+void PNS_VIA::operator delete( void* aPtr, size_t aSize )
+{
+    PNS_ITEM_POOL::Get( PNS_ITEM_POOL::VIAS ).Free( aPtr, aSize );
+}
+
+
 OPT_BOX2I PNS_VIA::ChangedArea( const PNS_VIA* aOther ) const
 {
     if ( aOther->Pos() != Pos() )
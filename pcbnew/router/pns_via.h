@@ -146,6 +146,10 @@ public:
 
     PNS_VIA* Clone() const;
 
+    ///> items are allocated from a PNS_ITEM_POOL
+    static void* operator new( size_t aSize );
+    static void operator delete( void* aPtr, size_t aSize );
+
     const SHAPE_LINE_CHAIN Hull( int aClearance = 0, int aWalkaroundThickness = 0 ) const;
 
     virtual VECTOR2I Anchor( int n ) const
@@ -54,6 +54,7 @@
 #include "router_tool.h"
 #include "pns_segment.h"
 #include "pns_router.h"
+#include "pns_batch_router.h"
 #include "trace.h"
 
 using namespace KIGFX;
@@ -108,6 +109,12 @@ static TOOL_ACTION ACT_SetDpDimensions( "pcbnew.InteractiveRouter.SetDpDimension
     _( "Sets the width and gap of the currently routed differential pair." ),
     ps_diff_pair_tune_length_xpm );
 
+static TOOL_ACTION ACT_RouteAll( "pcbnew.InteractiveRouter.RouteAll",
+    AS_CONTEXT, 0,
+    _( "Route All Unconnected" ),
+    _( "Routes all the unconnected ratsnest lines, shortest first." ),
+    ratsnest_xpm );
+
 
 ROUTER_TOOL::ROUTER_TOOL() :
     PNS_TOOL_BASE( "pcbnew.InteractiveRouter" )
@@ -211,6 +218,7 @@ public:
         Add( ACT_PlaceBlindVia );
         Add( ACT_PlaceMicroVia );
         Add( ACT_SwitchPosture );
+        Add( ACT_RouteAll );
 
         AppendSeparator();
 
@@ -764,6 +772,10 @@ int ROUTER_TOOL::mainLoop( PNS_ROUTER_MODE aMode )
             updateStartItem( *evt );
             performDragging();
         }
+        else if( evt->IsAction( &ACT_RouteAll ) )
+        {
+            performBatchRouting();
+        }
         else if( evt->IsAction( &ACT_PlaceThroughVia ) )
         {
             m_toolMgr->RunAction( COMMON_ACTIONS::layerToggle, true );
@@ -786,6 +798,46 @@ int ROUTER_TOOL::mainLoop( PNS_ROUTER_MODE aMode )
 }
 
 
+void ROUTER_TOOL::batchSizeSettings( PNS_SIZES_SETTINGS& aSizes, const PNS_ITEM* aStartItem )
+{
+    initSizeSettings( aSizes, m_board, aStartItem );
+    aSizes.AddLayerPair( m_frame->GetScreen()->m_Route_Layer_TOP,
+                         m_frame->GetScreen()->m_Route_Layer_BOTTOM );
+}
+
+
+void ROUTER_TOOL::performBatchRouting()
+{
+    PNS_BATCH_ROUTER batch( m_router );
+
+    batch.SetSizesHook( boost::bind( &ROUTER_TOOL::batchSizeSettings, this, _1, _2 ) );
+
+    wxBusyCursor dummy;
+    const PNS_BATCH_ROUTER::STATS& stats = batch.RouteAll();
+
+    // Save the recent changes in the undo buffer
+    m_frame->SaveCopyInUndoList( m_router->GetUndoBuffer(), UR_UNSPECIFIED );
+    m_router->ClearUndoBuffer();
+    m_frame->OnModify();
+
+    wxString msg;
+
+    msg.Printf( _( "Routed %d of %d connections (%.0f%%), %.1f ms per connection." ),
+                stats.m_routed, stats.m_connections, stats.SuccessRate() * 100.0,
+                stats.MsecsPerConnection() );
+
+    if( stats.m_unmatched )
+        msg += wxString::Format( _( "\n%d connections have an end which is not a pad, via or track." ),
+                                 stats.m_unmatched );
+
+    if( stats.m_layerMismatch )
+        msg += wxString::Format( _( "\n%d connections have ends on different layers and need a via." ),
+                                 stats.m_layerMismatch );
+
+    DisplayInfoMessage( m_frame, msg );
+}
+
+
 void ROUTER_TOOL::performDragging()
 {
     PCB_EDIT_FRAME* frame = getEditFrame<PCB_EDIT_FRAME>();
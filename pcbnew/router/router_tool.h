@@ -51,6 +51,7 @@ private:
 
     void performRouting();
     void performDragging();
+    void performBatchRouting();
 
     void getNetclassDimensions( int aNetCode, int& aWidth, int& aViaDiameter, int& aViaDrill );
     void handleCommonEvents( const TOOL_EVENT& evt );
@@ -63,6 +64,7 @@ private:
     bool finishInteractive();
 
     void initSizeSettings(PNS_SIZES_SETTINGS &aPNSSettings, const BOARD* aBoard, const PNS_ITEM* aStartItem, int aNet = -1 );
+    void batchSizeSettings( PNS_SIZES_SETTINGS& aSizes, const PNS_ITEM* aStartItem );
     void importCurrentSizeSettings( PNS_SIZES_SETTINGS &aPNSSettings, const BOARD_DESIGN_SETTINGS &aBoardSettings );
 
     PNS_ITEM *FindItemByParent( PNS_NODE* aNode, const BOARD_CONNECTED_ITEM* aParent );
@@ -0,0 +1,296 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file zone_fill_tracker.cpp
+ */
+
+#include <fctsys.h>
+
+#include <boost/functional/hash.hpp>
+
+#include <class_board.h>
+#include <class_module.h>
+#include <class_track.h>
+#include <class_pad.h>
+#include <class_edge_mod.h>
+#include <class_drawsegment.h>
+#include <class_pcb_text.h>
+#include <class_zone.h>
+
+#include <clearance_poly_cache.h>
+#include <zone_fill_tracker.h>
+
+
+static void hashPoint( std::size_t& aSeed, const wxPoint& aPoint )
+{
+    boost::hash_combine( aSeed, aPoint.x );
+    boost::hash_combine( aSeed, aPoint.y );
+}
+
+
+static void hashSize( std::size_t& aSeed, const wxSize& aSize )
+{
+    boost::hash_combine( aSeed, aSize.x );
+    boost::hash_combine( aSeed, aSize.y );
+}
+
+
+static void hashRect( std::size_t& aSeed, const EDA_RECT& aRect )
+{
+    hashPoint( aSeed, aRect.GetOrigin() );
+    hashSize( aSeed, aRect.GetSize() );
+}
+
+
+ZONE_FILL_TRACKER::ZONE_FILL_TRACKER() :
+    m_valid( false )
+{
+}
+
+
+void ZONE_FILL_TRACKER::Clear()
+{
+    m_states.clear();
+    m_valid = false;
+}
+
+
+void ZONE_FILL_TRACKER::addItem( const BOARD_ITEM* aItem, STATE_MAP& aStates )
+{
+    ITEM_STATE  state;
+    std::size_t hash = 0;
+
+    state.m_area = aItem->GetBoundingBox();
+
+    boost::hash_combine( hash, CLEARANCE_POLY_CACHE::ShapeHash( aItem ) );
+    hashRect( hash, state.m_area );
+
+    // Only copper layers and board edges are used by the zone fill
+    LSET layers = aItem->GetLayerSet() & ( LSET::AllCuMask() | LSET( Edge_Cuts ) );
+
+    for( LSEQ seq = layers.Seq();  seq;  ++seq )
+        boost::hash_combine( hash, (int) *seq );
+
+    if( aItem->IsConnected() )
+    {
+        const BOARD_CONNECTED_ITEM* item = static_cast<const BOARD_CONNECTED_ITEM*>( aItem );
+        int clearance = item->GetClearance();
+
+        boost::hash_combine( hash, item->GetNetCode() );
+        boost::hash_combine( hash, clearance );
+
+        state.m_area.Inflate( clearance );
+    }
+
+    switch( aItem->Type() )
+    {
+    case PCB_PAD_T:
+    {
+        const D_PAD* pad = static_cast<const D_PAD*>( aItem );
+
+        hashSize( hash, pad->GetDrillSize() );
+        boost::hash_combine( hash, (int) pad->GetDrillShape() );
+        boost::hash_combine( hash, (int) pad->GetZoneConnection() );
+        boost::hash_combine( hash, pad->GetThermalWidth() );
+        boost::hash_combine( hash, pad->GetThermalGap() );
+        break;
+    }
+
+    case PCB_MODULE_EDGE_T:
+    {
+        // The polygon points of footprint edges are relative to the footprint
+        const MODULE* module = static_cast<const MODULE*>( aItem->GetParent() );
+
+        if( module )
+        {
+            hashPoint( hash, module->GetPosition() );
+            boost::hash_combine( hash, module->GetOrientation() );
+        }
+    }
+        // Fall through
+    case PCB_LINE_T:
+    {
+        const DRAWSEGMENT* segment = static_cast<const DRAWSEGMENT*>( aItem );
+
+        hashPoint( hash, segment->GetStart() );
+        hashPoint( hash, segment->GetEnd() );
+        boost::hash_combine( hash, (int) segment->GetShape() );
+        boost::hash_combine( hash, segment->GetWidth() );
+        boost::hash_combine( hash, segment->GetAngle() );
+
+        const std::vector<wxPoint>& points = segment->GetPolyPoints();
+
+        for( unsigned ii = 0; ii < points.size(); ii++ )
+            hashPoint( hash, points[ii] );
+
+        state.m_area.Inflate( segment->GetWidth() / 2 );
+        break;
+    }
+
+    case PCB_ZONE_AREA_T:
+    {
+        const ZONE_CONTAINER* zone = static_cast<const ZONE_CONTAINER*>( aItem );
+        const CPolyLine*      outline = zone->Outline();
+
+        for( int ii = 0; ii < outline->GetCornersCount(); ii++ )
+        {
+            hashPoint( hash, outline->GetPos( ii ) );
+            boost::hash_combine( hash, outline->IsEndContour( ii ) );
+        }
+
+        boost::hash_combine( hash, zone->GetPriority() );
+        boost::hash_combine( hash, zone->GetZoneClearance() );
+        boost::hash_combine( hash, zone->GetMinThickness() );
+        boost::hash_combine( hash, zone->GetFillMode() );
+        boost::hash_combine( hash, zone->GetArcSegmentCount() );
+        boost::hash_combine( hash, (int) zone->GetPadConnection() );
+        boost::hash_combine( hash, zone->GetThermalReliefGap() );
+        boost::hash_combine( hash, zone->GetThermalReliefCopperBridge() );
+        boost::hash_combine( hash, zone->GetCornerSmoothingType() );
+        boost::hash_combine( hash, zone->GetCornerRadius() );
+        boost::hash_combine( hash, zone->GetIsKeepout() );
+        boost::hash_combine( hash, zone->GetDoNotAllowCopperPour() );
+
+        state.m_area.Inflate( zone->GetMinThickness() / 2 );
+        break;
+    }
+
+    default:
+        // Tracks and vias: fully described by their shape hash.
+        // Texts: only the bounding box is used
+        break;
+    }
+
+    state.m_hash = hash;
+    aStates[aItem] = state;
+}
+
+
+void ZONE_FILL_TRACKER::snapshot( BOARD* aBoard, STATE_MAP& aStates )
+{
+    aStates.clear();
+
+    for( TRACK* track = aBoard->m_Track;  track;  track = track->Next() )
+        addItem( track, aStates );
+
+    for( MODULE* module = aBoard->m_Modules;  module;  module = module->Next() )
+    {
+        for( D_PAD* pad = module->Pads();  pad;  pad = pad->Next() )
+            addItem( pad, aStates );
+
+        for( BOARD_ITEM* item = module->GraphicalItems();  item;  item = item->Next() )
+        {
+            if( item->Type() == PCB_MODULE_EDGE_T )
+                addItem( item, aStates );
+        }
+    }
+
+    for( BOARD_ITEM* item = aBoard->m_Drawings;  item;  item = item->Next() )
+    {
+        if( item->Type() == PCB_LINE_T || item->Type() == PCB_TEXT_T )
+            addItem( item, aStates );
+    }
+
+    for( int ii = 0; ii < aBoard->GetAreaCount(); ii++ )
+        addItem( aBoard->GetArea( ii ), aStates );
+}
+
+
+int ZONE_FILL_TRACKER::GetDirtyZones( BOARD* aBoard,
+                                      std::vector<ZONE_CONTAINER*>& aZones ) const
+{
+    aZones.clear();
+
+    if( !m_valid )
+    {
+        for( int ii = 0; ii < aBoard->GetAreaCount(); ii++ )
+            aZones.push_back( aBoard->GetArea( ii ) );
+
+        return 0;
+    }
+
+    STATE_MAP current;
+    snapshot( aBoard, current );
+
+    // Items added or modified: both the old and the new areas are dirty
+    std::vector<EDA_RECT> dirty;
+
+    for( STATE_MAP::const_iterator it = current.begin(); it != current.end(); ++it )
+    {
+        STATE_MAP::const_iterator old = m_states.find( it->first );
+
+        if( old == m_states.end() )
+        {
+            dirty.push_back( it->second.m_area );
+        }
+        else if( old->second.m_hash != it->second.m_hash )
+        {
+            dirty.push_back( old->second.m_area );
+            dirty.push_back( it->second.m_area );
+        }
+    }
+
+    // Items removed
+    for( STATE_MAP::const_iterator it = m_states.begin(); it != m_states.end(); ++it )
+    {
+        if( current.find( it->first ) == current.end() )
+            dirty.push_back( it->second.m_area );
+    }
+
+    int biggestClearance = aBoard->GetDesignSettings().GetBiggestClearanceValue();
+
+    for( int ii = 0; ii < aBoard->GetAreaCount(); ii++ )
+    {
+        ZONE_CONTAINER* zone = aBoard->GetArea( ii );
+
+        if( !zone->IsFilled() )
+        {
+            aZones.push_back( zone );
+            continue;
+        }
+
+        // The area searched by the fill for items creating holes in the zone
+        EDA_RECT area = zone->GetBoundingBox();
+        area.Inflate( std::max( biggestClearance, zone->GetClearance() ) +
+                      zone->GetMinThickness() );
+
+        for( unsigned jj = 0; jj < dirty.size(); jj++ )
+        {
+            if( area.Intersects( dirty[jj] ) )
+            {
+                aZones.push_back( zone );
+                break;
+            }
+        }
+    }
+
+    return dirty.size();
+}
+
+
+void ZONE_FILL_TRACKER::Commit( BOARD* aBoard )
+{
+    snapshot( aBoard, m_states );
+    m_valid = true;
+}
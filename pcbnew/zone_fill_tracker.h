@@ -0,0 +1,107 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file zone_fill_tracker.h
+ * @brief Finds the zones which must be refilled after a board modification.
+ */
+
+#ifndef ZONE_FILL_TRACKER_H
+#define ZONE_FILL_TRACKER_H
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include <class_eda_rect.h>
+
+class BOARD;
+class BOARD_ITEM;
+class ZONE_CONTAINER;
+
+
+/**
+ * Class ZONE_FILL_TRACKER
+ * remembers the state of the board items which have an effect on the zone fills
+ * (tracks, vias, pads, copper graphics, board edges and zone outlines) at the time
+ * of the last complete fill.
+ * <p>
+ * Before the next fill, the current board is compared to this state: the bounding
+ * boxes (with clearance) of the items added, removed or modified since then are the
+ * dirty regions, and only the zones intersecting a dirty region need to be refilled.
+ * The other zones keep their current filled areas.
+ * </p>
+ * Items are identified by their address: an item deleted and replaced by another one
+ * at the same address with the same state has no effect on the fills anyway.
+ */
+class ZONE_FILL_TRACKER
+{
+public:
+    ZONE_FILL_TRACKER();
+
+    /**
+     * Function Clear
+     * forgets the recorded state, so the next fill is a full fill.
+     * Must be called when the board is replaced.
+     */
+    void Clear();
+
+    /**
+     * Function GetDirtyZones
+     * collects the zones of aBoard to refill, i.e. the zones not filled, the zones
+     * modified and the zones intersecting a dirty region.  Every zone is collected
+     * if no state was recorded.
+     * @param aBoard is the board to compare to the recorded state.
+     * @param aZones receives the zones to refill, in board order.
+     * @return the number of dirty regions found.
+     */
+    int GetDirtyZones( BOARD* aBoard, std::vector<ZONE_CONTAINER*>& aZones ) const;
+
+    /**
+     * Function Commit
+     * records the current state of aBoard.  To be called once all the zones
+     * returned by GetDirtyZones() have been filled.
+     */
+    void Commit( BOARD* aBoard );
+
+private:
+    ///> State of a board item, as seen by the zone filling algorithm.
+    struct ITEM_STATE
+    {
+        EDA_RECT    m_area;     ///< bounding box, enlarged by the item clearance
+        std::size_t m_hash;     ///< hash of the item parameters used by the zone fill
+    };
+
+    typedef boost::unordered_map<const BOARD_ITEM*, ITEM_STATE> STATE_MAP;
+
+    ///> Computes the state of every item of aBoard used by the zone fill.
+    static void snapshot( BOARD* aBoard, STATE_MAP& aStates );
+
+    ///> Adds the state of aItem to aStates.
+    static void addItem( const BOARD_ITEM* aItem, STATE_MAP& aStates );
+
+    STATE_MAP   m_states;
+    bool        m_valid;        ///< true once a state has been recorded
+};
+
+#endif  // ZONE_FILL_TRACKER_H
@@ -28,6 +28,7 @@
 
 
 #include <algorithm> // sort
+#include <memory>    // auto_ptr
 
 #include <fctsys.h>
 #include <trigo.h>
@@ -54,32 +55,15 @@
  * to add holes for pads and tracks and other items not in net.
  */
 
-bool ZONE_CONTAINER::BuildFilledSolidAreasPolygons( BOARD* aPcb, SHAPE_POLY_SET* aOutlineBuffer )
+CPolyLine* ZONE_CONTAINER::buildSmoothedPoly() const
 {
-    /* convert outlines + holes to outlines without holes (adding extra segments if necessary)
-     * m_Poly data is expected normalized, i.e. NormalizeAreaOutlines was used after building
-     * this zone
-     */
-
-    if( GetNumCorners() <= 2 )  // malformed zone. polygon calculations do not like it ...
-        return 0;
-
-    // Make a smoothed polygon out of the user-drawn polygon if required
-    if( m_smoothedPoly )
-    {
-        delete m_smoothedPoly;
-        m_smoothedPoly = NULL;
-    }
-
     switch( m_cornerSmoothingType )
     {
     case ZONE_SETTINGS::SMOOTHING_CHAMFER:
-        m_smoothedPoly = m_Poly->Chamfer( m_cornerRadius );
-        break;
+        return m_Poly->Chamfer( m_cornerRadius );
 
     case ZONE_SETTINGS::SMOOTHING_FILLET:
-        m_smoothedPoly = m_Poly->Fillet( m_cornerRadius, m_ArcToSegmentsCount );
-        break;
+        return m_Poly->Fillet( m_cornerRadius, m_ArcToSegmentsCount );
 
     default:
         // Acute angles between adjacent edges can create issues in calculations,
@@ -87,39 +71,60 @@ bool ZONE_CONTAINER::BuildFilledSolidAreasPolygons( BOARD* aPcb, SHAPE_POLY_SET*
         // We can avoid issues by creating a very small chamfer which remove acute angles,
         // or left it without chamfer and use only CPOLYGONS_LIST::InflateOutline to create
         // clearance areas
-        m_smoothedPoly = m_Poly->Chamfer( Millimeter2iu( 0.0 ) );
-        break;
+        return m_Poly->Chamfer( Millimeter2iu( 0.0 ) );
     }
+}
+
+
+bool ZONE_CONTAINER::BuildFilledSolidAreasPolygons( BOARD* aPcb, SHAPE_POLY_SET* aOutlineBuffer )
+{
+    /* convert outlines + holes to outlines without holes (adding extra segments if necessary)
+     * m_Poly data is expected normalized, i.e. NormalizeAreaOutlines was used after building
+     * this zone
+     */
+
+    if( GetNumCorners() <= 2 )  // malformed zone. polygon calculations do not like it ...
+        return 0;
 
     if( aOutlineBuffer )
-        aOutlineBuffer->Append( ConvertPolyListToPolySet( m_smoothedPoly->m_CornersList ) );
+    {
+        // Only the outline is wanted, usually by the fill of another zone.  Do not
+        // touch m_smoothedPoly: this zone can be filled at the same time by another
+        // thread (see PCB_EDIT_FRAME::Fill_All_Zones).
+        std::auto_ptr<CPolyLine> smoothedPoly( buildSmoothedPoly() );
+
+        aOutlineBuffer->Append( ConvertPolyListToPolySet( smoothedPoly->m_CornersList ) );
+
+        return true;
+    }
+
+    // Make a smoothed polygon out of the user-drawn polygon if required
+    delete m_smoothedPoly;
+    m_smoothedPoly = buildSmoothedPoly();
 
     /* For copper layers, we now must add holes in the Polygon list.
      * holes are pads and tracks with their clearance area
      * for non copper layers just recalculate the m_FilledPolysList
      * with m_ZoneMinThickness taken in account
      */
+    m_FilledPolysList.RemoveAllContours();
+
+    if( IsOnCopperLayer() )
+    {
+        AddClearanceAreasPolygonsToPolysList_NG( aPcb );
+    }
     else
     {
-        m_FilledPolysList.RemoveAllContours();
-
-        if( IsOnCopperLayer() )
-        {
-            AddClearanceAreasPolygonsToPolysList_NG( aPcb );
-        }
-        else
-        {
-            int margin = m_ZoneMinThickness / 2;
-            m_FilledPolysList = ConvertPolyListToPolySet( m_smoothedPoly->m_CornersList );
-            m_FilledPolysList.Inflate( -margin, 16 );
-            m_FilledPolysList.Fracture( SHAPE_POLY_SET::PM_FAST );
-        }
+        int margin = m_ZoneMinThickness / 2;
+        m_FilledPolysList = ConvertPolyListToPolySet( m_smoothedPoly->m_CornersList );
+        m_FilledPolysList.Inflate( -margin, 16 );
+        m_FilledPolysList.Fracture( SHAPE_POLY_SET::PM_FAST );
+    }
 
-        if( m_FillMode )   // if fill mode uses segments, create them:
-            FillZoneAreasWithSegments();
+    if( m_FillMode )   // if fill mode uses segments, create them:
+        FillZoneAreasWithSegments();
 
-        m_IsFilled = true;
-    }
+    m_IsFilled = true;
 
     return true;
 }
@@ -28,6 +28,8 @@
 
 #include <wx/progdlg.h>
 
+#include <boost/bind.hpp>
+
 #include <fctsys.h>
 #include <pgm_base.h>
 #include <class_drawpanel.h>
@@ -35,6 +37,8 @@
 #include <ratsnest_data.h>
 #include <wxPcbStruct.h>
 #include <macros.h>
+#include <thread_pool.h>
+#include <profile.h>
 
 #include <class_board.h>
 #include <class_track.h>
@@ -42,10 +46,24 @@
 
 #include <pcbnew.h>
 #include <zones.h>
+#include <zone_fill_tracker.h>
+#include <clearance_poly_cache.h>
 
 #define FORMAT_STRING _( "Filling zone %d out of %d (net %s)..." )
 
 
+/**
+ * Function fillZoneCopy
+ * fills aZone, a copy of a board zone living outside of the board, and sets aDone
+ * when finished.  Runs on a worker thread of Fill_All_Zones(): aBoard is only read.
+ */
+static void fillZoneCopy( ZONE_CONTAINER* aZone, BOARD* aBoard, char* aDone )
+{
+    aZone->BuildFilledSolidAreasPolygons( aBoard );
+    *aDone = true;
+}
+
+
 /**
  * Function Delete_OldZone_Fill (obsolete)
  * Used for compatibility with old boards
@@ -148,28 +166,158 @@ int PCB_EDIT_FRAME::Fill_All_Zones( wxWindow * aActiveWindow, bool aVerbose )
     // Remove segment zones
     GetBoard()->m_Zone.DeleteAll();
 
-    int ii;
+    // Only refill the zones affected by the changes made since the last complete fill
+    std::vector<ZONE_CONTAINER*> zones;
+
+    if( g_IncrementalZoneFilling )
+    {
+        m_zoneFillTracker->GetDirtyZones( GetBoard(), zones );
+    }
+    else
+    {
+        for( int ii = 0; ii < areaCount; ii++ )
+            zones.push_back( GetBoard()->GetArea( ii ) );
+    }
+
+    // Zones filled with segments can show message boxes, and the zone dump file is
+    // shared by all zones: these zones are filled one by one on the main thread.
+    std::vector<ZONE_CONTAINER*> serialZones;
+    std::vector<ZONE_CONTAINER*> parallelZones;
 
-    for( ii = 0; ii < areaCount; ii++ )
+    for( unsigned ii = 0; ii < zones.size(); ii++ )
     {
-        ZONE_CONTAINER* zoneContainer = GetBoard()->GetArea( ii );
+        ZONE_CONTAINER* zoneContainer = zones[ii];
+
         if( zoneContainer->GetIsKeepout() )
             continue;
 
+        if( g_ParallelZoneFilling && !g_DumpZonesWhenFilling
+            && zoneContainer->GetFillMode() == 0 )
+            parallelZones.push_back( zoneContainer );
+        else
+            serialZones.push_back( zoneContainer );
+    }
+
+    // Forget the polygons of the items deleted since the last fill
+    GetBoard()->GetClearancePolyCache()->Prune( GetBoard() );
+
+#ifdef PROFILE
+    prof_counter fillTime;
+    prof_start( &fillTime );
+    GetBoard()->GetClearancePolyCache()->ResetCounters();
+#endif /* PROFILE */
+
+    int  ii = 0;
+    bool aborted = false;
+
+    if( !parallelZones.empty() )
+    {
+        // Each zone is filled as a copy, so the board (including the zones currently
+        // displayed) is never modified by the worker threads, which only read it.
+        std::vector<ZONE_CONTAINER*> copies;
+        std::vector<char>            filled( parallelZones.size(), false );
+
+        for( unsigned jj = 0; jj < parallelZones.size(); jj++ )
+        {
+            ZONE_CONTAINER* copy = new ZONE_CONTAINER( *parallelZones[jj] );
+
+            copy->ClearFilledPolysList();
+            copy->UnFill();
+            copies.push_back( copy );
+        }
+
+        // D_PAD::GetBoundingRadius() caches its value: compute it here, before
+        // the worker threads use it.
+        std::vector<D_PAD*> pads = GetBoard()->GetPads();
+
+        for( unsigned jj = 0; jj < pads.size(); jj++ )
+            pads[jj]->GetBoundingRadius();
+
+        int          done = 0;
+        THREAD_POOL  pool;
+
+        for( unsigned jj = 0; jj < copies.size(); jj++ )
+            pool.Submit( boost::bind( fillZoneCopy, copies[jj], GetBoard(), &filled[jj] ) );
+
+        while( !pool.Wait( 100 ) )
+        {
+            if( !progressDialog || aborted )
+                continue;
+
+            done = pool.GetFinishedCount();
+            msg.Printf( _( "Filling zones: %d out of %d done..." ),
+                        done, (int) parallelZones.size() );
+
+            if( !progressDialog->Update( done, msg ) )
+            {
+                // Aborted by user: zones not started yet keep their current filling
+                aborted = true;
+                pool.CancelPending();
+            }
+        }
+
+        // Commit the results on the main thread
+        done = pool.GetFinishedCount();
+
+        for( unsigned jj = 0; jj < copies.size(); jj++ )
+        {
+            ZONE_CONTAINER* zoneContainer = parallelZones[jj];
+
+            if( filled[jj] )
+            {
+                zoneContainer->SwapFilledAreas( *copies[jj] );
+                zoneContainer->ViewUpdate( KIGFX::VIEW_ITEM::ALL );
+                GetBoard()->GetRatsnest()->Update( zoneContainer );
+            }
+
+            delete copies[jj];
+        }
+
+        if( done )
+            OnModify();
+
+        ii = done;
+    }
+
+    for( unsigned jj = 0; jj < serialZones.size() && !aborted; jj++ )
+    {
+        ZONE_CONTAINER* zoneContainer = serialZones[jj];
+
         msg.Printf( FORMAT_STRING, ii + 1, areaCount, GetChars( zoneContainer->GetNetname() ) );
 
         if( progressDialog )
         {
             if( !progressDialog->Update( ii+1, msg ) )
+            {
+                aborted = true;
                 break;  // Aborted by user
+            }
         }
 
         errorLevel = Fill_Zone( zoneContainer );
+        ii++;
 
         if( errorLevel && !aVerbose )
+        {
+            aborted = true;
             break;
+        }
     }
 
+    // Record the board state only if every dirty zone was refilled
+    if( !aborted )
+        m_zoneFillTracker->Commit( GetBoard() );
+
+#ifdef PROFILE
+    prof_end( &fillTime );
+    wxLogDebug( wxT( "Fill_All_Zones: %d zones of %d filled (%d in parallel), %.1f ms" ),
+                (int) ( serialZones.size() + parallelZones.size() ), areaCount,
+                (int) parallelZones.size(), fillTime.msecs() );
+    wxLogDebug( wxT( "Fill_All_Zones: clearance polygons: %d cache hits, %d built" ),
+                GetBoard()->GetClearancePolyCache()->GetHitCount(),
+                GetBoard()->GetClearancePolyCache()->GetMissCount() );
+#endif /* PROFILE */
+
     if( progressDialog )
     {
         progressDialog->Update( ii+2, _( "Updating ratsnest..." ) );
@@ -64,6 +64,7 @@
 #include <class_pcb_text.h>
 #include <class_zone.h>
 #include <project.h>
+#include <clearance_poly_cache.h>
 
 #include <pcbnew.h>
 #include <zones.h>
@@ -148,6 +149,10 @@ void ZONE_CONTAINER::buildFeatureHoleList( BOARD* aPcb, SHAPE_POLY_SET& aFeature
     MODULE dummymodule( aPcb );    // Creates a dummy parent
     D_PAD dummypad( &dummymodule );
 
+    // Pads and tracks are usually converted once for each zone they overlap: keep
+    // their polygons in the board cache (the dummy pad is never cached).
+    CLEARANCE_POLY_CACHE* polyCache = aPcb->GetClearancePolyCache();
+
     for( MODULE* module = aPcb->m_Modules;  module;  module = module->Next() )
     {
         D_PAD* nextpad;
@@ -188,10 +193,17 @@ void ZONE_CONTAINER::buildFeatureHoleList( BOARD* aPcb, SHAPE_POLY_SET& aFeature
                 if( item_boundingbox.Intersects( zone_boundingbox ) )
                 {
                     int clearance = std::max( zone_clearance, item_clearance );
-                    pad->TransformShapeWithClearanceToPolygon( aFeatures,
-                                                               clearance,
-                                                               segsPerCircle,
-                                                               correctionFactor );
+
+                    if( pad == &dummypad )
+                        pad->TransformShapeWithClearanceToPolygon( aFeatures,
+                                                                   clearance,
+                                                                   segsPerCircle,
+                                                                   correctionFactor );
+                    else
+                        polyCache->TransformShapeWithClearanceToPolygon( pad, aFeatures,
+                                                                         clearance,
+                                                                         segsPerCircle,
+                                                                         correctionFactor );
                 }
 
                 continue;
@@ -206,10 +218,16 @@ void ZONE_CONTAINER::buildFeatureHoleList( BOARD* aPcb, SHAPE_POLY_SET& aFeature
 
                 if( item_boundingbox.Intersects( zone_boundingbox ) )
                 {
-                    pad->TransformShapeWithClearanceToPolygon( aFeatures,
-                                                               gap,
-                                                               segsPerCircle,
-                                                               correctionFactor );
+                    if( pad == &dummypad )
+                        pad->TransformShapeWithClearanceToPolygon( aFeatures,
+                                                                   gap,
+                                                                   segsPerCircle,
+                                                                   correctionFactor );
+                    else
+                        polyCache->TransformShapeWithClearanceToPolygon( pad, aFeatures,
+                                                                         gap,
+                                                                         segsPerCircle,
+                                                                         correctionFactor );
                 }
             }
         }
@@ -232,10 +250,10 @@ void ZONE_CONTAINER::buildFeatureHoleList( BOARD* aPcb, SHAPE_POLY_SET& aFeature
         if( item_boundingbox.Intersects( zone_boundingbox ) )
         {
             int clearance = std::max( zone_clearance, item_clearance );
-            track->TransformShapeWithClearanceToPolygon( aFeatures,
-                                                         clearance,
-                                                         segsPerCircle,
-                                                         correctionFactor );
+            polyCache->TransformShapeWithClearanceToPolygon( track, aFeatures,
+                                                             clearance,
+                                                             segsPerCircle,
+                                                             correctionFactor );
         }
     }
 
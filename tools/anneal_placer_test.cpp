@@ -0,0 +1,180 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file anneal_placer_test.cpp
+ * @brief Checks that ANNEAL_PLACER finds the same placement whatever the number of threads.
+ *
+ * The footprints are rectangles with 2 to 8 pins, stacked in a corner of the area, and
+ * connected by random nets of 2 to 6 pins. The placement is annealed with 1 thread, then
+ * with each of the other thread counts, and the positions, orientations and costs must be
+ * identical. The exit code is the number of thread counts giving another placement.
+ *
+ * usage: anneal_placer_test [footprint_count [max_threads]]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <thread_pool.h>
+#include <anneal_placer.h>
+
+
+static const int    areaSize = 100000000;     // 100 mm
+static const int    grid = 250000;
+
+
+static int randomCoord( int aMax )
+{
+    return (int) ( (double) rand() / RAND_MAX * aMax );
+}
+
+
+static ANNEAL_PLACER::FOOTPRINT randomFootprint()
+{
+    ANNEAL_PLACER::FOOTPRINT fp;
+    ANNEAL_PLACER::FOOTPRINT::SHAPE shape, rotated;
+
+    VECTOR2I halfSize( 1000000 + randomCoord( 4000000 ), 500000 + randomCoord( 2000000 ) );
+    int pinCount = 2 + rand() % 7;
+
+    shape.m_box = BOX2I( -halfSize, halfSize * 2 );
+    rotated.m_box = BOX2I( VECTOR2I( -halfSize.y, -halfSize.x ),
+                           VECTOR2I( halfSize.y, halfSize.x ) * 2 );
+
+    for( int i = 0; i < pinCount; i++ )
+    {
+        VECTOR2I pin( randomCoord( halfSize.x * 2 ) - halfSize.x,
+                      randomCoord( halfSize.y * 2 ) - halfSize.y );
+
+        shape.m_pins.push_back( pin );
+        rotated.m_pins.push_back( VECTOR2I( pin.y, -pin.x ) );
+    }
+
+    fp.m_position = VECTOR2I( randomCoord( areaSize / 4 ), randomCoord( areaSize / 4 ) );
+    fp.m_locked = rand() % 10 == 0;
+    fp.m_shapes.push_back( shape );
+    fp.m_shapes.push_back( rotated );
+
+    return fp;
+}
+
+
+static ANNEAL_PLACER* createPlacer( const std::vector<ANNEAL_PLACER::FOOTPRINT>& aFootprints,
+                                    const std::vector<ANNEAL_PLACER::NET>& aNets, int aThreads )
+{
+    ANNEAL_PLACER::PARAMS params;
+
+    params.m_area = BOX2I( VECTOR2I( 0, 0 ), VECTOR2I( areaSize, areaSize ) );
+    params.m_grid = grid;
+    params.m_clearance = grid;
+    params.m_threadCount = aThreads;
+
+    ANNEAL_PLACER* placer = new ANNEAL_PLACER( params );
+
+    for( unsigned i = 0; i < aFootprints.size(); i++ )
+        placer->AddFootprint( aFootprints[i] );
+
+    for( unsigned i = 0; i < aNets.size(); i++ )
+        placer->AddNet( aNets[i] );
+
+    return placer;
+}
+
+
+int main( int argc, char** argv )
+{
+    int footprintCount = argc > 1 ? atoi( argv[1] ) : 60;
+    int maxThreads = argc > 2 ? atoi( argv[2] )
+                              : std::max( 4, THREAD_POOL::DefaultThreadCount() );
+
+    srand( 1 );
+
+    std::vector<ANNEAL_PLACER::FOOTPRINT> footprints;
+    std::vector<ANNEAL_PLACER::NET> nets;
+
+    for( int i = 0; i < footprintCount; i++ )
+        footprints.push_back( randomFootprint() );
+
+    for( int i = 0; i < footprintCount * 2; i++ )
+    {
+        ANNEAL_PLACER::NET net;
+        int pinCount = 2 + rand() % 5;
+
+        for( int p = 0; p < pinCount; p++ )
+        {
+            int fp = rand() % footprintCount;
+            int pin = rand() % footprints[fp].m_shapes[0].m_pins.size();
+
+            net.push_back( ANNEAL_PLACER::PIN( fp, pin ) );
+        }
+
+        nets.push_back( net );
+    }
+
+    ANNEAL_PLACER* reference = createPlacer( footprints, nets, 1 );
+
+    reference->Run();
+
+    const ANNEAL_PLACER::STATS& refStats = reference->Stats();
+
+    printf( "%d footprints, %u nets, %d chains\n", footprintCount, (unsigned) nets.size(),
+            refStats.m_chains );
+    printf( "threads %2d: cost %.6g -> %.6g, best chain %d, %10.1f ms\n", 1,
+            refStats.m_initialCost, refStats.m_finalCost, refStats.m_bestChain,
+            refStats.m_msecs );
+
+    int failures = 0;
+
+    for( int threads = 2; threads <= maxThreads; threads++ )
+    {
+        ANNEAL_PLACER* placer = createPlacer( footprints, nets, threads );
+
+        placer->Run();
+
+        const ANNEAL_PLACER::STATS& stats = placer->Stats();
+        bool same = stats.m_finalCost == refStats.m_finalCost &&
+                    stats.m_bestChain == refStats.m_bestChain;
+
+        for( int i = 0; i < footprintCount && same; i++ )
+        {
+            same = placer->Footprint( i ).m_position == reference->Footprint( i ).m_position &&
+                   placer->Footprint( i ).m_orientation == reference->Footprint( i ).m_orientation;
+        }
+
+        printf( "threads %2d: cost %.6g -> %.6g, best chain %d, %10.1f ms %s\n", threads,
+                stats.m_initialCost, stats.m_finalCost, stats.m_bestChain, stats.m_msecs,
+                same ? "OK" : "DIFFERENT PLACEMENT" );
+
+        if( !same )
+            failures++;
+
+        delete placer;
+    }
+
+    delete reference;
+
+    return failures;
+}
@@ -0,0 +1,441 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file connectivity_bench.cpp
+ * @brief Runs the connectivity calculation of pcbnew (the CONNECTIONS class, as used by
+ * PCB_BASE_FRAME::TestConnections()) on a synthetic board, and checks the clusters built by
+ * CONNECTIONS::Propagate_SubNets() against the former propagation, which merged subnets by
+ * renumbering the track and pad lists.
+ *
+ * The board is made of real tracks and pads.  Each net is a chain of tracks, stored in a
+ * random order in the track list (like tracks added and deleted by the user), with a pad
+ * every few tracks.  Some tracks are missing, so a net can have several clusters.  Some pads
+ * are connected only through other pads they overlap, and some overlapping pads are not
+ * connected to any track.
+ *
+ * usage: connectivity_bench [track_count [tracks_per_net]]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <wx/init.h>
+
+#include <fctsys.h>
+#include <profile.h>
+#include <convert_to_biu.h>
+#include <class_board.h>
+#include <class_module.h>
+#include <class_pad.h>
+#include <class_track.h>
+#include <class_netinfo.h>
+
+#include <connect.h>
+
+
+static const int TRACK_LENGTH = Millimeter2iu( 2.0 );
+static const int TRACK_WIDTH  = Millimeter2iu( 0.25 );
+static const int PAD_SIZE     = Millimeter2iu( 0.6 );
+static const int NET_PITCH    = Millimeter2iu( 5.0 );
+
+// Pads overlapping each other: the center of each one is inside the previous one
+static const int PAD_OVERLAP  = PAD_SIZE / 3;
+
+
+static D_PAD* addPad( MODULE* aModule, const wxPoint& aPosition, int aNetCode )
+{
+    D_PAD* pad = new D_PAD( aModule );
+
+    pad->SetShape( PAD_CIRCLE );
+    pad->SetAttribute( PAD_STANDARD );
+    pad->SetLayerSet( D_PAD::StandardMask() );
+    pad->SetSize( wxSize( PAD_SIZE, PAD_SIZE ) );
+    pad->SetPosition( aPosition );
+    pad->SetPos0( aPosition );
+    pad->SetNetCode( aNetCode );
+
+    aModule->Pads().PushBack( pad );
+
+    return pad;
+}
+
+
+static void buildNet( BOARD* aBoard, MODULE* aModule, int aNetCode, int aTrackCount )
+{
+    int y = aNetCode * NET_PITCH;
+
+    // Position of each track in the chain, in the track list order
+    std::vector<int> order;
+
+    for( int ii = 0; ii < aTrackCount; ii++ )
+    {
+        // A few missing tracks
+        if( ii == 0 || rand() % 200 )
+            order.push_back( ii );
+    }
+
+    std::random_shuffle( order.begin(), order.end() );
+
+    for( unsigned ii = 0; ii < order.size(); ii++ )
+    {
+        TRACK* track = new TRACK( aBoard );
+
+        track->SetStart( wxPoint( order[ii] * TRACK_LENGTH, y ) );
+        track->SetEnd( wxPoint( ( order[ii] + 1 ) * TRACK_LENGTH, y ) );
+        track->SetWidth( TRACK_WIDTH );
+        track->SetLayer( F_Cu );
+        track->SetNetCode( aNetCode );
+
+        // The nets are built in net code order, so the track list stays sorted by net
+        aBoard->m_Track.PushBack( track );
+    }
+
+    // Pads on the chain, some of them extended by 2 overlapping pads
+    for( int ii = 0; ii <= aTrackCount; ii += 8 )
+    {
+        wxPoint position( ii * TRACK_LENGTH, y );
+
+        addPad( aModule, position, aNetCode );
+
+        if( ii % 32 == 0 )
+        {
+            addPad( aModule, position + wxPoint( 0, PAD_OVERLAP ), aNetCode );
+            addPad( aModule, position + wxPoint( 0, 2 * PAD_OVERLAP ), aNetCode );
+        }
+    }
+
+    // Overlapping pads connected to no track
+    wxPoint position( -4 * TRACK_LENGTH, y );
+
+    addPad( aModule, position, aNetCode );
+    addPad( aModule, position + wxPoint( PAD_OVERLAP, 0 ), aNetCode );
+
+    // An unconnected pad
+    addPad( aModule, position - wxPoint( TRACK_LENGTH, 0 ), aNetCode );
+}
+
+
+// A net: its track range in the track list, and its pads
+struct NET
+{
+    TRACK*              first;
+    TRACK*              last;
+    std::vector<D_PAD*> pads;
+};
+
+
+static std::vector<NET> collectNets( BOARD* aBoard )
+{
+    std::vector<NET> nets( aBoard->GetNetCount() );
+
+    for( unsigned ii = 0; ii < nets.size(); ii++ )
+    {
+        nets[ii].first = NULL;
+        nets[ii].last = NULL;
+        aBoard->GetSortedPadListByXthenYCoord( nets[ii].pads, ii );
+    }
+
+    for( TRACK* track = aBoard->m_Track; track; )
+    {
+        NET& net = nets[track->GetNetCode()];
+
+        net.first = track;
+        net.last = track->GetEndNetCode( track->GetNetCode() );
+        track = net.last->Next();
+    }
+
+    return nets;
+}
+
+
+// The connectivity of pcbnew, as done by PCB_BASE_FRAME::TestConnections()
+static void testConnections( BOARD* aBoard, const std::vector<NET>& aNets )
+{
+    for( unsigned ii = 0; ii < aBoard->GetPadCount(); ii++ )
+        aBoard->GetPad( ii )->SetSubNet( 0 );
+
+    CONNECTIONS connections( aBoard );
+
+    for( unsigned net = 1; net < aNets.size(); net++ )
+        connections.Build_CurrNet_SubNets_Connections( aNets[net].first, aNets[net].last, net );
+}
+
+
+// The former propagation: clusters are merged by renumbering the tracks and pads of the net.
+static void mergePadsSubNets( NET& aNet, int aOldSubNet, int aNewSubNet )
+{
+    if( aOldSubNet == aNewSubNet )
+        return;
+
+    if( ( aOldSubNet > 0 ) && ( aOldSubNet < aNewSubNet ) )
+        std::swap( aOldSubNet, aNewSubNet );
+
+    for( unsigned ii = 0; ii < aNet.pads.size(); ii++ )
+    {
+        if( aNet.pads[ii]->GetSubNet() == aOldSubNet )
+            aNet.pads[ii]->SetSubNet( aNewSubNet );
+    }
+}
+
+
+static void mergeSubNets( NET& aNet, int aOldSubNet, int aNewSubNet )
+{
+    if( aOldSubNet == aNewSubNet )
+        return;
+
+    if( ( aOldSubNet > 0 ) && ( aOldSubNet < aNewSubNet ) )
+        std::swap( aOldSubNet, aNewSubNet );
+
+    for( TRACK* track = aNet.first; track; track = track->Next() )
+    {
+        if( track->GetSubNet() == aOldSubNet )
+        {
+            track->SetSubNet( aNewSubNet );
+
+            for( unsigned ii = 0; ii < track->m_PadsConnected.size(); ii++ )
+            {
+                D_PAD* pad = track->m_PadsConnected[ii];
+
+                if( pad->GetSubNet() == aOldSubNet )
+                    pad->SetSubNet( aNewSubNet );
+            }
+        }
+
+        if( track == aNet.last )
+            break;
+    }
+}
+
+
+static void link( NET& aNet, BOARD_CONNECTED_ITEM* aItem, BOARD_CONNECTED_ITEM* aOther,
+                  int& aSubNetCode )
+{
+    if( aItem->GetSubNet() )
+    {
+        if( aOther->GetSubNet() > 0 )
+            mergeSubNets( aNet, aOther->GetSubNet(), aItem->GetSubNet() );
+        else
+            aOther->SetSubNet( aItem->GetSubNet() );
+    }
+    else
+    {
+        if( aOther->GetSubNet() > 0 )
+        {
+            aItem->SetSubNet( aOther->GetSubNet() );
+        }
+        else
+        {
+            aItem->SetSubNet( ++aSubNetCode );
+            aOther->SetSubNet( aItem->GetSubNet() );
+        }
+    }
+}
+
+
+static void propagateRenumbering( NET& aNet )
+{
+    for( TRACK* track = aNet.first; track; track = track->Next() )
+    {
+        track->SetSubNet( 0 );
+
+        if( track == aNet.last )
+            break;
+    }
+
+    for( unsigned ii = 0; ii < aNet.pads.size(); ii++ )
+        aNet.pads[ii]->SetSubNet( 0 );
+
+    int subNetCode = 1;
+
+    if( aNet.first )
+        aNet.first->SetSubNet( subNetCode );
+
+    for( TRACK* track = aNet.first; track; track = track->Next() )
+    {
+        for( unsigned ii = 0; ii < track->m_PadsConnected.size(); ii++ )
+            link( aNet, track, track->m_PadsConnected[ii], subNetCode );
+
+        for( unsigned ii = 0; ii < track->m_TracksConnected.size(); ii++ )
+            link( aNet, track, track->m_TracksConnected[ii], subNetCode );
+
+        if( track == aNet.last )
+            break;
+    }
+
+    for( unsigned ii = 0; ii < aNet.pads.size(); ii++ )
+    {
+        D_PAD* pad = aNet.pads[ii];
+
+        for( unsigned jj = 0; jj < pad->m_PadsConnected.size(); jj++ )
+        {
+            D_PAD* other = pad->m_PadsConnected[jj];
+
+            if( pad->GetSubNet() && other->GetSubNet() > 0 )
+            {
+                int subnet1 = other->GetSubNet();
+                int subnet2 = pad->GetSubNet();
+
+                mergePadsSubNets( aNet, subnet1, subnet2 );
+                mergeSubNets( aNet, subnet1, subnet2 );
+            }
+            else
+            {
+                link( aNet, pad, other, subNetCode );
+            }
+        }
+    }
+}
+
+
+// Returns the subnets of the tracks and pads of a net, renumbered in the item order,
+// to compare the clusters
+static std::vector<int> canonicalSubnets( const NET& aNet )
+{
+    std::vector<BOARD_CONNECTED_ITEM*> items;
+
+    for( TRACK* track = aNet.first; track; track = track->Next() )
+    {
+        items.push_back( track );
+
+        if( track == aNet.last )
+            break;
+    }
+
+    items.insert( items.end(), aNet.pads.begin(), aNet.pads.end() );
+
+    std::vector<int> result( items.size(), 0 );
+    std::vector<std::pair<int, int> > codes;     // old code, new code
+
+    for( unsigned ii = 0; ii < items.size(); ii++ )
+    {
+        int subnet = items[ii]->GetSubNet();
+
+        if( subnet == 0 )
+            continue;
+
+        unsigned jj;
+
+        for( jj = 0; jj < codes.size(); jj++ )
+        {
+            if( codes[jj].first == subnet )
+                break;
+        }
+
+        if( jj == codes.size() )
+            codes.push_back( std::make_pair( subnet, codes.size() + 1 ) );
+
+        result[ii] = codes[jj].second;
+    }
+
+    return result;
+}
+
+
+int main( int argc, char** argv )
+{
+    int trackCount = argc > 1 ? atoi( argv[1] ) : 100000;
+    int tracksPerNet = argc > 2 ? atoi( argv[2] ) : 2000;
+
+    if( trackCount <= 0 || tracksPerNet <= 0 )
+    {
+        fprintf( stderr, "usage: %s [track_count [tracks_per_net]]\n", argv[0] );
+        return 1;
+    }
+
+    wxInitializer initializer;
+
+    if( !initializer.IsOk() )
+    {
+        fprintf( stderr, "Failed to initialize wxWidgets\n" );
+        return 1;
+    }
+
+    srand( 1 );
+
+    BOARD*  board = new BOARD;
+    MODULE* module = new MODULE( board );
+    int     netCount = ( trackCount + tracksPerNet - 1 ) / tracksPerNet;
+
+    board->Add( module );
+
+    for( int ii = 1; ii <= netCount; ii++ )
+    {
+        board->AppendNet( new NETINFO_ITEM( board, wxString::Format( wxT( "N%d" ), ii ), ii ) );
+        buildNet( board, module, ii,
+                  std::min( tracksPerNet, trackCount - ( ii - 1 ) * tracksPerNet ) );
+    }
+
+    board->BuildListOfNets();
+
+    std::vector<NET> nets = collectNets( board );
+
+    printf( "%u tracks, %u pads, %d nets\n", board->m_Track.GetCount(), board->GetPadCount(),
+            netCount );
+
+    prof_counter connectivity, renumbering;
+
+    prof_start( &connectivity );
+    testConnections( board, nets );
+    prof_end( &connectivity );
+
+    std::vector<std::vector<int> > expected( nets.size() );
+
+    for( unsigned ii = 1; ii < nets.size(); ii++ )
+        expected[ii] = canonicalSubnets( nets[ii] );
+
+    // The former propagation, using the connections found by CONNECTIONS
+    prof_start( &renumbering );
+
+    for( unsigned ii = 1; ii < nets.size(); ii++ )
+        propagateRenumbering( nets[ii] );
+
+    prof_end( &renumbering );
+
+    int mismatches = 0;
+    int clusters = 0;
+
+    for( unsigned ii = 1; ii < nets.size(); ii++ )
+    {
+        std::vector<int> subnets = canonicalSubnets( nets[ii] );
+
+        if( subnets != expected[ii] )
+            mismatches++;
+
+        if( !subnets.empty() )
+            clusters += *std::max_element( subnets.begin(), subnets.end() );
+    }
+
+    printf( "connectivity (CONNECTIONS, all nets): %.1f ms, %d clusters\n",
+            connectivity.msecs(), clusters );
+    printf( "former subnet propagation alone:      %.1f ms\n", renumbering.msecs() );
+
+    if( mismatches )
+        printf( "%d nets with different clusters\n", mismatches );
+
+    delete board;
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file drc_bench.cpp
+ * @brief Loads a board without any window and measures the track and via clearance test
+ * of the DRC: the full scan the DRC used to do, then the spatial index on a single thread
+ * and on several threads.  The three runs must find the same errors.
+ *
+ * It also measures the interactive test (DRC::DrcBlind(), called while tracks are edited)
+ * of each track of the board against the whole board.
+ *
+ * usage: drc_bench board.kicad_pcb [thread_count]
+ *
+ * The thread count defaults to the number of hardware threads.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <wx/init.h>
+
+#include <fctsys.h>
+#include <profile.h>
+#include <thread_pool.h>
+#include <io_mgr.h>
+#include <class_board.h>
+#include <class_track.h>
+#include <class_marker_pcb.h>
+
+#include <drc_stuff.h>
+
+
+struct RUN
+{
+    double      msecs;
+    long long   pairs;
+    int         errors;
+    long long   checksum;   // of the error codes and positions, in track list order
+};
+
+
+static RUN testTracks( BOARD* aBoard, int aThreads, bool aFullScan )
+{
+    DRC drc( aBoard );
+    std::vector<MARKER_PCB*> markers;
+    prof_counter counter;
+    RUN run;
+
+    prof_start( &counter );
+    run.pairs = drc.TestTracks( markers, aThreads, aFullScan );
+    prof_end( &counter );
+
+    run.msecs = counter.msecs();
+    run.errors = 0;
+    run.checksum = 0;
+
+    for( unsigned ii = 0; ii < markers.size(); ++ii )
+    {
+        MARKER_PCB* marker = markers[ii];
+
+        if( !marker )
+            continue;
+
+        run.errors++;
+        run.checksum = run.checksum * 31 + ii;
+        run.checksum = run.checksum * 31 + marker->GetReporter().GetErrorCode();
+        run.checksum = run.checksum * 31 + marker->GetPos().x;
+        run.checksum = run.checksum * 31 + marker->GetPos().y;
+
+        delete marker;
+    }
+
+    return run;
+}
+
+
+static void report( const char* aName, const RUN& aRun, const RUN& aReference )
+{
+    printf( "%-22s %10.3f ms %12lld pairs %6d errors %8.2fx %s\n", aName, aRun.msecs, aRun.pairs,
+            aRun.errors, aReference.msecs / aRun.msecs,
+            aRun.errors == aReference.errors && aRun.checksum == aReference.checksum ?
+            "" : "MISMATCH" );
+}
+
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: %s board.kicad_pcb [thread_count]\n", argv[0] );
+        return 1;
+    }
+
+    int threads = argc > 2 ? atoi( argv[2] ) : THREAD_POOL::DefaultThreadCount();
+
+    wxInitializer initializer;
+
+    if( !initializer.IsOk() )
+    {
+        fprintf( stderr, "cannot initialize wxWidgets\n" );
+        return 1;
+    }
+
+    BOARD* board = NULL;
+
+    try
+    {
+        board = IO_MGR::Load( IO_MGR::KICAD, wxString::FromUTF8( argv[1] ) );
+    }
+    catch( const IO_ERROR& ioe )
+    {
+        fprintf( stderr, "%s\n", (const char*) ioe.errorText.mb_str() );
+        return 1;
+    }
+
+    // the pad list of the board, used by the DRC
+    board->BuildListOfNets();
+
+    int trackCount = 0;
+
+    for( TRACK* track = board->m_Track; track; track = track->Next() )
+        trackCount++;
+
+    printf( "%d tracks and vias, %u pads\n", trackCount, board->GetPadCount() );
+
+    RUN reference = testTracks( board, 1, true );
+    report( "full scan, 1 thread", reference, reference );
+
+    char name[32];
+    RUN run = testTracks( board, 1, false );
+    report( "indexed, 1 thread", run, reference );
+
+    run = testTracks( board, threads, false );
+    sprintf( name, "indexed, %d threads", threads );
+    report( name, run, reference );
+
+    // The interactive test of each track against the whole board
+    DRC drc( board );
+    prof_counter counter;
+    int errors = 0;
+
+    prof_start( &counter );
+
+    for( TRACK* track = board->m_Track; track; track = track->Next() )
+        errors += drc.DrcBlind( track, board->m_Track ) == BAD_DRC;
+
+    prof_end( &counter );
+
+    printf( "interactive            %10.3f ms %10.1f us/call %6d errors\n", counter.msecs(),
+            counter.msecs() * 1000.0 / std::max( trackCount, 1 ), errors );
+
+    delete board;
+
+    return 0;
+}
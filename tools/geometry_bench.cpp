@@ -0,0 +1,277 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file geometry_bench.cpp
+ * @brief Microbenchmarks of the segment collision and distance kernels: the scalar loops
+ * over the segments of a line chain, and SEG_ARRAY with each of the available kernels.
+ *
+ * The line chains look like tracks: random walks of horizontal, vertical and diagonal
+ * segments. The tested segments are short segments spread over the same area, and the
+ * tested chains are 8 segment walks starting near the chains. Each benchmark also checks
+ * that the kernels give the same results as the scalar loops.
+ *
+ * usage: geometry_bench [segments_per_chain [chain_count]]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <profile.h>
+#include <math/box2.h>
+#include <geometry/seg_array.h>
+#include <geometry/shape_line_chain.h>
+
+
+static const int    areaSize = 100000000;     // 100 mm
+static const int    clearance = 200000;
+static const int    queriesPerChain = 200;
+
+
+static int randomCoord( int aMax )
+{
+    return (int) ( (double) rand() / RAND_MAX * aMax );
+}
+
+
+static VECTOR2I randomPoint()
+{
+    return VECTOR2I( randomCoord( areaSize ), randomCoord( areaSize ) );
+}
+
+
+static VECTOR2I randomPointNear( const SHAPE_LINE_CHAIN& aChain )
+{
+    return aChain.CPoint( rand() % aChain.PointCount() ) +
+           VECTOR2I( randomCoord( 1000000 ) - 500000, randomCoord( 1000000 ) - 500000 );
+}
+
+
+static SHAPE_LINE_CHAIN randomChain( int aSegmentCount, const VECTOR2I& aStart )
+{
+    static const int dirs[8][2] =
+    {
+        { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+    };
+
+    SHAPE_LINE_CHAIN chain;
+    VECTOR2I p( aStart );
+
+    chain.Append( p );
+
+    for( int i = 0; i < aSegmentCount; i++ )
+    {
+        int dir = rand() % 8;
+        int length = 250000 + randomCoord( 2000000 );
+
+        p += VECTOR2I( dirs[dir][0] * length, dirs[dir][1] * length );
+        chain.Append( p );
+    }
+
+    return chain;
+}
+
+
+static SEG randomSeg( const SHAPE_LINE_CHAIN& aNear )
+{
+    // half of the segments close to the chain, to have some collisions
+    VECTOR2I p = rand() % 2 ? randomPointNear( aNear ) : randomPoint();
+
+    return SEG( p, p + VECTOR2I( randomCoord( 2000000 ) - 1000000, randomCoord( 2000000 ) - 1000000 ) );
+}
+
+
+// The scalar loop of SHAPE_LINE_CHAIN::Collide( const SEG& ), for reference
+static bool scalarCollide( const SHAPE_LINE_CHAIN& aChain, const SEG& aSeg, int aClearance )
+{
+    BOX2I box_a( aSeg.A, aSeg.B - aSeg.A );
+    BOX2I::ecoord_type dist_sq = (BOX2I::ecoord_type) aClearance * aClearance;
+
+    for( int i = 0; i < aChain.SegmentCount(); i++ )
+    {
+        const SEG& s = aChain.CSegment( i );
+        BOX2I box_b( s.A, s.B - s.A );
+
+        if( box_a.SquaredDistance( box_b ) < dist_sq && s.Collide( aSeg, aClearance ) )
+            return true;
+    }
+
+    return false;
+}
+
+
+static bool scalarCollide( const SHAPE_LINE_CHAIN& aChain, const SHAPE_LINE_CHAIN& aOther,
+                           int aClearance )
+{
+    for( int i = 0; i < aOther.SegmentCount(); i++ )
+        if( scalarCollide( aChain, aOther.CSegment( i ), aClearance ) )
+            return true;
+
+    return false;
+}
+
+
+static SEG_ARRAY::ecoord scalarDistance( const SHAPE_LINE_CHAIN& aChain, const SEG& aSeg )
+{
+    SEG_ARRAY::ecoord d = VECTOR2I::ECOORD_MAX;
+
+    for( int i = 0; i < aChain.SegmentCount(); i++ )
+        d = std::min( d, aChain.CSegment( i ).SquaredDistance( aSeg ) );
+
+    return d;
+}
+
+
+struct RESULT
+{
+    double msecs;
+    long long checksum;
+};
+
+
+static void report( const char* aName, const char* aKernel, const RESULT& aResult,
+                    const RESULT& aReference, int aCount )
+{
+    printf( "%-14s %-8s %10.3f ms %10.1f ns/test %8.2fx %s\n", aName, aKernel, aResult.msecs,
+            aResult.msecs * 1e6 / aCount, aReference.msecs / aResult.msecs,
+            aResult.checksum == aReference.checksum ? "" : "MISMATCH" );
+}
+
+
+int main( int argc, char** argv )
+{
+    int segmentCount = argc > 1 ? atoi( argv[1] ) : 64;
+    int chainCount = argc > 2 ? atoi( argv[2] ) : 1000;
+
+    srand( 1 );
+
+    std::vector<SHAPE_LINE_CHAIN> chains, others;
+    std::vector<SEG_ARRAY> arrays;
+    std::vector<SEG> queries;
+
+    for( int i = 0; i < chainCount; i++ )
+    {
+        chains.push_back( randomChain( segmentCount, randomPoint() ) );
+        arrays.push_back( SEG_ARRAY( chains.back() ) );
+        others.push_back( randomChain( 8, randomPointNear( chains.back() ) ) );
+
+        for( int q = 0; q < queriesPerChain; q++ )
+            queries.push_back( randomSeg( chains.back() ) );
+    }
+
+    int queryCount = chainCount * queriesPerChain;
+    prof_counter counter;
+
+    printf( "%d chains of %d segments, %d queries, default kernel: %s\n", chainCount,
+            segmentCount, queryCount, SEG_ARRAY::KernelName( SEG_ARRAY::Kernel() ) );
+
+    RESULT collideRef, chainRef, distanceRef, result;
+
+    // collisions: scalar loop
+    collideRef.checksum = 0;
+    prof_start( &counter );
+
+    for( int i = 0; i < queryCount; i++ )
+        collideRef.checksum += scalarCollide( chains[i / queriesPerChain], queries[i], clearance );
+
+    prof_end( &counter );
+    collideRef.msecs = counter.msecs();
+    report( "collide", "loop", collideRef, collideRef, queryCount );
+
+    // chain to chain collisions: scalar loops
+    chainRef.checksum = 0;
+    prof_start( &counter );
+
+    for( int i = 0; i < chainCount; i++ )
+        chainRef.checksum += scalarCollide( chains[i], others[i], clearance );
+
+    prof_end( &counter );
+    chainRef.msecs = counter.msecs();
+    report( "chain collide", "loop", chainRef, chainRef, chainCount );
+
+    // distances: scalar loop
+    distanceRef.checksum = 0;
+    prof_start( &counter );
+
+    for( int i = 0; i < queryCount; i++ )
+        distanceRef.checksum += scalarDistance( chains[i / queriesPerChain], queries[i] ) % 1000003;
+
+    prof_end( &counter );
+    distanceRef.msecs = counter.msecs();
+    report( "distance", "loop", distanceRef, distanceRef, queryCount );
+
+    SEG_ARRAY::KERNEL defaultKernel = SEG_ARRAY::Kernel();
+
+    for( int k = SEG_ARRAY::SCALAR; k <= SEG_ARRAY::AVX2; k++ )
+    {
+        SEG_ARRAY::KERNEL kernel = (SEG_ARRAY::KERNEL) k;
+
+        if( !SEG_ARRAY::SetKernel( kernel ) )
+            continue;
+
+        const char* name = SEG_ARRAY::KernelName( kernel );
+
+        // collisions against prebuilt arrays
+        result.checksum = 0;
+        prof_start( &counter );
+
+        for( int i = 0; i < queryCount; i++ )
+            result.checksum += arrays[i / queriesPerChain].Collide( queries[i], clearance );
+
+        prof_end( &counter );
+        result.msecs = counter.msecs();
+        report( "collide", name, result, collideRef, queryCount );
+
+        // chain to chain collisions through CollideShapes(), which builds an array of
+        // the first chain on each call
+        result.checksum = 0;
+        prof_start( &counter );
+
+        for( int i = 0; i < chainCount; i++ )
+        {
+            const SHAPE* shape = &chains[i];
+
+            result.checksum += shape->Collide( &others[i], clearance );
+        }
+
+        prof_end( &counter );
+        result.msecs = counter.msecs();
+        report( "chain collide", name, result, chainRef, chainCount );
+
+        // distances against prebuilt arrays
+        result.checksum = 0;
+        prof_start( &counter );
+
+        for( int i = 0; i < queryCount; i++ )
+            result.checksum += arrays[i / queriesPerChain].SquaredDistance( queries[i] ) % 1000003;
+
+        prof_end( &counter );
+        result.msecs = counter.msecs();
+        report( "distance", name, result, distanceRef, queryCount );
+    }
+
+    SEG_ARRAY::SetKernel( defaultKernel );
+
+    return 0;
+}
@@ -0,0 +1,416 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/**
+ * @file pns_replay.cpp
+ * @brief Replays a routing session recorded by the router tools against PNS_ROUTER,
+ * without any display, and reports the duration of each router operation.
+ *
+ * The session is recorded by running pcbnew with the KICAD_PNS_EVENT_LOG environment
+ * variable set to the name of the log file. The board given to the replay must be the
+ * board as it was when the recording started: the modifications done by the router
+ * are replayed, but not the ones done by the other tools.
+ *
+ * For each type of operation (start, move, fix, ...), the tool prints the number of
+ * operations, the 50th, 90th and 99th percentiles and the maximum of their duration,
+ * and the mean number of collision queries (and of those answered from the query cache),
+ * of branched nodes and of allocated items.
+ *
+ * usage: pns_replay [--parallel] board.kicad_pcb event_log
+ *        pns_replay --route-all board.kicad_pcb
+ *
+ * --parallel enables the parallel evaluation of the candidate paths (see
+ * PNS_ROUTING_SETTINGS::ParallelCandidates()), whatever the recorded settings.
+ *
+ * --route-all routes all the unconnected ratsnest lines of the board with PNS_BATCH_ROUTER,
+ * instead of replaying a session, and reports the success rate and the time per connection.
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <wx/init.h>
+
+#include <fctsys.h>
+#include <profile.h>
+#include <io_mgr.h>
+#include <richio.h>
+#include <class_board.h>
+#include <ratsnest_data.h>
+
+#include <router/pns_router.h>
+#include <router/pns_logger.h>
+#include <router/pns_batch_router.h>
+
+
+// Durations and counters of the operations of a given type
+struct EVENT_STATS
+{
+    EVENT_STATS() : m_collisionQueries( 0 ), m_cachedQueries( 0 ), m_branches( 0 ), m_allocs( 0 ) {}
+
+    std::vector<double> m_msecs;
+    long long m_collisionQueries;
+    long long m_cachedQueries;
+    long long m_branches;
+    long long m_allocs;
+};
+
+
+// Number of arguments of each type of event, see PNS_ROUTER
+static unsigned minArgCount( const std::string& aType )
+{
+    if( aType == "start" )
+        return 7;       // point, item, layer
+
+    if( aType == "drag" || aType == "move" || aType == "fix" )
+        return 6;       // point, item
+
+    if( aType == "mode" || aType == "layer" || aType == "ortho" )
+        return 1;
+
+    if( aType == "sizes" )
+        return 8;
+
+    if( aType == "settings" )
+        return 15;
+
+    return 0;
+}
+
+
+// Finds the item of an event, among the items found at the event point
+static PNS_ITEM* findItem( PNS_ROUTER& aRouter, const std::vector<int>& aArgs, int& aUnmatched )
+{
+    int kind = aArgs[2];
+
+    if( kind < 0 )
+        return NULL;
+
+    PNS_ITEMSET items = aRouter.QueryHoverItems( VECTOR2I( aArgs[0], aArgs[1] ) );
+
+    for( unsigned i = 0; i < items.Items().size(); i++ )
+    {
+        PNS_ITEM* item = items.Items()[i];
+
+        if( item->Kind() == kind && item->Net() == aArgs[3] &&
+            item->Layers().Start() == aArgs[4] && item->Layers().End() == aArgs[5] )
+            return item;
+    }
+
+    aUnmatched++;
+    return NULL;
+}
+
+
+static void loadSizes( PNS_ROUTER& aRouter, const std::vector<int>& aArgs )
+{
+    PNS_SIZES_SETTINGS sizes( aRouter.Sizes() );
+
+    sizes.SetTrackWidth( aArgs[0] );
+    sizes.SetDiffPairWidth( aArgs[1] );
+    sizes.SetDiffPairGap( aArgs[2] );
+    sizes.SetDiffPairViaGap( aArgs[3] );
+    sizes.SetDiffPairViaGapSameAsTraceGap( aArgs[4] );
+    sizes.SetViaDiameter( aArgs[5] );
+    sizes.SetViaDrill( aArgs[6] );
+    sizes.SetViaType( (PNS_VIA_TYPE) aArgs[7] );
+
+    sizes.ClearLayerPairs();
+
+    for( unsigned i = 8; i + 1 < aArgs.size(); i += 2 )
+        sizes.AddLayerPair( aArgs[i], aArgs[i + 1] );
+
+    aRouter.UpdateSizes( sizes );
+}
+
+
+static void loadSettings( PNS_ROUTER& aRouter, const std::vector<int>& aArgs, bool aForceParallel )
+{
+    PNS_ROUTING_SETTINGS settings( aRouter.Settings() );
+
+    settings.SetMode( (PNS_MODE) aArgs[0] );
+    settings.SetOptimizerEffort( (PNS_OPTIMIZATION_EFFORT) aArgs[1] );
+    settings.SetShoveVias( aArgs[2] );
+    settings.SetRemoveLoops( aArgs[3] );
+    settings.SetSmartPads( aArgs[4] );
+    settings.SetSuggestFinish( aArgs[5] );
+    settings.SetJumpOverObstacles( aArgs[6] );
+    settings.SetCanViolateDRC( aArgs[7] );
+    settings.SetSmoothDraggedSegments( aArgs[8] );
+    settings.SetFreeAngleMode( aArgs[9] );
+    settings.SetInlineDragEnabled( aArgs[10] );
+    settings.SetStartDiagonal( aArgs[11] );
+    settings.SetShoveIterationLimit( aArgs[12] );
+    settings.SetShoveTimeLimit( aArgs[13] );
+    settings.SetWalkaroundIterationLimit( aArgs[14] );
+
+    if( aArgs.size() > 15 )
+        settings.SetParallelCandidates( aArgs[15] );
+
+    if( aForceParallel )
+        settings.SetParallelCandidates( true );
+
+    aRouter.LoadSettings( settings );
+}
+
+
+// Returns the aRatio percentile of sorted values (nearest rank)
+static double percentile( const std::vector<double>& aSorted, double aRatio )
+{
+    int rank = (int) ceil( aRatio * aSorted.size() ) - 1;
+
+    return aSorted[std::max( 0, std::min( rank, (int) aSorted.size() - 1 ) )];
+}
+
+
+// Routes all the unconnected ratsnest lines of the board
+static void routeAll( PNS_ROUTER& aRouter )
+{
+    int unconnected = aRouter.GetBoard()->GetRatsnest()->GetUnconnectedCount();
+    PNS_BATCH_ROUTER batch( &aRouter );
+    const PNS_BATCH_ROUTER::STATS& stats = batch.RouteAll();
+
+    printf( "%d unconnected before, %d after\n", unconnected,
+            aRouter.GetBoard()->GetRatsnest()->GetUnconnectedCount() );
+    printf( "%d connections, %d routed (%.1f%%), %d ends not found, %.1f ms, %.3f ms/connection\n",
+            stats.m_connections, stats.m_routed, stats.SuccessRate() * 100.0, stats.m_unmatched,
+            stats.m_msecs, stats.MsecsPerConnection() );
+}
+
+
+int main( int argc, char** argv )
+{
+    bool forceParallel = argc == 4 && std::string( argv[1] ) == "--parallel";
+    bool batch = argc == 3 && std::string( argv[1] ) == "--route-all";
+
+    if( forceParallel || batch )
+    {
+        argv++;
+        argc--;
+    }
+
+    if( argc != 3 && !( batch && argc == 2 ) )
+    {
+        fprintf( stderr, "usage: %s [--parallel] board.kicad_pcb event_log\n"
+                         "       %s --route-all board.kicad_pcb\n", argv[0], argv[0] );
+        return 1;
+    }
+
+    wxInitializer initializer;
+
+    if( !initializer.IsOk() )
+    {
+        fprintf( stderr, "cannot initialize wxWidgets\n" );
+        return 1;
+    }
+
+    BOARD* board = NULL;
+
+    try
+    {
+        board = IO_MGR::Load( IO_MGR::KICAD, wxString::FromUTF8( argv[1] ) );
+    }
+    catch( const IO_ERROR& ioe )
+    {
+        fprintf( stderr, "%s\n", (const char*) ioe.errorText.mb_str() );
+        return 1;
+    }
+
+    if( batch )
+    {
+        board->GetRatsnest()->ProcessBoard();
+
+        PNS_ROUTER router;
+
+        router.SetBoard( board );
+        router.SyncWorld();
+        routeAll( router );
+
+        delete board;
+        return 0;
+    }
+
+    std::vector<PNS_LOGGER::EVENT> events;
+
+    if( !PNS_LOGGER::LoadEvents( argv[2], events ) )
+    {
+        fprintf( stderr, "cannot read '%s'\n", argv[2] );
+        delete board;
+        return 1;
+    }
+
+    board->GetRatsnest()->ProcessBoard();
+
+    PNS_ROUTER router;
+
+    router.SetBoard( board );
+    router.SyncWorld();
+    router.EnableSnapping( false );     // the recorded points are already snapped
+
+    std::map<std::string, EVENT_STATS> stats;
+    bool dragging = false;
+    int unmatched = 0;
+    int skipped = 0;
+    prof_counter total;
+
+    prof_start( &total );
+
+    for( unsigned i = 0; i < events.size(); i++ )
+    {
+        const std::string& type = events[i].m_type;
+        const std::vector<int>& args = events[i].m_args;
+
+        if( args.size() < minArgCount( type ) )
+        {
+            skipped++;
+            continue;
+        }
+
+        VECTOR2I p;
+        PNS_ITEM* item = NULL;
+
+        if( minArgCount( type ) >= 6 )
+        {
+            p = VECTOR2I( args[0], args[1] );
+
+            // The dragger ignores the end item, and has no placer to find it
+            if( !dragging )
+                item = findItem( router, args, unmatched );
+        }
+
+        prof_counter counter;
+        router.GetWorld()->ResetStats();
+        PNS_ITEM_POOL::ResetTotalStats();
+        prof_start( &counter );
+
+        if( type == "sync" )
+        {
+            router.SyncWorld();
+        }
+        else if( type == "mode" )
+        {
+            router.SetMode( (PNS_ROUTER_MODE) args[0] );
+        }
+        else if( type == "sizes" )
+        {
+            loadSizes( router, args );
+        }
+        else if( type == "settings" )
+        {
+            loadSettings( router, args, forceParallel );
+        }
+        else if( type == "start" )
+        {
+            router.StartRouting( p, item, args[6] );
+            dragging = false;
+        }
+        else if( type == "drag" )
+        {
+            dragging = router.StartDragging( p, item );
+        }
+        else if( type == "move" )
+        {
+            router.Move( p, item );
+        }
+        else if( type == "fix" )
+        {
+            if( router.FixRoute( p, item ) )
+                dragging = false;
+
+            router.ClearUndoBuffer();
+        }
+        else if( type == "stop" )
+        {
+            router.StopRouting();
+            dragging = false;
+        }
+        else if( type == "layer" )
+        {
+            router.SwitchLayer( args[0] );
+        }
+        else if( type == "flip" )
+        {
+            router.FlipPosture();
+        }
+        else if( type == "via" )
+        {
+            router.ToggleViaPlacement();
+        }
+        else if( type == "ortho" )
+        {
+            router.SetOrthoMode( args[0] );
+        }
+        else
+        {
+            skipped++;
+            continue;
+        }
+
+        prof_end( &counter );
+
+        EVENT_STATS& s = stats[type];
+        s.m_msecs.push_back( counter.msecs() );
+        s.m_collisionQueries += router.GetWorld()->Stats().m_collisionQueries;
+        s.m_cachedQueries += router.GetWorld()->Stats().m_cachedQueries;
+        s.m_branches += router.GetWorld()->Stats().m_branches;
+        s.m_allocs += router.AllocStats().m_allocs;
+    }
+
+    router.StopRouting();
+    prof_end( &total );
+
+    printf( "%u events, %d skipped, %d items not found, %.1f ms\n",
+            (unsigned) events.size(), skipped, unmatched, total.msecs() );
+    printf( "%-10s %8s %10s %10s %10s %10s %12s %12s %10s %10s\n", "event", "count",
+            "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)", "queries", "cached", "branches",
+            "allocs" );
+
+    for( std::map<std::string, EVENT_STATS>::iterator it = stats.begin(); it != stats.end(); ++it )
+    {
+        std::vector<double>& msecs = it->second.m_msecs;
+        int count = msecs.size();
+
+        std::sort( msecs.begin(), msecs.end() );
+
+        printf( "%-10s %8d %10.3f %10.3f %10.3f %10.3f %12.1f %12.1f %10.1f %10.1f\n",
+                it->first.c_str(), count, percentile( msecs, 0.5 ), percentile( msecs, 0.9 ),
+                percentile( msecs, 0.99 ), msecs.back(),
+                (double) it->second.m_collisionQueries / count,
+                (double) it->second.m_cachedQueries / count,
+                (double) it->second.m_branches / count,
+                (double) it->second.m_allocs / count );
+    }
+
+    PNS_ITEM_POOL::STATS pool = router.AllocStats();
+
+    printf( "%d joints in the final world, %lld items allocated, %lld reserved\n",
+            router.GetWorld()->JointCount(), pool.m_live, pool.m_reserved );
+
+    delete board;
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+/**
+ * @file recache_bench.cpp
+ * @brief Loads a board into a VIEW without any display, and measures VIEW::RecacheAllItems()
+ * drawing the items on a single thread and on several threads.
+ *
+ * The items are cached the way OPENGL_GAL does it: VERTEX_GAL generates the triangles of each
+ * group in a cached VERTEX_MANAGER, only the upload to the GPU is missing, so no window nor
+ * OpenGL context is needed. The parallel recache is measured twice: with the vertices built
+ * by the recache threads (GROUP_BUILDER), and with the recorded commands replayed on the main
+ * thread. All the recaches must give the same vertices.
+ *
+ * usage: recache_bench board.kicad_pcb [thread_count [repeat_count]]
+ *
+ * The thread count defaults to the number of hardware threads, each recache is repeated
+ * 5 times by default and the best time is reported.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <wx/init.h>
+
+#include <fctsys.h>
+#include <profile.h>
+#include <thread_pool.h>
+#include <io_mgr.h>
+#include <class_board.h>
+#include <class_module.h>
+#include <class_track.h>
+#include <class_zone.h>
+
+#include <view/view.h>
+#include <gal/opengl/vertex_gal.h>
+#include <gal/opengl/vertex_item.h>
+#include <pcb_painter.h>
+
+#include <boost/bind.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+
+
+// The groups cache of OPENGL_GAL, without the window
+class CACHED_VERTEX_GAL : public KIGFX::VERTEX_GAL
+{
+public:
+    CACHED_VERTEX_GAL() :
+        VERTEX_GAL( &m_cachedManager ), m_cachedManager( true ), m_groupCounter( 0 ),
+        m_useBuilders( true )
+    {
+    }
+
+    ~CACHED_VERTEX_GAL()
+    {
+        ClearCache();
+    }
+
+    virtual int BeginGroup()
+    {
+        boost::shared_ptr<KIGFX::VERTEX_ITEM> item( new KIGFX::VERTEX_ITEM( m_cachedManager ) );
+        m_groups[m_groupCounter] = item;
+
+        return m_groupCounter++;
+    }
+
+    virtual void EndGroup()
+    {
+        m_cachedManager.FinishItem();
+    }
+
+    virtual void DeleteGroup( int aGroupNumber )
+    {
+        m_groups.erase( aGroupNumber );
+    }
+
+    virtual void ClearCache()
+    {
+        m_groups.clear();
+        m_cachedManager.Clear();
+    }
+
+    virtual KIGFX::GROUP_BUILDER* CreateGroupBuilder()
+    {
+        if( !m_useBuilders )
+            return NULL;
+
+        return new KIGFX::VERTEX_GROUP_BUILDER( m_cachedManager );
+    }
+
+    /// Enables building the vertices on the recache threads
+    void UseBuilders( bool aEnable )
+    {
+        m_useBuilders = aEnable;
+    }
+
+    /// Copies the cached vertices in group order (i.e. in the order of the serial recache)
+    void GetVertices( int& aGroups, std::vector<KIGFX::VERTEX>& aVertices ) const
+    {
+        aGroups = m_groups.size();
+        aVertices.clear();
+
+        for( GROUPS_MAP::const_iterator it = m_groups.begin(); it != m_groups.end(); ++it )
+        {
+            const KIGFX::VERTEX* vertices = it->second->GetVertices();
+
+            aVertices.insert( aVertices.end(), vertices, vertices + it->second->GetSize() );
+        }
+    }
+
+private:
+    typedef std::map< int, boost::shared_ptr<KIGFX::VERTEX_ITEM> > GROUPS_MAP;
+
+    KIGFX::VERTEX_MANAGER   m_cachedManager;
+    GROUPS_MAP              m_groups;
+    int                     m_groupCounter;
+    bool                    m_useBuilders;
+};
+
+
+static void appendItem( std::vector<KIGFX::VIEW_ITEM*>* aItems, BOARD_ITEM* aItem )
+{
+    aItems->push_back( aItem );
+}
+
+
+static double recache( KIGFX::VIEW& aView, int aThreads, int aRepeat )
+{
+    prof_counter counter;
+    double best = 0.0;
+
+    aView.SetRecacheThreadCount( aThreads );
+
+    for( int i = 0; i < aRepeat; i++ )
+    {
+        prof_start( &counter );
+        aView.RecacheAllItems( true );
+        prof_end( &counter );
+
+        if( i == 0 || counter.msecs() < best )
+            best = counter.msecs();
+    }
+
+    return best;
+}
+
+
+int main( int argc, char** argv )
+{
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: %s board.kicad_pcb [thread_count [repeat_count]]\n", argv[0] );
+        return 1;
+    }
+
+    int threads = argc > 2 ? atoi( argv[2] ) : THREAD_POOL::DefaultThreadCount();
+    int repeat = argc > 3 ? atoi( argv[3] ) : 5;
+
+    wxInitializer initializer;
+
+    if( !initializer.IsOk() )
+    {
+        fprintf( stderr, "cannot initialize wxWidgets\n" );
+        return 1;
+    }
+
+    BOARD* board = NULL;
+
+    try
+    {
+        board = IO_MGR::Load( IO_MGR::KICAD, wxString::FromUTF8( argv[1] ) );
+    }
+    catch( const IO_ERROR& ioe )
+    {
+        fprintf( stderr, "%s\n", (const char*) ioe.errorText.mb_str() );
+        return 1;
+    }
+
+    CACHED_VERTEX_GAL gal;
+    KIGFX::PCB_PAINTER painter( &gal );
+    KIGFX::VIEW view( false );
+
+    view.SetGAL( &gal );
+    view.SetPainter( &painter );
+
+    // the same items as PCB_DRAW_PANEL_GAL::DisplayBoard()
+    std::vector<KIGFX::VIEW_ITEM*> items;
+
+    for( int i = 0; i < board->GetAreaCount(); ++i )
+        items.push_back( board->GetArea( i ) );
+
+    for( BOARD_ITEM* drawing = board->m_Drawings; drawing; drawing = drawing->Next() )
+        items.push_back( drawing );
+
+    for( TRACK* track = board->m_Track; track; track = track->Next() )
+        items.push_back( track );
+
+    for( MODULE* module = board->m_Modules; module; module = module->Next() )
+    {
+        module->RunOnChildren( boost::bind( &appendItem, &items, _1 ) );
+        items.push_back( module );
+    }
+
+    for( SEGZONE* zone = board->m_Zone; zone; zone = zone->Next() )
+        items.push_back( zone );
+
+    view.AddItems( items );
+
+    int groups;
+    std::vector<KIGFX::VERTEX> vertices;
+
+    double serial = recache( view, 1, repeat );
+    gal.GetVertices( groups, vertices );
+
+    printf( "%u items, %d groups, %u vertices\n", (unsigned) items.size(), groups,
+            (unsigned) vertices.size() );
+    printf( "1 thread               %10.3f ms\n", serial );
+
+    for( int i = 0; i < 2; i++ )
+    {
+        bool build = ( i == 0 );
+
+        gal.UseBuilders( build );
+
+        double parallel = recache( view, threads, repeat );
+        int pGroups;
+        std::vector<KIGFX::VERTEX> pVertices;
+
+        gal.GetVertices( pGroups, pVertices );
+
+        // The vertices must be the same as the serial ones, bit for bit
+        bool same = pGroups == groups && pVertices.size() == vertices.size() &&
+                    ( vertices.empty() || memcmp( &pVertices[0], &vertices[0],
+                                                  vertices.size() * sizeof( KIGFX::VERTEX ) ) == 0 );
+
+        printf( "%-3d threads, %-8s %10.3f ms %8.2fx %s\n", threads,
+                build ? "built" : "replayed", parallel, serial / parallel,
+                same ? "" : "MISMATCH" );
+    }
+
+    delete board;
+
+    return 0;
+}
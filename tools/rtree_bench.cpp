@@ -0,0 +1,175 @@
+/*
+ * This program source code file is part of KiCad, a free EDA CAD application.
+ *
+ * Copyright (C) 2015 KiCad Developers, see change_log.txt for contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, you may find one here:
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
+ * or you may search the http://www.gnu.org website for the version 2 license,
+ * or you may write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+/**
+ * @file rtree_bench.cpp
+ * @brief Benchmark of the R-tree used by the VIEW layers: loading items one by one vs. bulk
+ * loading (Sort-Tile-Recursive), window queries on both trees, and item removal searched with
+ * the whole plane (as VIEW_RTREE used to do) vs. the bounding box of the item.
+ *
+ * The items look like the items of a board: mostly small boxes (pads, vias, short tracks)
+ * and a few large ones (zones, long tracks). The queries must give the same results on both
+ * trees.
+ *
+ * usage: rtree_bench [item_count]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <vector>
+
+#include <profile.h>
+#include <geometry/rtree.h>
+
+
+typedef RTree<long, int, 2, float> TREE;
+
+static const int    areaSize = 300000000;     // 300 mm
+static const int    queryCount = 2000;
+static const int    removeCount = 2000;
+
+
+static int randomCoord( int aMax )
+{
+    return (int) ( (double) rand() / RAND_MAX * aMax );
+}
+
+
+static void randomBox( int aMin[2], int aMax[2] )
+{
+    // 1% large items, the others up to 2 mm
+    int size = rand() % 100 ? 2000000 : 50000000;
+
+    aMin[0] = randomCoord( areaSize );
+    aMin[1] = randomCoord( areaSize );
+    aMax[0] = aMin[0] + randomCoord( size );
+    aMax[1] = aMin[1] + randomCoord( size );
+}
+
+
+static bool countItem( long aItem, void* aContext )
+{
+    long long* sum = (long long*) aContext;
+
+    *sum += aItem;
+    return true;
+}
+
+
+static long long query( TREE& aTree, const std::vector<int>& aQueries )
+{
+    long long sum = 0;
+
+    for( int i = 0; i < queryCount; i++ )
+        aTree.Search( &aQueries[4 * i], &aQueries[4 * i + 2], countItem, &sum );
+
+    return sum;
+}
+
+
+int main( int argc, char** argv )
+{
+    int itemCount = argc > 1 ? atoi( argv[1] ) : 200000;
+
+    srand( 1 );
+
+    std::vector<int> mins( 2 * itemCount ), maxs( 2 * itemCount );
+    std::vector<long> ids( itemCount );
+
+    for( int i = 0; i < itemCount; i++ )
+    {
+        randomBox( &mins[2 * i], &maxs[2 * i] );
+        ids[i] = i;
+    }
+
+    // queries of the size of a zoomed in view, stored as min x, min y, max x, max y
+    std::vector<int> queries( 4 * queryCount );
+
+    for( int i = 0; i < queryCount; i++ )
+    {
+        int min[2], max[2];
+
+        randomBox( min, max );
+        queries[4 * i] = min[0];
+        queries[4 * i + 1] = min[1];
+        queries[4 * i + 2] = min[0] + 20000000;
+        queries[4 * i + 3] = min[1] + 20000000;
+    }
+
+    prof_counter counter;
+    TREE inserted, bulk;
+
+    printf( "%d items\n", itemCount );
+
+    prof_start( &counter );
+
+    for( int i = 0; i < itemCount; i++ )
+        inserted.Insert( &mins[2 * i], &maxs[2 * i], ids[i] );
+
+    prof_end( &counter );
+    printf( "insert one by one   %10.3f ms\n", counter.msecs() );
+
+    prof_start( &counter );
+    bulk.BulkLoad( itemCount, &mins[0], &maxs[0], &ids[0] );
+    prof_end( &counter );
+    printf( "bulk load           %10.3f ms\n", counter.msecs() );
+
+    long long insertedSum, bulkSum;
+
+    prof_start( &counter );
+    insertedSum = query( inserted, queries );
+    prof_end( &counter );
+    printf( "query (inserted)    %10.3f ms\n", counter.msecs() );
+
+    prof_start( &counter );
+    bulkSum = query( bulk, queries );
+    prof_end( &counter );
+    printf( "query (bulk loaded) %10.3f ms %s\n", counter.msecs(),
+            insertedSum == bulkSum ? "" : "MISMATCH" );
+
+    // removals, from the first and then the second half of the items
+    const int   planeMin[2] = { INT_MIN, INT_MIN };
+    const int   planeMax[2] = { INT_MAX, INT_MAX };
+    int         count = std::min( removeCount, itemCount / 2 );
+
+    prof_start( &counter );
+
+    for( int i = 0; i < count; i++ )
+        bulk.Remove( planeMin, planeMax, ids[i] );
+
+    prof_end( &counter );
+    printf( "remove (plane)      %10.3f ms\n", counter.msecs() );
+
+    prof_start( &counter );
+
+    for( int i = itemCount - count; i < itemCount; i++ )
+        bulk.Remove( &mins[2 * i], &maxs[2 * i], ids[i] );
+
+    prof_end( &counter );
+    printf( "remove (bbox)       %10.3f ms %s\n", counter.msecs(),
+            bulk.Count() == itemCount - 2 * count ? "" : "MISMATCH" );
+
+    return 0;
+}